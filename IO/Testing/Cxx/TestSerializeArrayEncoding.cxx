@@ -0,0 +1,183 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test writes a double, an int and an id type array and a transform
+// with vtkKWEXMLArchiveWriter, as ASCII, as base64 and as compressed base64,
+// and reads them back with vtkKWEXMLArchiveReader. The arrays read as base64
+// must be equal to those written, and the compressed archive smaller than the
+// uncompressed one. The size of the archives and the time taken to write and
+// read them are printed.
+
+#include "vtkKWEXMLArchiveWriter.h"
+#include "vtkKWEXMLArchiveReader.h"
+
+#include "vtkCommonInstantiator.h"
+#include "vtkDoubleArray.h"
+#include "vtkIdTypeArray.h"
+#include "vtkIntArray.h"
+#include "vtkMath.h"
+#include "vtkMatrix4x4.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+#include "vtkTransform.h"
+
+#include <vtksys/ios/sstream>
+
+#define VTK_CREATE(type, var) \
+  vtkSmartPointer<type> var = vtkSmartPointer<type>::New()
+
+#define fail(msg) \
+  std::cerr << msg << std::endl; \
+  return EXIT_FAILURE;
+
+namespace
+{
+// Are the arrays equal, exactly or to the precision of the ASCII values ?
+template <typename ArrayType>
+bool CompareArrays(vtkDataArray* written, vtkObject* readObject, bool exact)
+{
+  ArrayType* read = ArrayType::SafeDownCast(readObject);
+  if (!read ||
+      read->GetNumberOfComponents() != written->GetNumberOfComponents() ||
+      read->GetNumberOfTuples() != written->GetNumberOfTuples())
+    {
+    return false;
+    }
+  vtkIdType n = written->GetNumberOfTuples() *
+    written->GetNumberOfComponents();
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    double a = static_cast<ArrayType*>(written)->GetValue(i);
+    double b = read->GetValue(i);
+    if (exact ? a != b : fabs(a - b) > 1e-5 * (fabs(a) + 1.0))
+      {
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int TestSerializeArrayEncoding(int vtkNotUsed(argc), char *vtkNotUsed(argv)[])
+{
+  const vtkIdType numberOfTuples = 100000;
+
+  VTK_CREATE(vtkDoubleArray, doubles);
+  doubles->SetNumberOfComponents(3);
+  doubles->SetNumberOfTuples(numberOfTuples);
+  VTK_CREATE(vtkIntArray, ints);
+  ints->SetNumberOfTuples(numberOfTuples);
+  VTK_CREATE(vtkIdTypeArray, ids);
+  ids->SetNumberOfComponents(2);
+  ids->SetNumberOfTuples(numberOfTuples);
+
+  vtkMath::RandomSeed(1);
+  for (vtkIdType i = 0; i < numberOfTuples; ++i)
+    {
+    doubles->SetTuple3(i, vtkMath::Random(-1000.0, 1000.0),
+      vtkMath::Random(), static_cast<double>(i) / 3.0);
+    ints->SetValue(i, static_cast<int>(vtkMath::Random(-1e6, 1e6)));
+    ids->SetValue(2 * i, i);
+    ids->SetValue(2 * i + 1, numberOfTuples - i);
+    }
+
+  VTK_CREATE(vtkTransform, transform);
+  transform->RotateWXYZ(30.0, 1.0, 2.0, 3.0);
+  transform->Translate(0.1, 0.2, 0.3);
+
+  const char* names[3] = { "ASCII", "Base64", "Base64 + zlib" };
+  size_t sizes[3];
+  for (int mode = 0; mode < 3; ++mode)
+    {
+    VTK_CREATE(vtkKWEXMLArchiveWriter, writer);
+    if (mode > 0)
+      {
+      writer->SetArrayEncodingToBase64();
+      }
+    writer->SetCompressArrays(mode == 2);
+
+    vtkstd::vector<vtkSmartPointer<vtkObject> > objs;
+    objs.push_back(doubles);
+    objs.push_back(ints);
+    objs.push_back(ids);
+    objs.push_back(transform);
+
+    VTK_CREATE(vtkTimerLog, timer);
+    vtksys_ios::stringstream xmlStream;
+    timer->StartTimer();
+    writer->Serialize(xmlStream, "Arrays", objs);
+    timer->StopTimer();
+    double writeTime = timer->GetElapsedTime();
+    sizes[mode] = xmlStream.str().size();
+
+    VTK_CREATE(vtkKWEXMLArchiveReader, reader);
+    objs.clear();
+    timer->StartTimer();
+    reader->Serialize(xmlStream, "Arrays", objs);
+    timer->StopTimer();
+    double readTime = timer->GetElapsedTime();
+
+    cout << names[mode] << ": " << sizes[mode] << " bytes, written in "
+         << writeTime << " s, read in " << readTime << " s" << endl;
+
+    if (objs.size() != 4)
+      {
+      fail(names[mode] << ": reader didn't produce correct number of objects.");
+      }
+    bool exact = (mode > 0);
+    if (!CompareArrays<vtkDoubleArray>(doubles, objs[0], exact))
+      {
+      fail(names[mode] << ": double array has incorrect values.");
+      }
+    if (!CompareArrays<vtkIntArray>(ints, objs[1], true))
+      {
+      fail(names[mode] << ": int array has incorrect values.");
+      }
+    if (!CompareArrays<vtkIdTypeArray>(ids, objs[2], true))
+      {
+      fail(names[mode] << ": id type array has incorrect values.");
+      }
+
+    vtkTransform* newTransform = vtkTransform::SafeDownCast(objs[3]);
+    if (!newTransform)
+      {
+      fail(names[mode] << ": transform was not read.");
+      }
+    for (int i = 0; i < 4; ++i)
+      {
+      for (int j = 0; j < 4; ++j)
+        {
+        double a = transform->GetMatrix()->GetElement(i, j);
+        double b = newTransform->GetMatrix()->GetElement(i, j);
+        if (exact ? a != b : fabs(a - b) > 1e-5)
+          {
+          fail(names[mode] << ": transform has incorrect matrix.");
+          }
+        }
+      }
+    }
+
+  if (sizes[2] >= sizes[1])
+    {
+    fail("The compressed archive is not smaller than the uncompressed one.");
+    }
+
+  return EXIT_SUCCESS;
+}
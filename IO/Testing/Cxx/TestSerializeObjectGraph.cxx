@@ -0,0 +1,269 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test writes a tree of vtkInformation objects, each holding its index,
+// an array and its children, with vtkKWEXMLArchiveWriter. The writer puts
+// the children after their parent in the archive, so that most references
+// are to objects further in it. The tree is read back with
+// vtkKWEXMLArchiveReader from a stream, and from the DOM of the archive, and
+// must be the tree written. The nodes are also written in reverse order as
+// root objects, so that their references are to objects before them.
+// Last, a chain of serializable objects, each reading the index of the next
+// one when it is read, checks that the objects referenced further in the
+// archive are read before the objects referencing them.
+
+#include "vtkKWEXMLArchiveWriter.h"
+#include "vtkKWEXMLArchiveReader.h"
+#include "vtkKWEXMLElement.h"
+#include "vtkKWEXMLParser.h"
+#include "vtkKWEInformationKeyMap.h"
+#include "vtkKWESerializableObject.h"
+
+#include "vtkCommonInstantiator.h"
+#include "vtkDoubleArray.h"
+#include "vtkInformation.h"
+#include "vtkInformationIntegerKey.h"
+#include "vtkInformationObjectBaseKey.h"
+#include "vtkInformationObjectBaseVectorKey.h"
+#include "vtkInstantiator.h"
+#include "vtkObjectFactory.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+
+#include <vtksys/ios/sstream>
+
+#define VTK_CREATE(type, var) \
+  vtkSmartPointer<type> var = vtkSmartPointer<type>::New()
+
+#define fail(msg) \
+  std::cerr << msg << std::endl; \
+  return EXIT_FAILURE;
+
+namespace
+{
+class TestClass
+{
+public:
+  // The keys
+  static vtkInformationIntegerKey*           Index();
+  static vtkInformationObjectBaseKey*        Array();
+  static vtkInformationObjectBaseVectorKey*  Children();
+};
+
+vtkInformationKeyMacro(TestClass, Index,    Integer);
+vtkInformationKeyMacro(TestClass, Array,    ObjectBase);
+vtkInformationKeyMacro(TestClass, Children, ObjectBaseVector);
+
+const int NumberOfChildren = 3;
+const int Depth = 6;
+
+// A node of the tree and its descendants, numbered from index in pre-order.
+vtkInformation* NewTree(int depth, int& index,
+  vtkstd::vector<vtkSmartPointer<vtkObject> >& nodes)
+{
+  vtkInformation* node = vtkInformation::New();
+  nodes.push_back(node);
+  node->Set(TestClass::Index(), index);
+  VTK_CREATE(vtkDoubleArray, array);
+  array->InsertNextValue(index);
+  array->InsertNextValue(0.5 * index);
+  node->Set(TestClass::Array(), array);
+  ++index;
+
+  if (depth > 1)
+    {
+    for (int i = 0; i < NumberOfChildren; ++i)
+      {
+      vtkInformation* child = NewTree(depth - 1, index, nodes);
+      TestClass::Children()->Set(node, child, i);
+      child->Delete();
+      }
+    }
+  return node;
+}
+
+// A link of a chain. When read, it reads the index of the next link, which
+// must then have been read.
+class TestChainLink : public vtkKWESerializableObject
+{
+public:
+  static TestChainLink* New();
+  vtkTypeRevisionMacro(TestChainLink, vtkKWESerializableObject);
+
+  int Index;
+  int NextIndex;
+  vtkSmartPointer<TestChainLink> Next;
+
+  virtual void Serialize(vtkKWESerializer* ser)
+    {
+    ser->Serialize("Index", this->Index);
+    vtkObject* next = this->Next;
+    ser->Serialize("Next", next);
+    if (!ser->IsWriting())
+      {
+      this->Next.TakeReference(TestChainLink::SafeDownCast(next));
+      this->NextIndex = this->Next ? this->Next->Index : -1;
+      }
+    }
+
+protected:
+  TestChainLink() : Index(-1), NextIndex(-1) {}
+};
+
+vtkCxxRevisionMacro(TestChainLink, "$Revision: 1774 $");
+vtkStandardNewMacro(TestChainLink);
+
+vtkObject* NewTestChainLink()
+{
+  return TestChainLink::New();
+}
+
+// Is node the tree numbered from index ?
+bool CheckTree(vtkInformation* node, int depth, int& index)
+{
+  vtkDoubleArray* array = node ?
+    vtkDoubleArray::SafeDownCast(node->Get(TestClass::Array())) : 0;
+  if (!array || node->Get(TestClass::Index()) != index ||
+      array->GetNumberOfTuples() != 2 || array->GetValue(0) != index ||
+      array->GetValue(1) != 0.5 * index)
+    {
+    return false;
+    }
+  ++index;
+
+  int numberOfChildren = (depth > 1 ? NumberOfChildren : 0);
+  if (TestClass::Children()->Size(node) != numberOfChildren)
+    {
+    return false;
+    }
+  for (int i = 0; i < numberOfChildren; ++i)
+    {
+    if (!CheckTree(vtkInformation::SafeDownCast(
+          TestClass::Children()->Get(node, i)), depth - 1, index))
+      {
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int TestSerializeObjectGraph(int vtkNotUsed(argc), char *vtkNotUsed(argv)[])
+{
+  vtkKWEInformationKeyMap::RegisterKey(TestClass::Index());
+  vtkKWEInformationKeyMap::RegisterKey(TestClass::Array());
+  vtkKWEInformationKeyMap::RegisterKey(TestClass::Children());
+
+  int numberOfNodes = 0;
+  vtkstd::vector<vtkSmartPointer<vtkObject> > nodes;
+  vtkSmartPointer<vtkInformation> root;
+  root.TakeReference(NewTree(Depth, numberOfNodes, nodes));
+
+  VTK_CREATE(vtkKWEXMLArchiveWriter, writer);
+  vtkstd::vector<vtkSmartPointer<vtkObject> > objs;
+  objs.push_back(root);
+  vtksys_ios::stringstream xmlStream;
+  writer->Serialize(xmlStream, "Tree", objs);
+
+  // Read the archive from the stream.
+  VTK_CREATE(vtkKWEXMLArchiveReader, reader);
+  VTK_CREATE(vtkTimerLog, timer);
+  objs.clear();
+  timer->StartTimer();
+  reader->Serialize(xmlStream, "Tree", objs);
+  timer->StopTimer();
+  cout << numberOfNodes << " nodes, " << xmlStream.str().size()
+       << " bytes, read in " << timer->GetElapsedTime() << " s" << endl;
+
+  int index = 0;
+  if (objs.size() != 1 ||
+      !CheckTree(vtkInformation::SafeDownCast(objs[0]), Depth, index))
+    {
+    fail("The tree read from the stream is not the tree written.");
+    }
+
+  // Read the archive from its DOM.
+  VTK_CREATE(vtkKWEXMLParser, parser);
+  vtksys_ios::stringstream domStream(xmlStream.str());
+  parser->SetStream(&domStream);
+  if (!parser->Parse())
+    {
+    fail("Could not parse the archive.");
+    }
+  objs.clear();
+  reader->Serialize(parser->GetRootElement(), "Tree", objs);
+  index = 0;
+  if (objs.size() != 1 ||
+      !CheckTree(vtkInformation::SafeDownCast(objs[0]), Depth, index))
+    {
+    fail("The tree read from the DOM is not the tree written.");
+    }
+
+  // Write all the nodes as root objects, the last leaf first: each node is
+  // then written after the children it references.
+  objs.clear();
+  objs.insert(objs.end(), nodes.rbegin(), nodes.rend());
+  vtksys_ios::stringstream reverseStream;
+  writer->Serialize(reverseStream, "Nodes", objs);
+  objs.clear();
+  reader->Serialize(reverseStream, "Nodes", objs);
+  if (objs.size() != nodes.size())
+    {
+    fail("Not all the nodes were read.");
+    }
+  index = 0;
+  if (!CheckTree(vtkInformation::SafeDownCast(objs.back()), Depth, index))
+    {
+    fail("The nodes read are not the nodes written.");
+    }
+
+  // A chain, written from its first link: each link is written before the
+  // next one, which must still be read first.
+  const int numberOfLinks = 20;
+  vtkInstantiator::RegisterInstantiator("TestChainLink", NewTestChainLink);
+  VTK_CREATE(TestChainLink, first);
+  TestChainLink* link = first;
+  for (int i = 0; i < numberOfLinks; ++i)
+    {
+    link->Index = i;
+    if (i < numberOfLinks - 1)
+      {
+      link->Next = vtkSmartPointer<TestChainLink>::New();
+      link = link->Next;
+      }
+    }
+  objs.clear();
+  objs.push_back(first);
+  vtksys_ios::stringstream chainStream;
+  writer->Serialize(chainStream, "Chain", objs);
+  objs.clear();
+  reader->Serialize(chainStream, "Chain", objs);
+  link = objs.size() == 1 ? TestChainLink::SafeDownCast(objs[0]) : 0;
+  for (int i = 0; i < numberOfLinks; ++i, link = link->Next)
+    {
+    if (!link || link->Index != i ||
+        link->NextIndex != (i < numberOfLinks - 1 ? i + 1 : -1))
+      {
+      fail("Link " << i << " was read before the link it references.");
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -116,9 +116,10 @@ void vtkKWECommonSerializationHelper::SerializeDataArray(vtkDataArray *dataArray
 
     // Upon reading we are going to be limited to array of length vtkIdType,
     // which if not using 64-bit ID's means at most ~2^31 (~2 billion) values...
-    // which is a LOT when considering this will be written as ASCII (this
-    // serialization is NOT intended for storing LARGE data).  Therefore, for the
-    // time being, we write out at most what can be represented by an int.
+    // which is a LOT when considering this will be written as ASCII or base64
+    // (this serialization is NOT intended for storing LARGE data).  Therefore,
+    // for the time being, we write out at most what can be represented by an
+    // int.
     unsigned long numberOfValuesLong = dataArray->GetDataSize();
     unsigned int numberOfValues = static_cast<unsigned int>(
       static_cast<int>(numberOfValuesLong) );
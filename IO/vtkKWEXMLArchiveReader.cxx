@@ -20,6 +20,8 @@
 //=============================================================================
 #include "vtkKWEXMLArchiveReader.h"
 
+#include "vtkBase64Utilities.h"
+#include "vtkByteSwap.h"
 #include "vtkInformation.h"
 #include "vtkInformationDoubleKey.h"
 #include "vtkInformationIdTypeKey.h"
@@ -39,9 +41,13 @@
 #include "vtkKWEXMLParser.h"
 #include "vtkObjectFactory.h"
 #include "vtkSmartPointer.h"
+#include "vtkZLibDataCompressor.h"
 
+#include <vtkstd/algorithm>
 #include <vtkstd/list>
 #include <vtkstd/map>
+#include <vtkstd/set>
+#include <vtkstd/vector>
 #include <vtksys/SystemTools.hxx>
 #include <vtksys/ios/sstream>
 
@@ -50,20 +56,25 @@ vtkStandardNewMacro(vtkKWEXMLArchiveReader);
 
 vtkCxxSetObjectMacro(vtkKWEXMLArchiveReader, RootElement, vtkKWEXMLElement);
 
+struct vtkKWEXMLArchiveReaderPendingObject
+{
+  vtkSmartPointer<vtkKWEXMLElement> Element;
+  int NumberOfMissingReferences;
+};
+
 struct vtkKWEXMLArchiveReaderInternals
 {
-  vtkstd::map<int, vtkKWEXMLElement*> IdToElement;
+  // The elements of the objects that were parsed, but that reference
+  // objects that were not read yet, by object id. They are the only elements
+  // kept once parsed.
+  vtkstd::map<int, vtkKWEXMLArchiveReaderPendingObject> PendingObjects;
 
-  vtkKWEXMLElement* FindElement(int id)
-  {
-    vtkstd::map<int, vtkKWEXMLElement*>::iterator iter =
-      this->IdToElement.find(id);
-    if (iter != this->IdToElement.end())
-      {
-      return iter->second;
-      }
-    return 0;
-  }
+  // For each id of an object that was not read yet, the ids of the pending
+  // objects that reference it.
+  vtkstd::map<int, vtkstd::vector<int> > PendingReferences;
+
+  // The ids of the objects that were read.
+  vtkstd::set<int> ReadIds;
 
   vtkstd::map<int, vtkObject*> IdToObject;
 
@@ -97,10 +108,53 @@ struct vtkKWEXMLArchiveReaderInternals
   // Stack to hold all the serializable objects; to support a weakPtr
   // to an object that is read before the object being referred to is created.
   // The ObjectStack holds an extra reference to all objects to prevent leaks
-  // while supoorting this situtation (see comment in ReadObject).
+  // while supoorting this situtation (see comment in StartObjectElement).
   vtkstd::list<vtkSmartPointer<vtkObject> > ObjectStack;
 };
 
+//----------------------------------------------------------------------------
+// Parser handing the Object elements of an archive to the reader as they are
+// parsed, instead of adding them to the DOM of the archive. Only the root
+// element and the RootObjects element are kept in the DOM.
+class vtkKWEXMLArchiveReaderParser : public vtkKWEXMLParser
+{
+public:
+  static vtkKWEXMLArchiveReaderParser *New()
+    { return new vtkKWEXMLArchiveReaderParser; }
+
+  vtkKWEXMLArchiveReader* Reader;
+
+protected:
+  vtkKWEXMLArchiveReaderParser() : Reader(0) {}
+
+  virtual void StartElement(const char* name, const char** atts)
+    {
+    this->vtkKWEXMLParser::StartElement(name, atts);
+    if (this->NumberOfOpenElements == 1)
+      {
+      this->Reader->ReadArchiveVersion(this->OpenElements[0]);
+      }
+    else if (this->NumberOfOpenElements == 2 && strcmp(name, "Object") == 0)
+      {
+      this->Reader->StartObjectElement(this->OpenElements[1]);
+      }
+    }
+
+  virtual void EndElement(const char* name)
+    {
+    if (this->NumberOfOpenElements == 2 && strcmp(name, "Object") == 0)
+      {
+      vtkKWEXMLElement* finished = this->PopOpenElement();
+      this->Reader->EndObjectElement(finished);
+      finished->Delete();
+      }
+    else
+      {
+      this->vtkKWEXMLParser::EndElement(name);
+      }
+    }
+};
+
 
 
 //----------------------------------------------------------------------------
@@ -140,32 +194,28 @@ void vtkKWEXMLArchiveReader::Serialize(vtkKWEXMLElement *rootElement,
   this->Internal = new vtkKWEXMLArchiveReaderInternals;
   objs.clear();
 
+  // Hand the objects to the reader in the order the parser would have.
   this->SetRootElement(rootElement);
-  this->Serialize(objs);
-}
-
-//----------------------------------------------------------------------------
-void vtkKWEXMLArchiveReader::Serialize(vtkstd::vector<vtkSmartPointer<vtkObject> >& objs)
-{
-  unsigned int nnested = this->RootElement->GetNumberOfNestedElements();
+  this->ReadArchiveVersion(rootElement);
+  unsigned int nnested = rootElement->GetNumberOfNestedElements();
   for (unsigned int i=0; i<nnested; i++)
     {
-    vtkKWEXMLElement* elem = this->RootElement->GetNestedElement(i);
-    int id;
-    if (elem->GetScalarAttribute("id", &id))
+    vtkKWEXMLElement* elem = rootElement->GetNestedElement(i);
+    if (elem->GetName() && strcmp(elem->GetName(), "Object") == 0)
       {
-      this->Internal->IdToElement[id] = elem;
+      this->StartObjectElement(elem);
+      this->EndObjectElement(elem);
       }
     }
+  this->Serialize(objs);
+}
 
-  unsigned int version;
-  if (this->RootElement->GetScalarAttribute("version", &version))
-    {
-    this->SetArchiveVersion(version);
-    }
+//----------------------------------------------------------------------------
+void vtkKWEXMLArchiveReader::Serialize(vtkstd::vector<vtkSmartPointer<vtkObject> >& objs)
+{
+  this->ReadPendingObjects();
 
   this->Internal->Push(this->RootElement);
-  this->Internal->ObjectStack.clear(); // just to be sure
   this->Serialize("RootObjects", objs);
   this->Internal->Pop();
 
@@ -174,48 +224,187 @@ void vtkKWEXMLArchiveReader::Serialize(vtkstd::vector<vtkSmartPointer<vtkObject>
 }
 
 //----------------------------------------------------------------------------
-vtkObject* vtkKWEXMLArchiveReader::ReadObject(int id, bool weakPtr)
+void vtkKWEXMLArchiveReader::ReadArchiveVersion(vtkKWEXMLElement* rootElement)
+{
+  unsigned int version;
+  if (rootElement->GetScalarAttribute("version", &version))
+    {
+    this->SetArchiveVersion(version);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEXMLArchiveReader::StartObjectElement(vtkKWEXMLElement* elem)
 {
   // There will never be an object with id 0
-  if (id == 0)
+  int id;
+  if (!elem->GetScalarAttribute("id", &id) || id == 0)
     {
-    return 0;
+    return;
     }
 
-  vtkObject* obj = this->Internal->FindObject(id);
-  if (obj)
+  const char* className = elem->GetAttribute("type");
+  vtkObject* obj =
+    vtkObject::SafeDownCast(vtkInstantiator::CreateInstance(className));
+  if (!obj)
+    {
+    vtkErrorMacro("Could not create object of type " << className)
+    return;
+    }
+
+  // The object may be referenced before it is read, and may only have weak
+  // references. The ObjectStack holds the only reference until non-weak
+  // references are made to the object (and registered in ReadObject). The
+  // extra reference held by the ObjectStack gets removed when we are done
+  // reading (delete the this->Internal structure).
+  this->Internal->ObjectStack.push_back( obj );
+  obj->UnRegister(0);
+  this->Internal->IdToObject[id] = obj;
+}
+
+namespace
+{
+// Gathers the ids of the objects referenced in elem and its nested elements,
+// by Pointer elements and object keys of vtkInformation.
+void GetReferencedIds(vtkKWEXMLElement* elem, vtkstd::vector<int>& ids)
+{
+  int id;
+  if (elem->GetScalarAttribute("to_id", &id) && id != 0)
+    {
+    ids.push_back(id);
+    }
+  unsigned int length;
+  if (elem->GetAttribute("ids") &&
+    elem->GetScalarAttribute("length", &length) && length > 0)
     {
-    if (!weakPtr)
+    vtkstd::vector<unsigned long> vecIds(length);
+    unsigned int n = elem->GetVectorAttribute("ids", length, &vecIds[0]);
+    for (unsigned int i = 0; i < n; ++i)
       {
-      obj->Register(0);
+      if (vecIds[i] != 0)
+        {
+        ids.push_back(static_cast<int>(vecIds[i]));
+        }
       }
-    return obj;
     }
 
-  vtkKWEXMLElement* elem = this->Internal->FindElement(id);
-  if (!elem)
+  unsigned int nnested = elem->GetNumberOfNestedElements();
+  for (unsigned int i=0; i<nnested; i++)
     {
-    vtkErrorMacro("Could not find of id " << id)
-    return 0;
+    GetReferencedIds(elem->GetNestedElement(i), ids);
     }
-  const char* className = elem->GetAttribute("type");
-  obj = vtkObject::SafeDownCast(vtkInstantiator::CreateInstance(className));
+}
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEXMLArchiveReader::EndObjectElement(vtkKWEXMLElement* elem)
+{
+  int id;
+  if (!elem->GetScalarAttribute("id", &id))
+    {
+    return;
+    }
+  vtkObject* obj = this->Internal->FindObject(id);
   if (!obj)
     {
-    vtkErrorMacro("Could not create object of type " << className)
-    return 0;
+    return;
     }
-  this->Internal->ObjectStack.push_back( obj );
-  if (weakPtr)
+
+  // The object is read once all the objects it references were read, so
+  // that they are complete when it is. Only the objects of a cycle of
+  // references are read before some of the objects they reference.
+  vtkstd::vector<int> ids;
+  GetReferencedIds(elem, ids);
+  vtkstd::sort(ids.begin(), ids.end());
+  ids.erase(vtkstd::unique(ids.begin(), ids.end()), ids.end());
+  int numberOfMissingReferences = 0;
+  for (size_t i = 0; i < ids.size(); ++i)
     {
-    // pointer to this object was weak, but the object hadn't been created
-    // yet;  The ObjectStack will hold the only reference until non-weak
-    // references are made to the object (and registered at the top of this
-    // fn).  The extra reference held by the ObjectStack gets removed when
-    // we are done reading (delete the this->Internal structure).
-    obj->UnRegister(0);
+    if (ids[i] != id &&
+        this->Internal->ReadIds.find(ids[i]) == this->Internal->ReadIds.end())
+      {
+      this->Internal->PendingReferences[ids[i]].push_back(id);
+      ++numberOfMissingReferences;
+      }
     }
-  this->Internal->IdToObject[id] = obj;
+
+  if (numberOfMissingReferences == 0)
+    {
+    this->ReadObjectElement(obj, elem);
+    this->ReadWaitingObjects(id);
+    }
+  else
+    {
+    vtkKWEXMLArchiveReaderPendingObject& pending =
+      this->Internal->PendingObjects[id];
+    pending.Element = elem;
+    pending.NumberOfMissingReferences = numberOfMissingReferences;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEXMLArchiveReader::ReadWaitingObjects(int id)
+{
+  // Read the objects that were only waiting for this one to be read, then
+  // those that were waiting for them.
+  vtkstd::vector<int> readIds(1, id);
+  while (!readIds.empty())
+    {
+    int readId = readIds.back();
+    readIds.pop_back();
+    this->Internal->ReadIds.insert(readId);
+
+    vtkstd::map<int, vtkstd::vector<int> >::iterator waiting =
+      this->Internal->PendingReferences.find(readId);
+    if (waiting == this->Internal->PendingReferences.end())
+      {
+      continue;
+      }
+    vtkstd::vector<int> waitingIds;
+    waitingIds.swap(waiting->second);
+    this->Internal->PendingReferences.erase(waiting);
+    for (size_t i = 0; i < waitingIds.size(); ++i)
+      {
+      vtkstd::map<int, vtkKWEXMLArchiveReaderPendingObject>::iterator
+        pending = this->Internal->PendingObjects.find(waitingIds[i]);
+      if (pending != this->Internal->PendingObjects.end() &&
+          --pending->second.NumberOfMissingReferences == 0)
+        {
+        vtkSmartPointer<vtkKWEXMLElement> pendingElem =
+          pending->second.Element;
+        this->Internal->PendingObjects.erase(pending);
+        this->ReadObjectElement(this->Internal->FindObject(waitingIds[i]),
+          pendingElem);
+        readIds.push_back(waitingIds[i]);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEXMLArchiveReader::ReadPendingObjects()
+{
+  // The objects still pending are in cycles of references, or reference
+  // objects that are not in the archive or could not be created. Read them
+  // anyway, in the order of their ids, and read those that were only
+  // waiting for them as soon as they are.
+  while (!this->Internal->PendingObjects.empty())
+    {
+    vtkstd::map<int, vtkKWEXMLArchiveReaderPendingObject>::iterator pending =
+      this->Internal->PendingObjects.begin();
+    int id = pending->first;
+    vtkSmartPointer<vtkKWEXMLElement> pendingElem = pending->second.Element;
+    this->Internal->PendingObjects.erase(pending);
+    this->ReadObjectElement(this->Internal->FindObject(id), pendingElem);
+    this->ReadWaitingObjects(id);
+    }
+  this->Internal->PendingReferences.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEXMLArchiveReader::ReadObjectElement(vtkObject* obj,
+                                               vtkKWEXMLElement* elem)
+{
   this->Internal->Push(elem);
   vtkKWESerializableObject *serializableObject =
     vtkKWESerializableObject::SafeDownCast(obj);
@@ -231,16 +420,37 @@ vtkObject* vtkKWEXMLArchiveReader::ReadObject(int id, bool weakPtr)
     {
     vtkKWESerializationHelperMap::Serialize(obj, this);
     }
-
   this->Internal->Pop();
+}
+
+//----------------------------------------------------------------------------
+vtkObject* vtkKWEXMLArchiveReader::ReadObject(int id, bool weakPtr)
+{
+  // There will never be an object with id 0
+  if (id == 0)
+    {
+    return 0;
+    }
+
+  vtkObject* obj = this->Internal->FindObject(id);
+  if (!obj)
+    {
+    vtkErrorMacro("Could not find object of id " << id)
+    return 0;
+    }
+  if (!weakPtr)
+    {
+    obj->Register(0);
+    }
   return obj;
 }
 
 //----------------------------------------------------------------------------
 int vtkKWEXMLArchiveReader::ParseStream(istream& str)
 {
-  vtkSmartPointer<vtkKWEXMLParser> parser =
-    vtkSmartPointer<vtkKWEXMLParser>::New();
+  vtkSmartPointer<vtkKWEXMLArchiveReaderParser> parser =
+    vtkSmartPointer<vtkKWEXMLArchiveReaderParser>::New();
+  parser->Reader = this;
   parser->SetStream(&str);
   int result = parser->Parse();
   this->SetRootElement(parser->GetRootElement());
@@ -577,6 +787,105 @@ void vtkKWEXMLArchiveReader::Serialize(const char* name, vtkObject*& obj,
     }
 }
 
+namespace
+{
+// Decodes the values of an array written by vtkKWEXMLArchiveWriter as
+// base64 encoded, optionally zlib compressed, little endian StoredType.
+// Returns whether all length values were decoded.
+template <typename StoredType, typename ValueType>
+bool GetEncodedValues(vtkKWEXMLElement* elem, unsigned int length,
+  ValueType* vals)
+{
+  const char* encoding = elem->GetAttribute("encoding");
+  if (strcmp(encoding, "base64") != 0)
+    {
+    vtkGenericWarningMacro("Unknown array encoding: " << encoding);
+    return false;
+    }
+  const char* values = elem->GetAttribute("values");
+  unsigned long encodedSize =
+    values ? static_cast<unsigned long>(strlen(values)) : 0;
+  if (encodedSize == 0)
+    {
+    vtkGenericWarningMacro("Missing values of " << elem->GetName());
+    return false;
+    }
+
+  vtkstd::vector<unsigned char> decoded(encodedSize / 4 * 3 + 3);
+  unsigned long decodedSize = vtkBase64Utilities::Decode(
+    reinterpret_cast<const unsigned char*>(values),
+    static_cast<unsigned long>(decoded.size()), &decoded[0], encodedSize);
+
+  vtkstd::vector<StoredType> stored(length);
+  unsigned long size =
+    static_cast<unsigned long>(length * sizeof(StoredType));
+  const char* compressorName = elem->GetAttribute("compressor");
+  if (compressorName)
+    {
+    if (strcmp(compressorName, "zlib") != 0)
+      {
+      vtkGenericWarningMacro("Unknown array compressor: " << compressorName);
+      return false;
+      }
+    vtkSmartPointer<vtkZLibDataCompressor> compressor =
+      vtkSmartPointer<vtkZLibDataCompressor>::New();
+    if (compressor->Uncompress(&decoded[0], decodedSize,
+          reinterpret_cast<unsigned char*>(&stored[0]), size) != size)
+      {
+      vtkGenericWarningMacro("Could not uncompress values of "
+        << elem->GetName());
+      return false;
+      }
+    }
+  else
+    {
+    if (decodedSize != size)
+      {
+      vtkGenericWarningMacro("Could not decode values of " << elem->GetName());
+      return false;
+      }
+    memcpy(&stored[0], &decoded[0], size);
+    }
+
+  if (sizeof(StoredType) == 4)
+    {
+    vtkByteSwap::Swap4LERange(&stored[0], length);
+    }
+  else
+    {
+    vtkByteSwap::Swap8LERange(&stored[0], length);
+    }
+  for (unsigned int i = 0; i < length; ++i)
+    {
+    vals[i] = static_cast<ValueType>(stored[i]);
+    }
+  return true;
+}
+
+// Reads the values of an array, written as ASCII or encoded.
+template <typename StoredType, typename ValueType>
+void GetValues(vtkKWEXMLElement* elem, ValueType*& val, unsigned int& length)
+{
+  length = 0;
+  elem->GetScalarAttribute("length", &length);
+  if (length == 0)
+    {
+    return;
+    }
+  val = new ValueType[length];
+  if (!elem->GetAttribute("encoding"))
+    {
+    elem->GetVectorAttribute("values", length, val);
+    }
+  else if (!GetEncodedValues<StoredType>(elem, length, val))
+    {
+    delete[] val;
+    val = 0;
+    length = 0;
+    }
+}
+}
+
 //----------------------------------------------------------------------------
 void vtkKWEXMLArchiveReader::Serialize(const char* name, int& val)
 {
@@ -604,13 +913,7 @@ void vtkKWEXMLArchiveReader::Serialize(const char* name,
     delete[] val;
     val = 0;
     }
-  length = 0;
-  elem->GetScalarAttribute("length", &length);
-  if (length > 0)
-    {
-    val = new int[length];
-    elem->GetVectorAttribute("values", length, val);
-    }
+  GetValues<vtkTypeInt32>(elem, val, length);
 }
 
 //----------------------------------------------------------------------------
@@ -640,13 +943,7 @@ void vtkKWEXMLArchiveReader::Serialize(const char* name,
     delete[] val;
     val = 0;
     }
-  length = 0;
-  elem->GetScalarAttribute("length", &length);
-  if (length > 0)
-    {
-    val = new unsigned long[length];
-    elem->GetVectorAttribute("values", length, val);
-    }
+  GetValues<vtkTypeUInt64>(elem, val, length);
 }
 
 //----------------------------------------------------------------------------
@@ -676,13 +973,7 @@ void vtkKWEXMLArchiveReader::Serialize(const char* name, vtkIdType*& val,
     delete[] val;
     val = 0;
     }
-  length = 0;
-  elem->GetScalarAttribute("length", &length);
-  if (length > 0)
-    {
-    val = new vtkIdType[length];
-    elem->GetVectorAttribute("values", length, val);
-    }
+  GetValues<vtkTypeInt64>(elem, val, length);
 }
 #endif // if defined(VTK_USE_64BIT_IDS)
 
@@ -713,13 +1004,7 @@ void vtkKWEXMLArchiveReader::Serialize(const char* name,
     delete[] val;
     val = 0;
     }
-  length = 0;
-  elem->GetScalarAttribute("length", &length);
-  if (length > 0)
-    {
-    val = new double[length];
-    elem->GetVectorAttribute("values", length, val);
-    }
+  GetValues<vtkTypeFloat64>(elem, val, length);
 }
 
 //----------------------------------------------------------------------------
@@ -32,7 +32,18 @@
 //  reader->Serialize(istr, "ObjectTree", objs);
 // .. Do something with objs
 // \endcode
-// See vtkKWEXMLArchiveWriter for details about the XML format.
+// See vtkKWEXMLArchiveWriter for details about the XML format. Arrays
+// written as base64, compressed or not, are detected and decoded.
+//
+// Archives read from a stream are not loaded as a whole. Each object is
+// created when the parser reaches its element, and read as soon as its
+// element is complete and all the objects it references were read; only
+// the elements of the objects waiting for references further in the
+// archive are kept meanwhile. The objects referenced by an object are thus
+// read before it, unless they reference it in turn: the objects of a cycle
+// of references are read once the archive is parsed, and some of them get
+// objects that are not read yet. All the objects are read when Serialize()
+// returns.
 // .SECTION See Also
 // vtkKWESerializer vtkKWEXMLArchiveWriter
 
@@ -44,6 +55,7 @@
 
 //BTX
 class vtkKWEXMLElement;
+class vtkKWEXMLArchiveReaderParser;
 struct vtkKWEXMLArchiveReaderInternals;
 //ETX
 
@@ -152,9 +164,27 @@ private:
   vtkKWEXMLElement* RootElement;
 
   // Description:
+  // Get the object of the given id, created when its element was parsed.
   // weakPtr is true if the object is NOT to be reference counted.
   vtkObject* ReadObject(int id, bool weakPtr);
 
+  // Description:
+  // Called as the elements of the archive are parsed: read the version
+  // from the root element, create the object of an Object element when it
+  // starts, and read it once it ends and the objects it references were
+  // read.
+  void ReadArchiveVersion(vtkKWEXMLElement* rootElement);
+  void StartObjectElement(vtkKWEXMLElement* elem);
+  void EndObjectElement(vtkKWEXMLElement* elem);
+
+  // Description:
+  // Read an object from its element, the objects that were waiting for the
+  // object of id "id" to be read, or the objects still waiting for
+  // references once the archive is parsed.
+  void ReadObjectElement(vtkObject* obj, vtkKWEXMLElement* elem);
+  void ReadWaitingObjects(int id);
+  void ReadPendingObjects();
+
   // Description:
   // Reads a vtkInformationObject. Note that only keys registered
   // with the vtkKWEInformationKeyMap are restored.
@@ -164,6 +194,10 @@ private:
   void SetRootElement(vtkKWEXMLElement* re);
 
   vtkKWEXMLArchiveReaderInternals* Internal;
+
+  //BTX
+  friend class vtkKWEXMLArchiveReaderParser;
+  //ETX
 };
 
 #endif
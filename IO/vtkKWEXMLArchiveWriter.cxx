@@ -20,6 +20,8 @@
 //=============================================================================
 #include "vtkKWEXMLArchiveWriter.h"
 
+#include "vtkBase64Utilities.h"
+#include "vtkByteSwap.h"
 #include "vtkInformation.h"
 #include "vtkInformationIdTypeKey.h"
 #include "vtkInformationIntegerKey.h"
@@ -38,10 +40,12 @@
 #include "vtkKWEXMLElement.h"
 #include "vtkObjectFactory.h"
 #include "vtkSmartPointer.h"
+#include "vtkZLibDataCompressor.h"
 
 #include <vtkstd/list>
 #include <vtkstd/map>
 #include <vtkstd/algorithm>
+#include <vtkstd/vector>
 #include "vtksys/ios/sstream"
 
 vtkCxxRevisionMacro(vtkKWEXMLArchiveWriter, "$Revision: 1774 $");
@@ -74,6 +78,8 @@ vtkKWEXMLArchiveWriter::vtkKWEXMLArchiveWriter()
   this->Internal = new vtkKWEXMLArchiveWriterInternals;
   vtkKWESerializationHelperMap::InstantiateDefaultHelpers();
   this->RootElement = 0;
+  this->ArrayEncoding = vtkKWEXMLArchiveWriter::ASCII;
+  this->CompressArrays = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -87,6 +93,10 @@ vtkKWEXMLArchiveWriter::~vtkKWEXMLArchiveWriter()
 void vtkKWEXMLArchiveWriter::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "ArrayEncoding: "
+     << (this->ArrayEncoding == vtkKWEXMLArchiveWriter::BASE64 ?
+         "Base64" : "ASCII") << endl;
+  os << indent << "CompressArrays: " << this->CompressArrays << endl;
 }
 
 namespace
@@ -516,6 +526,73 @@ void vtkKWEXMLArchiveWriter::Serialize(ostream& ostr, const char* rootName,
   this->Internal = 0;
 }
 
+namespace
+{
+// Adds the values of an array to elem, as ASCII, or converted to StoredType,
+// little endian, optionally compressed with zlib and base64 encoded.
+template <typename StoredType, typename ValueType>
+void AddValues(vtkKWEXMLElement* elem, ValueType* vals, unsigned int length,
+  int encoding, int compress)
+{
+  if (encoding != vtkKWEXMLArchiveWriter::BASE64 || length == 0)
+    {
+    elem->AddAttribute("values", vals, length);
+    return;
+    }
+
+  vtkstd::vector<StoredType> stored(length);
+  for (unsigned int i = 0; i < length; ++i)
+    {
+    stored[i] = static_cast<StoredType>(vals[i]);
+    }
+  if (sizeof(StoredType) == 4)
+    {
+    vtkByteSwap::Swap4LERange(&stored[0], length);
+    }
+  else
+    {
+    vtkByteSwap::Swap8LERange(&stored[0], length);
+    }
+
+  const unsigned char* bytes =
+    reinterpret_cast<const unsigned char*>(&stored[0]);
+  unsigned long size =
+    static_cast<unsigned long>(length * sizeof(StoredType));
+  vtkstd::vector<unsigned char> compressed;
+  const char* compressorName = 0;
+  if (compress)
+    {
+    vtkSmartPointer<vtkZLibDataCompressor> compressor =
+      vtkSmartPointer<vtkZLibDataCompressor>::New();
+    compressed.resize(compressor->GetMaximumCompressionSpace(size));
+    unsigned long compressedSize = compressor->Compress(bytes, size,
+      &compressed[0], static_cast<unsigned long>(compressed.size()));
+    if (compressedSize > 0)
+      {
+      bytes = &compressed[0];
+      size = compressedSize;
+      compressorName = "zlib";
+      }
+    else
+      {
+      vtkGenericWarningMacro("Could not compress array, writing it uncompressed.");
+      }
+    }
+
+  vtkstd::vector<unsigned char> encoded((size + 2) / 3 * 4 + 1);
+  unsigned long encodedSize =
+    vtkBase64Utilities::Encode(bytes, size, &encoded[0]);
+  encoded[encodedSize] = 0;
+
+  elem->AddAttribute("encoding", "base64");
+  if (compressorName)
+    {
+    elem->AddAttribute("compressor", compressorName);
+    }
+  elem->AddAttribute("values", reinterpret_cast<const char*>(&encoded[0]));
+}
+}
+
 //----------------------------------------------------------------------------
 void vtkKWEXMLArchiveWriter::Serialize(const char* name, int& val)
 {
@@ -546,7 +623,8 @@ void vtkKWEXMLArchiveWriter::Serialize(const char* name,
     }
 
   elem->AddAttribute("length", length);
-  elem->AddAttribute("values", val, length);
+  AddValues<vtkTypeInt32>(elem, val, length, this->ArrayEncoding,
+    this->CompressArrays);
 }
 
 //----------------------------------------------------------------------------
@@ -579,7 +657,8 @@ void vtkKWEXMLArchiveWriter::Serialize(const char* name,
     }
 
   elem->AddAttribute("length", length);
-  elem->AddAttribute("values", val, length);
+  AddValues<vtkTypeUInt64>(elem, val, length, this->ArrayEncoding,
+    this->CompressArrays);
 }
 
 //----------------------------------------------------------------------------
@@ -613,7 +692,8 @@ void vtkKWEXMLArchiveWriter::Serialize(const char* name,
     }
 
   elem->AddAttribute("length", length);
-  elem->AddAttribute("values", val, length);
+  AddValues<vtkTypeInt64>(elem, val, length, this->ArrayEncoding,
+    this->CompressArrays);
 }
 #endif // if defined(VTK_USE_64BIT_IDS)
 
@@ -647,7 +727,8 @@ void vtkKWEXMLArchiveWriter::Serialize(const char* name,
     }
 
   elem->AddAttribute("length", length);
-  elem->AddAttribute("values", val, length);
+  AddValues<vtkTypeFloat64>(elem, val, length, this->ArrayEncoding,
+    this->CompressArrays);
 }
 
 //----------------------------------------------------------------------------
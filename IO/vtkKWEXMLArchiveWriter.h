@@ -55,6 +55,17 @@
 //   </Object>
 // </ConceptualModel>
 // \endcode
+//
+// Arrays are written as ASCII in the "values" attribute of their element by
+// default. Large arrays, such as those of vtkDataArray, are smaller and
+// quicker to read back when written with SetArrayEncodingToBase64(): the
+// values are then stored as little endian binary, optionally compressed
+// with zlib (see CompressArrays), and base64 encoded. The element then has
+// an "encoding" attribute, and a "compressor" attribute if compressed, which
+// vtkKWEXMLArchiveReader uses to decode it. For example:
+// \code
+//   <Array length="3" encoding="base64" values="AAAAAAAA8D8AAAAAAAAAQAAAAAAAAAhA"/>
+// \endcode
 // .SECTION See Also
 // vtkKWESerializer
 
@@ -84,6 +95,28 @@ public:
   // serializer (writer). Returns true.
   virtual bool IsWriting() {return true;}
 
+  // Description:
+  // How arrays are written: as ASCII values (the default), or as base64
+  // encoded binary values.
+  //BTX
+  enum ArrayEncodings
+    {
+    ASCII = 0,
+    BASE64
+    };
+  //ETX
+  vtkSetClampMacro(ArrayEncoding, int, ASCII, BASE64);
+  vtkGetMacro(ArrayEncoding, int);
+  void SetArrayEncodingToASCII() { this->SetArrayEncoding(ASCII); }
+  void SetArrayEncodingToBase64() { this->SetArrayEncoding(BASE64); }
+
+  // Description:
+  // Compress base64 encoded arrays with zlib. Off by default. Ignored when
+  // arrays are written as ASCII.
+  vtkSetMacro(CompressArrays, int);
+  vtkGetMacro(CompressArrays, int);
+  vtkBooleanMacro(CompressArrays, int);
+
   // Description:
   // This is the main entry point used to write a vector of
   // objects to the XML archive. The rootName is the name
@@ -208,6 +241,9 @@ protected:
   // lookup and return the id.
   virtual unsigned int Serialize(vtkObject*& obj);
 
+  int ArrayEncoding;
+  int CompressArrays;
+
 private:
   vtkKWEXMLArchiveWriter(const vtkKWEXMLArchiveWriter&);  // Not implemented.
   void operator=(const vtkKWEXMLArchiveWriter&);  // Not implemented.
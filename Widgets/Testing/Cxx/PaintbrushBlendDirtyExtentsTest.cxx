@@ -0,0 +1,153 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test paints small strokes into a binary drawing, updating
+// vtkKWEPaintbrushBlend after each of them, as the 2D representation does.
+// The blend then only updates the extents changed by the stroke. The result
+// is compared against a blend of the whole image, and the time taken per
+// stroke is reported for both. The drawing is also changed without recording
+// the extents changed, which must lead to a blend of the whole image.
+
+#include "vtkKWEPaintbrushBlend.h"
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushOperation.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkMath.h"
+#include "vtkTimerLog.h"
+#include "vtkSmartPointer.h"
+#include "PaintbrushTestUtilities.h"
+#include <string.h>
+
+// Compare the outputs of two blends.
+static bool PaintbrushBlendDirtyExtentsTestCompare( vtkKWEPaintbrushBlend *a,
+                                                    vtkKWEPaintbrushBlend *b )
+{
+  vtkImageData *ia = a->GetOutput(), *ib = b->GetOutput();
+  return ia->GetNumberOfPoints() == ib->GetNumberOfPoints() &&
+         memcmp( ia->GetScalarPointer(), ib->GetScalarPointer(),
+                 ia->GetNumberOfPoints() *
+                   ia->GetNumberOfScalarComponents() ) == 0;
+}
+
+int PaintbrushBlendDirtyExtentsTest( int , char *[] )
+{
+  const int dims[3] = { 512, 512, 1 };
+  vtkMath::RandomSeed(4321);
+
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetDimensions(dims[0], dims[1], dims[2]);
+  image->SetWholeExtent(image->GetExtent());
+  image->SetScalarTypeToUnsignedChar();
+  image->SetNumberOfScalarComponents(3);
+  image->AllocateScalars();
+  unsigned char *in = static_cast<unsigned char *>(image->GetScalarPointer());
+  for (int i = 0; i < dims[0]*dims[1]*dims[2]*3; i++)
+    {
+    in[i] = static_cast<unsigned char>(vtkMath::Random(0, 256));
+    }
+
+  vtkSmartPointer< vtkKWEPaintbrushOperation > operation =
+    vtkSmartPointer< vtkKWEPaintbrushOperation >::New();
+  vtkSmartPointer< vtkKWEPaintbrushDrawing > drawing =
+    vtkSmartPointer< vtkKWEPaintbrushDrawing >::New();
+  drawing->SetRepresentationToBinary();
+  drawing->SetImageData(image);
+  drawing->SetPaintbrushOperation(operation);
+  drawing->InitializeData();
+  vtkKWEPaintbrushSketch *sketch = drawing->GetItem(0);
+
+  // "blend" updates the extents changed, "reference" always blends the whole
+  // image.
+  vtkSmartPointer< vtkKWEPaintbrushBlend > blend =
+    vtkSmartPointer< vtkKWEPaintbrushBlend >::New();
+  blend->SetInput(image);
+  blend->SetPaintbrushDrawing(drawing);
+  blend->Update();
+
+  vtkSmartPointer< vtkKWEPaintbrushBlend > reference =
+    vtkSmartPointer< vtkKWEPaintbrushBlend >::New();
+  reference->SetInput(image);
+  reference->SetPaintbrushDrawing(drawing);
+
+  vtkSmartPointer< vtkTimerLog > timer = vtkSmartPointer< vtkTimerLog >::New();
+  double dirtyTime = 0.0, fullTime = 0.0;
+  const int nStrokes = 50;
+  for (int n = 0; n < nStrokes; n++)
+    {
+    // A square stroke of 21x21 pixels, at a random position.
+    const int x = static_cast<int>(vtkMath::Random(10, dims[0]-10));
+    const int y = static_cast<int>(vtkMath::Random(10, dims[1]-10));
+    int extent[6] = { x - 10, x + 10, y - 10, y + 10, 0, 0 };
+    vtkKWEPaintbrushStencilData *stroke = vtkKWEPaintbrushStencilData::New();
+    stroke->SetExtent(extent);
+    stroke->Allocate();
+    PaintbrushTestInsertBox(stroke, extent);
+    if (n % 5 == 4)
+      {
+      sketch->GetPaintbrushData()->Subtract(stroke);
+      }
+    else
+      {
+      sketch->GetPaintbrushData()->Add(stroke);
+      }
+    stroke->Delete();
+
+    timer->StartTimer();
+    blend->Update();
+    timer->StopTimer();
+    dirtyTime += timer->GetElapsedTime();
+
+    timer->StartTimer();
+    reference->Modified();
+    reference->Update();
+    timer->StopTimer();
+    fullTime += timer->GetElapsedTime();
+
+    if (!PaintbrushBlendDirtyExtentsTestCompare(blend, reference))
+      {
+      cerr << "The blend of the extents changed by stroke " << n
+           << " differs from the blend of the whole image." << endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  cout << "Blend per stroke: " << 1000.0 * dirtyTime / nStrokes
+       << " ms updating the extents changed, " << 1000.0 * fullTime / nStrokes
+       << " ms blending the whole image." << endl;
+
+  // A change that is not recorded.
+  vtkKWEPaintbrushStencilData *data = vtkKWEPaintbrushStencilData::SafeDownCast(
+                                             sketch->GetPaintbrushData());
+  data->GetImageStencilData()->InsertNextExtent(0, dims[0]-1, 0, 0);
+  data->GetImageStencilData()->Modified();
+  blend->Update();
+  reference->Modified();
+  reference->Update();
+  if (!PaintbrushBlendDirtyExtentsTestCompare(blend, reference))
+    {
+    cerr << "A change that was not recorded was not blended." << endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test blends a binary drawing onto unsigned char overlays with 1, 2, 3
+// and 4 components and compares the result of vtkKWEPaintbrushBlend against
+// a straightforward per-voxel evaluation of the blend equations. It also
+// reports the time taken by the blend for each of the component layouts.
+
+#include "vtkKWEPaintbrushBlend.h"
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushOperation.h"
+#include "vtkKWEPaintbrushProperty.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkMath.h"
+#include "vtkTimerLog.h"
+#include "vtkSmartPointer.h"
+#include <vtkstd/vector>
+
+// Reference blend of one voxel, written the obvious way.
+static void PaintbrushBlendTestReference( const unsigned char *in,
+                                          unsigned char *out,
+                                          int inC, int outC,
+                                          double opacity,
+                                          const unsigned char color[3] )
+{
+  const int o = static_cast<int>(256*opacity + 0.5);
+  if (outC >= 3 && inC >= 4)
+    {
+    const int r = in[3]*o, f = 65280 - r;
+    for (int c = 0; c < 3; c++)
+      {
+      out[c] = static_cast<unsigned char>((in[c]*f + color[c]*r)/65280);
+      }
+    }
+  else if (outC >= 3 && inC == 3)
+    {
+    for (int c = 0; c < 3; c++)
+      {
+      out[c] = static_cast<unsigned char>((in[c]*(256-o) + color[c]*o)/256);
+      }
+    }
+  else if (inC == 2)
+    {
+    const int r = in[1]*o, f = 65280 - r;
+    out[0] = static_cast<unsigned char>((out[0]*f + in[0]*r)/65280);
+    }
+  else
+    {
+    out[0] = static_cast<unsigned char>((in[0]*(256-o))/256);
+    }
+}
+
+int PaintbrushBlendTest( int , char *[] )
+{
+  // Odd sizes, so that the vectorized loops also exercise their remainders.
+  const int dims[3] = { 131, 97, 9 };
+  const int nVoxels = dims[0]*dims[1]*dims[2];
+  vtkMath::RandomSeed(1234);
+
+  // The canvas over which we draw.
+  vtkSmartPointer< vtkImageData > canvas = vtkSmartPointer< vtkImageData >::New();
+  canvas->SetDimensions(dims[0], dims[1], dims[2]);
+  canvas->SetWholeExtent(canvas->GetExtent());
+  canvas->SetScalarTypeToUnsignedChar();
+  canvas->SetNumberOfScalarComponents(1);
+  canvas->AllocateScalars();
+
+  vtkSmartPointer< vtkKWEPaintbrushOperation > operation =
+    vtkSmartPointer< vtkKWEPaintbrushOperation >::New();
+  vtkSmartPointer< vtkKWEPaintbrushDrawing > drawing =
+    vtkSmartPointer< vtkKWEPaintbrushDrawing >::New();
+  drawing->SetRepresentationToBinary();
+  drawing->SetImageData(canvas);
+  drawing->SetPaintbrushOperation(operation);
+
+  // This creates a single empty sketch for us.
+  drawing->InitializeData();
+  vtkKWEPaintbrushSketch *sketch = drawing->GetItem(0);
+  double sketchColor[3] = { 0.9, 0.3, 0.6 };
+  sketch->GetPaintbrushProperty()->SetColor(sketchColor);
+  sketch->GetPaintbrushProperty()->SetOpacity(0.7);
+
+  // Fill the sketch with random runs of voxels, remembering which voxels
+  // are inside.
+  vtkImageStencilData *stencil = vtkKWEPaintbrushStencilData::SafeDownCast(
+      sketch->GetPaintbrushData())->GetImageStencilData();
+  vtkstd::vector< char > inside(nVoxels, 0);
+  for (int z = 0; z < dims[2]; z++)
+    {
+    for (int y = 0; y < dims[1]; y++)
+      {
+      int x = static_cast<int>(vtkMath::Random(0, 10));
+      while (x < dims[0])
+        {
+        int r2 = x + static_cast<int>(vtkMath::Random(0, 40));
+        r2 = (r2 >= dims[0]) ? dims[0]-1 : r2;
+        stencil->InsertNextExtent(x, r2, y, z);
+        for (int i = x; i <= r2; i++)
+          {
+          inside[(z*dims[1] + y)*dims[0] + i] = 1;
+          }
+        x = r2 + 2 + static_cast<int>(vtkMath::Random(0, 20));
+        }
+      }
+    }
+  stencil->Modified();
+
+  int status = EXIT_SUCCESS;
+  for (int nComponents = 1; nComponents <= 4; nComponents++)
+    {
+    vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+    image->SetDimensions(dims[0], dims[1], dims[2]);
+    image->SetWholeExtent(image->GetExtent());
+    image->SetScalarTypeToUnsignedChar();
+    image->SetNumberOfScalarComponents(nComponents);
+    image->AllocateScalars();
+    unsigned char *in = static_cast<unsigned char *>(image->GetScalarPointer());
+    for (int i = 0; i < nVoxels*nComponents; i++)
+      {
+      in[i] = static_cast<unsigned char>(vtkMath::Random(0, 256));
+      }
+
+    vtkSmartPointer< vtkKWEPaintbrushBlend > blend =
+      vtkSmartPointer< vtkKWEPaintbrushBlend >::New();
+    blend->SetInput(image);
+    blend->SetPaintbrushDrawing(drawing);
+
+    vtkSmartPointer< vtkTimerLog > timer = vtkSmartPointer< vtkTimerLog >::New();
+    const int nIterations = 20;
+    timer->StartTimer();
+    for (int i = 0; i < nIterations; i++)
+      {
+      blend->Modified();
+      blend->Update();
+      }
+    timer->StopTimer();
+    cout << nComponents << " component(s): "
+         << 1000.0 * timer->GetElapsedTime() / nIterations
+         << " ms per blend of " << nVoxels << " voxels" << endl;
+
+    // The colors may have been assigned by the property manager, so query
+    // them only after the blend.
+    unsigned char color[3];
+    double colorD[3];
+    sketch->GetPaintbrushProperty()->GetColor(colorD);
+    color[0] = static_cast< unsigned char >(colorD[0] * 255.0);
+    color[1] = static_cast< unsigned char >(colorD[1] * 255.0);
+    color[2] = static_cast< unsigned char >(colorD[2] * 255.0);
+    const double opacity = sketch->GetPaintbrushProperty()->GetOpacity();
+
+    const unsigned char *out = static_cast<unsigned char *>(
+        blend->GetOutput()->GetScalarPointer());
+    int nErrors = 0;
+    for (int i = 0; i < nVoxels; i++)
+      {
+      unsigned char expected[4];
+      for (int c = 0; c < nComponents; c++)
+        {
+        expected[c] = in[i*nComponents + c];
+        }
+      if (inside[i])
+        {
+        PaintbrushBlendTestReference( in + i*nComponents, expected,
+            nComponents, nComponents, opacity, color );
+        }
+      for (int c = 0; c < nComponents; c++)
+        {
+        if (expected[c] != out[i*nComponents + c] && nErrors++ < 10)
+          {
+          cerr << "Mismatch with " << nComponents << " components at voxel "
+               << i << " component " << c << ": expected "
+               << static_cast<int>(expected[c]) << " got "
+               << static_cast<int>(out[i*nComponents + c]) << endl;
+          }
+        }
+      }
+    if (nErrors)
+      {
+      status = EXIT_FAILURE;
+      }
+    }
+
+  return status;
+}
@@ -0,0 +1,124 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test compares two boxes of 20x20x20 voxels, one shifted by 5 voxels
+// along X, stored as binary data and as label maps. Their overlap volume,
+// Dice coefficient, Jaccard index, boundary distances and confusion matrix
+// are checked against their known values.
+
+#include "vtkKWEPaintbrushDataStatistics.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "PaintbrushTestUtilities.h"
+#include <math.h>
+
+int PaintbrushDataStatisticsTest( int , char *[] )
+{
+  // Boxes from (x, 10, 10) to (x + 19, 29, 29), for x = 10 and 15.
+  int extent[6] = { 0, 49, 0, 49, 0, 49 };
+  const int boxes[2][6] = { { 10, 29, 10, 29, 10, 29 },
+                            { 15, 34, 10, 29, 10, 29 } };
+
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > a =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > b =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  a->SetExtent(extent);
+  a->Allocate();
+  PaintbrushTestInsertBox(a, boxes[0]);
+  b->SetExtent(extent);
+  b->Allocate();
+  PaintbrushTestInsertBox(b, boxes[1]);
+
+  // The boxes share 15x20x20 voxels.
+  const double overlap = vtkKWEPaintbrushDataStatistics::GetOverlapVolume(a, b);
+  const double dice = vtkKWEPaintbrushDataStatistics::GetDiceCoefficient(a, b);
+  const double jaccard = vtkKWEPaintbrushDataStatistics::GetJaccardIndex(a, b);
+  cout << "Overlap " << overlap << ", Dice " << dice << ", Jaccard "
+       << jaccard << endl;
+  if (overlap != 6000.0 || fabs(dice - 0.75) > 1e-12 ||
+      fabs(jaccard - 0.6) > 1e-12)
+    {
+    cerr << "Wrong overlap measures." << endl;
+    return EXIT_FAILURE;
+    }
+
+  // Each box is 5 voxels away from the other at most, on the side along X
+  // that they do not share.
+  vtkstd::vector< vtkIdType > histogram;
+  const double hausdorff =
+    vtkKWEPaintbrushDataStatistics::GetBoundaryDistanceHistogram(
+        a, b, 1.0, histogram);
+  cout << "Hausdorff distance " << hausdorff << ", histogram";
+  vtkIdType numberOfBoundaryVoxels = 0;
+  for (size_t i = 0; i < histogram.size(); i++)
+    {
+    cout << " " << histogram[i];
+    numberOfBoundaryVoxels += histogram[i];
+    }
+  cout << endl;
+
+  // 20x20x20 voxels, minus the 18x18x18 inside.
+  if (fabs(hausdorff - 5.0) > 1e-9 || histogram.size() != 6 ||
+      numberOfBoundaryVoxels != 8000 - 5832)
+    {
+    cerr << "Wrong boundary distances." << endl;
+    return EXIT_FAILURE;
+    }
+
+  // A bin width that is not positive is rejected.
+  if (vtkKWEPaintbrushDataStatistics::GetBoundaryDistanceHistogram(
+        a, b, 0.0, histogram) != -1.0 || !histogram.empty())
+    {
+    cerr << "A zero bin width was accepted." << endl;
+    return EXIT_FAILURE;
+    }
+
+  // The same boxes, with label 1 in label maps.
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > la =
+    vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > lb =
+    vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+  la->SetExtent(extent);
+  la->Allocate();
+  PaintbrushTestSetLabels(la, boxes[0], 1);
+  lb->SetExtent(extent);
+  lb->Allocate();
+  PaintbrushTestSetLabels(lb, boxes[1], 1);
+
+  typedef vtkKWEPaintbrushDataStatistics::LabelPairType LabelPairType;
+  vtkKWEPaintbrushDataStatistics::ConfusionMatrixType matrix;
+  if (!vtkKWEPaintbrushDataStatistics::GetConfusionMatrix(la, lb, matrix) ||
+      matrix.size() != 4 ||
+      matrix[LabelPairType(1, 1)] != 6000 ||
+      matrix[LabelPairType(1, 0)] != 2000 ||
+      matrix[LabelPairType(0, 1)] != 2000 ||
+      matrix[LabelPairType(0, 0)] != 50 * 50 * 50 - 10000 ||
+      fabs(vtkKWEPaintbrushDataStatistics::GetDiceCoefficient(matrix, 1)
+           - 0.75) > 1e-12)
+    {
+    cerr << "Wrong confusion matrix." << endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,269 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test writes a binary drawing of three box sketches and a label map
+// drawing of the same boxes with vtkKWEPaintbrushDrawingWriter, and reads
+// them back with vtkKWEPaintbrushDrawingReader. The sketches read must have
+// the labels, identifiers and colors written, must stay empty until they are
+// loaded, and must then match the sketches written voxel by voxel, also
+// after a stroke drawn on them is undone. The label map is loaded by Read(),
+// both into dense label data and into sparse label data, which must not
+// hold a dense copy of the labels.
+//
+// The test takes the name of the file to write as argument.
+
+#include "vtkKWEPaintbrushDrawingWriter.h"
+#include "vtkKWEPaintbrushDrawingReader.h"
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushProperty.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkPointData.h"
+#include "vtkSmartPointer.h"
+#include "PaintbrushTestUtilities.h"
+#include <vtkstd/vector>
+#include <string.h>
+
+static const int PaintbrushDrawingIOTestExtent[6] = { 0, 39, 0, 29, 0, 19 };
+
+// Do the n'th sketches of the drawings hold the same voxels ? If "empty",
+// is the n'th sketch of "b" empty ?
+static int PaintbrushDrawingIOTestCompare( vtkKWEPaintbrushDrawing *a,
+    vtkKWEPaintbrushDrawing *b, int n, bool empty )
+{
+  vtkKWEPaintbrushSketch *sa = a->GetItem(n), *sb = b->GetItem(n);
+  if (!sb || sa->GetLabel() != sb->GetLabel() ||
+      strcmp(sa->GetPaintbrushProperty()->GetIdentifier(),
+             sb->GetPaintbrushProperty()->GetIdentifier()) != 0)
+    {
+    cerr << "Sketch " << n << " was not read." << endl;
+    return 0;
+    }
+  double ca[3], cb[3];
+  sa->GetPaintbrushProperty()->GetColor(ca);
+  sb->GetPaintbrushProperty()->GetColor(cb);
+  if (ca[0] != cb[0] || ca[1] != cb[1] || ca[2] != cb[2])
+    {
+    cerr << "Sketch " << n << " has another color." << endl;
+    return 0;
+    }
+
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const int *e = PaintbrushDrawingIOTestExtent;
+  vtkKWEPaintbrushLabelData *la = NULL, *lb = NULL;
+  if (a->GetRepresentation() == vtkKWEPaintbrushEnums::Label)
+    {
+    la = vtkKWEPaintbrushLabelData::SafeDownCast(a->GetPaintbrushData());
+    lb = vtkKWEPaintbrushLabelData::SafeDownCast(b->GetPaintbrushData());
+    }
+  vtkstd::vector< LabelType > bufferA(e[1] - e[0] + 1);
+  vtkstd::vector< LabelType > bufferB(e[1] - e[0] + 1);
+  for (int z = e[4]; z <= e[5]; z++)
+    {
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      const LabelType *rowA =
+        la ? la->GetLabelRow(e[0], e[1], y, z, &bufferA[0]) : NULL;
+      const LabelType *rowB =
+        lb ? lb->GetLabelRow(e[0], e[1], y, z, &bufferB[0]) : NULL;
+      for (int x = e[0]; x <= e[1]; x++)
+        {
+        double p[3] = { x, y, z };
+        int ia, ib;
+        if (la)
+          {
+          ia = (rowA[x - e[0]] == sa->GetLabel());
+          ib = (rowB[x - e[0]] == sb->GetLabel());
+          }
+        else
+          {
+          ia = sa->GetPaintbrushData()->IsInside(p);
+          ib = sb->GetPaintbrushData()->IsInside(p);
+          }
+        if (ib != (empty ? 0 : ia))
+          {
+          cerr << "Sketch " << n << " differs at (" << x << ", " << y
+               << ", " << z << ")." << endl;
+          return 0;
+          }
+        }
+      }
+    }
+  return 1;
+}
+
+int PaintbrushDrawingIOTest( int argc, char *argv[] )
+{
+  if (argc < 2)
+    {
+    cerr << "Usage: " << argv[0] << " <file name>" << endl;
+    return EXIT_FAILURE;
+    }
+  const char *fileName = argv[1];
+
+  const int *e = PaintbrushDrawingIOTestExtent;
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetExtent(e[0], e[1], e[2], e[3], e[4], e[5]);
+  image->SetWholeExtent(e[0], e[1], e[2], e[3], e[4], e[5]);
+  image->SetScalarTypeToUnsignedChar();
+  image->AllocateScalars();
+
+  // The label map drawing is read both into dense and into sparse label
+  // data.
+  const int representations[3] = { vtkKWEPaintbrushEnums::Binary,
+    vtkKWEPaintbrushEnums::Label, vtkKWEPaintbrushEnums::Label };
+  for (int r = 0; r < 3; r++)
+    {
+    const bool label = (representations[r] == vtkKWEPaintbrushEnums::Label);
+    const bool sparse = (r == 2);
+    // A drawing of three box sketches. In the label map, later boxes
+    // overlap earlier ones.
+    vtkSmartPointer< vtkKWEPaintbrushDrawing > written =
+      vtkSmartPointer< vtkKWEPaintbrushDrawing >::New();
+    written->SetRepresentation(representations[r]);
+    written->SetImageData(image);
+    written->InitializeData();
+    written->AddItem();
+    written->AddItem();
+
+    const char *identifiers[3] = { "Liver", "Kidney", "Spleen" };
+    for (int n = 0; n < 3; n++)
+      {
+      vtkKWEPaintbrushSketch *sketch = written->GetItem(n);
+      sketch->SetLabel(static_cast< vtkKWEPaintbrushEnums::LabelType >(n + 1));
+      double color[3] = { 0.25 * n, 1.0, 0.5 };
+      sketch->GetPaintbrushProperty()->SetColor(color);
+      sketch->GetPaintbrushProperty()->SetIdentifier(identifiers[n]);
+
+      const int box[6] = { 3 + 10 * n, 12 + 10 * n, 2 + 5 * n, 20, n, 10 + n };
+      if (!label)
+        {
+        PaintbrushTestInsertBox(vtkKWEPaintbrushStencilData::SafeDownCast(
+            sketch->GetPaintbrushData()), box);
+        }
+      else
+        {
+        PaintbrushTestSetLabels(vtkKWEPaintbrushLabelData::SafeDownCast(
+            written->GetPaintbrushData()), box, sketch->GetLabel());
+        }
+      }
+
+    vtkSmartPointer< vtkKWEPaintbrushDrawingWriter > writer =
+      vtkSmartPointer< vtkKWEPaintbrushDrawingWriter >::New();
+    writer->SetFileName(fileName);
+    writer->SetDrawing(written);
+    if (!writer->Write())
+      {
+      return EXIT_FAILURE;
+      }
+
+    vtkSmartPointer< vtkKWEPaintbrushDrawing > read =
+      vtkSmartPointer< vtkKWEPaintbrushDrawing >::New();
+    read->SetImageData(image);
+    if (sparse)
+      {
+      read->SetRepresentation(vtkKWEPaintbrushEnums::Label);
+      read->InitializeData();
+      vtkKWEPaintbrushLabelData::SafeDownCast(
+          read->GetPaintbrushData())->SetStorageModeToSparse();
+      }
+    vtkSmartPointer< vtkKWEPaintbrushDrawingReader > reader =
+      vtkSmartPointer< vtkKWEPaintbrushDrawingReader >::New();
+    reader->SetFileName(fileName);
+    reader->SetDrawing(read);
+    if (!reader->Read() || reader->GetNumberOfSketches() != 3 ||
+        read->GetNumberOfItems() != 3 ||
+        read->GetRepresentation() != representations[r])
+      {
+      cerr << "The drawing was not read." << endl;
+      return EXIT_FAILURE;
+      }
+
+    // The sketches of a binary drawing are not loaded until asked for. The
+    // label map, shared by the sketches of a label map drawing, is loaded
+    // by Read().
+    for (int n = 0; n < 3; n++)
+      {
+      if (reader->IsSketchLoaded(n) != label ||
+          !PaintbrushDrawingIOTestCompare(written, read, n, !label))
+        {
+        return EXIT_FAILURE;
+        }
+      }
+    if (sparse)
+      {
+      vtkKWEPaintbrushLabelData *labelData =
+        vtkKWEPaintbrushLabelData::SafeDownCast(read->GetPaintbrushData());
+      if (labelData->GetStorageMode() != vtkKWEPaintbrushLabelData::Sparse ||
+          labelData->GetLabelMap()->GetPointData()->GetScalars())
+        {
+        cerr << "The label map was not read into the bricks." << endl;
+        return EXIT_FAILURE;
+        }
+      }
+
+    if (!reader->LoadSketch(1) || !reader->IsSketchLoaded(1) ||
+        !PaintbrushDrawingIOTestCompare(written, read, 1, false))
+      {
+      return EXIT_FAILURE;
+      }
+
+    reader->LoadAllSketches();
+    reader->Close();
+    for (int n = 0; n < 3; n++)
+      {
+      if (!PaintbrushDrawingIOTestCompare(written, read, n, false))
+        {
+        return EXIT_FAILURE;
+        }
+      }
+
+    // The sketches loaded are strokes: undoing a stroke drawn after them,
+    // and composing the strokes again, keeps them.
+    vtkKWEPaintbrushSketch *sketch = read->GetItem(1);
+    vtkSmartPointer< vtkKWEPaintbrushStencilData > stroke =
+      vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+    stroke->SetExtent(image->GetExtent());
+    stroke->SetSpacing(image->GetSpacing());
+    stroke->SetOrigin(image->GetOrigin());
+    stroke->Allocate();
+    const int box[6] = { 30, 36, 24, 28, 14, 18 };
+    PaintbrushTestInsertBox(stroke, box);
+    sketch->AddNewStroke(vtkKWEPaintbrushEnums::Draw, stroke);
+    if (!sketch->PopStroke())
+      {
+      cerr << "The stroke drawn after loading was not undone." << endl;
+      return EXIT_FAILURE;
+      }
+    sketch->ComposeStrokes();
+    for (int n = 0; n < 3; n++)
+      {
+      if (!PaintbrushDrawingIOTestCompare(written, read, n, false))
+        {
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
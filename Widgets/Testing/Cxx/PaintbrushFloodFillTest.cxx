@@ -0,0 +1,159 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test flood fills an image made of a C shaped region, which the fill
+// has to go around, next to a box separated from it by a thin wall. The
+// number of voxels filled is checked in 3D, in 2D, within the extent of the
+// operation, with an explicit intensity range, and following the labels of
+// a sparse label map.
+
+#include "vtkKWEPaintbrushOperationFloodFill.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+
+// Number of voxels of the stencil.
+static vtkIdType PaintbrushFloodFillTestCount(
+  vtkKWEPaintbrushStencilData *data )
+{
+  vtkImageStencilData *stencil = data->GetImageStencilData();
+  int extent[6];
+  stencil->GetExtent(extent);
+  vtkIdType n = 0;
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      int r1, r2, iter = 0;
+      while (stencil->GetNextExtent(r1, r2, extent[0], extent[1], y, z, iter))
+        {
+        n += r2 - r1 + 1;
+        }
+      }
+    }
+  return n;
+}
+
+// Fill from "p" and check the number of voxels filled.
+static bool PaintbrushFloodFillTestFill(
+  vtkKWEPaintbrushOperationFloodFill *fill, double x, double y, double z,
+  vtkIdType expected, const char *what )
+{
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > data =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  double p[3] = { x, y, z };
+  vtkKWEPaintbrushEnums::OperationType op;
+  fill->GetPaintbrushData(data, p, op);
+  const vtkIdType n = PaintbrushFloodFillTestCount(data);
+  if (n != expected)
+    {
+    cerr << what << ": " << n << " voxels filled instead of " << expected
+         << "." << endl;
+    return false;
+    }
+  return true;
+}
+
+int PaintbrushFloodFillTest( int , char *[] )
+{
+  // The C shape covers [5,50]x[5,50] less [15,50]x[15,40], the box covers
+  // [53,57]x[5,50], both over the slices [2,17].
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetDimensions(60, 60, 20);
+  image->SetScalarTypeToShort();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > labelData =
+    vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+  labelData->SetExtent(image->GetExtent());
+  labelData->Allocate();
+
+  for (int z = 0; z < 20; z++)
+    {
+    for (int y = 0; y < 60; y++)
+      {
+      for (int x = 0; x < 60; x++)
+        {
+        const bool inSlices = (z >= 2 && z <= 17 && y >= 5 && y <= 50);
+        const bool inC = inSlices && x >= 5 && x <= 50 &&
+                         !(x >= 15 && y >= 15 && y <= 40);
+        const bool inBox = inSlices && x >= 53 && x <= 57;
+        *static_cast< short * >(image->GetScalarPointer(x, y, z)) =
+          (inC || inBox) ? 100 : 0;
+        *static_cast< vtkKWEPaintbrushEnums::LabelType * >(
+          labelData->GetLabelMap()->GetScalarPointer(x, y, z)) =
+          inC ? 1 : (inBox ? 2 : 0);
+        }
+      }
+    }
+  labelData->SetStorageModeToSparse();
+
+  const vtkIdType cVoxels = 46*46 - 36*26;
+  const vtkIdType boxVoxels = 5*46;
+
+  vtkSmartPointer< vtkKWEPaintbrushOperationFloodFill > fill =
+    vtkSmartPointer< vtkKWEPaintbrushOperationFloodFill >::New();
+  fill->SetImageData(image);
+
+  if (!PaintbrushFloodFillTestFill(fill, 10, 10, 10, 16*cVoxels, "3D") ||
+      !PaintbrushFloodFillTestFill(fill, 55, 45, 3, 16*boxVoxels, "Box") ||
+      !PaintbrushFloodFillTestFill(fill, 56, 56, 10, 60*60*20 - 16*(cVoxels +
+                                   boxVoxels), "Background"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  fill->SetFillDimension(2);
+  if (!PaintbrushFloodFillTestFill(fill, 10, 10, 10, cVoxels, "2D"))
+    {
+    return EXIT_FAILURE;
+    }
+  fill->SetFillDimension(3);
+
+  fill->SetExtent(0, 59, 0, 59, 0, 9);
+  if (!PaintbrushFloodFillTestFill(fill, 10, 10, 5, 8*cVoxels, "Extent"))
+    {
+    return EXIT_FAILURE;
+    }
+  fill->SetExtent(0, -1, 0, -1, 0, -1);
+
+  fill->SetIntensityRange(150, 200);
+  if (!PaintbrushFloodFillTestFill(fill, 10, 10, 10, 0, "Outside the range"))
+    {
+    return EXIT_FAILURE;
+    }
+  fill->SetIntensityRange(50, 150);
+  if (!PaintbrushFloodFillTestFill(fill, 10, 10, 10, 16*cVoxels, "Range"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  fill->SetFillCriterionToLabelBoundary();
+  fill->SetLabelData(labelData);
+  if (!PaintbrushFloodFillTestFill(fill, 55, 45, 3, 16*boxVoxels, "Label"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
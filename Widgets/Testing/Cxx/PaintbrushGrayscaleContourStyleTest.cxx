@@ -0,0 +1,149 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test contours three grayscale sketches with
+// vtkKWEPaintbrushRepresentationGrayscale2D, one of them styled the way
+// StippledInvertedHighlight highlights it, with stippled lines and visible
+// edges. The contours of each sketch must be rendered by an actor with the
+// line stipple pattern and edge visibility of the sketch, and the two
+// sketches styled alike must share an actor.
+
+#include "vtkKWEPaintbrushRepresentationGrayscale2D.h"
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushProperty.h"
+#include "vtkKWEPaintbrushGrayscaleData.h"
+#include "vtkImageActor.h"
+#include "vtkImageData.h"
+#include "vtkPolyDataMapper.h"
+#include "vtkPolyData.h"
+#include "vtkCellData.h"
+#include "vtkIntArray.h"
+#include "vtkActor.h"
+#include "vtkProperty.h"
+#include "vtkPropCollection.h"
+#include "vtkSmartPointer.h"
+
+int PaintbrushGrayscaleContourStyleTest( int , char *[] )
+{
+  int extent[6] = { 0, 63, 0, 63, 0, 0 };
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetExtent(extent);
+  image->SetWholeExtent(extent);
+  image->SetScalarTypeToUnsignedChar();
+  image->AllocateScalars();
+
+  vtkSmartPointer< vtkImageActor > imageActor =
+    vtkSmartPointer< vtkImageActor >::New();
+  imageActor->SetInput(image);
+  imageActor->SetDisplayExtent(extent);
+
+  vtkSmartPointer< vtkKWEPaintbrushRepresentationGrayscale2D > rep =
+    vtkSmartPointer< vtkKWEPaintbrushRepresentationGrayscale2D >::New();
+  rep->SetImageActor(imageActor);
+  rep->SetImageData(image);
+  vtkKWEPaintbrushDrawing *drawing = rep->GetPaintbrushDrawing();
+  while (drawing->GetNumberOfItems() < 3)
+    {
+    drawing->AddItem();
+    }
+
+  // A disk per sketch, side by side.
+  for (int n = 0; n < 3; n++)
+    {
+    vtkSmartPointer< vtkImageData > disk = vtkSmartPointer< vtkImageData >::New();
+    disk->SetExtent(extent);
+    disk->SetScalarTypeToUnsignedChar();
+    disk->AllocateScalars();
+    unsigned char *p = static_cast< unsigned char * >(disk->GetScalarPointer());
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      for (int x = extent[0]; x <= extent[1]; x++, p++)
+        {
+        const int dx = x - (12 + 20 * n), dy = y - 32;
+        *p = (dx * dx + dy * dy < 64) ? 255 : 0;
+        }
+      }
+    vtkSmartPointer< vtkKWEPaintbrushGrayscaleData > data =
+      vtkSmartPointer< vtkKWEPaintbrushGrayscaleData >::New();
+    data->SetImageData(disk);
+    drawing->GetItem(n)->AddNewStroke(vtkKWEPaintbrushEnums::Draw, data);
+    }
+
+  // Style the second sketch as a StippledInvertedHighlight highlights it.
+  vtkProperty *highlighted =
+    drawing->GetItem(1)->GetPaintbrushProperty()->GetProperty();
+  highlighted->SetEdgeVisibility(1);
+  highlighted->SetLineStipplePattern(0x000f);
+
+  rep->BuildRepresentation();
+
+  vtkSmartPointer< vtkPropCollection > props =
+    vtkSmartPointer< vtkPropCollection >::New();
+  rep->GetActors(props);
+  int nContourActors = 0, nContoured[3] = { 0, 0, 0 };
+  vtkProp *prop;
+  for (props->InitTraversal(); (prop = props->GetNextProp()); )
+    {
+    vtkActor *actor = vtkActor::SafeDownCast(prop);
+    vtkPolyDataMapper *mapper = actor ?
+      vtkPolyDataMapper::SafeDownCast(actor->GetMapper()) : NULL;
+    vtkIntArray *sketchIds = (mapper && mapper->GetInput()) ?
+      vtkIntArray::SafeDownCast(
+        mapper->GetInput()->GetCellData()->GetArray("SketchId")) : NULL;
+    if (!sketchIds)
+      {
+      continue;
+      }
+    ++nContourActors;
+
+    for (vtkIdType i = 0; i < sketchIds->GetNumberOfTuples(); i++)
+      {
+      const int n = sketchIds->GetValue(i);
+      vtkProperty *property =
+        drawing->GetItem(n)->GetPaintbrushProperty()->GetProperty();
+      if (actor->GetProperty()->GetLineStipplePattern() !=
+          property->GetLineStipplePattern() ||
+          actor->GetProperty()->GetEdgeVisibility() !=
+          property->GetEdgeVisibility() ||
+          actor->GetProperty()->GetLineWidth() != property->GetLineWidth())
+        {
+        cerr << "The contours of sketch " << n << " are not rendered with "
+             << "its property." << endl;
+        return EXIT_FAILURE;
+        }
+      ++nContoured[n];
+      }
+    }
+
+  if (!nContoured[0] || !nContoured[1] || !nContoured[2])
+    {
+    cerr << "Not every sketch was contoured." << endl;
+    return EXIT_FAILURE;
+    }
+  if (nContourActors != 2)
+    {
+    cerr << nContourActors << " actors render the contours instead of 2."
+         << endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test paints a stroke of small brushes into a grayscale sketch
+// allocated through SetExtent() and Allocate(), whose image only grows to
+// cover the painted voxels, and into a sketch whose whole image is set
+// with SetImageData(). Both must give the same image, and the image of the
+// first must stay smaller than the extent. The sketches are then resized
+// and must still agree.
+
+#include "vtkKWEPaintbrushGrayscaleData.h"
+#include "vtkImageData.h"
+#include "vtkMath.h"
+#include "vtkSmartPointer.h"
+#include <math.h>
+#include <string.h>
+
+// Compares the two sketches over the extent of "reference".
+static int PaintbrushGrayscaleDataLazyTestCompare(
+    vtkKWEPaintbrushGrayscaleData *lazy,
+    vtkKWEPaintbrushGrayscaleData *reference, const char *when )
+{
+  int extent[6], lazyExtent[6];
+  reference->GetExtent(extent);
+  lazy->GetExtent(lazyExtent);
+  for (int i = 0; i < 6; i++)
+    {
+    if (extent[i] != lazyExtent[i])
+      {
+      cerr << when << ": the extents differ." << endl;
+      return 0;
+      }
+    }
+
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  lazy->GetPaintbrushDataAsImageData(image);
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      for (int x = extent[0]; x <= extent[1]; x++)
+        {
+        const int a = static_cast< unsigned char * >(
+                        image->GetScalarPointer(x, y, z))[0];
+        const int b = static_cast< unsigned char * >(
+                        reference->GetImageData()->GetScalarPointer(x, y, z))[0];
+        double p[3] = { x, y, z };
+        if (a != b || lazy->IsInside(p) != reference->IsInside(p))
+          {
+          cerr << when << ": " << a << " instead of " << b << " at ("
+               << x << ", " << y << ", " << z << ")." << endl;
+          return 0;
+          }
+        }
+      }
+    }
+  return 1;
+}
+
+int PaintbrushGrayscaleDataLazyTest( int , char *[] )
+{
+  vtkMath::RandomSeed(2010);
+  int extent[6] = { 0, 199, 0, 199, 0, 99 };
+
+  vtkSmartPointer< vtkKWEPaintbrushGrayscaleData > lazy =
+    vtkSmartPointer< vtkKWEPaintbrushGrayscaleData >::New();
+  lazy->SetExtent(extent);
+  lazy->Allocate(0.0);
+
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetExtent(extent);
+  image->SetScalarTypeToUnsignedChar();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  memset(image->GetScalarPointer(), 0, image->GetNumberOfPoints());
+  vtkSmartPointer< vtkKWEPaintbrushGrayscaleData > reference =
+    vtkSmartPointer< vtkKWEPaintbrushGrayscaleData >::New();
+  reference->SetImageData(image);
+
+  // A stroke of spherical soft brushes along a random walk, with a few
+  // erased brushes.
+  const int radius = 5;
+  int center[3] = { 60, 80, 50 };
+  for (int i = 0; i < 200; i++)
+    {
+    for (int j = 0; j < 3; j++)
+      {
+      center[j] += static_cast< int >(vtkMath::Random(-2.0, 3.0));
+      }
+    vtkImageData *brush = vtkImageData::New();
+    brush->SetExtent( center[0] - radius, center[0] + radius,
+                      center[1] - radius, center[1] + radius,
+                      center[2] - radius, center[2] + radius );
+    brush->SetScalarTypeToUnsignedChar();
+    brush->SetNumberOfScalarComponents(1);
+    brush->AllocateScalars();
+    unsigned char *b = static_cast< unsigned char * >(
+      brush->GetScalarPointer());
+    for (int z = -radius; z <= radius; z++)
+      {
+      for (int y = -radius; y <= radius; y++)
+        {
+        for (int x = -radius; x <= radius; x++, b++)
+          {
+          const double d =
+            sqrt(static_cast< double >(x*x + y*y + z*z)) / radius;
+          *b = (d < 1.0) ? static_cast< unsigned char >(255.0 * (1.0 - d)) : 0;
+          }
+        }
+      }
+
+    if (i % 10 == 9)
+      {
+      lazy->Subtract(brush);
+      reference->Subtract(brush);
+      }
+    else
+      {
+      lazy->Add(brush);
+      reference->Add(brush);
+      }
+    brush->Delete();
+    }
+
+  if (!PaintbrushGrayscaleDataLazyTestCompare(lazy, reference, "Painted"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  const vtkIdType stored = lazy->GetImageData()->GetNumberOfPoints();
+  cout << "The painted sketch stores " << stored << " voxels of "
+       << reference->GetImageData()->GetNumberOfPoints() << "." << endl;
+  if (stored >= reference->GetImageData()->GetNumberOfPoints())
+    {
+    cerr << "The painted sketch stores its whole extent." << endl;
+    return EXIT_FAILURE;
+    }
+
+  // Crop, then grow with another fill value.
+  int cropped[6] = { 20, 150, 40, 180, 10, 70 };
+  lazy->Resize(cropped, 0.0);
+  reference->Resize(cropped, 0.0);
+  if (!PaintbrushGrayscaleDataLazyTestCompare(lazy, reference, "Cropped"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  int grown[6] = { 0, 170, 20, 199, 0, 80 };
+  lazy->Resize(grown, 255.0);
+  reference->Resize(grown, 255.0);
+  if (!PaintbrushGrayscaleDataLazyTestCompare(lazy, reference, "Grown"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
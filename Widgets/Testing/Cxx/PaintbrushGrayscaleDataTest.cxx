@@ -0,0 +1,149 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test applies Add, Subtract and Replace to an unsigned char grayscale
+// sketch, with a brush of the same scalar type and with a float brush of
+// the same values. The first takes the integer fast path of the operators,
+// the second the generic path, and both must give the same sketch. The
+// results are also checked against the operators applied voxel by voxel.
+// The time taken by each path is reported.
+
+#include "vtkKWEPaintbrushGrayscaleData.h"
+#include "vtkImageData.h"
+#include "vtkPointData.h"
+#include "vtkDataArray.h"
+#include "vtkMath.h"
+#include "vtkTimerLog.h"
+#include "vtkSmartPointer.h"
+#include <string.h>
+
+// Set the voxels of an unsigned char image to random values. A third of
+// them are 0, outside the brush.
+static void PaintbrushGrayscaleDataTestRandomize( vtkImageData *image )
+{
+  unsigned char *p = static_cast< unsigned char * >(image->GetScalarPointer());
+  const vtkIdType n = image->GetNumberOfPoints();
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    p[i] = (vtkMath::Random() < 0.33) ? 0 :
+      static_cast< unsigned char >(vtkMath::Random(0, 256));
+    }
+}
+
+int PaintbrushGrayscaleDataTest( int , char *[] )
+{
+  vtkMath::RandomSeed(4242);
+  int extent[6] = { 0, 255, 0, 255, 0, 63 };
+  int brushExtent[6] = { 30, 200, -10, 120, 10, 80 };
+
+  vtkSmartPointer< vtkImageData > original =
+    vtkSmartPointer< vtkImageData >::New();
+  original->SetExtent(extent);
+  original->SetScalarTypeToUnsignedChar();
+  original->SetNumberOfScalarComponents(1);
+  original->AllocateScalars();
+  PaintbrushGrayscaleDataTestRandomize(original);
+
+  vtkSmartPointer< vtkImageData > brush = vtkSmartPointer< vtkImageData >::New();
+  brush->SetExtent(brushExtent);
+  brush->SetScalarTypeToUnsignedChar();
+  brush->SetNumberOfScalarComponents(1);
+  brush->AllocateScalars();
+  PaintbrushGrayscaleDataTestRandomize(brush);
+
+  vtkSmartPointer< vtkImageData > floatBrush =
+    vtkSmartPointer< vtkImageData >::New();
+  floatBrush->DeepCopy(brush);
+  floatBrush->SetScalarTypeToFloat();
+  floatBrush->AllocateScalars();
+  floatBrush->GetPointData()->GetScalars()->DeepCopy(
+    brush->GetPointData()->GetScalars());
+
+  vtkSmartPointer< vtkTimerLog > timer = vtkSmartPointer< vtkTimerLog >::New();
+  const char *operations[3] = { "Add", "Subtract", "Replace" };
+  for (int op = 0; op < 3; op++)
+    {
+    vtkSmartPointer< vtkKWEPaintbrushGrayscaleData > data[2];
+    double time[2];
+    for (int i = 0; i < 2; i++)
+      {
+      data[i] = vtkSmartPointer< vtkKWEPaintbrushGrayscaleData >::New();
+      data[i]->GetImageData()->DeepCopy(original);
+      vtkImageData *b = (i == 0) ? brush : floatBrush;
+      timer->StartTimer();
+      switch (op)
+        {
+        case 0: data[i]->Add(b);      break;
+        case 1: data[i]->Subtract(b); break;
+        case 2: data[i]->Replace(b);  break;
+        }
+      timer->StopTimer();
+      time[i] = timer->GetElapsedTime();
+      }
+
+    cout << operations[op] << ": " << 1000.0 * time[0]
+         << " ms with an unsigned char brush, " << 1000.0 * time[1]
+         << " ms with a float brush." << endl;
+
+    if (memcmp(data[0]->GetImageData()->GetScalarPointer(),
+               data[1]->GetImageData()->GetScalarPointer(),
+               original->GetNumberOfPoints()) != 0)
+      {
+      cerr << operations[op] << " differs between an unsigned char brush and "
+           << "a float brush." << endl;
+      return EXIT_FAILURE;
+      }
+
+    // Voxel by voxel.
+    for (int z = extent[4]; z <= extent[5]; z++)
+      {
+      for (int y = extent[2]; y <= extent[3]; y++)
+        {
+        for (int x = extent[0]; x <= extent[1]; x++)
+          {
+          int a = static_cast< unsigned char * >(
+                      original->GetScalarPointer(x, y, z))[0];
+          const unsigned char result = static_cast< unsigned char * >(
+                      data[0]->GetImageData()->GetScalarPointer(x, y, z))[0];
+          if (x >= brushExtent[0] && x <= brushExtent[1] &&
+              y >= brushExtent[2] && y <= brushExtent[3] &&
+              z >= brushExtent[4] && z <= brushExtent[5])
+            {
+            const int b = static_cast< unsigned char * >(
+                      brush->GetScalarPointer(x, y, z))[0];
+            if (b > 0)
+              {
+              a = (op == 0) ? (b > a ? b : a) : ((op == 1) ? (b < a ? b : a) : b);
+              }
+            }
+          if (result != a)
+            {
+            cerr << operations[op] << " gave " << static_cast< int >(result)
+                 << " instead of " << a << " at (" << x << ", " << y << ", "
+                 << z << ")." << endl;
+            return EXIT_FAILURE;
+            }
+          }
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test paints a grayscale stroke into a sketch and erases across it
+// with a second stroke. It then undoes and redoes the erase, and undoes a
+// third stroke, which composes the first two again. After each step the
+// sketch must hold the image it had when the strokes were painted, and its
+// image must only cover the painted voxels, not the whole canvas: the erase
+// stroke starts filled with 255, which can't lower any voxel, so it must not
+// grow the sketch when it is subtracted again.
+
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushOperation.h"
+#include "vtkKWEPaintbrushShapeEllipsoid.h"
+#include "vtkKWEPaintbrushGrayscaleData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include <string.h>
+
+// Expose the painting of the shape on the current stroke, done by the
+// widget as the mouse moves.
+class PaintbrushGrayscaleEraseUndoTestSketch : public vtkKWEPaintbrushSketch
+{
+public:
+  static PaintbrushGrayscaleEraseUndoTestSketch *New()
+    { return new PaintbrushGrayscaleEraseUndoTestSketch; }
+  int Paint( double p[3] )
+    { return this->AddShapeToCurrentStroke(p); }
+};
+
+// Compare the image of the sketch with "reference", and check that the
+// sketch stores no more than an eighth of the canvas.
+static int PaintbrushGrayscaleEraseUndoTestCheck(
+    vtkKWEPaintbrushSketch *sketch, vtkImageData *reference,
+    const char *step )
+{
+  vtkKWEPaintbrushGrayscaleData *data =
+    vtkKWEPaintbrushGrayscaleData::SafeDownCast(sketch->GetPaintbrushData());
+  if (data->GetImageData()->GetNumberOfPoints() * 8 >
+      sketch->GetImageData()->GetNumberOfPoints())
+    {
+    cerr << "After " << step << ", the sketch stores "
+         << data->GetImageData()->GetNumberOfPoints() << " voxels." << endl;
+    return 0;
+    }
+
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  data->GetPaintbrushDataAsImageData(image);
+  if (image->GetNumberOfPoints() != reference->GetNumberOfPoints() ||
+      memcmp(image->GetScalarPointer(), reference->GetScalarPointer(),
+             reference->GetNumberOfPoints()) != 0)
+    {
+    cerr << "After " << step << ", the image of the sketch differs." << endl;
+    return 0;
+    }
+  return 1;
+}
+
+int PaintbrushGrayscaleEraseUndoTest( int , char *[] )
+{
+  vtkSmartPointer< vtkImageData > canvas = vtkSmartPointer< vtkImageData >::New();
+  canvas->SetDimensions(128, 128, 32);
+  canvas->SetWholeExtent(canvas->GetExtent());
+  canvas->SetScalarTypeToUnsignedChar();
+  canvas->AllocateScalars();
+
+  vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid > shape =
+    vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid >::New();
+  shape->SetSpacing(canvas->GetSpacing());
+  shape->SetOrigin(canvas->GetOrigin());
+  shape->SetWidth(8.0, 8.0, 8.0);
+  shape->SetRepresentation(vtkKWEPaintbrushEnums::Grayscale);
+  vtkSmartPointer< vtkKWEPaintbrushOperation > operation =
+    vtkSmartPointer< vtkKWEPaintbrushOperation >::New();
+  operation->SetPaintbrushShape(shape);
+
+  PaintbrushGrayscaleEraseUndoTestSketch *sketch =
+    PaintbrushGrayscaleEraseUndoTestSketch::New();
+  sketch->SetRepresentationToGrayscale();
+  sketch->SetImageData(canvas);
+  sketch->SetPaintbrushOperation(operation);
+  sketch->Initialize();
+
+  // Paint along x, then erase along y across the painted stroke.
+  vtkSmartPointer< vtkImageData > drawn = vtkSmartPointer< vtkImageData >::New();
+  vtkSmartPointer< vtkImageData > erased = vtkSmartPointer< vtkImageData >::New();
+  sketch->AddNewStroke(vtkKWEPaintbrushEnums::Draw);
+  for (int x = 20; x <= 50; x += 2)
+    {
+    double p[3] = { x, 30.0, 10.0 };
+    sketch->Paint(p);
+    }
+  sketch->GetPaintbrushData()->GetPaintbrushDataAsImageData(drawn);
+
+  shape->SetPolarityToErase();
+  sketch->AddNewStroke(vtkKWEPaintbrushEnums::Erase);
+  for (int y = 20; y <= 40; y += 2)
+    {
+    double p[3] = { 35.0, y, 10.0 };
+    sketch->Paint(p);
+    }
+  sketch->GetPaintbrushData()->GetPaintbrushDataAsImageData(erased);
+
+  if (drawn->GetScalarComponentAsDouble(35, 30, 10, 0) < 127.5 ||
+      erased->GetScalarComponentAsDouble(35, 30, 10, 0) > 127.5)
+    {
+    cerr << "The erase stroke did not erase the drawn stroke." << endl;
+    sketch->Delete();
+    return EXIT_FAILURE;
+    }
+
+  int ok =
+    PaintbrushGrayscaleEraseUndoTestCheck(sketch, erased, "erasing") &&
+    sketch->PopStroke() &&
+    PaintbrushGrayscaleEraseUndoTestCheck(sketch, drawn, "undo of the erase") &&
+    sketch->PushStroke() &&
+    PaintbrushGrayscaleEraseUndoTestCheck(sketch, erased, "redo of the erase");
+
+  // Undoing a later stroke composes the first two again.
+  shape->SetPolarityToDraw();
+  sketch->AddNewStroke(vtkKWEPaintbrushEnums::Draw);
+  for (int x = 20; x <= 50; x += 2)
+    {
+    double p[3] = { x, 60.0, 20.0 };
+    sketch->Paint(p);
+    }
+  ok = ok && sketch->PopStroke() &&
+    PaintbrushGrayscaleEraseUndoTestCheck(sketch, erased,
+                                          "undo of a later stroke");
+
+  sketch->Delete();
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test clips a label map, stored densely and sparsely, with extents
+// inside it, clipping one of its sides, containing it and disjoint from
+// it. The labels are compared with those of a reference implementation that
+// blanks out the voxels one at a time, and the number of voxels of each
+// label, kept up to date by the label data, is checked.
+
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "PaintbrushTestUtilities.h"
+
+typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+static const int PaintbrushLabelDataClipTestExtent[6] =
+  { -10, 89, 0, 69, 5, 44 };
+
+// Blank out the voxels outside "extent", one at a time.
+static void PaintbrushLabelDataClipTestReference( vtkImageData *labelMap,
+                                                  const int extent[6] )
+{
+  const int *e = PaintbrushLabelDataClipTestExtent;
+  LabelType *labels = static_cast< LabelType * >(labelMap->GetScalarPointer());
+  for (int z = e[4]; z <= e[5]; z++)
+    {
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      for (int x = e[0]; x <= e[1]; x++, labels++)
+        {
+        if (x < extent[0] || x > extent[1] || y < extent[2] ||
+            y > extent[3] || z < extent[4] || z > extent[5])
+          {
+          *labels = vtkKWEPaintbrushLabelData::NoLabelValue;
+          }
+        }
+      }
+    }
+}
+
+int PaintbrushLabelDataClipTest( int , char *[] )
+{
+  const int *e = PaintbrushLabelDataClipTestExtent;
+  const int clipExtents[][6] = {
+    { 10, 60, 20, 50, 15, 30 },   // inside
+    { -20, 40, -5, 80, 0, 50 },   // clipping the +X side
+    { 30, 100, -5, 80, 0, 50 },   // clipping the -X side
+    { -20, 100, 10, 80, 0, 50 },  // clipping the -Y side
+    { -20, 100, -5, 80, 0, 20 },  // clipping the +Z side
+    { -20, 100, -5, 80, 0, 50 },  // containing
+    { 100, 120, 0, 69, 5, 44 },   // disjoint
+    { 0, 0, 30, 30, 40, 40 } };   // a single voxel
+  const int numberOfClipExtents =
+    static_cast< int >(sizeof(clipExtents) / sizeof(clipExtents[0]));
+
+  for (int c = 0; c < numberOfClipExtents; c++)
+    {
+    for (int sparse = 0; sparse < 2; sparse++)
+      {
+      vtkSmartPointer< vtkKWEPaintbrushLabelData > labelData =
+        vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+      labelData->SetExtent(e[0], e[1], e[2], e[3], e[4], e[5]);
+      labelData->Allocate();
+
+      // Overlapping boxes of labels 1 to 3.
+      LabelType *labels = static_cast< LabelType * >(
+          labelData->GetLabelMap()->GetScalarPointer());
+      for (int z = e[4]; z <= e[5]; z++)
+        {
+        for (int y = e[2]; y <= e[3]; y++)
+          {
+          for (int x = e[0]; x <= e[1]; x++, labels++)
+            {
+            *labels = static_cast< LabelType >(
+              (x / 20 + y / 15 + z / 10) % 4);
+            }
+          }
+        }
+
+      vtkSmartPointer< vtkImageData > reference =
+        vtkSmartPointer< vtkImageData >::New();
+      reference->DeepCopy(labelData->GetLabelMap());
+      PaintbrushLabelDataClipTestReference(reference, clipExtents[c]);
+
+      if (sparse)
+        {
+        labelData->SetStorageModeToSparse();
+        }
+
+      // Count the labels now, so that Clip updates the counts.
+      labelData->GetLabels();
+
+      int clipExtent[6];
+      memcpy(clipExtent, clipExtents[c], sizeof(clipExtent));
+      labelData->Clip(clipExtent);
+
+      if (!PaintbrushTestCompareLabels(labelData, reference))
+        {
+        cerr << "Clip " << c << " of " << (sparse ? "sparse" : "dense")
+             << " labels differs from the reference." << endl;
+        return EXIT_FAILURE;
+        }
+
+      if (!PaintbrushTestCheckLabelCounts(labelData))
+        {
+        cerr << "Wrong label counts after clip " << c << " of "
+             << (sparse ? "sparse" : "dense") << " labels." << endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test collapses the labels 32, 64, 125 and 127 of a label map into
+// 1, 2, 3 and 4 with RelabelDataToContiguousLabels, with 1 thread and with
+// the default number of threads, stored densely and sparsely. The labels
+// and the number of voxels of each label are checked. The time taken to
+// count and to relabel the voxels is printed. The same is then done with
+// labels at both ends of the range of the label type, negative ones if it
+// is signed.
+
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+#include <limits>
+
+typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+static const int PaintbrushLabelDataRelabelTestDims[3] = { 256, 256, 128 };
+
+// Label of voxel i, before relabeling, as an index into the labels.
+static int PaintbrushLabelDataRelabelTestLabel( vtkIdType i )
+{
+  return static_cast< int >((i / 1000) % 5);
+}
+
+// Collapse "labels", in increasing order, one of them being NoLabelValue,
+// stored densely or sparsely, with 1 thread or the default number of
+// threads.
+static bool PaintbrushLabelDataRelabelTestLabels( const LabelType labels[5],
+                                                  int sparse, int threads )
+{
+  const int *dims = PaintbrushLabelDataRelabelTestDims;
+  vtkSmartPointer< vtkTimerLog > timer = vtkSmartPointer< vtkTimerLog >::New();
+
+  // Expected label of each label after relabeling.
+  LabelType newLabels[5];
+  for (int l = 0, next = 1; l < 5; l++)
+    {
+    newLabels[l] = (labels[l] == vtkKWEPaintbrushLabelData::NoLabelValue)
+      ? labels[l] : static_cast< LabelType >(next++);
+    }
+
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > labelData =
+    vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+  labelData->SetExtent(0, dims[0]-1, 0, dims[1]-1, 0, dims[2]-1);
+  labelData->Allocate();
+  if (!threads)
+    {
+    labelData->SetNumberOfThreads(1);
+    }
+
+  LabelType *ptr = static_cast< LabelType * >(
+      labelData->GetLabelMap()->GetScalarPointer());
+  const vtkIdType n = labelData->GetLabelMap()->GetNumberOfPoints();
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    ptr[i] = labels[PaintbrushLabelDataRelabelTestLabel(i)];
+    }
+  if (sparse)
+    {
+    labelData->SetStorageModeToSparse();
+    }
+
+  timer->StartTimer();
+  labelData->GetLabels();
+  timer->StopTimer();
+  const double countTime = timer->GetElapsedTime();
+
+  timer->StartTimer();
+  labelData->RelabelDataToContiguousLabels();
+  timer->StopTimer();
+  cout << (sparse ? "Sparse" : "Dense") << " labels "
+       << static_cast< double >(labels[0]) << " to "
+       << static_cast< double >(labels[4]) << ", "
+       << labelData->GetNumberOfThreads() << " thread(s): counted in "
+       << countTime << " s, relabeled in " << timer->GetElapsedTime()
+       << " s." << endl;
+
+  vtkSmartPointer< vtkImageData > relabeled =
+    vtkSmartPointer< vtkImageData >::New();
+  labelData->GetPaintbrushDataAsImageData(relabeled);
+  ptr = static_cast< LabelType * >(relabeled->GetScalarPointer());
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    if (ptr[i] != newLabels[PaintbrushLabelDataRelabelTestLabel(i)])
+      {
+      cerr << "Voxel " << i << " was relabeled to "
+           << static_cast< double >(ptr[i]) << endl;
+      return false;
+      }
+    }
+
+  // Counted once the labels have changed, and kept up to date.
+  labelData->SetCheckLabelCounts(1);
+  vtkKWEPaintbrushLabelData::LabelSetType present = labelData->GetLabels();
+  if (present.size() != 4 || *present.begin() != 1 ||
+      *present.rbegin() != 4)
+    {
+    cerr << "Wrong labels after relabeling." << endl;
+    return false;
+    }
+  vtkIdType total = 0;
+  for (int l = 0; l < 5; l++)
+    {
+    total += labelData->GetNumberOfVoxels(newLabels[l]);
+    }
+  if (total != n)
+    {
+    cerr << "Wrong label counts after relabeling." << endl;
+    return false;
+    }
+  return true;
+}
+
+int PaintbrushLabelDataRelabelTest( int , char *[] )
+{
+  const LabelType minLabel = std::numeric_limits< LabelType >::min();
+  const LabelType maxLabel = std::numeric_limits< LabelType >::max();
+
+  LabelType labelSets[2][5] = {
+    { 0, 32, 64, 125, 127 },
+    { 0, static_cast< LabelType >(maxLabel - 100),
+      static_cast< LabelType >(maxLabel - 3),
+      static_cast< LabelType >(maxLabel - 1), maxLabel } };
+  if (minLabel < 0)
+    {
+    // Negative labels, sorted before NoLabelValue.
+    labelSets[1][0] = minLabel;
+    labelSets[1][1] = static_cast< LabelType >(minLabel + 1);
+    labelSets[1][2] = static_cast< LabelType >(-3);
+    labelSets[1][3] = 0;
+    }
+
+  for (int set = 0; set < 2; set++)
+    {
+    for (int sparse = 0; sparse < 2; sparse++)
+      {
+      for (int threads = 0; threads < 2; threads++)
+        {
+        if (!PaintbrushLabelDataRelabelTestLabels(
+              labelSets[set], sparse, threads))
+          {
+          return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test applies Add, Subtract and Replace to the same label map stored
+// densely and sparsely, and checks that both give the same labels, that
+// undoing the changes restores the label map in both cases, and that the
+// storage mode can be switched back and forth. The number of voxels of each
+// label, kept up to date by the label data, is checked against a count of
+// the voxels. The memory used by each storage is printed. Last, the
+// sketches of a drawing are initialized from label data stored either way,
+// and one of them is copied to another slice: the labels must not depend on
+// the storage, and sparse labels must never be copied to the label map.
+
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkKWEPaintbrushLabelBricks.h"
+#include "vtkKWEPaintbrushLabelDelta.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushOperation.h"
+#include "vtkKWEPaintbrushShapeEllipsoid.h"
+#include "vtkImageData.h"
+#include "vtkPointData.h"
+#include "vtkSmartPointer.h"
+#include "PaintbrushTestUtilities.h"
+
+int PaintbrushLabelDataSparseTest( int , char *[] )
+{
+  int extent[6] = { 0, 199, 0, 179, 0, 119 };
+
+  // A label map with two boxes of labels in the middle, the rest unlabeled.
+  const int box1[6] = { 60, 99, 50, 109, 40, 79 };
+  const int box2[6] = { 100, 149, 50, 109, 40, 79 };
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > original =
+    vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+  original->SetExtent(extent);
+  original->Allocate();
+  PaintbrushTestSetLabels(original, box1, 1);
+  PaintbrushTestSetLabels(original, box2, 2);
+
+  // A stencil made of a box overlapping the labeled boxes.
+  const int stencilBox[6] = { 90, 130, 30, 69, 60, 99 };
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > stencil =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  stencil->SetExtent(extent);
+  stencil->Allocate();
+  stencil->SetLabel(3);
+  PaintbrushTestInsertBox(stencil, stencilBox);
+
+  const char *operations[3] = { "Add", "Subtract", "Replace" };
+  for (int op = 0; op < 3; op++)
+    {
+    vtkSmartPointer< vtkKWEPaintbrushLabelData > dense =
+      vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+    dense->DeepCopy(original);
+    dense->SetLabel(2);
+
+    vtkSmartPointer< vtkKWEPaintbrushLabelData > sparse =
+      vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+    sparse->DeepCopy(original);
+    sparse->SetLabel(2);
+    sparse->SetStorageModeToSparse();
+
+    // Count the labels now, so that the operations update the counts.
+    dense->GetLabels();
+    if (!PaintbrushTestCompareLabels(sparse, original->GetLabelMap()) ||
+        sparse->GetLabels() != original->GetLabels())
+      {
+      cerr << "Converting to sparse storage changed the labels." << endl;
+      return EXIT_FAILURE;
+      }
+
+    vtkSmartPointer< vtkKWEPaintbrushLabelDelta > delta =
+      vtkSmartPointer< vtkKWEPaintbrushLabelDelta >::New();
+    sparse->SetDeltaRecorder(delta);
+    switch (op)
+      {
+      case 0: dense->Add(stencil);      sparse->Add(stencil);      break;
+      case 1: dense->Subtract(stencil); sparse->Subtract(stencil); break;
+      case 2: dense->Replace(stencil);  sparse->Replace(stencil);  break;
+      }
+    sparse->SetDeltaRecorder(NULL);
+
+    cout << operations[op] << ": dense "
+         << dense->GetLabelMap()->GetActualMemorySize() << " KB, sparse "
+         << sparse->GetBricks()->GetActualMemorySize() << " KB in "
+         << sparse->GetBricks()->GetNumberOfAllocatedBricks() << " of "
+         << sparse->GetBricks()->GetNumberOfBricks() << " bricks" << endl;
+
+    if (!PaintbrushTestCompareLabels(sparse, dense->GetLabelMap()) ||
+        sparse->GetLabels() != dense->GetLabels())
+      {
+      cerr << operations[op] << " differs between dense and sparse storage."
+           << endl;
+      return EXIT_FAILURE;
+      }
+
+    if (!PaintbrushTestCheckLabelCounts(dense) ||
+        !PaintbrushTestCheckLabelCounts(sparse))
+      {
+      cerr << "Wrong label counts after " << operations[op] << "." << endl;
+      return EXIT_FAILURE;
+      }
+
+    if (sparse->GetBricks()->GetActualMemorySize() >=
+        dense->GetLabelMap()->GetActualMemorySize())
+      {
+      cerr << "Sparse storage uses more memory than dense storage." << endl;
+      return EXIT_FAILURE;
+      }
+
+    if (!delta->Undo(sparse) ||
+        !PaintbrushTestCompareLabels(sparse, original->GetLabelMap()) ||
+        !PaintbrushTestCheckLabelCounts(sparse))
+      {
+      cerr << "Undoing " << operations[op] << " on sparse storage failed."
+           << endl;
+      return EXIT_FAILURE;
+      }
+
+    sparse->SetStorageModeToDense();
+    if (sparse->GetBricks()->IsAllocated() ||
+        !PaintbrushTestCompareLabels(sparse, original->GetLabelMap()))
+      {
+      cerr << "Converting back to dense storage failed." << endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Sketches initialized from the label data, densely and sparsely stored.
+  // Composing their strokes again gives back the labels only if they were
+  // initialized from them. The sketch of label 1 is then copied from a
+  // slice through box1 to a slice with no labels.
+  vtkSmartPointer< vtkImageData > canvas = vtkSmartPointer< vtkImageData >::New();
+  canvas->SetExtent(extent);
+  canvas->SetWholeExtent(extent);
+  canvas->SetScalarTypeToUnsignedChar();
+  canvas->AllocateScalars();
+  vtkSmartPointer< vtkKWEPaintbrushOperation > operation =
+    vtkSmartPointer< vtkKWEPaintbrushOperation >::New();
+  operation->SetPaintbrushShape(
+    vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid >::New());
+
+  int sourceSlice[6] = { extent[0], extent[1], extent[2], extent[3], 50, 50 };
+  int targetSlice[6] = { extent[0], extent[1], extent[2], extent[3], 100, 100 };
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > labelData[2];
+  vtkSmartPointer< vtkKWEPaintbrushDrawing > drawing[2];
+  for (int sparse = 0; sparse < 2; sparse++)
+    {
+    drawing[sparse] = vtkSmartPointer< vtkKWEPaintbrushDrawing >::New();
+    drawing[sparse]->SetRepresentationToLabel();
+    drawing[sparse]->SetImageData(canvas);
+    drawing[sparse]->SetPaintbrushOperation(operation);
+    drawing[sparse]->InitializeData();
+    labelData[sparse] = vtkKWEPaintbrushLabelData::SafeDownCast(
+      drawing[sparse]->GetPaintbrushData());
+    labelData[sparse]->DeepCopy(original);
+    if (sparse)
+      {
+      labelData[sparse]->SetStorageModeToSparse();
+      }
+    drawing[sparse]->CreateSketches();
+
+    for (int i = 0; i < drawing[sparse]->GetNumberOfItems(); i++)
+      {
+      drawing[sparse]->GetItem(i)->ComposeStrokes();
+      }
+    if (drawing[sparse]->GetNumberOfItems() != 2 ||
+        !PaintbrushTestCompareLabels(labelData[sparse],
+                                     original->GetLabelMap()))
+      {
+      cerr << "Sketches of " << (sparse ? "sparse" : "dense")
+           << " labels were not initialized from them." << endl;
+      return EXIT_FAILURE;
+      }
+
+    drawing[sparse]->GetItemWithLabel(1)->CopySketchFromExtentToExtent(
+      sourceSlice, targetSlice);
+    }
+
+  if (PaintbrushTestCompareLabels(labelData[0], original->GetLabelMap()) ||
+      !PaintbrushTestCompareLabels(labelData[1],
+                                   labelData[0]->GetLabelMap()) ||
+      !PaintbrushTestCheckLabelCounts(labelData[1]))
+    {
+    cerr << "Copying a sketch of sparse labels differs from dense labels."
+         << endl;
+    return EXIT_FAILURE;
+    }
+  if (labelData[1]->GetLabelMap()->GetPointData()->GetScalars())
+    {
+    cerr << "The labels of sparse label data were copied to its label map."
+         << endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
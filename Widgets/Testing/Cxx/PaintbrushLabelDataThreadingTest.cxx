@@ -0,0 +1,171 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test applies Add, Subtract and Replace to a large label map with 1 to
+// 16 threads, checks that the label map and the recorded changes do not
+// depend on the number of threads, and that undoing the changes restores the
+// label map. The time taken by each operation is printed.
+
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkKWEPaintbrushLabelDelta.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+#include "PaintbrushTestUtilities.h"
+#include <math.h>
+
+int PaintbrushLabelDataThreadingTest( int , char *[] )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const int dims[3] = { 256, 256, 96 };
+  int extent[6] = { 0, dims[0]-1, 0, dims[1]-1, 0, dims[2]-1 };
+
+  // A label map with slabs of three labels, some voxels left unlabeled.
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > original =
+    vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+  original->SetExtent(extent);
+  original->Allocate();
+  LabelType *labels = static_cast< LabelType * >(
+      original->GetLabelMap()->GetScalarPointer());
+  for (int z = 0; z < dims[2]; z++)
+    {
+    for (int y = 0; y < dims[1]; y++)
+      {
+      for (int x = 0; x < dims[0]; x++, labels++)
+        {
+        *labels = static_cast< LabelType >((x/16 + y/8 + z/4) % 4);
+        }
+      }
+    }
+
+  // A stencil made of a ball, with a few holes along X.
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > stencil =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  stencil->SetExtent(extent);
+  stencil->Allocate();
+  stencil->SetLabel(2);
+  const double r = dims[2] / 2.0 - 1.0;
+  for (int z = 0; z < dims[2]; z++)
+    {
+    for (int y = 0; y < dims[1]; y++)
+      {
+      const double dy = (y - dims[1]/2.0) / dims[1] * dims[2];
+      const double dz = z - dims[2]/2.0;
+      const double d2 = r*r - dy*dy - dz*dz;
+      if (d2 < 0)
+        {
+        continue;
+        }
+      const int halfWidth = static_cast< int >(
+          sqrt(d2) / dims[2] * dims[0]);
+      const int x1 = dims[0]/2 - halfWidth, x2 = dims[0]/2 + halfWidth;
+      for (int x = x1; x <= x2; x += 40)
+        {
+        stencil->GetImageStencilData()->InsertNextExtent(
+            x, (x + 31 < x2 ? x + 31 : x2), y, z);
+        }
+      }
+    }
+
+  // The label map applied in the label map to label map operations is
+  // a shifted copy of the original.
+  vtkSmartPointer< vtkKWEPaintbrushLabelData > source =
+    vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+  source->DeepCopy(original);
+  extent[0] += 7;
+  extent[1] += 7;
+  source->GetLabelMap()->SetExtent(extent);
+
+  vtkSmartPointer< vtkTimerLog > timer = vtkSmartPointer< vtkTimerLog >::New();
+  const char *operations[3] = { "Add", "Subtract", "Replace" };
+  const int numberOfThreads[5] = { 1, 2, 4, 8, 16 };
+
+  for (int s = 0; s < 2; s++)
+    {
+    vtkKWEPaintbrushData *data = s ? static_cast< vtkKWEPaintbrushData * >(source)
+                                   : static_cast< vtkKWEPaintbrushData * >(stencil);
+    for (int op = 0; op < 3; op++)
+      {
+      vtkSmartPointer< vtkKWEPaintbrushLabelData > reference;
+      vtkIdType referenceRuns = 0;
+      for (int t = 0; t < 5; t++)
+        {
+        vtkSmartPointer< vtkKWEPaintbrushLabelData > labelData =
+          vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+        labelData->DeepCopy(original);
+        labelData->SetLabel(1);
+        labelData->SetNumberOfThreads(numberOfThreads[t]);
+
+        vtkSmartPointer< vtkKWEPaintbrushLabelDelta > delta =
+          vtkSmartPointer< vtkKWEPaintbrushLabelDelta >::New();
+        labelData->SetDeltaRecorder(delta);
+
+        timer->StartTimer();
+        switch (op)
+          {
+          case 0: labelData->Add(data); break;
+          case 1: labelData->Subtract(data); break;
+          case 2: labelData->Replace(data); break;
+          }
+        timer->StopTimer();
+        labelData->SetDeltaRecorder(NULL);
+
+        cout << operations[op] << (s ? " label map" : " stencil")
+             << " with " << numberOfThreads[t] << " thread(s): "
+             << timer->GetElapsedTime() << " s, "
+             << delta->GetNumberOfRuns() << " runs recorded" << endl;
+
+        if (t == 0)
+          {
+          reference = vtkSmartPointer< vtkKWEPaintbrushLabelData >::New();
+          reference->DeepCopy(labelData);
+          referenceRuns = delta->GetNumberOfRuns();
+          if (PaintbrushTestCompareLabelMaps(
+                labelData->GetLabelMap(), original->GetLabelMap()))
+            {
+            cerr << operations[op] << " did not change anything." << endl;
+            return EXIT_FAILURE;
+            }
+          }
+        else if (!PaintbrushTestCompareLabelMaps(
+                   labelData->GetLabelMap(), reference->GetLabelMap()) ||
+                 delta->GetNumberOfRuns() != referenceRuns)
+          {
+          cerr << operations[op] << " with " << numberOfThreads[t]
+               << " threads differs from the result with one thread." << endl;
+          return EXIT_FAILURE;
+          }
+
+        if (!delta->Undo(labelData) ||
+            !PaintbrushTestCompareLabelMaps(
+                labelData->GetLabelMap(), original->GetLabelMap()))
+          {
+          cerr << "Undoing " << operations[op] << " with "
+               << numberOfThreads[t] << " threads failed." << endl;
+          return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
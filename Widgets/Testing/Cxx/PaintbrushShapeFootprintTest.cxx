@@ -0,0 +1,222 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test rasterizes an ellipsoid and a box shape, on an anisotropic grid,
+// centered at every sub-voxel phase for which the shapes cache a footprint.
+// The stencils and grayscale images, translated from the cached footprints,
+// must match the shape evaluated directly at each of their voxels. Every
+// phase is visited twice, at different voxels, so that the second pass is
+// served from the cache.
+
+#include "vtkKWEPaintbrushShapeEllipsoid.h"
+#include "vtkKWEPaintbrushShapeBox.h"
+#include "vtkImageData.h"
+#include "vtkImageStencilData.h"
+#include "vtkSmartPointer.h"
+
+// Expose the value of the shape at an offset from its center, normally
+// sampled only when a footprint is computed.
+template < class TShape >
+class PaintbrushShapeFootprintTestShape : public TShape
+{
+public:
+  static PaintbrushShapeFootprintTestShape *New()
+    { return new PaintbrushShapeFootprintTestShape; }
+  double Evaluate( const double d[3], int grayscale )
+    { return this->EvaluateFootprint(d, grayscale); }
+};
+
+// Is (x,y,z) in one of the runs of the stencil ?
+static bool PaintbrushShapeFootprintTestIsInside(
+  vtkImageStencilData *stencil, int x, int y, int z )
+{
+  int r1, r2, iter = 0;
+  const int *e = stencil->GetExtent();
+  while (stencil->GetNextExtent(r1, r2, e[0], e[1], y, z, iter))
+    {
+    if (x >= r1 && x <= r2)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+// Rasterize the shape at p and compare each voxel with the shape evaluated
+// at that voxel. Returns the number of voxels that differ.
+template < class TShape >
+static int PaintbrushShapeFootprintTestCompare(
+  PaintbrushShapeFootprintTestShape< TShape > *shape, double p[3],
+  bool binary )
+{
+  const double *origin = shape->GetOrigin();
+  const double *spacing = shape->GetSpacing();
+  int nErrors = 0;
+  double d[3];
+
+  if (binary)
+    {
+    vtkSmartPointer< vtkImageStencilData > stencil =
+      vtkSmartPointer< vtkImageStencilData >::New();
+    shape->GetStencil(stencil, p);
+    const int *e = stencil->GetExtent();
+    for (int z = e[4]; z <= e[5]; z++)
+      {
+      d[2] = origin[2] + z * spacing[2] - p[2];
+      for (int y = e[2]; y <= e[3]; y++)
+        {
+        d[1] = origin[1] + y * spacing[1] - p[1];
+        for (int x = e[0]; x <= e[1]; x++)
+          {
+          d[0] = origin[0] + x * spacing[0] - p[0];
+          if ((shape->Evaluate(d, 0) != 0.0) !=
+              PaintbrushShapeFootprintTestIsInside(stencil, x, y, z))
+            {
+            ++nErrors;
+            }
+          }
+        }
+      }
+    return nErrors;
+    }
+
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  shape->GetGrayscaleData(image, p);
+  const int *e = image->GetExtent();
+  for (int z = e[4]; z <= e[5]; z++)
+    {
+    d[2] = origin[2] + z * spacing[2] - p[2];
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      d[1] = origin[1] + y * spacing[1] - p[1];
+      for (int x = e[0]; x <= e[1]; x++)
+        {
+        d[0] = origin[0] + x * spacing[0] - p[0];
+
+        // The footprints hold floats: allow for rounding across an integer.
+        const double expected = static_cast< double >(
+          static_cast< unsigned char >(shape->Evaluate(d, 1)));
+        if (fabs(image->GetScalarComponentAsDouble(x, y, z, 0) - expected)
+            > 1.0)
+          {
+          ++nErrors;
+          }
+        }
+      }
+    }
+  return nErrors;
+}
+
+// Centers at all the 1/8th voxel phases, on two passes, so that footprints
+// are computed on the first pass and reused on the second.
+template < class TShape >
+static int PaintbrushShapeFootprintTestShapeAtAllPhases(
+  PaintbrushShapeFootprintTestShape< TShape > *shape, bool binary )
+{
+  const double *origin = shape->GetOrigin();
+  const double *spacing = shape->GetSpacing();
+  int nErrors = 0;
+  for (int pass = 0; pass < 2; pass++)
+    {
+    for (int k = 0; k < 8; k++)
+      {
+      for (int l = 0; l < 8; l++)
+        {
+        // All the phases along x and y, a few along z. Multiples of 1/8th
+        // of the spacing are exact, so the centers fall on the phases the
+        // footprints are computed for.
+        const int phase[3] = { k, l, (k + 3 * l) % 8 };
+        double p[3];
+        for (int i = 0; i < 3; i++)
+          {
+          p[i] = origin[i] +
+            (20 + 7 * pass + i + phase[i] / 8.0) * spacing[i];
+          }
+        nErrors += PaintbrushShapeFootprintTestCompare(shape, p, binary);
+        }
+      }
+    }
+  return nErrors;
+}
+
+int PaintbrushShapeFootprintTest( int , char *[] )
+{
+  double spacing[3] = { 1.0, 0.5, 2.0 };
+  double origin[3] = { 0.25, -1.0, 0.5 };
+  int retVal = EXIT_SUCCESS;
+
+  // The ellipsoid, in binary and in grayscale.
+
+  PaintbrushShapeFootprintTestShape< vtkKWEPaintbrushShapeEllipsoid >
+    *ellipsoid = PaintbrushShapeFootprintTestShape<
+      vtkKWEPaintbrushShapeEllipsoid >::New();
+  ellipsoid->SetSpacing(spacing);
+  ellipsoid->SetOrigin(origin);
+  ellipsoid->SetWidth(7.3, 5.1, 9.7);
+
+  int nErrors = PaintbrushShapeFootprintTestShapeAtAllPhases(ellipsoid, true);
+  if (nErrors)
+    {
+    cerr << nErrors << " voxels of the ellipsoid stencils differ from the "
+         << "ellipsoid." << endl;
+    retVal = EXIT_FAILURE;
+    }
+
+  ellipsoid->SetRepresentation(vtkKWEPaintbrushEnums::Grayscale);
+  ellipsoid->SetTransitionRegion(0.4);
+  nErrors = PaintbrushShapeFootprintTestShapeAtAllPhases(ellipsoid, false);
+  if (nErrors)
+    {
+    cerr << nErrors << " voxels of the grayscale ellipsoids differ from the "
+         << "ellipsoid." << endl;
+    retVal = EXIT_FAILURE;
+    }
+
+  // Changing the shape discards the footprints of the previous one.
+  ellipsoid->SetPolarityToErase();
+  ellipsoid->SetWidth(4.0, 6.5, 3.3);
+  nErrors = PaintbrushShapeFootprintTestShapeAtAllPhases(ellipsoid, false);
+  if (nErrors)
+    {
+    cerr << nErrors << " voxels of the resized erasing ellipsoids differ "
+         << "from the ellipsoid." << endl;
+    retVal = EXIT_FAILURE;
+    }
+  ellipsoid->Delete();
+
+  // The box, in grayscale. Its stencil is built from its extent directly.
+
+  PaintbrushShapeFootprintTestShape< vtkKWEPaintbrushShapeBox > *box =
+    PaintbrushShapeFootprintTestShape< vtkKWEPaintbrushShapeBox >::New();
+  box->SetSpacing(spacing);
+  box->SetOrigin(origin);
+  box->SetWidth(6.2, 4.4, 8.9);
+  box->SetRepresentation(vtkKWEPaintbrushEnums::Grayscale);
+  nErrors = PaintbrushShapeFootprintTestShapeAtAllPhases(box, false);
+  if (nErrors)
+    {
+    cerr << nErrors << " voxels of the grayscale boxes differ from the box."
+         << endl;
+    retVal = EXIT_FAILURE;
+    }
+  box->Delete();
+
+  return retVal;
+}
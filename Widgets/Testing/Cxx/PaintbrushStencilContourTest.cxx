@@ -0,0 +1,153 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test contours a slice of a stencil with vtkKWEStencilContourFilter,
+// which generates isolines from the runs of the stencil, and compares them
+// against the isolines vtkContourFilter generates from the same slice
+// rasterized. Both must have the same length, the lines of the stencil being
+// made of fewer, longer segments. Each axis is tried in turn as the normal
+// to the slice.
+
+#include "vtkKWEStencilContourFilter.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushUtilities.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkContourFilter.h"
+#include "vtkPolyData.h"
+#include "vtkCellArray.h"
+#include "vtkMath.h"
+#include "vtkSmartPointer.h"
+
+// Total length of the lines of a polydata.
+static double PaintbrushStencilContourTestLength( vtkPolyData *pd )
+{
+  double length = 0.0, p1[3], p2[3];
+  vtkIdType npts, *pts;
+  vtkCellArray *lines = pd->GetLines();
+  for (lines->InitTraversal(); lines->GetNextCell(npts, pts); )
+    {
+    for (vtkIdType i = 1; i < npts; i++)
+      {
+      pd->GetPoint(pts[i-1], p1);
+      pd->GetPoint(pts[i], p2);
+      length += sqrt(vtkMath::Distance2BetweenPoints(p1, p2));
+      }
+    }
+  return length;
+}
+
+int PaintbrushStencilContourTest( int , char *[] )
+{
+  const int dims[3] = { 96, 80, 64 };
+
+  // A hollow ball, with a few random runs scattered around.
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > data =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  int dataExtent[6] = { 0, dims[0]-1, 0, dims[1]-1, 0, dims[2]-1 };
+  data->SetExtent(dataExtent);
+  double spacing[3] = { 0.5, 1.0, 2.0 }, origin[3] = { -10.0, 5.0, 0.0 };
+  data->SetSpacing(spacing);
+  data->SetOrigin(origin);
+  data->Allocate();
+  vtkImageStencilData *stencil = data->GetImageStencilData();
+  vtkMath::RandomSeed(1234);
+  for (int z = 0; z < dims[2]; z++)
+    {
+    for (int y = 0; y < dims[1]; y++)
+      {
+      const double r2 = (y - 40.0) * (y - 40.0) + (z - 32.0) * (z - 32.0);
+      int x = 0;
+      if (r2 < 900.0)
+        {
+        const int outer = static_cast< int >(sqrt(900.0 - r2));
+        if (r2 < 100.0)
+          {
+          const int inner = static_cast< int >(sqrt(100.0 - r2));
+          stencil->InsertNextExtent(48 - outer, 48 - inner - 1, y, z);
+          stencil->InsertNextExtent(48 + inner + 1, 48 + outer, y, z);
+          }
+        else
+          {
+          stencil->InsertNextExtent(48 - outer, 48 + outer, y, z);
+          }
+        x = 48 + outer + 2;
+        }
+      while ((x += static_cast< int >(vtkMath::Random(2, 12))) < dims[0])
+        {
+        const int x2 = x + static_cast< int >(vtkMath::Random(0, 6));
+        stencil->InsertNextExtent(x, (x2 < dims[0]) ? x2 : dims[0]-1, y, z);
+        x = x2 + 1;
+        }
+      }
+    }
+
+  for (int axis = 0; axis < 3; axis++)
+    {
+    int extent[6] = { 0, dims[0]-1, 0, dims[1]-1, 0, dims[2]-1 };
+    extent[2*axis] = extent[2*axis+1] = dims[axis] / 2;
+
+    vtkSmartPointer< vtkKWEStencilContourFilter > contour =
+      vtkSmartPointer< vtkKWEStencilContourFilter >::New();
+    contour->SetInput(stencil);
+    contour->SetExtent(extent);
+    contour->Update();
+
+    vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+    image->SetExtent(extent);
+    image->SetSpacing(stencil->GetSpacing());
+    image->SetOrigin(stencil->GetOrigin());
+    image->SetScalarTypeToUnsignedChar();
+    image->SetNumberOfScalarComponents(1);
+    image->AllocateScalars();
+    vtkKWEPaintbrushUtilities::GetImageFromStencil(image, stencil, 255, 0, true);
+    vtkSmartPointer< vtkContourFilter > reference =
+      vtkSmartPointer< vtkContourFilter >::New();
+    reference->SetInput(image);
+    reference->SetValue(0, 127.5);
+    reference->Update();
+
+    vtkPolyData *output = contour->GetOutput();
+    const double length = PaintbrushStencilContourTestLength(output);
+    const double referenceLength =
+      PaintbrushStencilContourTestLength(reference->GetOutput());
+    cout << "Slice normal to axis " << axis << ": "
+         << output->GetNumberOfLines() << " lines from the runs, "
+         << reference->GetOutput()->GetNumberOfLines()
+         << " from the rasterized slice." << endl;
+
+    if (referenceLength <= 0.0 ||
+        fabs(length - referenceLength) > 1e-6 * referenceLength)
+      {
+      cerr << "The isolines of the slice normal to axis " << axis
+           << " are " << length << " long instead of " << referenceLength
+           << "." << endl;
+      return EXIT_FAILURE;
+      }
+
+    if (output->GetNumberOfLines() >= reference->GetOutput()->GetNumberOfLines())
+      {
+      cerr << "Long runs were not contoured as single segments." << endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
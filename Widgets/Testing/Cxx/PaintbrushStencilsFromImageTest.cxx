@@ -0,0 +1,163 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test extracts the stencils of a label map with 120 labels, all at once
+// with GetStencilsFromImage and one at a time with GetStencilFromImage, and
+// checks both against the voxels of the label map. Labels that are not
+// requested must be ignored. The time taken by each is printed.
+
+#include "vtkKWEPaintbrushUtilities.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "vtkTimerLog.h"
+#include <vtkstd/vector>
+
+typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+
+// Check that the voxels inside the stencil are those of the image with the
+// supplied label.
+static bool PaintbrushStencilsFromImageTestCheck( vtkImageData *image,
+                                                  vtkImageStencilData *stencil,
+                                                  LabelType label )
+{
+  int extent[6];
+  image->GetExtent(extent);
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      const LabelType *row = static_cast< LabelType * >(
+                          image->GetScalarPointer(extent[0], y, z));
+      vtkstd::vector< bool > inside(extent[1] - extent[0] + 1, false);
+      int r1, r2, iter = 0, moreSubExtents = 1;
+      while (moreSubExtents)
+        {
+        moreSubExtents = stencil->GetNextExtent(
+          r1, r2, extent[0], extent[1], y, z, iter);
+        for (int x = r1; x <= r2; x++)
+          {
+          inside[x - extent[0]] = true;
+          }
+        }
+      for (int x = extent[0]; x <= extent[1]; x++)
+        {
+        if (inside[x - extent[0]] != (row[x - extent[0]] == label))
+          {
+          return false;
+          }
+        }
+      }
+    }
+  return true;
+}
+
+int PaintbrushStencilsFromImageTest( int , char *[] )
+{
+  const int dims[3] = { 160, 150, 100 }, numberOfLabels = 120;
+
+  // Stripes of labels 1 to 120 along X, each a few voxels wide, with
+  // unlabeled gaps, shifted from one row to the next.
+  vtkSmartPointer< vtkImageData > image = vtkSmartPointer< vtkImageData >::New();
+  image->SetExtent(0, dims[0]-1, 0, dims[1]-1, 0, dims[2]-1);
+  image->SetScalarType( vtkKWEPaintbrushEnums::GetLabelType() );
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  LabelType *labels = static_cast< LabelType * >(image->GetScalarPointer());
+  for (int z = 0; z < dims[2]; z++)
+    {
+    for (int y = 0; y < dims[1]; y++)
+      {
+      for (int x = 0; x < dims[0]; x++, labels++)
+        {
+        const int stripe = (x + y + 3 * z) / 5;
+        *labels = (stripe % 7 == 0) ? 0 : static_cast< LabelType >(
+                                          stripe % numberOfLabels + 1);
+        }
+      }
+    }
+
+  // Every other label is requested.
+  vtkstd::vector< LabelType > requested;
+  for (int l = 2; l <= numberOfLabels; l += 2)
+    {
+    requested.push_back(static_cast< LabelType >(l));
+    }
+
+  vtkSmartPointer< vtkTimerLog > timer = vtkSmartPointer< vtkTimerLog >::New();
+  timer->StartTimer();
+  vtkstd::map< LabelType, vtkSmartPointer< vtkKWEPaintbrushStencilData > >
+    stencils = vtkKWEPaintbrushUtilities::GetStencilsFromImage(image, requested);
+  timer->StopTimer();
+  cout << "GetStencilsFromImage: " << timer->GetElapsedTime() << " s for "
+       << requested.size() << " labels." << endl;
+
+  if (stencils.size() != requested.size())
+    {
+    cerr << "Expected " << requested.size() << " stencils, got "
+         << stencils.size() << "." << endl;
+    return EXIT_FAILURE;
+    }
+
+  double elapsed = 0.0;
+  for (size_t i = 0; i < requested.size(); i++)
+    {
+    const LabelType label = requested[i];
+    if (stencils[label]->GetLabel() != label ||
+        !PaintbrushStencilsFromImageTestCheck(image,
+              stencils[label]->GetImageStencilData(), label))
+      {
+      cerr << "GetStencilsFromImage: wrong stencil for label " << label
+           << "." << endl;
+      return EXIT_FAILURE;
+      }
+
+    vtkSmartPointer< vtkImageStencilData > stencil =
+      vtkSmartPointer< vtkImageStencilData >::New();
+    timer->StartTimer();
+    vtkKWEPaintbrushUtilities::GetStencilFromImage<
+      vtkKWEPaintbrushUtilities::vtkFunctorEqualTo >(image, stencil, label);
+    timer->StopTimer();
+    elapsed += timer->GetElapsedTime();
+    if (!PaintbrushStencilsFromImageTestCheck(image, stencil, label))
+      {
+      cerr << "GetStencilFromImage: wrong stencil for label " << label
+           << "." << endl;
+      return EXIT_FAILURE;
+      }
+    }
+  cout << "GetStencilFromImage: " << elapsed << " s for "
+       << requested.size() << " labels." << endl;
+
+  // The threshold itself is within a <= stencil. The unlabeled voxels are
+  // the only ones <= 0.
+  vtkSmartPointer< vtkImageStencilData > stencil =
+    vtkSmartPointer< vtkImageStencilData >::New();
+  vtkKWEPaintbrushUtilities::GetStencilFromImage<
+    vtkKWEPaintbrushUtilities::vtkFunctorLessThanEqualTo >(image, stencil, 0);
+  if (!PaintbrushStencilsFromImageTestCheck(image, stencil, 0))
+    {
+    cerr << "GetStencilFromImage: wrong stencil for voxels <= 0." << endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test replays a freehand stroke of 10000 mouse move samples, then
+// replays it a second time. Every sample of the second pass must be rejected
+// as a duplicate of an existing node of the stroke. It reports the time
+// taken by both passes, the second one measuring mostly the node lookup.
+
+#include "vtkKWEPaintbrushStroke.h"
+#include "vtkKWEPaintbrushOperation.h"
+#include "vtkKWEPaintbrushShapeEllipsoid.h"
+#include "vtkImageData.h"
+#include "vtkTimerLog.h"
+#include "vtkSmartPointer.h"
+#include <vtkstd/vector>
+
+// Expose the stroke's AddShapeAtPosition, normally invoked by the sketch.
+class PaintbrushStrokeNodeTestStroke : public vtkKWEPaintbrushStroke
+{
+public:
+  static PaintbrushStrokeNodeTestStroke *New()
+    { return new PaintbrushStrokeNodeTestStroke; }
+  int AddShape( double p[3] ) { return this->AddShapeAtPosition(p); }
+};
+
+int PaintbrushStrokeNodeTest( int , char *[] )
+{
+  const int nSamples = 10000;
+
+  vtkSmartPointer< vtkImageData > canvas = vtkSmartPointer< vtkImageData >::New();
+  canvas->SetDimensions(64, 64, 1);
+  canvas->SetWholeExtent(canvas->GetExtent());
+  canvas->SetScalarTypeToUnsignedChar();
+  canvas->AllocateScalars();
+
+  vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid > shape =
+    vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid >::New();
+  shape->SetWidth(2.0, 2.0, 1.0);
+  shape->SetSpacing(canvas->GetSpacing());
+  shape->SetOrigin(canvas->GetOrigin());
+  vtkSmartPointer< vtkKWEPaintbrushOperation > operation =
+    vtkSmartPointer< vtkKWEPaintbrushOperation >::New();
+  operation->SetPaintbrushShape(shape);
+
+  PaintbrushStrokeNodeTestStroke *stroke = PaintbrushStrokeNodeTestStroke::New();
+  stroke->SetPaintbrushOperation(operation);
+  stroke->SetRepresentationToBinary();
+  stroke->SetImageData(canvas);
+  stroke->SetStateToDraw();
+
+  // A spiral, sampled finely enough that consecutive samples are a few
+  // thousandths of a pixel apart, as with a slowly dragged mouse.
+  vtkstd::vector< double > samples(3*nSamples);
+  for (int i = 0; i < nSamples; i++)
+    {
+    const double t = 0.01 * i, r = 5.0 + 0.002 * i;
+    samples[3*i]   = 32.0 + r * cos(t);
+    samples[3*i+1] = 32.0 + r * sin(t);
+    samples[3*i+2] = 0.0;
+    }
+
+  int retVal = EXIT_SUCCESS;
+  vtkSmartPointer< vtkTimerLog > timer = vtkSmartPointer< vtkTimerLog >::New();
+
+  timer->StartTimer();
+  int nAdded = 0;
+  for (int i = 0; i < nSamples; i++)
+    {
+    nAdded += stroke->AddShape(&samples[3*i]);
+    }
+  timer->StopTimer();
+  cout << "Drawing " << nSamples << " samples: "
+       << timer->GetElapsedTime() << " s" << endl;
+  if (nAdded != nSamples)
+    {
+    cerr << "Only " << nAdded << " of " << nSamples
+         << " distinct samples were added to the stroke." << endl;
+    retVal = EXIT_FAILURE;
+    }
+
+  timer->StartTimer();
+  int nDuplicatesAdded = 0;
+  for (int i = 0; i < nSamples; i++)
+    {
+    nDuplicatesAdded += stroke->AddShape(&samples[3*i]);
+    }
+  timer->StopTimer();
+  cout << "Replaying " << nSamples << " duplicate samples: "
+       << timer->GetElapsedTime() << " s" << endl;
+  if (nDuplicatesAdded)
+    {
+    cerr << nDuplicatesAdded << " duplicate samples were added to the stroke."
+         << endl;
+    retVal = EXIT_FAILURE;
+    }
+
+  // Samples within the tolerance (1e-4) of a node, including across the
+  // cells of the hash, are duplicates. Those further away are not.
+  double p[3] = { 10.0, 10.0, 0.0 };
+  double q[3] = { 10.0 - 0.6e-4, 10.0 + 0.6e-4, 0.0 };
+  double r[3] = { 10.0 + 2e-4, 10.0, 0.0 };
+  if (!stroke->AddShape(p) || stroke->AddShape(q) || !stroke->AddShape(r))
+    {
+    cerr << "Samples near the tolerance were not handled correctly." << endl;
+    retVal = EXIT_FAILURE;
+    }
+
+  stroke->Delete();
+  return retVal;
+}
@@ -0,0 +1,254 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test sweeps an ellipsoid and a box along an axis aligned, two
+// diagonal and a zero length segment, through the swept rasterization of
+// vtkKWEPaintbrushOperation, and compares the result with the shape stamped
+// at regularly spaced positions along the segment:
+//  - every stamped voxel must be swept,
+//  - every swept voxel must be stamped by the shape enlarged by the distance
+//    between two positions,
+//  - a zero length segment must sweep exactly one stamp.
+// The positions are multiples of 1/8th of a voxel, so that the stamps are
+// not moved by the sub-voxel quantization of the shapes.
+
+#include "vtkKWEPaintbrushOperation.h"
+#include "vtkKWEPaintbrushShapeEllipsoid.h"
+#include "vtkKWEPaintbrushShapeBox.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkImageStencilData.h"
+#include "vtkSmartPointer.h"
+#include <vtkstd/vector>
+
+#define PaintbrushSweptStencilTestSize 64
+
+// Set the voxels of the stencil in a 64^3 grid. Returns false if the
+// stencil does not fit in the grid.
+static bool PaintbrushSweptStencilTestMark( vtkKWEPaintbrushStencilData *data,
+                                            vtkstd::vector< char > &grid )
+{
+  const int n = PaintbrushSweptStencilTestSize;
+  grid.assign(n*n*n, 0);
+  vtkImageStencilData *stencil = data->GetImageStencilData();
+  const int *e = stencil->GetExtent();
+  for (int z = e[4]; z <= e[5]; z++)
+    {
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      int r1, r2, iter = 0;
+      while (stencil->GetNextExtent(r1, r2, e[0], e[1], y, z, iter))
+        {
+        if (r1 < 0 || r2 >= n || y < 0 || y >= n || z < 0 || z >= n)
+          {
+          return false;
+          }
+        for (int x = r1; x <= r2; x++)
+          {
+          grid[(z * n + y) * n + x] = 1;
+          }
+        }
+      }
+    }
+  return true;
+}
+
+// Stamp the shape at "nSteps"+1 positions from p0 to p1, in a 64^3 grid.
+static bool PaintbrushSweptStencilTestStamp(
+  vtkKWEPaintbrushOperation *operation, double p0[3], double p1[3],
+  int nSteps, vtkstd::vector< char > &grid )
+{
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > stamp =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  vtkstd::vector< char > stampGrid;
+  vtkKWEPaintbrushEnums::OperationType op;
+  grid.assign(PaintbrushSweptStencilTestSize * PaintbrushSweptStencilTestSize
+              * PaintbrushSweptStencilTestSize, 0);
+  for (int s = 0; s <= nSteps; s++)
+    {
+    double p[3];
+    for (int i = 0; i < 3; i++)
+      {
+      p[i] = p0[i] + (p1[i] - p0[i]) * s / (nSteps ? nSteps : 1);
+      }
+    operation->GetPaintbrushData(stamp, p, op);
+    if (!PaintbrushSweptStencilTestMark(stamp, stampGrid))
+      {
+      return false;
+      }
+    for (unsigned int v = 0; v < grid.size(); v++)
+      {
+      grid[v] |= stampGrid[v];
+      }
+    }
+  return true;
+}
+
+// Number of voxels set in a and not in b.
+static int PaintbrushSweptStencilTestCountMissing(
+  const vtkstd::vector< char > &a, const vtkstd::vector< char > &b )
+{
+  int n = 0;
+  for (unsigned int v = 0; v < a.size(); v++)
+    {
+    n += (a[v] && !b[v]) ? 1 : 0;
+    }
+  return n;
+}
+
+// Compare the sweep of the shape of the operation from p0 to p1 with the
+// stamps along the segment. Returns the number of errors.
+static int PaintbrushSweptStencilTestSegment(
+  vtkKWEPaintbrushOperation *operation, const char *name,
+  double p0[3], double p1[3], int nSteps )
+{
+  vtkKWEPaintbrushShape *shape = operation->GetPaintbrushShape();
+  vtkSmartPointer< vtkKWEPaintbrushStencilData > swept =
+    vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+  vtkKWEPaintbrushEnums::OperationType op;
+  vtkstd::vector< char > sweptGrid, stampGrid;
+  if (!operation->GetSweptPaintbrushData(swept, p0, p1, op) ||
+      !PaintbrushSweptStencilTestMark(swept, sweptGrid) ||
+      !PaintbrushSweptStencilTestStamp(operation, p0, p1, nSteps, stampGrid))
+    {
+    cerr << name << ": could not rasterize the shape." << endl;
+    return 1;
+    }
+
+  int nErrors = 0;
+  int nMissing = PaintbrushSweptStencilTestCountMissing(stampGrid, sweptGrid);
+  if (nMissing)
+    {
+    cerr << name << ": " << nMissing << " stamped voxels are not swept."
+         << endl;
+    ++nErrors;
+    }
+
+  if (nSteps == 0)
+    {
+    nMissing = PaintbrushSweptStencilTestCountMissing(sweptGrid, stampGrid);
+    if (nMissing)
+      {
+      cerr << name << ": " << nMissing << " swept voxels are not in the "
+           << "stamp." << endl;
+      ++nErrors;
+      }
+    return nErrors;
+    }
+
+  // Any point of the swept volume is in the shape centered at a point of the
+  // segment, at most half a step away from one of the stamps. The shape,
+  // enlarged by the step relative to its size, contains that point.
+  double width[3], spacing[3], step = 0.0;
+  shape->GetWidth(width[0], width[1], width[2]);
+  shape->GetSpacing(spacing);
+  for (int i = 0; i < 3; i++)
+    {
+    const double d = 2.0 * (p1[i] - p0[i]) / nSteps / width[i];
+    step += d * d;
+    }
+  const double factor = 1.0 + sqrt(step);
+  shape->SetWidth(width[0] * factor, width[1] * factor, width[2] * factor);
+  PaintbrushSweptStencilTestStamp(operation, p0, p1, nSteps, stampGrid);
+  shape->SetWidth(width[0], width[1], width[2]);
+
+  nMissing = PaintbrushSweptStencilTestCountMissing(sweptGrid, stampGrid);
+  if (nMissing)
+    {
+    cerr << name << ": " << nMissing << " swept voxels are not in the "
+         << "enlarged stamps." << endl;
+    ++nErrors;
+    }
+  return nErrors;
+}
+
+// Sweep the shape of the operation along the test segments.
+static int PaintbrushSweptStencilTestShape(
+  vtkKWEPaintbrushOperation *operation )
+{
+  // Segment ends, in voxels, multiples of 1/8th of a voxel, and the number
+  // of steps that keeps the stamps at multiples of 1/8th of a voxel.
+  const double start[3] = { 20.375, 24.625, 16.125 };
+  const double segments[4][3] = { { 12.0,  0.0,  0.0 },
+                                  {  8.0, -8.0,  4.0 },
+                                  {  6.0,  3.0, -5.0 },
+                                  {  0.0,  0.0,  0.0 } };
+  const int nSteps[4] = { 96, 32, 8, 0 };
+  const char *names[4] = { "axis aligned", "diagonal", "skew",
+                           "zero length" };
+
+  vtkKWEPaintbrushShape *shape = operation->GetPaintbrushShape();
+  double spacing[3], origin[3];
+  shape->GetSpacing(spacing);
+  shape->GetOrigin(origin);
+
+  int nErrors = 0;
+  for (int s = 0; s < 4; s++)
+    {
+    double p0[3], p1[3];
+    for (int i = 0; i < 3; i++)
+      {
+      p0[i] = origin[i] + start[i] * spacing[i];
+      p1[i] = origin[i] + (start[i] + segments[s][i]) * spacing[i];
+      }
+    nErrors += PaintbrushSweptStencilTestSegment(
+      operation, names[s], p0, p1, nSteps[s]);
+
+    // And backwards.
+    nErrors += PaintbrushSweptStencilTestSegment(
+      operation, names[s], p1, p0, nSteps[s]);
+    }
+  return nErrors;
+}
+
+int PaintbrushSweptStencilTest( int , char *[] )
+{
+  double spacing[3] = { 1.0, 0.5, 2.0 };
+  double origin[3] = { 0.25, -1.0, 0.5 };
+  int retVal = EXIT_SUCCESS;
+
+  vtkSmartPointer< vtkKWEPaintbrushOperation > operation =
+    vtkSmartPointer< vtkKWEPaintbrushOperation >::New();
+
+  vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid > ellipsoid =
+    vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid >::New();
+  ellipsoid->SetSpacing(spacing);
+  ellipsoid->SetOrigin(origin);
+  ellipsoid->SetWidth(7.3, 5.1, 9.7);
+  operation->SetPaintbrushShape(ellipsoid);
+  if (PaintbrushSweptStencilTestShape(operation))
+    {
+    cerr << "The swept ellipsoids differ from the stamped ones." << endl;
+    retVal = EXIT_FAILURE;
+    }
+
+  vtkSmartPointer< vtkKWEPaintbrushShapeBox > box =
+    vtkSmartPointer< vtkKWEPaintbrushShapeBox >::New();
+  box->SetSpacing(spacing);
+  box->SetOrigin(origin);
+  box->SetWidth(6.2, 4.4, 8.9);
+  operation->SetPaintbrushShape(box);
+  if (PaintbrushSweptStencilTestShape(operation))
+    {
+    cerr << "The swept boxes differ from the stamped ones." << endl;
+    retVal = EXIT_FAILURE;
+    }
+
+  return retVal;
+}
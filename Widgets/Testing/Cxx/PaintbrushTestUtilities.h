@@ -0,0 +1,130 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// Helpers shared by the paintbrush tests, to fill stencils and label maps
+// and to check label maps.
+
+#ifndef __PaintbrushTestUtilities_h
+#define __PaintbrushTestUtilities_h
+
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include <string.h>
+#include <vtkstd/map>
+#include <vtkstd/vector>
+
+// Insert the voxels of "box" in the stencil, which must be allocated and
+// must not hold any voxel after the first row of "box".
+inline void PaintbrushTestInsertBox( vtkKWEPaintbrushStencilData *data,
+                                     const int box[6] )
+{
+  vtkImageStencilData *stencil = data->GetImageStencilData();
+  for (int z = box[4]; z <= box[5]; z++)
+    {
+    for (int y = box[2]; y <= box[3]; y++)
+      {
+      stencil->InsertNextExtent(box[0], box[1], y, z);
+      }
+    }
+}
+
+// Set the voxels of "box", which must be inside the label map, to "label".
+inline void PaintbrushTestSetLabels( vtkKWEPaintbrushLabelData *data,
+                                     const int box[6],
+                                     vtkKWEPaintbrushEnums::LabelType label )
+{
+  for (int z = box[4]; z <= box[5]; z++)
+    {
+    for (int y = box[2]; y <= box[3]; y++)
+      {
+      vtkKWEPaintbrushEnums::LabelType *labels =
+        static_cast< vtkKWEPaintbrushEnums::LabelType * >(
+            data->GetLabelMap()->GetScalarPointer(box[0], y, z));
+      for (int x = box[0]; x <= box[1]; x++)
+        {
+        *labels++ = label;
+        }
+      }
+    }
+}
+
+// Are the labels of two label maps of the same extent equal ?
+inline bool PaintbrushTestCompareLabelMaps( vtkImageData *a, vtkImageData *b )
+{
+  return a->GetNumberOfPoints() == b->GetNumberOfPoints() &&
+         memcmp( a->GetScalarPointer(), b->GetScalarPointer(),
+                 a->GetNumberOfPoints() *
+                   sizeof(vtkKWEPaintbrushEnums::LabelType) ) == 0;
+}
+
+// Are the labels of label data, in either storage mode, equal to those of a
+// label map of the same extent ?
+inline bool PaintbrushTestCompareLabels( vtkKWEPaintbrushLabelData *a,
+                                         vtkImageData *b )
+{
+  vtkSmartPointer< vtkImageData > labels =
+    vtkSmartPointer< vtkImageData >::New();
+  a->GetPaintbrushDataAsImageData(labels);
+  return PaintbrushTestCompareLabelMaps(labels, b);
+}
+
+// Are the labels present, and their number of voxels, kept up to date by the
+// label data equal to a count of its voxels ?
+inline bool PaintbrushTestCheckLabelCounts( vtkKWEPaintbrushLabelData *a )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  vtkstd::map< LabelType, vtkIdType > counts;
+  int e[6];
+  a->GetExtent(e);
+  vtkstd::vector< LabelType > buffer(e[1] - e[0] + 1);
+  for (int z = e[4]; z <= e[5]; z++)
+    {
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      const LabelType *labels = a->GetLabelRow(e[0], e[1], y, z, &buffer[0]);
+      for (int x = e[0]; x <= e[1]; x++)
+        {
+        ++counts[*labels++];
+        }
+      }
+    }
+
+  vtkKWEPaintbrushLabelData::LabelSetType present = a->GetLabels();
+  present.insert(vtkKWEPaintbrushLabelData::NoLabelValue);
+  counts[vtkKWEPaintbrushLabelData::NoLabelValue];
+  if (present.size() != counts.size())
+    {
+    return false;
+    }
+  for (vtkstd::map< LabelType, vtkIdType >::const_iterator it = counts.begin();
+       it != counts.end(); ++it)
+    {
+    if (a->GetNumberOfVoxels(it->first) != it->second)
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+#endif
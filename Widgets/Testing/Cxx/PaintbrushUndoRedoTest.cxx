@@ -0,0 +1,220 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// This test draws overlapping strokes in two sketches of a label map drawing
+// and checks the label map after each undo and redo. Some of the undo/redo
+// operations are done incrementally, from the changes recorded for each
+// stroke, and some by composing the drawing.
+
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushOperation.h"
+#include "vtkKWEPaintbrushShapeEllipsoid.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "PaintbrushTestUtilities.h"
+#include <vtkstd/vector>
+
+// A box shaped stroke, drawn in a given sketch.
+struct PaintbrushUndoRedoTestBox
+{
+  int Sketch;
+  int Extent[6];
+};
+
+static const int PaintbrushUndoRedoTestDims[3] = { 32, 32, 3 };
+
+// Draw the box as a new stroke of its sketch.
+static void PaintbrushUndoRedoTestDraw( vtkKWEPaintbrushDrawing *drawing,
+                                        vtkImageData *canvas,
+                                        const PaintbrushUndoRedoTestBox &box )
+{
+  vtkKWEPaintbrushStencilData *data = vtkKWEPaintbrushStencilData::New();
+  data->SetExtent(canvas->GetExtent());
+  data->SetSpacing(canvas->GetSpacing());
+  data->SetOrigin(canvas->GetOrigin());
+  data->Allocate();
+  PaintbrushTestInsertBox(data, box.Extent);
+  drawing->GetItem(box.Sketch)->AddNewStroke(vtkKWEPaintbrushEnums::Draw, data);
+  data->Delete();
+}
+
+// Compare the label map with the boxes painted in order, with the label of
+// their sketch.
+static int PaintbrushUndoRedoTestCheck(
+  const char *step, vtkKWEPaintbrushDrawing *drawing,
+  const vtkstd::vector< PaintbrushUndoRedoTestBox > &boxes )
+{
+  const int *dims = PaintbrushUndoRedoTestDims;
+  vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > expected(
+      dims[0]*dims[1]*dims[2], vtkKWEPaintbrushLabelData::NoLabelValue);
+  for (unsigned int i = 0; i < boxes.size(); i++)
+    {
+    const int *e = boxes[i].Extent;
+    for (int z = e[4]; z <= e[5]; z++)
+      {
+      for (int y = e[2]; y <= e[3]; y++)
+        {
+        for (int x = e[0]; x <= e[1]; x++)
+          {
+          expected[(z*dims[1] + y)*dims[0] + x] =
+            drawing->GetItem(boxes[i].Sketch)->GetLabel();
+          }
+        }
+      }
+    }
+
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast(drawing->GetPaintbrushData());
+  vtkKWEPaintbrushEnums::LabelType *labels =
+    static_cast< vtkKWEPaintbrushEnums::LabelType * >(
+        labelData->GetLabelMap()->GetScalarPointer());
+  for (unsigned int i = 0; i < expected.size(); i++)
+    {
+    if (labels[i] != expected[i])
+      {
+      cerr << "After " << step << ", voxel " << i << " has label "
+           << static_cast<int>(labels[i]) << " instead of "
+           << static_cast<int>(expected[i]) << endl;
+      return 0;
+      }
+    }
+  return 1;
+}
+
+int PaintbrushUndoRedoTest( int , char *[] )
+{
+  const int *dims = PaintbrushUndoRedoTestDims;
+  vtkSmartPointer< vtkImageData > canvas = vtkSmartPointer< vtkImageData >::New();
+  canvas->SetDimensions(dims[0], dims[1], dims[2]);
+  canvas->SetWholeExtent(canvas->GetExtent());
+  canvas->SetScalarTypeToUnsignedChar();
+  canvas->AllocateScalars();
+
+  vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid > shape =
+    vtkSmartPointer< vtkKWEPaintbrushShapeEllipsoid >::New();
+  vtkSmartPointer< vtkKWEPaintbrushOperation > operation =
+    vtkSmartPointer< vtkKWEPaintbrushOperation >::New();
+  operation->SetPaintbrushShape(shape);
+
+  vtkSmartPointer< vtkKWEPaintbrushDrawing > drawing =
+    vtkSmartPointer< vtkKWEPaintbrushDrawing >::New();
+  drawing->SetRepresentationToLabel();
+  drawing->SetImageData(canvas);
+  drawing->SetPaintbrushOperation(operation);
+  drawing->InitializeData();
+  drawing->RemoveAllItems();
+
+  for (int i = 0; i < 2; i++)
+    {
+    vtkSmartPointer< vtkKWEPaintbrushSketch > sketch =
+      vtkSmartPointer< vtkKWEPaintbrushSketch >::New();
+    sketch->SetLabel(static_cast< vtkKWEPaintbrushEnums::LabelType >(i+1));
+    drawing->AddItem(sketch);
+    }
+  vtkKWEPaintbrushSketch *sketchA = drawing->GetItem(0);
+  vtkKWEPaintbrushSketch *sketchB = drawing->GetItem(1);
+
+  const PaintbrushUndoRedoTestBox A0 = { 0, {  0,  9,  0,  9, 0, 2 } };
+  const PaintbrushUndoRedoTestBox B0 = { 1, { 20, 29, 20, 29, 0, 2 } };
+  const PaintbrushUndoRedoTestBox A1 = { 0, {  5, 14,  5, 14, 0, 1 } };
+  const PaintbrushUndoRedoTestBox B1 = { 1, { 12, 24, 12, 24, 1, 2 } };
+
+  vtkstd::vector< PaintbrushUndoRedoTestBox > boxes;
+  const PaintbrushUndoRedoTestBox strokes[3] = { A0, B0, A1 };
+  for (int i = 0; i < 3; i++)
+    {
+    PaintbrushUndoRedoTestDraw(drawing, canvas, strokes[i]);
+    boxes.push_back(strokes[i]);
+    }
+  if (!PaintbrushUndoRedoTestCheck("drawing", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Nothing drawn after A1, it is undone and redone from its own changes.
+  boxes.pop_back();
+  if (!sketchA->PopStroke() ||
+      !PaintbrushUndoRedoTestCheck("undo of A1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+  boxes.push_back(A1);
+  if (!sketchA->PushStroke() ||
+      !PaintbrushUndoRedoTestCheck("redo of A1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // B1 overlaps A1, so undoing A1 now requires composing the drawing.
+  PaintbrushUndoRedoTestDraw(drawing, canvas, B1);
+  boxes.push_back(B1);
+  if (!PaintbrushUndoRedoTestCheck("drawing B1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  boxes.erase(boxes.begin() + 2);
+  if (!sketchA->PopStroke() ||
+      !PaintbrushUndoRedoTestCheck("undo of A1 under B1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  boxes.pop_back();
+  if (!sketchB->PopStroke() ||
+      !PaintbrushUndoRedoTestCheck("undo of B1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  boxes.push_back(B1);
+  if (!sketchB->PushStroke() ||
+      !PaintbrushUndoRedoTestCheck("redo of B1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // A1 is older than B1, so it is redone by composing the drawing.
+  boxes.insert(boxes.begin() + 2, A1);
+  if (!sketchA->PushStroke() ||
+      !PaintbrushUndoRedoTestCheck("redo of A1 under B1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Finally undo B1 and A1 in order, both from their recorded changes.
+  boxes.pop_back();
+  if (!sketchB->PopStroke() ||
+      !PaintbrushUndoRedoTestCheck("second undo of B1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+  boxes.pop_back();
+  if (!sketchA->PopStroke() ||
+      !PaintbrushUndoRedoTestCheck("second undo of A1", drawing, boxes))
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -46,6 +46,10 @@ public:
 
   virtual void AddSeed( int seed[3] );
 
+  // Remove the seeds added so far, when the filter is run again from
+  // another seed.
+  virtual void ClearSeeds();
+
   // No MTime checks etc.. will update every time..
   virtual void Update();
 
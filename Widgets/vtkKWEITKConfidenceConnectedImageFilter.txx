@@ -60,6 +60,22 @@ vtkKWEITKConfidenceConnectedImageFilter< InputPixelType >
   filter->GetRegionGrowingFilter()->AddSeed(index);
 }
 
+template< class InputPixelType >
+void
+vtkKWEITKConfidenceConnectedImageFilter< InputPixelType >
+::ClearSeeds()
+{
+  FilterModuleStencilOutput< FilterType > * f =
+    (dynamic_cast<
+     FilterModuleStencilOutput< FilterType > * >(this->m_Filter));
+  if (!f)
+    {
+    itkExceptionMacro( << "dynamic cast returned false.. impossible!");
+    }
+
+  f->GetFilter()->GetRegionGrowingFilter()->ClearSeeds();
+}
+
 template< class InputPixelType >
 void
 vtkKWEITKConfidenceConnectedImageFilter< InputPixelType >
@@ -77,6 +93,10 @@ vtkKWEITKConfidenceConnectedImageFilter< InputPixelType >
 
   FilterType *filter = f->GetFilter();
 
+  // The filter is run again on regions of other sizes, so hole filling may
+  // have been turned off for a previous, smaller, region.
+  filter->UseHoleFillingOn();
+
   // Override the propagation of extents.. the voting filters require that
   // the input be 1/2 the structuring element size larger on each side.
   // So we will shrink the output extents appropriately.
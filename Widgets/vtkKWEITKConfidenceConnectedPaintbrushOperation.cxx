@@ -26,8 +26,6 @@
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkKWEPaintbrushGrayscaleData.h"
 #include "vtkObjectFactory.h"
-#include "vtkImageExtractComponents.h"
-#include "vtkExtractVOI.h"
 #include "vtkKWEPaintbrushUtilities.h"
 
 vtkCxxRevisionMacro(vtkKWEITKConfidenceConnectedPaintbrushOperation, "$Revision: 1774 $");
@@ -49,21 +47,25 @@ PaintbrushRunner( vtkKWEITKConfidenceConnectedPaintbrushOperation * self,
                   vtkImageStencilData *stencil,
                   T )
 {
-  self->InternalFilter = NULL;
-
+  // The filter, and the ITK importer within it, are kept from one click to
+  // the next, as long as the pixel type does not change.
   typedef vtkitk::vtkKWEITKConfidenceConnectedImageFilter< T > PaintbrushFilterType;
-  typename PaintbrushFilterType::Pointer filter = PaintbrushFilterType::New();
-  self->InternalFilter = filter;
+  typename PaintbrushFilterType::Pointer filter =
+    dynamic_cast< PaintbrushFilterType * >(self->InternalFilter.GetPointer());
+  if (!filter)
+    {
+    filter = PaintbrushFilterType::New();
+    self->InternalFilter = filter;
+    }
 
   // Set the update region to a certain region on either side of the center
-  int extent[6], imageExtent[6];
-  double spacing[3], origin[3];
+  int extent[6], bounds[6];
+  double spacing[3];
   self->GetImageData()->GetSpacing(spacing);
-  self->GetImageData()->GetExtent(imageExtent);
+  self->GetRegionOfInterestBounds(bounds);
 
   // Set the center and radius to mask out a spherical stencil, instead of
   // one with rectangular jagged edges.
-  self->GetImageData()->GetOrigin(origin);
   double radiusFactor = 10.0 * spacing[0];
 
   int xyz[3] = { (int)(center[0]/spacing[0] + 0.5),
@@ -80,37 +82,34 @@ PaintbrushRunner( vtkKWEITKConfidenceConnectedPaintbrushOperation * self,
   extent[3] = (int)((center[1] + radiusFactor)/spacing[1] + 0.5);
   extent[4] = (int)((center[2] - radiusFactor)/spacing[2] + 0.5);
   extent[5] = (int)((center[2] + radiusFactor)/spacing[2] + 0.5);
-  vtkKWEPaintbrushUtilities::GetIntersectingExtents(extent, imageExtent, extent);
+  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                                     extent, bounds, extent))
+    {
+    return 0;
+    }
 
   // Despite the fact that the FilterModule framework supports updates on
   // requested extents, a lot of filters in ITK (such as the
   // ConfidenceConnectedImageFilter don't really support updating a subextent.
-  // So in most cases, you will have to extract a VOI).
-  vtkExtractVOI *extractVOI = vtkExtractVOI::New();
-  extractVOI->SetInput( self->GetImageData());
-  extractVOI->SetVOI(extent);
-
-  // Extract the first component
-  vtkImageExtractComponents * extractComponent = vtkImageExtractComponents::New();
-  extractComponent->SetInput( extractVOI->GetOutput() );
-  extractComponent->GetOutput()->SetUpdateExtent( extent );
-  extractComponent->SetComponents(0);
-  extractComponent->Update();
-  filter->SetRequestedExtent(extent);
-
-  // This is the filter that does most of the work. This is where most of the
-  // time for this operation is spent
-  filter->SetInput( extractComponent->GetOutput() );
-  filter->AddSeed( xyz );
-  filter->SetRequestedExtent(extent);
-  filter->Update();
-  filter->BoundWithRadiusOn();
-  filter->SetCenter( xyz );
-  filter->SetRadius( radius );
-  filter->GetOutputAsStencil(stencil);
-
-  extractComponent->Delete();
-  extractVOI->Delete();
+  // So the filter runs on a copy of the region of interest, grown until the
+  // segmentation no longer reaches its border.
+  do
+    {
+    filter->SetInput( self->GetRegionOfInterest(extent) );
+    filter->ClearSeeds();
+    filter->AddSeed( xyz );
+    filter->SetRequestedExtent(extent);
+
+    // This is the filter that does most of the work. This is where most of
+    // the time for this operation is spent
+    filter->Update();
+    filter->SetBoundWithRadius( !self->GetGrowRegionOfInterest() );
+    filter->SetCenter( xyz );
+    filter->SetRadius( radius );
+    filter->GetOutputAsStencil(stencil);
+    }
+  while (self->GrowRegionOfInterestIfNeeded(stencil, extent, bounds));
+
   return 1;
 }
 
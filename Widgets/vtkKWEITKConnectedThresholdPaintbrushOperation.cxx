@@ -26,8 +26,6 @@
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkKWEPaintbrushGrayscaleData.h"
 #include "vtkObjectFactory.h"
-#include "vtkImageExtractComponents.h"
-#include "vtkExtractVOI.h"
 #include "vtkKWEPaintbrushUtilities.h"
 
 vtkCxxRevisionMacro(vtkKWEITKConnectedThresholdPaintbrushOperation, "$Revision: 1774 $");
@@ -49,25 +47,27 @@ PaintbrushRunner( vtkKWEITKConnectedThresholdPaintbrushOperation * self,
                   vtkImageStencilData *stencil,
                   T )
 {
-  self->InternalFilter = NULL;
-
+  // The filter, and the ITK importer within it, are kept from one click to
+  // the next, as long as the pixel type does not change.
   typedef vtkitk::vtkKWEITKConnectedThresholdImageFilter< T > PaintbrushFilterType;
-  typename PaintbrushFilterType::Pointer filter = PaintbrushFilterType::New();
-  self->InternalFilter = filter;
+  typename PaintbrushFilterType::Pointer filter =
+    dynamic_cast< PaintbrushFilterType * >(self->InternalFilter.GetPointer());
+  if (!filter)
+    {
+    filter = PaintbrushFilterType::New();
+    self->InternalFilter = filter;
+    }
 
   // Set the update region to a certain region on either side of the center
   double spacing[3];
-  double origin[3];
-  int imageExtent[6];
-  self->GetImageData()->GetOrigin(origin);
   self->GetImageData()->GetSpacing(spacing);
-  self->GetImageData()->GetExtent(imageExtent);
 
   int xyz[3] = { (int)(center[0]/spacing[0] + 0.5),
                  (int)(center[1]/spacing[1] + 0.5),
                  (int)(center[2]/spacing[2] + 0.5) };
 
-  int extent[6];
+  int bounds[6], extent[6];
+  self->GetRegionOfInterestBounds(bounds);
   if( self->GetFilterHalfWidth()[0] >= 0 &&
       self->GetFilterHalfWidth()[1] >= 0 &&
       self->GetFilterHalfWidth()[2] >= 0 )
@@ -78,44 +78,38 @@ PaintbrushRunner( vtkKWEITKConnectedThresholdPaintbrushOperation * self,
     extent[3] = (int)(xyz[1]+self->GetFilterHalfWidth()[1]);
     extent[4] = (int)(xyz[2]-self->GetFilterHalfWidth()[2]);
     extent[5] = (int)(xyz[2]+self->GetFilterHalfWidth()[2]);
-    vtkKWEPaintbrushUtilities::GetIntersectingExtents(extent, imageExtent, extent);
-    vtkKWEPaintbrushUtilities::GetIntersectingExtents(extent, self->GetExtent(), extent);
+    if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                                       extent, bounds, extent))
+      {
+      return 0;
+      }
     }
   else
     {
-    vtkKWEPaintbrushUtilities::GetIntersectingExtents(self->GetExtent(), imageExtent, extent);
+    memcpy(extent, bounds, 6*sizeof(int));
     }
 
   // Despite the fact that the FilterModule framework supports updates on
   // requested extents, a lot of filters in ITK (such as the
   // ConnectedThresholdImageFilter don't really support updating a subextent.
-  // So in most cases, you will have to extract a VOI).
-  vtkExtractVOI *extractVOI = vtkExtractVOI::New();
-  extractVOI->SetInput( self->GetImageData());
-  extractVOI->SetVOI(extent);
-
-  // Extract the first component
-  vtkImageExtractComponents * extractComponent = vtkImageExtractComponents::New();
-  extractComponent->SetInput( extractVOI->GetOutput() );
-  //extractComponent->GetOutput()->SetUpdateExtent( extent );
-  extractComponent->SetComponents(0);
-  extractComponent->Update();
-  //filter->SetRequestedExtent(extent);
-
-  // This is the filter that does most of the work. This is where most of the
-  // time for this operation is spent
-  filter->SetInput( extractComponent->GetOutput() );
-  // Should add a seed for every point in the stencil
-  filter->AddSeed( xyz );
-  filter->SetRequestedExtent(extent);
-  //filter->BoundWithRadiusOn();
-  filter->SetCenter( xyz );
-  filter->SetRadius( self->GetFilterHalfWidth() );
-  filter->Update();
-  filter->GetOutputAsStencil(stencil);
-
-  extractComponent->Delete();
-  extractVOI->Delete();
+  // So the filter runs on a copy of the region of interest, grown until the
+  // segmentation no longer reaches its border.
+  do
+    {
+    filter->SetInput( self->GetRegionOfInterest(extent) );
+    filter->AddSeed( xyz );
+    filter->SetRequestedExtent(extent);
+    filter->SetBoundWithRadius( !self->GetGrowRegionOfInterest() );
+    filter->SetCenter( xyz );
+    filter->SetRadius( self->GetFilterHalfWidth() );
+
+    // This is the filter that does most of the work. This is where most of
+    // the time for this operation is spent
+    filter->Update();
+    filter->GetOutputAsStencil(stencil);
+    }
+  while (self->GrowRegionOfInterestIfNeeded(stencil, extent, bounds));
+
   return 1;
 }
 
@@ -29,6 +29,7 @@
 #include "vtkImageData.h"
 #include "vtkImageIterator.h"
 #include "vtkImageThreshold.h"
+#include "vtkImageStencilData.h"
 #include "vtkSmartPointer.h"
 #include "vtkKWEPaintbrushSketch.h"
 #include "vtkKWEPaintbrushDrawing.h"
@@ -47,9 +48,175 @@
 #include "itkImage.h"
 #include "itkImageRegionIterator.h"
 
+#include <vtkstd/vector>
+
 vtkCxxRevisionMacro(vtkKWEITKPaintbrushExtractConnectedComponents, "$Revision: 1774 $");
 vtkStandardNewMacro(vtkKWEITKPaintbrushExtractConnectedComponents);
 
+//----------------------------------------------------------------------------
+// A run of voxels X1 to X2 of the row (Y,Z) that belong to a component.
+struct vtkKWEITKPaintbrushComponentRun
+{
+  int X1, X2, Y, Z;
+};
+
+// The runs of a connected component, in the order of the rows, and their
+// bounding box.
+struct vtkKWEITKPaintbrushComponent
+{
+  vtkKWEITKPaintbrushComponent()
+    {
+    this->Extent[0] = this->Extent[2] = this->Extent[4] = VTK_INT_MAX;
+    this->Extent[1] = this->Extent[3] = this->Extent[5] = VTK_INT_MIN;
+    }
+
+  int Extent[6];
+  vtkstd::vector< vtkKWEITKPaintbrushComponentRun > Runs;
+};
+
+//----------------------------------------------------------------------------
+// Split a label map of connected components, labeled 1 to N, into the runs
+// of each component, in a single pass over the label map.
+template <class TLabelImage>
+void vtkKWEITKPaintbrushExtractConnectedComponentsSplit(
+  const TLabelImage *labelImage,
+  vtkstd::vector< vtkKWEITKPaintbrushComponent > &components )
+{
+  typedef typename TLabelImage::PixelType LabelType;
+  const typename TLabelImage::RegionType region =
+                              labelImage->GetBufferedRegion();
+  const int origin[3] = { static_cast< int >(region.GetIndex()[0]),
+                          static_cast< int >(region.GetIndex()[1]),
+                          static_cast< int >(region.GetIndex()[2]) };
+  const int size[3] = { static_cast< int >(region.GetSize()[0]),
+                        static_cast< int >(region.GetSize()[1]),
+                        static_cast< int >(region.GetSize()[2]) };
+  const LabelType nComponents = static_cast< LabelType >(components.size());
+
+  const LabelType *row = labelImage->GetBufferPointer();
+  for (int z = 0; z < size[2]; z++)
+    {
+    for (int y = 0; y < size[1]; y++, row += size[0])
+      {
+      int x = 0;
+      while (x < size[0])
+        {
+        const LabelType label = row[x];
+        int end = x + 1;
+        while (end < size[0] && row[end] == label)
+          {
+          ++end;
+          }
+        if (label > 0 && label <= nComponents)
+          {
+          vtkKWEITKPaintbrushComponent &component = components[label - 1];
+          vtkKWEITKPaintbrushComponentRun run =
+            { origin[0] + x, origin[0] + end - 1, origin[1] + y, origin[2] + z };
+          component.Runs.push_back(run);
+
+          int *e = component.Extent;
+          e[0] = (run.X1 < e[0]) ? run.X1 : e[0];
+          e[1] = (run.X2 > e[1]) ? run.X2 : e[1];
+          e[2] = (run.Y  < e[2]) ? run.Y  : e[2];
+          e[3] = (run.Y  > e[3]) ? run.Y  : e[3];
+          e[4] = (run.Z  < e[4]) ? run.Z  : e[4];
+          e[5] = (run.Z  > e[5]) ? run.Z  : e[5];
+          }
+        x = end;
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Copy a component of a grayscale drawing into "segment", whose extent is
+// the bounding box of the component padded by the 2 voxels of the
+// transition region. Within the component, the values of the drawing are
+// copied. Around it, the values of the drawing below 127.5 are copied if
+// they lie within the dilation of the component by a 5x5x5 structuring
+// element. The dilation only runs over the extent of "segment".
+static void vtkKWEITKPaintbrushExtractConnectedComponentsGrayscale(
+  const vtkKWEITKPaintbrushComponent &component,
+  vtkImageData *drawingImage, vtkImageData *segment )
+{
+  typedef itk::Image< unsigned char, 3 > ImageType;
+
+  int extent[6];
+  segment->GetExtent(extent);
+  ImageType::IndexType index;
+  ImageType::SizeType size;
+  for (int i = 0; i < 3; i++)
+    {
+    index[i] = extent[2*i];
+    size[i] = extent[2*i+1] - extent[2*i] + 1;
+    }
+  const vtkIdType nX = static_cast< vtkIdType >(size[0]);
+  const vtkIdType nXY = nX * static_cast< vtkIdType >(size[1]);
+
+  // The component alone, over the padded bounding box.
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( ImageType::RegionType(index, size) );
+  image->Allocate();
+  image->FillBuffer(0);
+  unsigned char *mask = image->GetBufferPointer();
+  for (vtkstd::vector< vtkKWEITKPaintbrushComponentRun >::const_iterator
+       it = component.Runs.begin(); it != component.Runs.end(); ++it)
+    {
+    memset( mask + (it->X1 - extent[0]) + (it->Y - extent[2]) * nX
+                 + (it->Z - extent[4]) * nXY, 255, it->X2 - it->X1 + 1 );
+    }
+
+  // Dilate the object, so we can copy over the transition region as well.
+  // We will dilate with a 5x5x5 structuring element.
+  typedef itk::BinaryBallStructuringElement<
+                  unsigned char, 3 > StructuringElementType;
+  typedef itk::BinaryDilateImageFilter<
+    ImageType, ImageType, StructuringElementType > DilateFilterType;
+  DilateFilterType::Pointer dilate = DilateFilterType::New();
+  dilate->SetInput( image );
+
+  StructuringElementType  structuringElement;
+  structuringElement.SetRadius( 2 );  // 5x5 structuring element
+  structuringElement.CreateStructuringElement();
+  dilate->SetKernel( structuringElement );
+  dilate->SetDilateValue(255);
+  dilate->Update();
+  const unsigned char *dilated = dilate->GetOutput()->GetBufferPointer();
+
+  // Within the object, copy the drawing. Within the transition region,
+  // copy the drawing where it lies below the threshold. Outside, set 0.
+  vtkImageIterator< unsigned char > it1( drawingImage, extent );
+  vtkImageIterator< unsigned char > it2( segment, extent );
+  while( !it2.IsAtEnd() )
+    {
+    unsigned char *inSI    = it1.BeginSpan();
+    unsigned char *inSIEnd = it1.EndSpan();
+    unsigned char *outSI   = it2.BeginSpan();
+    while (inSI != inSIEnd)
+      {
+      const unsigned char inputDrawingVal = *inSI;
+      if (*mask)
+        {
+        *outSI = inputDrawingVal; // Within the object
+        }
+      else if (*dilated && inputDrawingVal <= 127.5)
+        {
+        *outSI = inputDrawingVal; // Within the transition region
+        }
+      else
+        {
+        *outSI = 0; // Outside.
+        }
+      ++inSI;
+      ++outSI;
+      ++mask;
+      ++dilated;
+      }
+    it1.NextSpan();
+    it2.NextSpan();
+    }
+}
+
 //----------------------------------------------------------------------------
 vtkKWEITKPaintbrushExtractConnectedComponents::
 vtkKWEITKPaintbrushExtractConnectedComponents()
@@ -127,8 +294,12 @@ int vtkKWEITKPaintbrushExtractConnectedComponents
     inputBinaryImage->ShallowCopy( inputImage );
     }
 
+  // Components are labeled with 32 bit integers, so that there is no limit
+  // in practice to their number.
   typedef itk::Image< unsigned char, 3 > ImageType;
-  typedef itk::ConnectedComponentImageFilter< ImageType, ImageType > FilterType;
+  typedef itk::Image< unsigned int, 3 >  LabelImageType;
+  typedef itk::ConnectedComponentImageFilter<
+                          ImageType, LabelImageType > FilterType;
 
   FilterType::Pointer connectedComponentsFilter = FilterType::New();
 
@@ -137,9 +308,7 @@ int vtkKWEITKPaintbrushExtractConnectedComponents
 
   // Connect the pipeline.
   typedef itk::VTKImageToImageFilter< ImageType >  VTK2ITKConverter;
-  typedef itk::ImageToVTKImageFilter< ImageType >  ITK2VTKConverter;
   VTK2ITKConverter::Pointer inputConverter = VTK2ITKConverter::New();
-  ITK2VTKConverter::Pointer outputConverter = ITK2VTKConverter::New();
   inputConverter->SetInput( inputBinaryImage );
   connectedComponentsFilter->SetInput( inputConverter->GetOutput() );
 
@@ -155,172 +324,66 @@ int vtkKWEITKPaintbrushExtractConnectedComponents
     return 0;
     }
 
-  // Covert the segmented object label map to VTK land.
-  outputConverter->SetInput( connectedComponentsFilter->GetOutput() );
-  outputConverter->Update();
+  const int nSegments = static_cast< int >(
+                      connectedComponentsFilter->GetObjectCount());
 
-  int nSegments = static_cast< int >(connectedComponentsFilter->GetObjectCount());
+  // Split the label map into the runs of each of the components, along with
+  // their bounding boxes, in a single pass. The sketches are built from
+  // these, so as to avoid going over the whole extent for each of them.
+  vtkstd::vector< vtkKWEITKPaintbrushComponent > components(nSegments);
+  vtkKWEITKPaintbrushExtractConnectedComponentsSplit(
+    connectedComponentsFilter->GetOutput(), components );
 
-  // Find the bounding box of each of the segments. We will do that so as to
-  // save some memory allocating N sketches of the whole extent.
-  int *sketchExtents = new int[6*nSegments];
-  this->ComputeSegmentExtents( nSegments,
-      sketchExtents, outputConverter->GetOutput() );
+  // The extent of the drawing, which bounds the transition regions.
+  int imageExtent[6];
+  inputImage->GetExtent(imageExtent);
 
   // Now extract each connected component out into a vtkKWEPaintbrushSketch.
-  for (int n = 1; n <= nSegments; n++)
+  for (int n = 0; n < nSegments; n++)
     {
+    const vtkKWEITKPaintbrushComponent &component = components[n];
+    vtkKWEPaintbrushData * data;
 
-    int extent[6];
-    inputDrawing->GetImageData()->GetExtent(extent);
-
-    // Extract segmentN into an imageData.
-    vtkSmartPointer< vtkImageData > segmentN
-      = vtkSmartPointer< vtkImageData >::New();
-    segmentN->SetExtent( sketchExtents + 6*(n-1) );
-    segmentN->SetScalarTypeToUnsignedChar();
-    segmentN->SetOrigin( inputDrawing->GetImageData()->GetOrigin() );
-    segmentN->SetSpacing( inputDrawing->GetImageData()->GetSpacing() );
-    segmentN->AllocateScalars();
-
-    if (inputDrawing->GetRepresentation() == vtkKWEPaintbrushEnums::Grayscale)
+    // Convert the runs of the segment into a vtkKWEPaintbrushData.
+    if (inputDrawing->GetRepresentation() == vtkKWEPaintbrushEnums::Binary)
       {
-
-      // Extract object N from the output of the connected components algo
-      ImageType::Pointer image = ImageType::New();
-      image->SetRegions(connectedComponentsFilter->GetOutput()
-          ->GetLargestPossibleRegion());
-      image->Allocate();
-      typedef itk::ImageRegionConstIterator< ImageType > ConstIteratorType;
-      typedef itk::ImageRegionIterator< ImageType > IteratorType;
-      ConstIteratorType cit( connectedComponentsFilter->GetOutput(),
-              connectedComponentsFilter->GetOutput()->GetBufferedRegion());
-      IteratorType it( image, image->GetBufferedRegion());
-      while (!it.IsAtEnd())
+      vtkKWEPaintbrushStencilData *sdata = vtkKWEPaintbrushStencilData::New();
+      vtkImageStencilData *stencil = sdata->GetImageStencilData();
+      stencil->SetExtent( const_cast< int * >(component.Extent) );
+      stencil->SetOrigin( inputDrawing->GetImageData()->GetOrigin() );
+      stencil->SetSpacing( inputDrawing->GetImageData()->GetSpacing() );
+      stencil->AllocateExtents();
+      for (vtkstd::vector< vtkKWEITKPaintbrushComponentRun >::const_iterator
+           it = component.Runs.begin(); it != component.Runs.end(); ++it)
         {
-        it.Set( (cit.Get() == n) ? 255 : 0 );
-        ++cit;
-        ++it;
-        }
-
-
-      // Dilate the object, so we can copy over the transition region as well.
-      // We will dilate with a 5x5x5 structuring element.
-      typedef itk::BinaryBallStructuringElement<
-                      unsigned char, 3 > StructuringElementType;
-      typedef itk::BinaryDilateImageFilter<
-        ImageType, ImageType, StructuringElementType > DilateFilterType;
-      DilateFilterType::Pointer dilate = DilateFilterType::New();
-      dilate->SetInput( image );
-
-      StructuringElementType  structuringElement;
-      structuringElement.SetRadius( 2 );  // 5x5 structuring element
-      structuringElement.CreateStructuringElement();
-      dilate->SetKernel( structuringElement );
-      dilate->SetDilateValue(255);
-      dilate->Update();
-
-      // Covert the dilated ITK image to VTK
-      ITK2VTKConverter::Pointer dilatedConverter = ITK2VTKConverter::New();
-      dilatedConverter->SetInput( dilate->GetOutput() );
-
-      cout << "Start dilating object " << n << " of " << nSegments << endl;
-      dilatedConverter->Update();
-      cout << "Finished dilating" << endl;
-
-      // Now do the copy of both the object and the transition region.
-      // For the object, we need to look in the extracted segment, for the
-      // transition region, we need to look in the dilation. Within these
-      // regions we will copy the grayscale values from the original image.
-      // Outside these we will set the values to 0.
-      //
-      // So we need 4 iterators, to iterate over
-      //  * Extracted object
-      //  * Dilation of above
-      //  * Input drawing
-      //  * Output drawing.
-      //
-      vtkImageIterator< unsigned char > it1(
-          outputConverter->GetOutput(), segmentN->GetExtent());
-      vtkImageIterator< unsigned char > it2( segmentN, segmentN->GetExtent() );
-      vtkImageIterator< unsigned char > it3( inputImage, segmentN->GetExtent() );
-      vtkImageIterator< unsigned char > it4(
-          dilatedConverter->GetOutput(), segmentN->GetExtent() );
-
-      while( !it2.IsAtEnd() )
-        {
-        unsigned char *inSI    = it1.BeginSpan();
-        unsigned char *inSIEnd = it1.EndSpan();
-        unsigned char *inSI2   = it2.BeginSpan();
-        unsigned char *inSI3   = it3.BeginSpan();
-        unsigned char *inSI4   = it3.BeginSpan();
-        while (inSI != inSIEnd)
-          {
-          unsigned char inputDrawingVal = *inSI3;
-          if (*inSI == (unsigned char)n)
-            {
-            *inSI2 = inputDrawingVal; // Within the object
-            }
-          else if (*inSI4 && inputDrawingVal <= 127.5)
-            {
-            *inSI2 = inputDrawingVal; // Within the transition region
-            }
-          else
-            {
-            *inSI2 = 0; // Outside.
-            }
-
-          ++inSI;
-          ++inSI2;
-          ++inSI3;
-          ++inSI4;
-          }
-
-        it1.NextSpan();
-        it2.NextSpan();
-        it3.NextSpan();
-        it4.NextSpan();
+        stencil->InsertNextExtent( it->X1, it->X2, it->Y, it->Z );
         }
+      data = sdata;
       }
-    else // Binary case
+    else if (inputDrawing->GetRepresentation() == vtkKWEPaintbrushEnums::Grayscale)
       {
-      vtkImageIterator< unsigned char > it1(
-          outputConverter->GetOutput(), segmentN->GetExtent());
-      vtkImageIterator< unsigned char > it2( segmentN, segmentN->GetExtent() );
-
-      while( !it2.IsAtEnd() )
+      // The segment, along with the transition region around it, which
+      // lies within two voxels of it.
+      int extent[6];
+      for (int i = 0; i < 3; i++)
         {
-        unsigned char *inSI    = it1.BeginSpan();
-        unsigned char *inSIEnd = it1.EndSpan();
-        unsigned char *inSI2   = it2.BeginSpan();
-        while (inSI != inSIEnd)
-          {
-          *inSI2 = ((*inSI == (unsigned char)n) ? 255 : 0);
-          ++inSI;
-          ++inSI2;
-          }
-        it1.NextSpan();
-        it2.NextSpan();
+        extent[2*i]   = component.Extent[2*i]   - 2;
+        extent[2*i+1] = component.Extent[2*i+1] + 2;
         }
-      }
+      vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                                      extent, imageExtent, extent);
 
-    // Populate a sketch that encapsulates this segment and add it to the
-    // drawing.
-    vtkKWEPaintbrushSketch *sketchN = outputDrawing->AddItem();
-    vtkKWEPaintbrushData * data;
+      vtkSmartPointer< vtkImageData > segmentN
+        = vtkSmartPointer< vtkImageData >::New();
+      segmentN->SetExtent( extent );
+      segmentN->SetScalarTypeToUnsignedChar();
+      segmentN->SetOrigin( inputDrawing->GetImageData()->GetOrigin() );
+      segmentN->SetSpacing( inputDrawing->GetImageData()->GetSpacing() );
+      segmentN->AllocateScalars();
+
+      vtkKWEITKPaintbrushExtractConnectedComponentsGrayscale(
+        component, inputImage, segmentN );
 
-    // Convert this vtkImageData that represents the segment into
-    // a vtkKWEPaintbrushData.
-    if (inputDrawing->GetRepresentation() == vtkKWEPaintbrushEnums::Binary)
-      {
-      vtkKWEPaintbrushStencilData *sdata = vtkKWEPaintbrushStencilData::New();
-      vtkKWEPaintbrushUtilities::GetStencilFromImage<
-        vtkKWEPaintbrushUtilities::vtkFunctorGreaterThan >(
-          segmentN, sdata->GetImageStencilData(), 127.5 );
-      data = sdata;
-      }
-    else if (inputDrawing->GetRepresentation() == vtkKWEPaintbrushEnums::Grayscale)
-      {
       vtkKWEPaintbrushGrayscaleData *sdata = vtkKWEPaintbrushGrayscaleData::New();
       sdata->SetImageData( segmentN );
       data = sdata;
@@ -331,6 +394,10 @@ int vtkKWEITKPaintbrushExtractConnectedComponents
       return 0;
       }
 
+    // Populate a sketch that encapsulates this segment and add it to the
+    // drawing.
+    vtkKWEPaintbrushSketch *sketchN = outputDrawing->AddItem();
+
     // Copy over some default properties from the input drawing.
     vtkKWEPaintbrushProperty *inputProperty =
       inputDrawing->GetItem(this->SketchIndex)->GetPaintbrushProperty();
@@ -343,7 +410,6 @@ int vtkKWEITKPaintbrushExtractConnectedComponents
     data->Delete();
     }
 
-  delete [] sketchExtents;
   return 1;
 }
 
@@ -457,67 +523,3 @@ vtkKWEPaintbrushDrawing* vtkKWEITKPaintbrushExtractConnectedComponents::GetOutpu
 {
   return vtkKWEPaintbrushDrawing::SafeDownCast(this->GetOutputDataObject(0));
 }
-
-//----------------------------------------------------------------------------
-void vtkKWEITKPaintbrushExtractConnectedComponents
-::ComputeSegmentExtents( int nSegments, int *e, vtkImageData *image )
-{
-  vtkImageIterator< unsigned char > it(image, image->GetExtent());
-  for (int i = 0; i < nSegments; i++)
-    {
-    const int offset = i*6;
-    e[offset]   = e[offset + 2] = e[offset + 4] = VTK_INT_MAX;
-    e[offset+1] = e[offset + 3] = e[offset + 5] = VTK_INT_MIN;
-    }
-
-  int extent[6];
-  image->GetExtent(extent);
-  int ijk[3] = { extent[0], extent[2], extent[4] };
-
-  while( !it.IsAtEnd() )
-    {
-    unsigned char *inSI    = it.BeginSpan();
-    unsigned char *inSIEnd = it.EndSpan();
-    while (inSI != inSIEnd)
-      {
-      for (int i = 1; i <= nSegments; i++)
-        {
-        if (*inSI == i)
-          {
-          const int offset = (i-1)*6;
-          for (int j = 0; j < 3; j++)
-            {
-            if (e[offset + 2*j]    > ijk[j]) { e[offset + 2*j]   = ijk[j]; }
-            if (e[offset + 2*j +1] < ijk[j]) { e[offset + 2*j+1] = ijk[j]; }
-            }
-          }
-        }
-
-      ++inSI;
-      ++ijk[0];
-
-      // Find out our structured coordinate in the image.
-      }
-    it.NextSpan();
-
-    if (ijk[0] > extent[1])
-      {
-      ijk[0] = extent[0];
-      ++ijk[1];
-      if (ijk[1] > extent[3])
-        {
-        ijk[1] = extent[2];
-        ++ijk[2];
-        }
-      }
-    }
-
-  for (int i = 0; i < nSegments; i++)
-    {
-    const int offset = i*6;
-    cout << e[offset] <<" " <<
-      e[offset + 1] << " " << e[offset + 2] << " " << e[offset + 3] << " " << e[offset + 4] << " " << e[offset + 5] << endl;
-    }
-
-}
-
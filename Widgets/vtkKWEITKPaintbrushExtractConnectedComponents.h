@@ -26,6 +26,13 @@
 // sketch). The algorithm will produce as output a drawing with 'n' sketches
 // where 'n' is the number of connected components. Each connected component
 // is a seperate sketch.
+//
+// The label map of the components is split in a single pass into the runs
+// of each component and its bounding box, so the cost does not grow with
+// the number of components times the size of the volume. Components are
+// labeled with 32 bit integers. For grayscale drawings, the transition
+// region around each component is found by dilating the component within
+// its bounding box, padded by the radius of the dilation.
 // .SECTION See Also
 
 #ifndef __vtkKWEITKPaintbrushExtractConnectedComponents_h
@@ -88,11 +95,6 @@ protected:
                                 vtkInformationVector** inputVector,
                                 vtkInformationVector* outputVector);
 
-  // Description:
-  // Compute the tightest bounding box that covers each of the connected
-  // components.
-  void ComputeSegmentExtents( int nSegments, int *e, vtkImageData *image );
-
   int SketchIndex;
 
 private:
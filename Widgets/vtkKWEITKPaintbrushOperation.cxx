@@ -19,6 +19,10 @@
 //
 //=============================================================================
 #include "vtkKWEITKPaintbrushOperation.h"
+#include "vtkKWEPaintbrushUtilities.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkPointData.h"
 #include "vtkObjectFactory.h"
 
 vtkCxxRevisionMacro(vtkKWEITKPaintbrushOperation, "$Revision: 1774 $");
@@ -30,16 +34,167 @@ vtkKWEITKPaintbrushOperation::vtkKWEITKPaintbrushOperation()
   this->FilterHalfWidth[0] = 10;
   this->FilterHalfWidth[1] = 10;
   this->FilterHalfWidth[2] = 10;
+  this->GrowRegionOfInterest = 1;
+  this->RegionOfInterest = vtkImageData::New();
 }
 
 //----------------------------------------------------------------------
 vtkKWEITKPaintbrushOperation::~vtkKWEITKPaintbrushOperation()
 {
+  this->InternalFilter = NULL;
+  this->RegionOfInterest->Delete();
+}
+
+//----------------------------------------------------------------------
+void vtkKWEITKPaintbrushOperation::SetImageData( vtkImageData *image )
+{
+  if (image != this->ImageData)
+    {
+    this->RegionOfInterest->Initialize();
+    }
+  this->Superclass::SetImageData(image);
+}
+
+//----------------------------------------------------------------------
+template <class T>
+void vtkKWEITKPaintbrushOperationCopyRegion( vtkImageData *image,
+                                             vtkImageData *region,
+                                             int extent[6], T * )
+{
+  const int nComponents = image->GetNumberOfScalarComponents();
+  const int nX = extent[1] - extent[0] + 1;
+  T *outPtr = static_cast< T * >(region->GetScalarPointer());
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      const T *inPtr = static_cast< T * >(
+        image->GetScalarPointer(extent[0], y, z));
+      if (nComponents == 1)
+        {
+        memcpy(outPtr, inPtr, nX * sizeof(T));
+        outPtr += nX;
+        }
+      else
+        {
+        for (int x = 0; x < nX; x++, inPtr += nComponents)
+          {
+          *outPtr++ = *inPtr;
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------
+vtkImageData *vtkKWEITKPaintbrushOperation::GetRegionOfInterest( int extent[6] )
+{
+  vtkImageData *region = this->RegionOfInterest;
+  int regionExtent[6];
+  region->GetExtent(regionExtent);
+  if (region->GetPointData()->GetScalars() &&
+      region->GetScalarType() == this->ImageData->GetScalarType() &&
+      memcmp(regionExtent, extent, 6 * sizeof(int)) == 0 &&
+      this->RegionOfInterestTime > this->ImageData->GetMTime())
+    {
+    return region;
+    }
+
+  // The region is reallocated only if it needs more room. The importer
+  // picks up the new extent and data through the pipeline, since the region
+  // is modified.
+  region->SetSpacing(this->ImageData->GetSpacing());
+  region->SetOrigin(this->ImageData->GetOrigin());
+  region->SetExtent(extent);
+  region->SetWholeExtent(extent);
+  region->SetUpdateExtent(extent);
+  region->SetScalarType(this->ImageData->GetScalarType());
+  region->SetNumberOfScalarComponents(1);
+  region->AllocateScalars();
+
+  switch (this->ImageData->GetScalarType())
+    {
+    vtkTemplateMacro( vtkKWEITKPaintbrushOperationCopyRegion(
+      this->ImageData, region, extent, static_cast< VTK_TT * >(0)) );
+    }
+
+  region->Modified();
+  this->RegionOfInterestTime.Modified();
+  return region;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEITKPaintbrushOperation::GetRegionOfInterestBounds( int bounds[6] )
+{
+  this->ImageData->GetExtent(bounds);
+  if (this->Extent[0] <= this->Extent[1])
+    {
+    vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                                   bounds, this->Extent, bounds);
+    }
+}
+
+//----------------------------------------------------------------------
+int vtkKWEITKPaintbrushOperation::GrowRegionOfInterestIfNeeded(
+  vtkImageStencilData *stencil, int extent[6], const int bounds[6] )
+{
+  if (!this->GrowRegionOfInterest)
+    {
+    return 0;
+    }
+
+  // Find the sides of the region touched by the segmentation.
+  int touched[6] = { 0, 0, 0, 0, 0, 0 };
+  int stencilExtent[6];
+  stencil->GetExtent(stencilExtent);
+  for (int z = stencilExtent[4]; z <= stencilExtent[5]; z++)
+    {
+    for (int y = stencilExtent[2]; y <= stencilExtent[3]; y++)
+      {
+      int r1, r2, iter = 0;
+      while (stencil->GetNextExtent( r1, r2, stencilExtent[0],
+                                     stencilExtent[1], y, z, iter ))
+        {
+        touched[0] |= (r1 <= extent[0]);
+        touched[1] |= (r2 >= extent[1]);
+        touched[2] |= (y <= extent[2]);
+        touched[3] |= (y >= extent[3]);
+        touched[4] |= (z <= extent[4]);
+        touched[5] |= (z >= extent[5]);
+        }
+      }
+    }
+
+  // Push out, by half the size of the region, the sides touched that can
+  // still move.
+  int grown = 0;
+  for (int i = 0; i < 3; i++)
+    {
+    const int step = (extent[2*i+1] - extent[2*i] + 2) / 2;
+    if (touched[2*i] && extent[2*i] > bounds[2*i])
+      {
+      extent[2*i] -= step;
+      extent[2*i] = (extent[2*i] < bounds[2*i]) ? bounds[2*i] : extent[2*i];
+      grown = 1;
+      }
+    if (touched[2*i+1] && extent[2*i+1] < bounds[2*i+1])
+      {
+      extent[2*i+1] += step;
+      extent[2*i+1] = (extent[2*i+1] > bounds[2*i+1])
+                                ? bounds[2*i+1] : extent[2*i+1];
+      grown = 1;
+      }
+    }
+  return grown;
 }
 
 //----------------------------------------------------------------------
 void vtkKWEITKPaintbrushOperation::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "FilterHalfWidth: (" << this->FilterHalfWidth[0] << ", "
+     << this->FilterHalfWidth[1] << ", " << this->FilterHalfWidth[2] << ")"
+     << endl;
+  os << indent << "GrowRegionOfInterest: "
+     << this->GrowRegionOfInterest << endl;
 }
-
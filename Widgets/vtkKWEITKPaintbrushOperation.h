@@ -21,6 +21,12 @@
 // .NAME vtkKWEITKPaintbrushOperation -
 // .SECTION Description
 // This is an abstract base class.
+//
+// The ITK filters of the subclasses run on a region of interest around the
+// seed, copied from the first component of the image data. By default, the
+// region grows as long as the segmentation touches its border, see
+// GrowRegionOfInterest. The region and the ITK filter importing it are kept
+// from one click to the next.
 // .SECTION See Also
 
 #ifndef __vtkKWEITKPaintbrushOperation_h
@@ -28,10 +34,12 @@
 
 #include "vtkKWEPaintbrushOperation.h"
 #include "vtkKWEITKImageToStencilFilter.h"
+#include "vtkTimeStamp.h" // for RegionOfInterestTime
 
 typedef double  RealType;
 
 class vtkImageStencilData;
+class vtkImageData;
 
 class VTKEdge_WIDGETS_EXPORT vtkKWEITKPaintbrushOperation
                                 : public vtkKWEPaintbrushOperation
@@ -51,11 +59,61 @@ public:
   vtkSetVector3Macro( FilterHalfWidth, double );
   vtkGetVector3Macro( FilterHalfWidth, double );
 
+  // Description:
+  // Grow the region of interest the filter runs on for as long as the
+  // segmentation touches one of its sides, pushing those sides out by half
+  // the size of the region each time, up to the image extent (and the
+  // Extent of the operation). The region starts FilterHalfWidth voxels on
+  // either side of the seed. The segmentation is then bounded by the
+  // filter alone, rather than by a sphere. On by default.
+  vtkSetMacro( GrowRegionOfInterest, int );
+  vtkGetMacro( GrowRegionOfInterest, int );
+  vtkBooleanMacro( GrowRegionOfInterest, int );
+
+  // Description:
+  // Set the image data on which the paintbrush is drawn. The region of
+  // interest copied from the previous image is discarded.
+  virtual void SetImageData( vtkImageData * );
+
+  // Description:
+  // INTERNAL - Do not use.
+  // The first component of the image data over "extent", in an image kept
+  // from one click to the next, so that the ITK filter importing it stays
+  // connected. It is only copied again when the extent or the image data
+  // change.
+  vtkImageData *GetRegionOfInterest( int extent[6] );
+
+  // Description:
+  // INTERNAL - Do not use.
+  // The extent a region of interest may grow to: the image data's, bounded
+  // by the Extent of the operation if set.
+  void GetRegionOfInterestBounds( int bounds[6] );
+
+  // Description:
+  // INTERNAL - Do not use.
+  // If GrowRegionOfInterest is on and the stencil touches a side of
+  // "extent" that lies within "bounds", push out the sides touched and
+  // return 1. Return 0 if the region need not or cannot grow.
+  int GrowRegionOfInterestIfNeeded( vtkImageStencilData *,
+                                    int extent[6], const int bounds[6] );
+
+  // Description:
+  // The filters run about each position of a stroke. Strokes are never
+  // swept.
+  virtual int GetSweptPaintbrushData(vtkKWEPaintbrushData *,
+                                     double *, double *,
+                                     vtkKWEPaintbrushEnums::OperationType &)
+    { return 0; }
+
 protected:
   vtkKWEITKPaintbrushOperation();
   ~vtkKWEITKPaintbrushOperation();
 
   double FilterHalfWidth[3];
+  int    GrowRegionOfInterest;
+
+  vtkImageData *RegionOfInterest;
+  vtkTimeStamp  RegionOfInterestTime;
 
   // Description:
   // Filter the incoming data (first arg) through this operation. The
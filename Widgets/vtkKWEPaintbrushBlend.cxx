@@ -21,6 +21,7 @@
 #include "vtkKWEPaintbrushBlend.h"
 
 #include "vtkAlgorithmOutput.h"
+#include "vtkDataArray.h"
 #include "vtkImageData.h"
 #include "vtkImageStencilData.h"
 #include "vtkInformation.h"
@@ -37,6 +38,13 @@
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkKWEPaintbrushLabelData.h"
 #include "vtkKWEPaintbrushEnums.h"
+#include "vtkKWEPaintbrushUtilities.h"
+#include <vtkstd/algorithm>
+#include <vtkstd/vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 typedef unsigned char VTKColorType [3];
 
@@ -50,11 +58,13 @@ vtkKWEPaintbrushBlend::vtkKWEPaintbrushBlend()
   this->SetNumberOfInputPorts(2);
   this->Opacity = 0.5;
   this->UseOverlay=1;
+  this->BlendedImage = vtkImageData::New();
 }
 
 //----------------------------------------------------------------------------
 vtkKWEPaintbrushBlend::~vtkKWEPaintbrushBlend()
 {
+  this->BlendedImage->Delete();
 }
 
 //----------------------------------------------------------------------------
@@ -123,587 +133,799 @@ int vtkKWEPaintbrushBlend::RequestData(
     // Preprocess and store all the labels.
     }
 
-  return this->Superclass::RequestData(request,inputVector,outputVector);
+  vtkImageData *output = vtkImageData::SafeDownCast(
+    outputVector->GetInformationObject(0)->Get(vtkDataObject::DATA_OBJECT()));
+
+  // A stroke usually changes a small part of the drawing. Blend only that
+  // part if we can.
+  if (this->RequestDataForDirtyExtents(request, inputVector, outputVector))
+    {
+    this->BlendDone(drawing, output);
+    return 1;
+    }
+
+  int ret = this->Superclass::RequestData(request,inputVector,outputVector);
+  this->BlendDone(drawing, output);
+  return ret;
 }
 
 //----------------------------------------------------------------------------
-// This templated function blends a stencil that represents a sketch from a
-// drawing into the overlaid image. This method is specific to the case when
-// the overlaid image has data type of CHAR
-template <class T>
-void vtkKWEPaintbrushBlendExecuteChar( vtkImageStencilData * stencil,
-                                    vtkKWEPaintbrushBlend *vtkNotUsed(self),
-                                    int extent[6],
-                                    vtkImageData *inData, T *,
-                                    vtkImageData *outData, T *,
-                                    double opacity, unsigned char color[3])
+void vtkKWEPaintbrushBlend::BlendDone( vtkKWEPaintbrushDrawing *drawing,
+                                       vtkImageData *output )
 {
-  int inC, outC;
-  unsigned short r, f, o;
-  int v0, v1, v2;
-  int stencilExtent[6];
-
-  // round opacity to a value in the range [0,256], because division
-  // by 256 can be efficiently achieved by bit-shifting by 8 bits
-  o = static_cast<unsigned short>(256*opacity + 0.5);
-  r = o;
-  f = static_cast<unsigned short>(256 - o);
-
-  inC = inData->GetNumberOfScalarComponents();
-  outC = outData->GetNumberOfScalarComponents();
+  // Keep a reference to the blended image, to update it in place next time.
+  this->BlendedImage->SetScalarType(output->GetScalarType());
+  this->BlendedImage->SetNumberOfScalarComponents(
+                        output->GetNumberOfScalarComponents());
+  this->BlendedImage->SetExtent(output->GetExtent());
+  this->BlendedImage->GetPointData()->SetScalars(
+                        output->GetPointData()->GetScalars());
+
+  this->BlendedSketches.clear();
+  for (int n = 0; n < drawing->GetNumberOfItems(); n++)
+    {
+    this->BlendedSketches.push_back(drawing->GetItem(n));
+    }
+  this->BlendTime.Modified();
+}
 
-  // Check the stencil extents
-  stencil->GetExtent(stencilExtent);
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushBlend::RequestDataForDirtyExtents(
+  vtkInformation* request,
+  vtkInformationVector** inputVector,
+  vtkInformationVector* outputVector)
+{
+  vtkInformation *outInfo = outputVector->GetInformationObject(0);
+  vtkImageData *output = vtkImageData::SafeDownCast(
+          outInfo->Get(vtkDataObject::DATA_OBJECT()));
+  vtkImageData *input = vtkImageData::SafeDownCast(
+    inputVector[0]->GetInformationObject(0)->Get(vtkDataObject::DATA_OBJECT()));
+  vtkKWEPaintbrushDrawing *drawing = vtkKWEPaintbrushDrawing::SafeDownCast(
+    inputVector[1]->GetInformationObject(0)->Get(vtkDataObject::DATA_OBJECT()));
+  vtkImageData *blended = this->BlendedImage;
+
+  int outExt[6], blendedExt[6];
+  outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outExt);
+  blended->GetExtent(blendedExt);
+
+  // The last blend can be updated if it covers the same extent, and if
+  // nothing but the voxels of the drawing changed since.
+  const unsigned long blendTime = this->BlendTime.GetMTime();
+  vtkDataArray *scalars = blended->GetPointData()->GetScalars();
+  if (!scalars ||
+      scalars->GetDataType() != input->GetScalarType() ||
+      scalars->GetNumberOfComponents() !=
+        input->GetNumberOfScalarComponents() ||
+      outExt[0] != blendedExt[0] || outExt[1] != blendedExt[1] ||
+      outExt[2] != blendedExt[2] || outExt[3] != blendedExt[3] ||
+      outExt[4] != blendedExt[4] || outExt[5] != blendedExt[5] ||
+      this->GetMTime() > blendTime ||
+      input->GetMTime() > blendTime ||
+      drawing->vtkObject::GetMTime() > blendTime ||
+      drawing->GetNumberOfItems() !=
+        static_cast< int >(this->BlendedSketches.size()))
+    {
+    return 0;
+    }
 
-  stencilExtent[0] = (stencilExtent[0] < extent[0]) ? extent[0] : stencilExtent[0];
-  stencilExtent[1] = (stencilExtent[1] > extent[1]) ? extent[1] : stencilExtent[1];
-  stencilExtent[2] = (stencilExtent[2] < extent[2]) ? extent[2] : stencilExtent[2];
-  stencilExtent[3] = (stencilExtent[3] > extent[3]) ? extent[3] : stencilExtent[3];
-  stencilExtent[4] = (stencilExtent[4] < extent[4]) ? extent[4] : stencilExtent[4];
-  stencilExtent[5] = (stencilExtent[5] > extent[5]) ? extent[5] : stencilExtent[5];
+  // Extents of the drawing changed since the last blend.
+  vtkstd::vector< int > dirtyExtents;
+  for (int n = 0; n < drawing->GetNumberOfItems(); n++)
+    {
+    vtkKWEPaintbrushSketch *sketch = drawing->GetItem(n);
+    if (sketch != this->BlendedSketches[n] ||
+        sketch->vtkObject::GetMTime() > blendTime ||
+        sketch->GetPaintbrushProperty()->GetMTime() > blendTime)
+      {
+      return 0;
+      }
+    if (drawing->GetRepresentation() == vtkKWEPaintbrushEnums::Binary &&
+        !sketch->GetPaintbrushData()->GetDirtyExtents(
+                                            blendTime, dirtyExtents))
+      {
+      return 0;
+      }
+    }
+  if (drawing->GetRepresentation() == vtkKWEPaintbrushEnums::Label &&
+      !drawing->GetPaintbrushData()->GetDirtyExtents(
+                                            blendTime, dirtyExtents))
+    {
+    return 0;
+    }
 
-  // Loop through ouput pixels
-  for (int idxZ = stencilExtent[4]; idxZ <= stencilExtent[5]; idxZ++)
+  // Blend the extents within the output, or their bounding box if they
+  // overlap a lot, as successive changes of a stroke do.
+  vtkstd::vector< int > extents;
+  int bounds[6] = { VTK_INT_MAX, VTK_INT_MIN, VTK_INT_MAX,
+                    VTK_INT_MIN, VTK_INT_MAX, VTK_INT_MIN };
+  double nVoxels = 0.0;
+  for (size_t i = 0; i < dirtyExtents.size(); i += 6)
     {
-    for (int idxY = stencilExtent[2]; idxY <= stencilExtent[3]; idxY++)
+    int extent[6];
+    if (vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+          &dirtyExtents[i], outExt, extent))
       {
-      int iter = 0, moreSubExtents = 1, r1, r2;
-      while (moreSubExtents)
+      extents.insert(extents.end(), extent, extent + 6);
+      nVoxels += static_cast< double >(extent[1] - extent[0] + 1) *
+                 (extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1);
+      for (int j = 0; j < 3; j++)
         {
-        moreSubExtents = stencil->GetNextExtent( r1, r2,
-            stencilExtent[0], stencilExtent[1], idxY, idxZ, iter );
+        bounds[2*j]   = (extent[2*j] < bounds[2*j]) ? extent[2*j] : bounds[2*j];
+        bounds[2*j+1] = (extent[2*j+1] > bounds[2*j+1])
+                                        ? extent[2*j+1] : bounds[2*j+1];
+        }
+      }
+    }
 
-        r1 = (r1 < stencilExtent[0]) ? stencilExtent[0] : r1;
-        r2 = (r2 > stencilExtent[1]) ? stencilExtent[1] : r2;
+  if (!extents.empty())
+    {
+    const double nBoundsVoxels =
+      static_cast< double >(bounds[1] - bounds[0] + 1) *
+      (bounds[3] - bounds[2] + 1) * (bounds[5] - bounds[4] + 1);
+    const double nOutputVoxels =
+      static_cast< double >(outExt[1] - outExt[0] + 1) *
+      (outExt[3] - outExt[2] + 1) * (outExt[5] - outExt[4] + 1);
+    if (nBoundsVoxels > 0.5 * nOutputVoxels)
+      {
+      // Much of the output changed, blending it all with threads is faster.
+      return 0;
+      }
+    if (nVoxels >= nBoundsVoxels)
+      {
+      extents.assign(bounds, bounds + 6);
+      }
 
-        if (r1 <= r2 )  // sanity check
-          {
-          T *beginInPtr  =
-            static_cast<T *>(inData->GetScalarPointer(r1, idxY, idxZ));
-          T *beginOutPtr =
-            static_cast<T *>(outData->GetScalarPointer(r1, idxY, idxZ));
-          T *endOutPtr   =
-            static_cast<T *>(outData->GetScalarPointer(r2, idxY, idxZ));
+    vtkImageData *inData0[1] = { input };
+    vtkImageData **inData[1] = { inData0 };
+    vtkImageData *outData[1] = { blended };
+    for (size_t i = 0; i < extents.size(); i += 6)
+      {
+      this->ThreadedRequestData( request, inputVector, outputVector,
+                                 inData, outData, &extents[i], 0 );
+      }
+    scalars->Modified();
+    }
 
-          while (beginOutPtr <= endOutPtr)
-            {
+  output->SetExtent(outExt);
+  output->GetPointData()->SetScalars(scalars);
+  return 1;
+}
 
-            if (outC >= 3 && inC >= 4)
-              {
-              // RGB(A) blended with RGBA
+//----------------------------------------------------------------------------
+// Span kernels used to blend a run of voxels of a stencil into an overlay
+// of type CHAR. There is one kernel per component layout of the overlay, so
+// the layout is resolved once per blend rather than once per voxel:
+//   vtkKWEPaintbrushBlendSpanRGBA - RGB(A) blended with RGBA
+//   vtkKWEPaintbrushBlendSpanRGB  - RGB(A) blended with RGB
+//   vtkKWEPaintbrushBlendSpanLA   - luminance(+alpha) blended with luminance+alpha
+//   vtkKWEPaintbrushBlendSpanL    - luminance(+alpha) blended with luminance
+// Each kernel blends "n" consecutive voxels starting at inPtr/outPtr. The
+// opacity "o" is in the range [0,256]. BlendsOutput tells whether the kernel
+// blends into the output, or replaces it with a blend of the input.
+
+// do some math tricks to achieve division by 65280:
+// this is not an approximation, it gives exactly the
+// same result as an integer division by 65280
+#define vtkKWEPaintbrushBlendDivideBy65280(v) \
+  (((v) + ((v) >> 8) + ((v) >> 16) + 1) >> 16)
 
-              // multiply to get a number in the range [0,65280]
-              // where 65280 = 255*256 = range of beginInPtr[3] * range of o
-              r = static_cast<unsigned short>(beginInPtr[3]*o);
-              f = static_cast<unsigned short>(65280 - r);
-
-              v0 = beginInPtr[0]*f + color[0]*r;
-              v1 = beginInPtr[1]*f + color[1]*r;
-              v2 = beginInPtr[2]*f + color[2]*r;
-
-
-              // do some math tricks to achieve division by 65280:
-              // this is not an approximation, it gives exactly the
-              // same result as an integer division by 65280
-              beginOutPtr[0] =
-                static_cast<T>((v0 + (v0 >> 8) + (v0 >> 16) + 1) >> 16);
-              beginOutPtr[1] =
-                static_cast<T>((v1 + (v1 >> 8) + (v1 >> 16) + 1) >> 16);
-              beginOutPtr[2] =
-                static_cast<T>((v2 + (v2 >> 8) + (v2 >> 16) + 1) >> 16);
-              }
+template <class T>
+class vtkKWEPaintbrushBlendSpanRGBA
+{
+public:
+  enum { BlendsOutput = 0 };
 
-            else if (outC >= 3 && inC == 3)
-              {
-              // RGB(A) blended with RGB
+  static inline void Blend( const T *inPtr, T *outPtr, int n,
+                            int inC, int outC, unsigned short o,
+                            const unsigned char color[3] )
+    {
+    for (; n > 0; --n, inPtr += inC, outPtr += outC)
+      {
+      // multiply to get a number in the range [0,65280]
+      // where 65280 = 255*256 = range of inPtr[3] * range of o
+      const unsigned short r = static_cast<unsigned short>(inPtr[3]*o);
+      const unsigned short f = static_cast<unsigned short>(65280 - r);
+      const int v0 = inPtr[0]*f + color[0]*r;
+      const int v1 = inPtr[1]*f + color[1]*r;
+      const int v2 = inPtr[2]*f + color[2]*r;
+      outPtr[0] = static_cast<T>(vtkKWEPaintbrushBlendDivideBy65280(v0));
+      outPtr[1] = static_cast<T>(vtkKWEPaintbrushBlendDivideBy65280(v1));
+      outPtr[2] = static_cast<T>(vtkKWEPaintbrushBlendDivideBy65280(v2));
+      }
+    }
+};
 
-              // the bit-shift achieves a division by 256
-              beginOutPtr[0] =
-                static_cast<T>((beginInPtr[0]*f + color[0]*r) >> 8);
-              beginOutPtr[1] =
-                static_cast<T>((beginInPtr[1]*f + color[1]*r) >> 8);
-              beginOutPtr[2] =
-                static_cast<T>((beginInPtr[2]*f + color[2]*r) >> 8);
-              }
+template <class T>
+class vtkKWEPaintbrushBlendSpanRGB
+{
+public:
+  enum { BlendsOutput = 0 };
 
-            else if (inC == 2)
-              {
-              // luminance(+alpha) blended with luminance+alpha
+  static inline void Blend( const T *inPtr, T *outPtr, int n,
+                            int inC, int outC, unsigned short o,
+                            const unsigned char color[3] )
+    {
+    const unsigned short r = o;
+    const unsigned short f = static_cast<unsigned short>(256 - o);
+    for (; n > 0; --n, inPtr += inC, outPtr += outC)
+      {
+      // the bit-shift achieves a division by 256
+      outPtr[0] = static_cast<T>((inPtr[0]*f + color[0]*r) >> 8);
+      outPtr[1] = static_cast<T>((inPtr[1]*f + color[1]*r) >> 8);
+      outPtr[2] = static_cast<T>((inPtr[2]*f + color[2]*r) >> 8);
+      }
+    }
+};
 
-              // multiply to get a number in the range [0,65280]
-              // where 65280 = 255*256 = range of beginInPtr[1] * range of o
-              r = static_cast<unsigned short>(beginInPtr[1]*o);
-              f = static_cast<unsigned short>(65280 - r);
-              v0 = beginOutPtr[0]*f + beginInPtr[0]*r;
-              // do some math tricks to achieve division by 65280:
-              // this is not an approximation, it gives exactly the
-              // same result as an integer division by 65280
-              beginOutPtr[0] =
-                static_cast<T>((v0 + (v0 >> 8) + (v0 >> 16) + 1) >> 16);
-              }
+template <class T>
+class vtkKWEPaintbrushBlendSpanLA
+{
+public:
+  enum { BlendsOutput = 1 };
 
-            else
-              {
-              // luminance(+alpha) blended with luminance
+  static inline void Blend( const T *inPtr, T *outPtr, int n,
+                            int inC, int outC, unsigned short o,
+                            const unsigned char * )
+    {
+    for (; n > 0; --n, inPtr += inC, outPtr += outC)
+      {
+      // multiply to get a number in the range [0,65280]
+      // where 65280 = 255*256 = range of inPtr[1] * range of o
+      const unsigned short r = static_cast<unsigned short>(inPtr[1]*o);
+      const unsigned short f = static_cast<unsigned short>(65280 - r);
+      const int v0 = outPtr[0]*f + inPtr[0]*r;
+      outPtr[0] = static_cast<T>(vtkKWEPaintbrushBlendDivideBy65280(v0));
+      }
+    }
+};
 
-              // the bit-shift achieves a division by 256
-              beginOutPtr[0] = static_cast<T>((beginInPtr[0]*f) >> 8);
-              }
+template <class T>
+class vtkKWEPaintbrushBlendSpanL
+{
+public:
+  enum { BlendsOutput = 0 };
 
-            beginInPtr += inC;
-            beginOutPtr += outC;
-            }
-          }
-        }
+  static inline void Blend( const T *inPtr, T *outPtr, int n,
+                            int inC, int outC, unsigned short o,
+                            const unsigned char * )
+    {
+    const unsigned short f = static_cast<unsigned short>(256 - o);
+    for (; n > 0; --n, inPtr += inC, outPtr += outC)
+      {
+      // the bit-shift achieves a division by 256
+      outPtr[0] = static_cast<T>((inPtr[0]*f) >> 8);
       }
     }
-}
+};
 
+#if defined(__SSE2__)
 //----------------------------------------------------------------------------
-// This templated function blends an image that represents a label map into
-// the overlay image. This function is specific to the case when the overlay
-// image has data type of CHAR
-template <class T>
-void vtkKWEPaintbrushBlendExecuteChar(
-     vtkKWEPaintbrushLabelData *labelMap,
-     vtkKWEPaintbrushBlend *self,
-     int extent[6],
-     vtkImageData *inData, T *,
-     vtkImageData *outData, T *,
-     vtkKWEPaintbrushPropertyManager::LabelToColorMapType &labelToColorMap)
+// SSE2 versions of the RGB and RGBA kernels for unsigned char overlays whose
+// voxels are tightly packed (the input and output have the same number of
+// components). They produce exactly the same values as the scalar kernels.
+// Other layouts fall back to the scalar loops above.
+
+// Unsigned 32 bit division by 65280 of four lanes, see
+// vtkKWEPaintbrushBlendDivideBy65280
+static inline __m128i vtkKWEPaintbrushBlendDivideBy65280SSE2( __m128i v )
 {
-  // Is an overlay present ? If absent, the label map, passed through the
-  // color lookup table is displayed as is. If not, it is blended with
-  // the overlay and displayed.
-  bool useOverlay = self->GetUseOverlay() ? true : false;
+  v = _mm_add_epi32( _mm_add_epi32( v, _mm_srli_epi32(v, 8) ),
+                     _mm_add_epi32( _mm_srli_epi32(v, 16), _mm_set1_epi32(1) ) );
+  return _mm_srli_epi32(v, 16);
+}
 
-  int inC, outC;
-  unsigned short r = 0, f = 0, o = 0;
-  int v0, v1, v2;
-  int labelMapExtent[6];
+// Blend two RGBA pixels, unpacked to 16 bits per component.
+static inline __m128i vtkKWEPaintbrushBlendTwoPixelsRGBASSE2(
+  __m128i px, __m128i o, __m128i color )
+{
+  // Broadcast the alpha of each pixel over its four components
+  const __m128i a = _mm_shufflehi_epi16( _mm_shufflelo_epi16(px, 0xFF), 0xFF );
+
+  // r = a*o is in the range [0,65280], so it fits in an unsigned short.
+  const __m128i r = _mm_mullo_epi16(a, o);
+  const __m128i f = _mm_sub_epi16(
+                 _mm_set1_epi16(static_cast<short>(0xFF00)), r );
+
+  // 16x16 -> 32 bit products for in*f + color*r
+  const __m128i pl = _mm_mullo_epi16(px, f);
+  const __m128i ph = _mm_mulhi_epu16(px, f);
+  const __m128i ql = _mm_mullo_epi16(color, r);
+  const __m128i qh = _mm_mulhi_epu16(color, r);
+  const __m128i v0 = _mm_add_epi32( _mm_unpacklo_epi16(pl, ph),
+                                    _mm_unpacklo_epi16(ql, qh) );
+  const __m128i v1 = _mm_add_epi32( _mm_unpackhi_epi16(pl, ph),
+                                    _mm_unpackhi_epi16(ql, qh) );
+  return _mm_packs_epi32( vtkKWEPaintbrushBlendDivideBy65280SSE2(v0),
+                          vtkKWEPaintbrushBlendDivideBy65280SSE2(v1) );
+}
 
+template <>
+class vtkKWEPaintbrushBlendSpanRGBA< unsigned char >
+{
+public:
+  enum { BlendsOutput = 0 };
 
-  inC = inData->GetNumberOfScalarComponents();
-  outC = outData->GetNumberOfScalarComponents();
+  static inline void Blend( const unsigned char *inPtr, unsigned char *outPtr,
+                            int n, int inC, int outC, unsigned short o,
+                            const unsigned char color[3] )
+    {
+    if (inC == 4 && outC == 4)
+      {
+      const __m128i ov = _mm_set1_epi16(static_cast<short>(o));
+      const __m128i color16 = _mm_set_epi16(
+        0, color[2], color[1], color[0], 0, color[2], color[1], color[0] );
+      const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+      const __m128i zero = _mm_setzero_si128();
+
+      // 4 pixels at a time. The alpha of the output is left untouched, as
+      // done by the scalar kernel.
+      for (; n >= 4; n -= 4, inPtr += 16, outPtr += 16)
+        {
+        const __m128i px = _mm_loadu_si128(
+                    reinterpret_cast< const __m128i * >(inPtr));
+        const __m128i blended = _mm_packus_epi16(
+          vtkKWEPaintbrushBlendTwoPixelsRGBASSE2(
+            _mm_unpacklo_epi8(px, zero), ov, color16),
+          vtkKWEPaintbrushBlendTwoPixelsRGBASSE2(
+            _mm_unpackhi_epi8(px, zero), ov, color16) );
+        const __m128i old = _mm_loadu_si128(
+                    reinterpret_cast< const __m128i * >(outPtr));
+        _mm_storeu_si128( reinterpret_cast< __m128i * >(outPtr),
+                          _mm_or_si128( _mm_andnot_si128(alphaMask, blended),
+                                        _mm_and_si128(alphaMask, old) ) );
+        }
+      }
 
-  // Check the label map's extents
-  labelMap->GetExtent(labelMapExtent);
+    // Remaining pixels
+    for (; n > 0; --n, inPtr += inC, outPtr += outC)
+      {
+      const unsigned short r = static_cast<unsigned short>(inPtr[3]*o);
+      const unsigned short f = static_cast<unsigned short>(65280 - r);
+      const int v0 = inPtr[0]*f + color[0]*r;
+      const int v1 = inPtr[1]*f + color[1]*r;
+      const int v2 = inPtr[2]*f + color[2]*r;
+      outPtr[0] = static_cast<unsigned char>(vtkKWEPaintbrushBlendDivideBy65280(v0));
+      outPtr[1] = static_cast<unsigned char>(vtkKWEPaintbrushBlendDivideBy65280(v1));
+      outPtr[2] = static_cast<unsigned char>(vtkKWEPaintbrushBlendDivideBy65280(v2));
+      }
+    }
+};
 
-  // Find the intersection of the labelmap's extents and the overlaid image's
-  // extents. This is the region we need to be blending.
-  labelMapExtent[0] = (labelMapExtent[0] < extent[0]) ? extent[0] : labelMapExtent[0];
-  labelMapExtent[1] = (labelMapExtent[1] > extent[1]) ? extent[1] : labelMapExtent[1];
-  labelMapExtent[2] = (labelMapExtent[2] < extent[2]) ? extent[2] : labelMapExtent[2];
-  labelMapExtent[3] = (labelMapExtent[3] > extent[3]) ? extent[3] : labelMapExtent[3];
-  labelMapExtent[4] = (labelMapExtent[4] < extent[4]) ? extent[4] : labelMapExtent[4];
-  labelMapExtent[5] = (labelMapExtent[5] > extent[5]) ? extent[5] : labelMapExtent[5];
+template <>
+class vtkKWEPaintbrushBlendSpanRGB< unsigned char >
+{
+public:
+  enum { BlendsOutput = 0 };
 
-  vtkImageData *labelMapData = labelMap->GetLabelMap();
+  static inline void Blend( const unsigned char *inPtr, unsigned char *outPtr,
+                            int n, int inC, int outC, unsigned short o,
+                            const unsigned char color[3] )
+    {
+    const unsigned short r = o;
+    const unsigned short f = static_cast<unsigned short>(256 - o);
 
-  // Lookup table of label to color map.
-  unsigned char color[3];
+    if (inC == 3 && outC == 3)
+      {
+      // Packed RGB: every byte is blended the same way, only the color
+      // changes. The color pattern repeats every 48 bytes (3 registers).
+      // in*f + color*r <= 255*256, so 16 bit lanes suffice.
+      unsigned short pattern[48];
+      for (int i = 0; i < 48; ++i)
+        {
+        pattern[i] = static_cast<unsigned short>(color[i%3]*r);
+        }
+      __m128i colorR[6];
+      for (int i = 0; i < 6; ++i)
+        {
+        colorR[i] = _mm_loadu_si128(
+                reinterpret_cast< const __m128i * >(pattern + 8*i));
+        }
+      const __m128i fv = _mm_set1_epi16(static_cast<short>(f));
+      const __m128i zero = _mm_setzero_si128();
 
-  // To avoid gcc 4.4 warning "color[x] may be used uninitialized in this
-  // function [-Wuninitialized]"
-  color[0]=0;
-  color[1]=0;
-  color[2]=0;
+      // 16 pixels at a time.
+      for (; n >= 16; n -= 16, inPtr += 48, outPtr += 48)
+        {
+        for (int j = 0; j < 3; ++j)
+          {
+          const __m128i v = _mm_loadu_si128(
+                  reinterpret_cast< const __m128i * >(inPtr + 16*j));
+          __m128i lo = _mm_unpacklo_epi8(v, zero);
+          __m128i hi = _mm_unpackhi_epi8(v, zero);
+          lo = _mm_srli_epi16( _mm_add_epi16(
+                  _mm_mullo_epi16(lo, fv), colorR[2*j]), 8 );
+          hi = _mm_srli_epi16( _mm_add_epi16(
+                  _mm_mullo_epi16(hi, fv), colorR[2*j+1]), 8 );
+          _mm_storeu_si128( reinterpret_cast< __m128i * >(outPtr + 16*j),
+                            _mm_packus_epi16(lo, hi) );
+          }
+        }
+      }
 
-  vtkKWEPaintbrushPropertyManager::vtkKWEPaintbrushLabelMapColor colorClass;
+    // Remaining pixels
+    for (; n > 0; --n, inPtr += inC, outPtr += outC)
+      {
+      outPtr[0] = static_cast<unsigned char>((inPtr[0]*f + color[0]*r) >> 8);
+      outPtr[1] = static_cast<unsigned char>((inPtr[1]*f + color[1]*r) >> 8);
+      outPtr[2] = static_cast<unsigned char>((inPtr[2]*f + color[2]*r) >> 8);
+      }
+    }
+};
+#endif
 
-  // Loop through pixels
-  T *beginInPtr = NULL, *beginOutPtr;
-  vtkKWEPaintbrushEnums::LabelType * labelPtr;
+//----------------------------------------------------------------------------
+// Color and opacity of a sketch, in the fixed point form used by the span
+// kernels.
+struct vtkKWEPaintbrushBlendSketchColor
+{
+  unsigned short Opacity;  // in the range [0,256]
+  unsigned char  Color[3];
+};
 
-  // Type of compositing..
-  int compositeType = 3; // luminance(+alpha) blended with luminance
-  if (outC >= 3 && inC >= 4)
-    {
-    // RGB(A) blended with RGBA
-    compositeType = 0;
-    }
-  else if (outC >= 3 && inC == 3)
+// Start or end of a run of a sketch along a row. Runs end before the ones
+// starting at the same voxel start.
+struct vtkKWEPaintbrushBlendRunEvent
+{
+  int X;      // first voxel of the run, or the one past its last voxel
+  int Start;  // 1 for the start of a run, 0 for its end
+  int Sketch;
+  bool operator<( const vtkKWEPaintbrushBlendRunEvent &e ) const
     {
-    // RGB(A) blended with RGB
-    compositeType = 1;
+    return (this->X < e.X) || (this->X == e.X && this->Start < e.Start);
     }
-  else if (inC == 2)
+};
+
+//----------------------------------------------------------------------------
+// Blend the sketches into the overlay in a single pass, using the span
+// kernel TKernel. The runs of all the sketches along a row are merged, so
+// that each span of voxels covered by the same sketches is blended at once,
+// with the sketches in order. Kernels that replace the output with a blend
+// of the input only need the last of them. Row pointers are computed from
+// the increments of the images, rather than queried for every run.
+template <class T, class TKernel>
+void vtkKWEPaintbrushBlendSketchRuns(
+  const vtkstd::vector< vtkImageStencilData * > &stencils,
+  const vtkstd::vector< vtkKWEPaintbrushBlendSketchColor > &colors,
+  int extent[6], vtkImageData *inData, vtkImageData *outData )
+{
+  const int inC = inData->GetNumberOfScalarComponents();
+  const int outC = outData->GetNumberOfScalarComponents();
+
+  vtkIdType inInc[3], outInc[3];
+  inData->GetIncrements(inInc);
+  outData->GetIncrements(outInc);
+  int *inExt  = inData->GetExtent();
+  int *outExt = outData->GetExtent();
+  T *inBase  = static_cast<T *>(inData->GetScalarPointer());
+  T *outBase = static_cast<T *>(outData->GetScalarPointer());
+
+  // The extent of each stencil, within the extent blended.
+  const int nSketches = static_cast< int >(stencils.size());
+  vtkstd::vector< int > stencilExtents(6*nSketches);
+  for (int n = 0; n < nSketches; n++)
     {
-    // luminance(+alpha) blended with luminance+alpha
-    compositeType = 2;
+    int *e = &stencilExtents[6*n];
+    stencils[n]->GetExtent(e);
+    for (int i = 0; i < 6; i += 2)
+      {
+      e[i]   = (e[i]   < extent[i])   ? extent[i]   : e[i];
+      e[i+1] = (e[i+1] > extent[i+1]) ? extent[i+1] : e[i+1];
+      }
     }
 
-
-  vtkKWEPaintbrushEnums::LabelType lastLabel =
-                                 vtkKWEPaintbrushLabelData::NoLabelValue;
-  // Loop through ouput pixels
-  for (int idxZ = labelMapExtent[4]; idxZ <= labelMapExtent[5]; idxZ++)
+  vtkstd::vector< vtkKWEPaintbrushBlendRunEvent > events;
+  vtkstd::vector< int > active;
+  for (int idxZ = extent[4]; idxZ <= extent[5]; idxZ++)
     {
-    for (int idxY = labelMapExtent[2]; idxY <= labelMapExtent[3]; idxY++)
+    for (int idxY = extent[2]; idxY <= extent[3]; idxY++)
       {
-
-      if (useOverlay)
+      // The runs of all the sketches along this row.
+      events.clear();
+      for (int n = 0; n < nSketches; n++)
         {
-        beginInPtr  = static_cast<T *>(inData->GetScalarPointer(labelMapExtent[0], idxY, idxZ));
-        }
-      beginOutPtr = static_cast<T *>(outData->GetScalarPointer(labelMapExtent[0], idxY, idxZ));
-      labelPtr = static_cast<vtkKWEPaintbrushEnums::LabelType *>(
-          labelMapData->GetScalarPointer(labelMapExtent[0], idxY, idxZ));
-
-      for (int idxX = labelMapExtent[0]; idxX <= labelMapExtent[1]; idxX++)
-        {
-
-        const vtkKWEPaintbrushEnums::LabelType label = *labelPtr;
-
-        if (useOverlay)
+        const int *e = &stencilExtents[6*n];
+        if (idxY < e[2] || idxY > e[3] || idxZ < e[4] || idxZ > e[5])
           {
-          if (label != vtkKWEPaintbrushLabelData::NoLabelValue)
-            {
-            if( label != lastLabel )
-              {
-              colorClass = labelToColorMap[label];
-              lastLabel = label;
-              color[0] = colorClass.Color[0];
-              color[1] = colorClass.Color[1];
-              color[2] = colorClass.Color[2];
-
-              // round opacity to a value in the range [0,256], because division
-              // by 256 can be efficiently achieved by bit-shifting by 8 bits
-              o = static_cast<unsigned short>(256*colorClass.Opacity + 0.5);
-              r = o;
-              f = static_cast<unsigned short>(256 - o);
-              }
-
-            if (compositeType == 0)
-              {
-              // RGB(A) blended with RGBA
-
-              // multiply to get a number in the range [0,65280]
-              // where 65280 = 255*256 = range of inSI[3] * range of o
-              r = static_cast<unsigned short>(beginInPtr[3]*o);
-              f = static_cast<unsigned short>(65280 - r);
-              v0 = beginInPtr[0]*f + color[0]*r;
-              v1 = beginInPtr[1]*f + color[1]*r;
-              v2 = beginInPtr[2]*f + color[2]*r;
-
-              // do some math tricks to achieve division by 65280:
-              // this is not an approximation, it gives exactly the
-              // same result as an integer division by 65280
-              beginOutPtr[0] =
-                static_cast<T>((v0 + (v0 >> 8) + (v0 >> 16) + 1) >> 16);
-              beginOutPtr[1] =
-                static_cast<T>((v1 + (v1 >> 8) + (v1 >> 16) + 1) >> 16);
-              beginOutPtr[2] =
-                static_cast<T>((v2 + (v2 >> 8) + (v2 >> 16) + 1) >> 16);
-              }
-
-            else if (compositeType == 1)
-              {
-              // the bit-shift achieves a division by 256
-              beginOutPtr[0] =
-                static_cast<T>((beginInPtr[0]*f + color[0]*r) >> 8);
-              beginOutPtr[1] =
-                static_cast<T>((beginInPtr[1]*f + color[1]*r) >> 8);
-              beginOutPtr[2] =
-                static_cast<T>((beginInPtr[2]*f + color[2]*r) >> 8);
-              }
-
-            else if (compositeType == 2)
-              {
-              // luminance(+alpha) blended with luminance+alpha
-
-              // multiply to get a number in the range [0,65280]
-              // where 65280 = 255*256 = range of beginInPtr[1] * range of o
-              r = static_cast<unsigned short>(beginInPtr[1]*o);
-              f = static_cast<unsigned short>(65280 - r);
-              v0 = beginOutPtr[0]*f + beginInPtr[0]*r;
-
-              // do some math tricks to achieve division by 65280:
-              // this is not an approximation, it gives exactly the
-              // same result as an integer division by 65280
-              beginOutPtr[0] =
-                static_cast<T>((v0 + (v0 >> 8) + (v0 >> 16) + 1) >> 16);
-              }
+          continue;
+          }
 
-            else
-              {
-              // luminance(+alpha) blended with luminance
+        int iter = 0, moreSubExtents = 1, r1, r2;
+        while (moreSubExtents)
+          {
+          moreSubExtents = stencils[n]->GetNextExtent( r1, r2,
+              e[0], e[1], idxY, idxZ, iter );
 
-              // the bit-shift achieves a division by 256
-              beginOutPtr[0] = static_cast<T>((beginInPtr[0]*f) >> 8);
-              }
-            }
+          r1 = (r1 < e[0]) ? e[0] : r1;
+          r2 = (r2 > e[1]) ? e[1] : r2;
 
-          beginInPtr += inC;
-          beginOutPtr += outC;
-          ++labelPtr;
-          }
-        else // No overlays.
-          {
-          if( label != lastLabel )
+          if (r1 <= r2 )  // sanity check
             {
-            colorClass = labelToColorMap[label];
-            lastLabel = label;
+            vtkKWEPaintbrushBlendRunEvent event;
+            event.Sketch = n;
+            event.X = r1;
+            event.Start = 1;
+            events.push_back(event);
+            event.X = r2 + 1;
+            event.Start = 0;
+            events.push_back(event);
             }
+          }
+        }
 
-          if (compositeType == 0)
-            {
-            beginOutPtr[0] = colorClass.Color[0];
-            beginOutPtr[1] = colorClass.Color[1];
-            beginOutPtr[2] = colorClass.Color[2];
-            if (outC > 3)
-              {
-              beginOutPtr[3] = 255;
-              }
-            }
-          else if (compositeType == 1)
-            {
-            beginOutPtr[0] = colorClass.Color[0];
-            beginOutPtr[1] = colorClass.Color[1];
-            beginOutPtr[2] = colorClass.Color[2];
-            }
-          else if (compositeType == 2)
+      if (events.empty())
+        {
+        continue;
+        }
+
+      // Pointers to voxel (0,idxY,idxZ), so that voxel r1 is at rowPtr+r1*inc
+      const T *inRow = inBase + (idxY - inExt[2])*inInc[1]
+               + (idxZ - inExt[4])*inInc[2] - inExt[0]*inInc[0];
+      T *outRow = outBase + (idxY - outExt[2])*outInc[1]
+               + (idxZ - outExt[4])*outInc[2] - outExt[0]*outInc[0];
+
+      // Sweep along the row, keeping the sketches covering the current span
+      // sorted.
+      vtkstd::sort(events.begin(), events.end());
+      active.clear();
+      const size_t nEvents = events.size();
+      for (size_t i = 0; i < nEvents; )
+        {
+        const int x = events[i].X;
+        for (; i < nEvents && events[i].X == x; ++i)
+          {
+          vtkstd::vector< int >::iterator it = vtkstd::lower_bound(
+                active.begin(), active.end(), events[i].Sketch);
+          if (events[i].Start)
             {
-            beginOutPtr[0] = colorClass.Color[0];
+            active.insert(it, events[i].Sketch);
             }
           else
             {
-            // luminance(+alpha) blended with luminance
-            // the bit-shift achieves a division by 256
-            beginOutPtr[0] = colorClass.Color[0];
+            active.erase(it);
             }
+          }
+        if (active.empty())
+          {
+          continue;
+          }
 
-          beginOutPtr += outC;
-          ++labelPtr;
+        // The span from x to the next event is covered by the active
+        // sketches.
+        const int n = events[i].X - x;
+        const T *inPtr = inRow + x*inInc[0];
+        T *outPtr = outRow + x*outInc[0];
+        if (TKernel::BlendsOutput)
+          {
+          for (size_t k = 0; k < active.size(); k++)
+            {
+            const vtkKWEPaintbrushBlendSketchColor &c = colors[active[k]];
+            TKernel::Blend( inPtr, outPtr, n, inC, outC, c.Opacity, c.Color );
+            }
+          }
+        else
+          {
+          const vtkKWEPaintbrushBlendSketchColor &c = colors[active.back()];
+          TKernel::Blend( inPtr, outPtr, n, inC, outC, c.Opacity, c.Color );
           }
         }
       }
     }
-
 }
 
 //----------------------------------------------------------------------------
-// This templated function blends an image that represents a label map into
-// the overlay image. This function is specific to the case when the overlay
-// (canvas) image as well as the label map have data type of CHAR
+// This templated function blends the stencils that represent the sketches of
+// a drawing into the overlaid image. This method is specific to the case
+// when the overlaid image has data type of CHAR
 template <class T>
-void vtkKWEPaintbrushBlendExecuteCharLabelMapTypeUC(
-                        vtkKWEPaintbrushLabelData * labelMap,
-                        vtkKWEPaintbrushBlend *self,
-                        int extent[6],
-                        vtkImageData *inData, T *,
-                        vtkImageData *outData, T *,
-                        VTKColorType *labelToColorMapUC,
-                        double       *labelToOpacityMapUC)
+void vtkKWEPaintbrushBlendExecuteChar(
+  const vtkstd::vector< vtkImageStencilData * > &stencils,
+  const vtkstd::vector< vtkKWEPaintbrushBlendSketchColor > &colors,
+  vtkKWEPaintbrushBlend *vtkNotUsed(self),
+  int extent[6],
+  vtkImageData *inData, T *,
+  vtkImageData *outData, T * )
 {
-  // Is an overlay present ? If absent, the label map, passed through the
-  // color lookup table is displayed as is. If not, it is blended with
-  // the overlay and displayed.
-  bool useOverlay = self->GetUseOverlay() ? true : false;
-
-  int inC, outC;
-  unsigned short r, f, o;
-  int v0, v1, v2;
-  int labelMapExtent[6];
-  double opacity = 1.0;
-
-
-  inC = inData->GetNumberOfScalarComponents();
-  outC = outData->GetNumberOfScalarComponents();
+  const int inC = inData->GetNumberOfScalarComponents();
+  const int outC = outData->GetNumberOfScalarComponents();
 
-  // Check the label map's extents
-  labelMap->GetExtent(labelMapExtent);
-
-  // Find the intersection of the labelmap's extents and the overlaid image's
-  // extents. This is the region we need to be blending.
-  labelMapExtent[0] = (labelMapExtent[0] < extent[0]) ? extent[0] : labelMapExtent[0];
-  labelMapExtent[1] = (labelMapExtent[1] > extent[1]) ? extent[1] : labelMapExtent[1];
-  labelMapExtent[2] = (labelMapExtent[2] < extent[2]) ? extent[2] : labelMapExtent[2];
-  labelMapExtent[3] = (labelMapExtent[3] > extent[3]) ? extent[3] : labelMapExtent[3];
-  labelMapExtent[4] = (labelMapExtent[4] < extent[4]) ? extent[4] : labelMapExtent[4];
-  labelMapExtent[5] = (labelMapExtent[5] > extent[5]) ? extent[5] : labelMapExtent[5];
-
-  vtkImageData *labelMapData = labelMap->GetLabelMap();
-
-  vtkImageIterator< T > inIt( inData, labelMapExtent );
-  vtkImageIterator< T > outIt( outData, labelMapExtent );
-  vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > labelMapIt(
-                                 labelMapData, labelMapExtent );
-
-  unsigned char *color;
-
-  int compositeType = 3;
+  // Pick the kernel for this component layout once, for the whole extent.
   if (outC >= 3 && inC >= 4)
     {
-    compositeType = 0;
+    vtkKWEPaintbrushBlendSketchRuns< T, vtkKWEPaintbrushBlendSpanRGBA< T > >(
+        stencils, colors, extent, inData, outData );
     }
   else if (outC >= 3 && inC == 3)
     {
-    compositeType = 1;
+    vtkKWEPaintbrushBlendSketchRuns< T, vtkKWEPaintbrushBlendSpanRGB< T > >(
+        stencils, colors, extent, inData, outData );
     }
   else if (inC == 2)
     {
-    compositeType = 2;
+    vtkKWEPaintbrushBlendSketchRuns< T, vtkKWEPaintbrushBlendSpanLA< T > >(
+        stencils, colors, extent, inData, outData );
     }
+  else
+    {
+    vtkKWEPaintbrushBlendSketchRuns< T, vtkKWEPaintbrushBlendSpanL< T > >(
+        stencils, colors, extent, inData, outData );
+    }
+}
 
-  T *beginInPtr = 0, *beginOutPtr;
-  vtkKWEPaintbrushEnums::LabelType * labelPtr;
-
-  // Loop through ouput pixels
-  for (int idxZ = labelMapExtent[4]; idxZ <= labelMapExtent[5]; idxZ++)
+//----------------------------------------------------------------------------
+// Walk the runs of voxels of the same label along the rows of the label map
+// within "extent", and blend each run into the overlay using the span kernel
+// TKernel, with the color of the label from the dense lookup table of the
+// property manager.
+template <class T, class TKernel>
+void vtkKWEPaintbrushBlendLabelRuns(
+  vtkKWEPaintbrushLabelData *labelMap,
+  const vtkKWEPaintbrushPropertyManager *propertyManager,
+  int extent[6], vtkImageData *inData, vtkImageData *outData )
+{
+  typedef vtkKWEPaintbrushPropertyManager::vtkKWEPaintbrushLabelColor
+                                                          LabelColorType;
+  const int inC = inData->GetNumberOfScalarComponents();
+  const int outC = outData->GetNumberOfScalarComponents();
+
+  vtkIdType inInc[3], outInc[3];
+  inData->GetIncrements(inInc);
+  outData->GetIncrements(outInc);
+  int *inExt  = inData->GetExtent();
+  int *outExt = outData->GetExtent();
+  T *inBase  = static_cast<T *>(inData->GetScalarPointer());
+  T *outBase = static_cast<T *>(outData->GetScalarPointer());
+
+  // Rows of labels are read from the label data, which may store them
+  // sparsely, into this buffer if need be.
+  const int nX = extent[1] - extent[0] + 1;
+  vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > labelRow(nX);
+
+  for (int idxZ = extent[4]; idxZ <= extent[5]; idxZ++)
     {
-    for (int idxY = labelMapExtent[2]; idxY <= labelMapExtent[3]; idxY++)
+    for (int idxY = extent[2]; idxY <= extent[3]; idxY++)
       {
-      if (useOverlay)
+      const T *inPtr = inBase + (idxY - inExt[2])*inInc[1]
+               + (idxZ - inExt[4])*inInc[2] + (extent[0] - inExt[0])*inInc[0];
+      T *outPtr = outBase + (idxY - outExt[2])*outInc[1]
+               + (idxZ - outExt[4])*outInc[2] + (extent[0] - outExt[0])*outInc[0];
+      const vtkKWEPaintbrushEnums::LabelType *labels =
+        labelMap->GetLabelRow( extent[0], extent[1], idxY, idxZ, &labelRow[0] );
+
+      int x = 0;
+      while (x < nX)
         {
-        beginInPtr  = static_cast<T *>(inData->GetScalarPointer(labelMapExtent[0], idxY, idxZ));
+        const vtkKWEPaintbrushEnums::LabelType label = labels[x];
+        int end = x + 1;
+        while (end < nX && labels[end] == label)
+          {
+          ++end;
+          }
+        if (label != vtkKWEPaintbrushLabelData::NoLabelValue)
+          {
+          const LabelColorType &c = propertyManager->GetLabelColor(label);
+          TKernel::Blend( inPtr + x*inInc[0], outPtr + x*outInc[0], end - x,
+                          inC, outC, c.Opacity, c.Color );
+          }
+        x = end;
         }
-      beginOutPtr = static_cast<T *>(outData->GetScalarPointer(labelMapExtent[0], idxY, idxZ));
-      labelPtr = static_cast<vtkKWEPaintbrushEnums::LabelType *>(
-          labelMapData->GetScalarPointer(labelMapExtent[0], idxY, idxZ));
-
-      for (int idxX = labelMapExtent[0]; idxX <= labelMapExtent[1]; idxX++)
-        {
+      }
+    }
+}
 
-        const vtkKWEPaintbrushEnums::LabelType label = *labelPtr;
+//----------------------------------------------------------------------------
+// Without overlay, the label map is passed through the lookup table of the
+// property manager.
+template <class T>
+void vtkKWEPaintbrushBlendLabelColors(
+  vtkKWEPaintbrushLabelData *labelMap,
+  const vtkKWEPaintbrushPropertyManager *propertyManager,
+  int extent[6], vtkImageData *inData, vtkImageData *outData )
+{
+  typedef vtkKWEPaintbrushPropertyManager::vtkKWEPaintbrushLabelColor
+                                                          LabelColorType;
+  const int inC = inData->GetNumberOfScalarComponents();
+  const int outC = outData->GetNumberOfScalarComponents();
+  const int nColors = (outC >= 3 && inC >= 3) ? 3 : 1;
+  const bool setAlpha = (outC > 3 && inC >= 4);
+
+  vtkIdType outInc[3];
+  outData->GetIncrements(outInc);
+  int *outExt = outData->GetExtent();
+  T *outBase = static_cast<T *>(outData->GetScalarPointer());
+
+  const int nX = extent[1] - extent[0] + 1;
+  vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > labelRow(nX);
+
+  for (int idxZ = extent[4]; idxZ <= extent[5]; idxZ++)
+    {
+    for (int idxY = extent[2]; idxY <= extent[3]; idxY++)
+      {
+      T *outPtr = outBase + (idxY - outExt[2])*outInc[1]
+               + (idxZ - outExt[4])*outInc[2] + (extent[0] - outExt[0])*outInc[0];
+      const vtkKWEPaintbrushEnums::LabelType *labels =
+        labelMap->GetLabelRow( extent[0], extent[1], idxY, idxZ, &labelRow[0] );
 
-        if (useOverlay)
+      for (int x = 0; x < nX; x++, outPtr += outC)
+        {
+        const LabelColorType &c = propertyManager->GetLabelColor(labels[x]);
+        for (int i = 0; i < nColors; i++)
           {
-
-          if (label != vtkKWEPaintbrushLabelData::NoLabelValue)
-            {
-            // Get the color for this label in the label map.
-            color = labelToColorMapUC[label];
-            opacity = labelToOpacityMapUC[label];
-
-            // round opacity to a value in the range [0,256], because division
-            // by 256 can be efficiently achieved by bit-shifting by 8 bits
-            o = static_cast<unsigned short>(256*opacity + 0.5);
-            r = o;
-            f = static_cast<unsigned short>(256 - o);
-
-            if (compositeType == 0)
-              {
-              if (useOverlay)
-                {
-                // RGB(A) blended with RGBA
-
-                // multiply to get a number in the range [0,65280]
-                // where 65280 = 255*256 = range of beginInPtr[3] * range of o
-                r = static_cast<unsigned short>(beginInPtr[3]*o);
-                f = static_cast<unsigned short>(65280 - r);
-
-                v0 = beginInPtr[0]*f + color[0]*r;
-                v1 = beginInPtr[1]*f + color[1]*r;
-                v2 = beginInPtr[2]*f + color[2]*r;
-
-
-                // do some math tricks to achieve division by 65280:
-                // this is not an approximation, it gives exactly the
-                // same result as an integer division by 65280
-                beginOutPtr[0] =
-                  static_cast<T>((v0 + (v0 >> 8) + (v0 >> 16) + 1) >> 16);
-                beginOutPtr[1] =
-                  static_cast<T>((v1 + (v1 >> 8) + (v1 >> 16) + 1) >> 16);
-                beginOutPtr[2] =
-                  static_cast<T>((v2 + (v2 >> 8) + (v2 >> 16) + 1) >> 16);
-                }
-              else
-                {
-                beginOutPtr[0] = color[0];
-                beginOutPtr[1] = color[1];
-                beginOutPtr[2] = color[2];
-                }
-              }
-
-            else if (compositeType == 1)
-              {
-              if (useOverlay)
-                {
-                // RGB(A) blended with RGB
-
-                // the bit-shift achieves a division by 256
-                beginOutPtr[0] =
-                  static_cast<T>((beginInPtr[0]*f + color[0]*r) >> 8);
-                beginOutPtr[1] =
-                  static_cast<T>((beginInPtr[1]*f + color[1]*r) >> 8);
-                beginOutPtr[2] =
-                  static_cast<T>((beginInPtr[2]*f + color[2]*r) >> 8);
-                }
-              else
-                {
-                beginOutPtr[0] = color[0];
-                beginOutPtr[1] = color[1];
-                beginOutPtr[2] = color[2];
-                }
-              }
-
-            else if (compositeType == 2)
-              {
-              // luminance(+alpha) blended with luminance+alpha
-
-              // multiply to get a number in the range [0,65280]
-              // where 65280 = 255*256 = range of beginInPtr[1] * range of o
-              r = static_cast<unsigned short>(beginInPtr[1]*o);
-              f = static_cast<unsigned short>(65280 - r);
-              v0 = beginOutPtr[0]*f + beginInPtr[0]*r;
-              // do some math tricks to achieve division by 65280:
-              // this is not an approximation, it gives exactly the
-              // same result as an integer division by 65280
-              beginOutPtr[0] =
-                static_cast<T>((v0 + (v0 >> 8) + (v0 >> 16) + 1) >> 16);
-              }
-
-            else
-              {
-              // luminance(+alpha) blended with luminance
-
-              // the bit-shift achieves a division by 256
-              beginOutPtr[0] = static_cast<T>((beginInPtr[0]*f) >> 8);
-              }
-            }
-          beginInPtr += inC;
-          beginOutPtr += outC;
-          ++labelPtr;
+          outPtr[i] = c.Color[i];
           }
-
-        else // no overlay
+        if (setAlpha)
           {
-          // Get the color for this label in the label map.
-          color = labelToColorMapUC[label];
-
-          if (compositeType == 0)
-            {
-            beginOutPtr[0] = color[0];
-            beginOutPtr[1] = color[1];
-            beginOutPtr[2] = color[2];
-            if (outC > 3) { beginOutPtr[3] = 255; }
-            }
-
-          else if (compositeType == 1)
-            {
-            beginOutPtr[0] = color[0];
-            beginOutPtr[1] = color[1];
-            beginOutPtr[2] = color[2];
-            }
-
-          else if (compositeType == 2)
-            {
-            beginOutPtr[0] = color[0];
-            }
-
-          else
-            {
-            beginOutPtr[0] = color[0];
-            }
-          beginOutPtr += outC;
-          ++labelPtr;
+          outPtr[3] = 255;
           }
         }
       }
     }
 }
 
+//----------------------------------------------------------------------------
+// This templated function blends an image that represents a label map into
+// the overlay image. This function is specific to the case when the overlay
+// image has data type of CHAR. Whatever the label type, colors are looked up
+// in the dense table of the property manager.
+template <class T>
+void vtkKWEPaintbrushBlendExecuteChar(
+     vtkKWEPaintbrushLabelData *labelMap,
+     vtkKWEPaintbrushBlend *self,
+     int extent[6],
+     vtkImageData *inData, T *,
+     vtkImageData *outData, T *,
+     const vtkKWEPaintbrushPropertyManager *propertyManager )
+{
+  // Find the intersection of the labelmap's extents and the overlaid image's
+  // extents. This is the region we need to be blending.
+  int labelMapExtent[6];
+  labelMap->GetExtent(labelMapExtent);
+  for (int i = 0; i < 6; i += 2)
+    {
+    labelMapExtent[i] = (labelMapExtent[i] < extent[i])
+                              ? extent[i] : labelMapExtent[i];
+    labelMapExtent[i+1] = (labelMapExtent[i+1] > extent[i+1])
+                              ? extent[i+1] : labelMapExtent[i+1];
+    if (labelMapExtent[i] > labelMapExtent[i+1])
+      {
+      return;
+      }
+    }
+
+  // Is an overlay present ? If absent, the label map, passed through the
+  // color lookup table is displayed as is. If not, it is blended with
+  // the overlay and displayed.
+  if (!self->GetUseOverlay())
+    {
+    vtkKWEPaintbrushBlendLabelColors< T >(
+        labelMap, propertyManager, labelMapExtent, inData, outData );
+    return;
+    }
+
+  // Pick the kernel for this component layout once, for the whole extent.
+  const int inC = inData->GetNumberOfScalarComponents();
+  const int outC = outData->GetNumberOfScalarComponents();
+  if (outC >= 3 && inC >= 4)
+    {
+    vtkKWEPaintbrushBlendLabelRuns< T, vtkKWEPaintbrushBlendSpanRGBA< T > >(
+        labelMap, propertyManager, labelMapExtent, inData, outData );
+    }
+  else if (outC >= 3 && inC == 3)
+    {
+    vtkKWEPaintbrushBlendLabelRuns< T, vtkKWEPaintbrushBlendSpanRGB< T > >(
+        labelMap, propertyManager, labelMapExtent, inData, outData );
+    }
+  else if (inC == 2)
+    {
+    vtkKWEPaintbrushBlendLabelRuns< T, vtkKWEPaintbrushBlendSpanLA< T > >(
+        labelMap, propertyManager, labelMapExtent, inData, outData );
+    }
+  else
+    {
+    vtkKWEPaintbrushBlendLabelRuns< T, vtkKWEPaintbrushBlendSpanL< T > >(
+        labelMap, propertyManager, labelMapExtent, inData, outData );
+    }
+}
+
 //----------------------------------------------------------------------------
 template <class T>
 void vtkKWEPaintbrushBlendExecute( vtkImageStencilData *stencil,
@@ -875,18 +1097,30 @@ void vtkKWEPaintbrushBlendExecute(
 
   vtkImageIterator< T > inIt( inData, labelMapExtent );
   vtkImageIterator< T > outIt( outData, labelMapExtent );
-  vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > labelMapIt(
-                                     labelMap->GetLabelMap(), labelMapExtent );
+  if (labelMapExtent[0] > labelMapExtent[1] ||
+      labelMapExtent[2] > labelMapExtent[3] ||
+      labelMapExtent[4] > labelMapExtent[5])
+    {
+    return;
+    }
+
+  // Rows of labels are read from the label data, which may store them
+  // sparsely, into this buffer if need be.
+  vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > labelRow(
+                      labelMapExtent[1] - labelMapExtent[0] + 1 );
+  int idxY = labelMapExtent[2], idxZ = labelMapExtent[4];
 
   // Lookup table of label to color map.
   unsigned char color[3];
   vtkKWEPaintbrushPropertyManager::vtkKWEPaintbrushLabelMapColor colorClass;
 
   // Loop through pixels
-  while (!labelMapIt.IsAtEnd())
+  while (idxZ <= labelMapExtent[5])
     {
-    vtkKWEPaintbrushEnums::LabelType *labelMapSI    = labelMapIt.BeginSpan();
-    vtkKWEPaintbrushEnums::LabelType *labelMapSIEnd = labelMapIt.EndSpan();
+    const vtkKWEPaintbrushEnums::LabelType *labelMapSI = labelMap->GetLabelRow(
+        labelMapExtent[0], labelMapExtent[1], idxY, idxZ, &labelRow[0] );
+    const vtkKWEPaintbrushEnums::LabelType *labelMapSIEnd =
+                                        labelMapSI + labelRow.size();
     T                             *inSI          = inIt.BeginSpan();
     T                             *outSI         = outIt.BeginSpan();
 
@@ -963,7 +1197,11 @@ void vtkKWEPaintbrushBlendExecute(
       outSI += outC;
       }
 
-    labelMapIt.NextSpan();
+    if (++idxY > labelMapExtent[3])
+      {
+      idxY = labelMapExtent[2];
+      ++idxZ;
+      }
     inIt.NextSpan();
     outIt.NextSpan();
     }
@@ -1018,14 +1256,26 @@ void vtkKWEPaintbrushBlendExecuteLabelMapTypeUC(
 
   vtkImageIterator< T > inIt( inData, labelMapExtent );
   vtkImageIterator< T > outIt( outData, labelMapExtent );
-  vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > labelMapIt(
-                                     labelMap->GetLabelMap(), labelMapExtent );
+  if (labelMapExtent[0] > labelMapExtent[1] ||
+      labelMapExtent[2] > labelMapExtent[3] ||
+      labelMapExtent[4] > labelMapExtent[5])
+    {
+    return;
+    }
+
+  // Rows of labels are read from the label data, which may store them
+  // sparsely, into this buffer if need be.
+  vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > labelRow(
+                      labelMapExtent[1] - labelMapExtent[0] + 1 );
+  int idxY = labelMapExtent[2], idxZ = labelMapExtent[4];
 
   // Loop through pixels
-  while (!labelMapIt.IsAtEnd())
+  while (idxZ <= labelMapExtent[5])
     {
-    vtkKWEPaintbrushEnums::LabelType *labelMapSI    = labelMapIt.BeginSpan();
-    vtkKWEPaintbrushEnums::LabelType *labelMapSIEnd = labelMapIt.EndSpan();
+    const vtkKWEPaintbrushEnums::LabelType *labelMapSI = labelMap->GetLabelRow(
+        labelMapExtent[0], labelMapExtent[1], idxY, idxZ, &labelRow[0] );
+    const vtkKWEPaintbrushEnums::LabelType *labelMapSIEnd =
+                                        labelMapSI + labelRow.size();
     T                             *inSI          = inIt.BeginSpan();
     T                             *outSI         = outIt.BeginSpan();
 
@@ -1100,7 +1350,11 @@ void vtkKWEPaintbrushBlendExecuteLabelMapTypeUC(
       outSI += outC;
       }
 
-    labelMapIt.NextSpan();
+    if (++idxY > labelMapExtent[3])
+      {
+      idxY = labelMapExtent[2];
+      ++idxZ;
+      }
     inIt.NextSpan();
     outIt.NextSpan();
     }
@@ -1196,37 +1450,47 @@ void vtkKWEPaintbrushBlend::ThreadedRequestData (
   if (drawing->GetRepresentation() == vtkKWEPaintbrushEnums::Binary)
     {
 
-    // Loop over each stencil and blend it.
-    for (int n = 0; n < drawing->GetNumberOfItems(); n++)
+    // The stencils of the sketches, and their colors.
+    const int nSketches = drawing->GetNumberOfItems();
+    vtkstd::vector< vtkImageStencilData * > stencils(nSketches);
+    vtkstd::vector< vtkKWEPaintbrushBlendSketchColor > colors(nSketches);
+    for (int n = 0; n < nSketches; n++)
       {
       vtkKWEPaintbrushSketch *sketch = drawing->GetItem(n);
-      vtkImageStencilData *stencil = (vtkKWEPaintbrushStencilData::
+      stencils[n] = (vtkKWEPaintbrushStencilData::
         SafeDownCast(sketch->GetPaintbrushData()))->GetImageStencilData();
 
-      // The color of the blend.
-      unsigned char color[3];
+      // round opacity to a value in the range [0,256], because division
+      // by 256 can be efficiently achieved by bit-shifting by 8 bits
       double colorD[3];
       sketch->GetPaintbrushProperty()->GetColor(colorD);
-      color[0] = static_cast< unsigned char >(colorD[0] * 255.0);
-      color[1] = static_cast< unsigned char >(colorD[1] * 255.0);
-      color[2] = static_cast< unsigned char >(colorD[2] * 255.0);
-      double opacity = sketch->GetPaintbrushProperty()->GetOpacity();
+      const double opacity = sketch->GetPaintbrushProperty()->GetOpacity();
+      colors[n].Color[0] = static_cast< unsigned char >(colorD[0] * 255.0);
+      colors[n].Color[1] = static_cast< unsigned char >(colorD[1] * 255.0);
+      colors[n].Color[2] = static_cast< unsigned char >(colorD[2] * 255.0);
+      colors[n].Opacity = static_cast<unsigned short>(256*opacity + 0.5);
+      }
 
-      // for performance reasons, use a special method for unsigned char
-      if (inData[0][0]->GetScalarType() == VTK_UNSIGNED_CHAR)
-        {
-        vtkKWEPaintbrushBlendExecuteChar(
-              stencil, this, outExt,
-              inData[0][0], static_cast<unsigned char *>(inPtr),
-              outData[0], static_cast<unsigned char *>(outPtr),
-              opacity, color );
-        }
-      else
+    // for performance reasons, use a special method for unsigned char, which
+    // blends all the sketches in one pass.
+    if (inData[0][0]->GetScalarType() == VTK_UNSIGNED_CHAR)
+      {
+      vtkKWEPaintbrushBlendExecuteChar(
+            stencils, colors, this, outExt,
+            inData[0][0], static_cast<unsigned char *>(inPtr),
+            outData[0], static_cast<unsigned char *>(outPtr) );
+      }
+    else
+      {
+      // Loop over each stencil and blend it.
+      for (int n = 0; n < nSketches; n++)
         {
+        const double opacity =
+          drawing->GetItem(n)->GetPaintbrushProperty()->GetOpacity();
         switch (inData[0][0]->GetScalarType())
           {
           vtkTemplateMacro(
-            vtkKWEPaintbrushBlendExecute(stencil, this, outExt,
+            vtkKWEPaintbrushBlendExecute(stencils[n], this, outExt,
                                  inData[0][0], static_cast<VTK_TT *>(inPtr),
                                  outData[0], static_cast<VTK_TT *>(outPtr),
                                  opacity ));
@@ -1253,27 +1517,11 @@ void vtkKWEPaintbrushBlend::ThreadedRequestData (
     // for performance reasons, use a special method for unsigned char
     if (inData[0][0]->GetScalarType() == VTK_UNSIGNED_CHAR)
       {
-      if (vtkKWEPaintbrushEnums::GetLabelType() == VTK_UNSIGNED_CHAR)
-        {
-
-        // Fast Lookup table of label to color map.
-        VTKColorType *labelToColorMapUC   = propertyManager->LabelToColorMapUC;
-        double       *labelToOpacityMapUC = propertyManager->LabelToOpacityMapUC;
-
-        vtkKWEPaintbrushBlendExecuteCharLabelMapTypeUC(
-            labelData, this, outExt,
-            inData[0][0], static_cast<unsigned char *>(inPtr),
-            outData[0], static_cast<unsigned char *>(outPtr),
-            labelToColorMapUC, labelToOpacityMapUC );
-        }
-      else
-        {
-        vtkKWEPaintbrushBlendExecuteChar(
-            labelData, this, outExt,
-            inData[0][0], static_cast<unsigned char *>(inPtr),
-            outData[0], static_cast<unsigned char *>(outPtr),
-            propertyManager->LabelToColorMap );
-        }
+      vtkKWEPaintbrushBlendExecuteChar(
+          labelData, this, outExt,
+          inData[0][0], static_cast<unsigned char *>(inPtr),
+          outData[0], static_cast<unsigned char *>(outPtr),
+          propertyManager );
       }
     else
       {
@@ -1338,5 +1586,6 @@ void vtkKWEPaintbrushBlend::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os, indent);
   os << indent << "Opacity:      " << this->Opacity    << endl;
   os << indent << "UseOverlay:   " << this->UseOverlay << endl;
+  os << indent << "BlendTime:    " << this->BlendTime.GetMTime() << endl;
 }
 
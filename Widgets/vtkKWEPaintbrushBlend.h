@@ -27,10 +27,12 @@
 #include "VTKEdgeConfigure.h"
 #include "vtkThreadedImageAlgorithm.h"
 #include <vtkstd/map>
+#include <vtkstd/vector> // for BlendedSketches
 
 class vtkImageStencilData;
 class vtkKWEPaintbrushDrawing;
 class vtkKWEPaintbrushBlendColors;
+class vtkKWEPaintbrushSketch;
 
 class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushBlend : public vtkThreadedImageAlgorithm
 {
@@ -87,9 +89,28 @@ protected:
                           vtkInformationVector** inputVector,
                           vtkInformationVector* outputVector);
 
+  // Description:
+  // When only the voxels of the drawing changed since the last blend, blend
+  // the extents that changed into the image of the last blend, and pass it
+  // to the output. Returns 0 if the whole image must be blended again.
+  int RequestDataForDirtyExtents(vtkInformation* request,
+                                 vtkInformationVector** inputVector,
+                                 vtkInformationVector* outputVector);
+
+  // Description:
+  // Remember what was blended, once done.
+  void BlendDone(vtkKWEPaintbrushDrawing *, vtkImageData *output);
+
   double            Opacity;
   int               UseOverlay;
 
+  // The image of the last blend, updated in place, and when it was made.
+  vtkImageData     *BlendedImage;
+  vtkTimeStamp      BlendTime;
+  //BTX
+  vtkstd::vector< vtkKWEPaintbrushSketch * > BlendedSketches;
+  //ETX
+
 private:
   vtkKWEPaintbrushBlend(const vtkKWEPaintbrushBlend&);  // Not implemented.
   void operator=(const vtkKWEPaintbrushBlend&);  // Not implemented.
@@ -28,6 +28,8 @@ vtkKWEPaintbrushData::vtkKWEPaintbrushData()
 {
   this->Label = 1;
   this->ComputeDelta = 0;
+  this->DirtyExtentsStartTime = 0;
+  this->DirtyExtentsMTime = 0;
 }
 
 //----------------------------------------------------------------------
@@ -41,6 +43,66 @@ void vtkKWEPaintbrushData::Clear( vtkKWEPaintbrushEnums::LabelType )
   this->Allocate( );
 }
 
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushData::ExtentModified( int extent[6], unsigned long mtime )
+{
+  // If we were changed since the last recorded change, we don't know where.
+  // Start recording afresh.
+  if (mtime != this->DirtyExtentsMTime)
+    {
+    this->DirtyExtents.clear();
+    this->DirtyExtentsStartTime = mtime;
+    }
+
+  // Strokes are made of many small changes. Forget about the oldest ones
+  // once there are too many, views are usually updated long before.
+  const size_t maxDirtyExtents = 256;
+  if (this->DirtyExtents.size() >= maxDirtyExtents)
+    {
+    const size_t n = maxDirtyExtents / 2;
+    this->DirtyExtentsStartTime = this->DirtyExtents[n-1].Time;
+    this->DirtyExtents.erase( this->DirtyExtents.begin(),
+                              this->DirtyExtents.begin() + n );
+    }
+
+  this->Modified();
+
+  vtkKWEPaintbrushDirtyExtent dirtyExtent;
+  dirtyExtent.Time = this->GetMTime();
+  for (int i = 0; i < 6; i++)
+    {
+    dirtyExtent.Extent[i] = extent[i];
+    }
+  this->DirtyExtents.push_back(dirtyExtent);
+  this->DirtyExtentsMTime = dirtyExtent.Time;
+}
+
+//----------------------------------------------------------------------
+int vtkKWEPaintbrushData::GetDirtyExtents( unsigned long time,
+                                           vtkstd::vector< int > &extents )
+{
+  const unsigned long mtime = this->GetMTime();
+  if (mtime <= time)
+    {
+    // Nothing changed.
+    return 1;
+    }
+  if (mtime != this->DirtyExtentsMTime || time < this->DirtyExtentsStartTime)
+    {
+    return 0;
+    }
+
+  vtkstd::vector< vtkKWEPaintbrushDirtyExtent >::const_iterator it;
+  for (it = this->DirtyExtents.begin(); it != this->DirtyExtents.end(); ++it)
+    {
+    if (it->Time > time)
+      {
+      extents.insert(extents.end(), it->Extent, it->Extent + 6);
+      }
+    }
+  return 1;
+}
+
 //----------------------------------------------------------------------
 void vtkKWEPaintbrushData::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -24,6 +24,7 @@
 #include "VTKEdgeConfigure.h" // needed for export symbols directives
 #include "vtkKWEPaintbrushEnums.h"
 #include "vtkDataObject.h"
+#include <vtkstd/vector> // for GetDirtyExtents
 
 class vtkImageData;
 
@@ -97,10 +98,41 @@ public:
   void SetComputeDelta( int i ) { this->ComputeDelta = i; }
   int GetComputeDelta() { return this->ComputeDelta; }
 
+  //BTX
+  // Description:
+  // INTERNAL - Do not use.
+  // Extents changed since "time", so that views need only update the parts
+  // of their images that changed. The extents are appended to "extents", 6
+  // values per extent. Returns 0 if some of the changes made since "time"
+  // were not recorded, in which case anything may have changed.
+  int GetDirtyExtents( unsigned long time, vtkstd::vector< int > &extents );
+  //ETX
+
 protected:
   vtkKWEPaintbrushData();
   ~vtkKWEPaintbrushData();
 
+  // Description:
+  // Subclasses call this instead of Modified() when only the voxels within
+  // "extent" changed. "mtime" is the MTime before the change. Changes made
+  // with Modified() are not recorded, and reported as such by
+  // GetDirtyExtents.
+  void ExtentModified( int extent[6], unsigned long mtime );
+
+  //BTX
+  struct vtkKWEPaintbrushDirtyExtent
+    {
+    unsigned long Time;
+    int           Extent[6];
+    };
+  vtkstd::vector< vtkKWEPaintbrushDirtyExtent > DirtyExtents;
+  //ETX
+
+  // Changes made up to DirtyExtentsStartTime are not recorded. The changes
+  // are all recorded as long as the MTime is DirtyExtentsMTime.
+  unsigned long DirtyExtentsStartTime;
+  unsigned long DirtyExtentsMTime;
+
   // Relevant only for vtkKWEPaintbrushStencilData when editing into label maps.
   vtkKWEPaintbrushEnums::LabelType Label;
 
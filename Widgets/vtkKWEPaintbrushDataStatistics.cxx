@@ -30,11 +30,14 @@
 #include "vtkImageStencilData.h"
 #include "vtkKWEPaintbrushGrayscaleData.h"
 #include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushLabelData.h"
 #include "vtkKWEPaintbrushUtilities.h"
 #include "vtkContourFilter.h"
 #include "vtkImageConstantPad.h"
 #include "vtkTriangleFilter.h"
 #include "vtkMassProperties.h"
+#include <math.h>
+#include <vtkstd/algorithm>
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushDataStatistics, "$Revision: 1774 $");
 vtkStandardNewMacro(vtkKWEPaintbrushDataStatistics);
@@ -222,69 +225,560 @@ void vtkKWEPaintbrushDataStatistics::SetInput(vtkKWEPaintbrushData* input)
   this->SetInputConnection(0,input->GetProducerPort());
 }
 
+//----------------------------------------------------------------------------
+// Runs of a row of a stencil, within x1 to x2, sorted and disjoint.
+typedef vtkstd::vector< vtkstd::pair< int, int > > vtkKWEPaintbrushDataStatisticsRunsType;
+
+static void vtkKWEPaintbrushDataStatisticsGetRuns( vtkImageStencilData *s,
+    int x1, int x2, int y, int z, vtkKWEPaintbrushDataStatisticsRunsType &runs )
+{
+  runs.clear();
+  bool sorted = true;
+  int r1, r2, iter = 0, moreSubExtents = 1;
+  while (moreSubExtents)
+    {
+    moreSubExtents = s->GetNextExtent(r1, r2, x1, x2, y, z, iter);
+    if (r1 <= r2)
+      {
+      sorted &= (runs.empty() || r1 > runs.back().second);
+      runs.push_back(vtkstd::pair< int, int >(r1, r2));
+      }
+    }
+
+  // Stencils are normally made of sorted runs. Merge them otherwise.
+  if (!sorted)
+    {
+    vtkstd::sort(runs.begin(), runs.end());
+    size_t n = 0;
+    for (size_t i = 1; i < runs.size(); i++)
+      {
+      if (runs[i].first <= runs[n].second + 1)
+        {
+        runs[n].second = vtkstd::max(runs[n].second, runs[i].second);
+        }
+      else
+        {
+        runs[++n] = runs[i];
+        }
+      }
+    runs.resize(n + 1);
+    }
+}
+
+//----------------------------------------------------------------------------
+static vtkIdType vtkKWEPaintbrushDataStatisticsGetNumberOfVoxels(
+    const vtkKWEPaintbrushDataStatisticsRunsType &runs )
+{
+  vtkIdType n = 0;
+  for (size_t i = 0; i < runs.size(); i++)
+    {
+    n += runs[i].second - runs[i].first + 1;
+    }
+  return n;
+}
+
+//----------------------------------------------------------------------------
+// Arguments of the computation of the overlap of two stencils. Slice z
+// stores the number of voxels of each stencil and of their intersection at
+// Counts[3 * (z - Extent[4])].
+struct vtkKWEPaintbrushDataStatisticsOverlapStruct
+{
+  vtkImageStencilData *Stencils[2];
+  int                  Extents[2][6];
+  int                  Extent[6]; // union of Extents
+  vtkIdType           *Counts;
+};
+
+//----------------------------------------------------------------------------
+static void vtkKWEPaintbrushDataStatisticsOverlapSlab(
+                              void *arguments, int z1, int z2 )
+{
+  vtkKWEPaintbrushDataStatisticsOverlapStruct *str =
+    static_cast< vtkKWEPaintbrushDataStatisticsOverlapStruct * >(arguments);
+  vtkKWEPaintbrushDataStatisticsRunsType runs[2];
+
+  for (int z = z1; z <= z2; z++)
+    {
+    vtkIdType *counts = str->Counts + 3 * (z - str->Extent[4]);
+    for (int y = str->Extent[2]; y <= str->Extent[3]; y++)
+      {
+      for (int i = 0; i < 2; i++)
+        {
+        const int *e = str->Extents[i];
+        runs[i].clear();
+        if (y >= e[2] && y <= e[3] && z >= e[4] && z <= e[5])
+          {
+          vtkKWEPaintbrushDataStatisticsGetRuns(
+            str->Stencils[i], e[0], e[1], y, z, runs[i] );
+          counts[i] += vtkKWEPaintbrushDataStatisticsGetNumberOfVoxels(runs[i]);
+          }
+        }
+
+      // Merge the two sorted lists of runs.
+      size_t i = 0, j = 0;
+      while (i < runs[0].size() && j < runs[1].size())
+        {
+        const int r1 = vtkstd::max(runs[0][i].first, runs[1][j].first);
+        const int r2 = vtkstd::min(runs[0][i].second, runs[1][j].second);
+        if (r1 <= r2)
+          {
+          counts[2] += r2 - r1 + 1;
+          }
+        if (runs[0][i].second < runs[1][j].second)
+          {
+          ++i;
+          }
+        else
+          {
+          ++j;
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Number of voxels of each stencil, and of their intersection.
+static void vtkKWEPaintbrushDataStatisticsGetOverlap(
+    vtkKWEPaintbrushStencilData * s1,
+    vtkKWEPaintbrushStencilData * s2, vtkIdType counts[3] )
+{
+  vtkKWEPaintbrushDataStatisticsOverlapStruct str;
+  str.Stencils[0] = s1->GetImageStencilData();
+  str.Stencils[1] = s2->GetImageStencilData();
+  s1->GetExtent( str.Extents[0] );
+  s2->GetExtent( str.Extents[1] );
+  for (int i = 0; i < 3; i++)
+    {
+    str.Extent[2*i]   = vtkstd::min(str.Extents[0][2*i], str.Extents[1][2*i]);
+    str.Extent[2*i+1] = vtkstd::max(str.Extents[0][2*i+1], str.Extents[1][2*i+1]);
+    counts[i] = 0;
+    }
+
+  const int nz = str.Extent[5] - str.Extent[4] + 1;
+  if (nz < 1)
+    {
+    return;
+    }
+  vtkstd::vector< vtkIdType > sliceCounts(3 * nz, 0);
+  str.Counts = &sliceCounts[0];
+
+  vtkKWEPaintbrushUtilities::ExecuteOnSlabs( str.Extent,
+      vtkKWEPaintbrushDataStatisticsOverlapSlab, &str );
+
+  for (int z = 0; z < nz; z++)
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      counts[i] += sliceCounts[3 * z + i];
+      }
+    }
+}
+
 //----------------------------------------------------------------------------
 double vtkKWEPaintbrushDataStatistics::GetOverlapVolume(
     vtkKWEPaintbrushStencilData * s1,
     vtkKWEPaintbrushStencilData * s2 )
 {
-  unsigned long nVoxels = 0;
+  vtkIdType counts[3];
+  vtkKWEPaintbrushDataStatisticsGetOverlap( s1, s2, counts );
 
-  int s1Extent[6], s2Extent[6], commonExtent[6];
-  s1->GetExtent( s1Extent );
-  s2->GetExtent( s2Extent );
+  double spacing[3];
+  s1->GetImageStencilData()->GetSpacing(spacing);
+  return static_cast<double>(counts[2]) * spacing[0] * spacing[1] * spacing[2];
+}
+
+//----------------------------------------------------------------------------
+double vtkKWEPaintbrushDataStatistics::GetDiceCoefficient(
+    vtkKWEPaintbrushStencilData * s1,
+    vtkKWEPaintbrushStencilData * s2 )
+{
+  vtkIdType counts[3];
+  vtkKWEPaintbrushDataStatisticsGetOverlap( s1, s2, counts );
+  if (counts[0] + counts[1] == 0)
+    {
+    return 1.0;
+    }
+  return 2.0 * static_cast< double >(counts[2]) /
+               static_cast< double >(counts[0] + counts[1]);
+}
 
-  vtkImageStencilData *s1data = s1->GetImageStencilData();
-  vtkImageStencilData *s2data = s2->GetImageStencilData();
+//----------------------------------------------------------------------------
+double vtkKWEPaintbrushDataStatistics::GetJaccardIndex(
+    vtkKWEPaintbrushStencilData * s1,
+    vtkKWEPaintbrushStencilData * s2 )
+{
+  vtkIdType counts[3];
+  vtkKWEPaintbrushDataStatisticsGetOverlap( s1, s2, counts );
+  if (counts[0] + counts[1] == 0)
+    {
+    return 1.0;
+    }
+  return static_cast< double >(counts[2]) /
+         static_cast< double >(counts[0] + counts[1] - counts[2]);
+}
 
-  if (vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-                s1Extent, s2Extent, commonExtent) )
+//----------------------------------------------------------------------------
+// Squared distances, larger than any within an image, mark voxels that are
+// not yet known to be near the boundary.
+#define VTK_KWE_DATA_STATISTICS_FAR 1e30
+
+// Arguments of the distance transform. The distance map and the masks span
+// Extent. Each pass computes the distance transform along one axis, through
+// the lines of voxels spaced by Increments[Axis].
+struct vtkKWEPaintbrushDataStatisticsDistanceStruct
+{
+  int            Extent[6];
+  vtkIdType      Increments[3];
+  double         Spacing[3];
+  int            Axis;
+  double        *Distances;
+};
 
+//----------------------------------------------------------------------------
+// One dimensional squared distance transform of "n" samples, from
+// Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions".
+// "w" is the square of the spacing between samples. Samples at
+// VTK_KWE_DATA_STATISTICS_FAR are left out of the lower envelope.
+static void vtkKWEPaintbrushDataStatisticsDistance1D( double *f, int n,
+    double w, int *v, double *z, double *d )
+{
+  int k = -1;
+  for (int q = 0; q < n; q++)
     {
+    if (f[q] >= VTK_KWE_DATA_STATISTICS_FAR)
+      {
+      continue;
+      }
+    double s = 0.0;
+    while (k >= 0)
+      {
+      const int p = v[k];
+      s = ((f[q] + w * q * q) - (f[p] + w * p * p)) / (2.0 * w * (q - p));
+      if (s > z[k])
+        {
+        break;
+        }
+      --k;
+      }
+    ++k;
+    v[k] = q;
+    z[k] = (k == 0) ? -VTK_KWE_DATA_STATISTICS_FAR : s;
+    }
 
-    // Find the number of voxels that are ON in both
-    int moreSubExtents1, moreSubExtents2;
+  if (k < 0)
+    {
+    return; // no sample is near the boundary
+    }
 
-    int iter_1, iter_2, r1_1, r2_1, r1_2, r2_2;
+  z[k + 1] = VTK_KWE_DATA_STATISTICS_FAR;
+  for (int q = 0, j = 0; q < n; q++)
+    {
+    while (z[j + 1] < q)
+      {
+      ++j;
+      }
+    const double dq = q - v[j];
+    d[q] = w * dq * dq + f[v[j]];
+    }
+  for (int q = 0; q < n; q++)
+    {
+    f[q] = d[q];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Apply the distance transform along Axis to the lines of voxels whose
+// index along SlabAxis is within s1 to s2. The slabs are along Z for the X
+// and Y passes, and along Y for the Z pass.
+static void vtkKWEPaintbrushDataStatisticsDistanceSlab(
+                              void *arguments, int s1, int s2 )
+{
+  vtkKWEPaintbrushDataStatisticsDistanceStruct *str =
+    static_cast< vtkKWEPaintbrushDataStatisticsDistanceStruct * >(arguments);
+  const int axis = str->Axis;
+  const int slabAxis = (axis == 2) ? 1 : 2;
+  const int otherAxis = 3 - axis - slabAxis;
+  const int *e = str->Extent;
+  const int n = e[2*axis+1] - e[2*axis] + 1;
+  const vtkIdType inc = str->Increments[axis];
+  const double w = str->Spacing[axis] * str->Spacing[axis];
+
+  vtkstd::vector< double > f(n), d(n), z(n + 1);
+  vtkstd::vector< int > v(n);
+
+  for (int i = s1; i <= s2; i++)
+    {
+    for (int j = e[2*otherAxis]; j <= e[2*otherAxis+1]; j++)
+      {
+      double *line = str->Distances +
+        (i - e[2*slabAxis]) * str->Increments[slabAxis] +
+        (j - e[2*otherAxis]) * str->Increments[otherAxis];
+      for (int q = 0; q < n; q++)
+        {
+        f[q] = line[q * inc];
+        }
+      vtkKWEPaintbrushDataStatisticsDistance1D( &f[0], n, w, &v[0], &z[0], &d[0] );
+      for (int q = 0; q < n; q++)
+        {
+        line[q * inc] = f[q];
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Rasterize a stencil into "mask", spanning "extent": 1 inside, 2 on its
+// boundary, 0 outside.
+static void vtkKWEPaintbrushDataStatisticsGetBoundary(
+    vtkKWEPaintbrushStencilData *s, const int extent[6],
+    const vtkIdType increments[3], vtkstd::vector< unsigned char > &mask )
+{
+  int e[6];
+  s->GetExtent(e);
+  vtkKWEPaintbrushDataStatisticsRunsType runs;
+  for (int z = e[4]; z <= e[5]; z++)
+    {
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      unsigned char *row = &mask[0] + (y - extent[2]) * increments[1] +
+                           (z - extent[4]) * increments[2] - extent[0];
+      vtkKWEPaintbrushDataStatisticsGetRuns(
+        s->GetImageStencilData(), e[0], e[1], y, z, runs );
+      for (size_t r = 0; r < runs.size(); r++)
+        {
+        vtkstd::fill( row + runs[r].first, row + runs[r].second + 1, 1 );
+        }
+      }
+    }
 
-    for (int z=commonExtent[4]; z <= commonExtent[5]; z++)
+  // Voxels inside with a face neighbor outside, or on the border of the
+  // extent, are on the boundary.
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
       {
-      for (int y=commonExtent[2] ; y <= commonExtent[3]; y++)
+      unsigned char *row = &mask[0] + (y - extent[2]) * increments[1] +
+                           (z - extent[4]) * increments[2];
+      for (int x = extent[0]; x <= extent[1]; x++, row++)
         {
-        iter_1 = 0;
-        moreSubExtents1 = 1;
-        while( moreSubExtents1 )
+        if (*row &&
+            (x == extent[0] || !row[-1] ||
+             x == extent[1] || !row[1] ||
+             y == extent[2] || !row[-increments[1]] ||
+             y == extent[3] || !row[increments[1]] ||
+             z == extent[4] || !row[-increments[2]] ||
+             z == extent[5] || !row[increments[2]]))
           {
-          moreSubExtents1 = s1data->GetNextExtent(
-            r1_1, r2_1, commonExtent[0], commonExtent[1], y, z, iter_1);
+          *row = 2;
+          }
+        }
+      }
+    }
+}
 
-          if (r1_1 <= r2_1)
-            {
-            moreSubExtents2 = 1;
-            iter_2 = 0;
-            while( moreSubExtents2 )
-              {
-              moreSubExtents2 = s2data->GetNextExtent(
-                 r1_2, r2_2, r1_1, r2_1, y, z, iter_2);
+//----------------------------------------------------------------------------
+double vtkKWEPaintbrushDataStatistics::GetBoundaryDistanceHistogram(
+    vtkKWEPaintbrushStencilData * s1,
+    vtkKWEPaintbrushStencilData * s2, double binWidth,
+    vtkstd::vector< vtkIdType > &histogram )
+{
+  histogram.clear();
+  if (!(binWidth > 0.0))
+    {
+    vtkGenericWarningMacro( << "The bin width must be positive." );
+    return -1.0;
+    }
+
+  vtkKWEPaintbrushDataStatisticsDistanceStruct str;
+  int e1[6], e2[6];
+  s1->GetExtent(e1);
+  s2->GetExtent(e2);
+  for (int i = 0; i < 3; i++)
+    {
+    str.Extent[2*i]   = vtkstd::min(e1[2*i], e2[2*i]);
+    str.Extent[2*i+1] = vtkstd::max(e1[2*i+1], e2[2*i+1]);
+    if (str.Extent[2*i] > str.Extent[2*i+1])
+      {
+      return -1.0;
+      }
+    }
+  s1->GetImageStencilData()->GetSpacing(str.Spacing);
+
+  const int *e = str.Extent;
+  str.Increments[0] = 1;
+  str.Increments[1] = e[1] - e[0] + 1;
+  str.Increments[2] = str.Increments[1] * (e[3] - e[2] + 1);
+  const vtkIdType n = str.Increments[2] * (e[5] - e[4] + 1);
+
+  vtkstd::vector< unsigned char > mask1(n, 0), mask2(n, 0);
+  vtkKWEPaintbrushDataStatisticsGetBoundary( s1, e, str.Increments, mask1 );
+  vtkKWEPaintbrushDataStatisticsGetBoundary( s2, e, str.Increments, mask2 );
+
+  // Squared distances to the boundary of the second data, one axis at a
+  // time.
+  vtkstd::vector< double > distances(n);
+  bool empty = true;
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    distances[i] = (mask2[i] == 2) ? 0.0 : VTK_KWE_DATA_STATISTICS_FAR;
+    empty &= (mask2[i] != 2);
+    }
+  if (empty)
+    {
+    return -1.0;
+    }
+  str.Distances = &distances[0];
+
+  for (str.Axis = 0; str.Axis < 3; str.Axis++)
+    {
+    // The Z pass is split along Y.
+    int slabExtent[6] = { e[0], e[1], e[2], e[3], e[4], e[5] };
+    if (str.Axis == 2)
+      {
+      slabExtent[2] = e[4];
+      slabExtent[3] = e[5];
+      slabExtent[4] = e[2];
+      slabExtent[5] = e[3];
+      }
+    vtkKWEPaintbrushUtilities::ExecuteOnSlabs( slabExtent,
+        vtkKWEPaintbrushDataStatisticsDistanceSlab, &str );
+    }
+
+  double maxDistance = -1.0;
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    if (mask1[i] == 2)
+      {
+      const double distance = sqrt(distances[i]);
+      const size_t bin = static_cast< size_t >(distance / binWidth);
+      if (bin >= histogram.size())
+        {
+        histogram.resize(bin + 1, 0);
+        }
+      ++histogram[bin];
+      maxDistance = vtkstd::max(maxDistance, distance);
+      }
+    }
 
-              if (r1_2 <= r2_2)
-                {
-                // There is an intersection
-                nVoxels += (r2_2 - r1_2 + 1);
+  return maxDistance;
+}
+
+//----------------------------------------------------------------------------
+// Arguments of the computation of a confusion matrix. Slice z adds its
+// pairs of labels to Matrices[z - Extent[4]].
+struct vtkKWEPaintbrushDataStatisticsConfusionStruct
+{
+  vtkKWEPaintbrushLabelData *LabelData[2];
+  int                        Extent[6];
+  vtkKWEPaintbrushDataStatistics::ConfusionMatrixType *Matrices;
+};
 
-                } // end if there is a finite intersectingextent in data1
+//----------------------------------------------------------------------------
+static void vtkKWEPaintbrushDataStatisticsConfusionSlab(
+                              void *arguments, int z1, int z2 )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  typedef vtkKWEPaintbrushDataStatistics::LabelPairType LabelPairType;
+  vtkKWEPaintbrushDataStatisticsConfusionStruct *str =
+    static_cast< vtkKWEPaintbrushDataStatisticsConfusionStruct * >(arguments);
+  const int *e = str->Extent;
+  const int nx = e[1] - e[0] + 1;
+  vtkstd::vector< LabelType > buffer1(nx), buffer2(nx);
+
+  for (int z = z1; z <= z2; z++)
+    {
+    vtkKWEPaintbrushDataStatistics::ConfusionMatrixType &matrix =
+      str->Matrices[z - e[4]];
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      const LabelType *row1 =
+        str->LabelData[0]->GetLabelRow( e[0], e[1], y, z, &buffer1[0] );
+      const LabelType *row2 =
+        str->LabelData[1]->GetLabelRow( e[0], e[1], y, z, &buffer2[0] );
+
+      // Pairs of labels come in runs.
+      int x = 0;
+      while (x < nx)
+        {
+        const int start = x;
+        while (++x < nx && row1[x] == row1[start] && row2[x] == row2[start])
+          {
+          }
+        matrix[LabelPairType(row1[start], row2[start])] += x - start;
+        }
+      }
+    }
+}
 
-              } // end foreach extent tuple of data2
-                // within the extent extracted from data1
+//----------------------------------------------------------------------------
+bool vtkKWEPaintbrushDataStatistics::GetConfusionMatrix(
+    vtkKWEPaintbrushLabelData * l1,
+    vtkKWEPaintbrushLabelData * l2, ConfusionMatrixType &matrix )
+{
+  matrix.clear();
 
-            } // end if there is a finite extent in data1
-          } // end for each extent tuple in data1
-        } // end for each scan line
-      } // end of each slice
+  vtkKWEPaintbrushDataStatisticsConfusionStruct str;
+  int e2[6];
+  l1->GetExtent(str.Extent);
+  l2->GetExtent(e2);
+  if (!vtkKWEPaintbrushUtilities::ExtentIsEqualToExtent(str.Extent, e2))
+    {
+    vtkGenericWarningMacro( << "The label maps must have the same extent." );
+    return false;
     }
 
-  double spacing[3];
-  s1data->GetSpacing(spacing);
-  return static_cast<double>(nVoxels) * spacing[0] * spacing[1] * spacing[2];
+  const int nz = str.Extent[5] - str.Extent[4] + 1;
+  if (nz < 1 || str.Extent[1] < str.Extent[0] || str.Extent[3] < str.Extent[2])
+    {
+    return true;
+    }
+  vtkstd::vector< ConfusionMatrixType > matrices(nz);
+  str.LabelData[0] = l1;
+  str.LabelData[1] = l2;
+  str.Matrices     = &matrices[0];
+
+  vtkKWEPaintbrushUtilities::ExecuteOnSlabs( str.Extent,
+      vtkKWEPaintbrushDataStatisticsConfusionSlab, &str );
+
+  for (int z = 0; z < nz; z++)
+    {
+    ConfusionMatrixType::const_iterator it;
+    for (it = matrices[z].begin(); it != matrices[z].end(); ++it)
+      {
+      matrix[it->first] += it->second;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double vtkKWEPaintbrushDataStatistics::GetDiceCoefficient(
+    const ConfusionMatrixType &matrix, vtkKWEPaintbrushEnums::LabelType label )
+{
+  // Voxels with the label in the first map, in the second, and in both.
+  vtkIdType n1 = 0, n2 = 0, n12 = 0;
+  ConfusionMatrixType::const_iterator it;
+  for (it = matrix.begin(); it != matrix.end(); ++it)
+    {
+    if (it->first.first == label)
+      {
+      n1 += it->second;
+      }
+    if (it->first.second == label)
+      {
+      n2 += it->second;
+      }
+    if (it->first.first == label && it->first.second == label)
+      {
+      n12 += it->second;
+      }
+    }
+  if (n1 + n2 == 0)
+    {
+    return 1.0;
+    }
+  return 2.0 * static_cast< double >(n12) / static_cast< double >(n1 + n2);
 }
 
 //----------------------------------------------------------------------------
@@ -28,6 +28,11 @@
 //   algo->SetInput( paintbrushData );
 //   double volume = algo->GetVolume();
 //
+// Static methods compare two paintbrush data, such as a drawing and a
+// reference segmentation: overlap volume, Dice coefficient, Jaccard index,
+// distances between their boundaries and, for label maps, the confusion
+// matrix of their labels. Slabs of slices are processed in parallel.
+//
 // .SECTION See Also
 
 #ifndef __vtkKWEPaintbrushDataStatistics_h
@@ -35,6 +40,10 @@
 
 #include "vtkAlgorithm.h"
 #include "VTKEdgeConfigure.h"
+#include "vtkKWEPaintbrushEnums.h" // for LabelType
+#include <vtkstd/map> // for ConfusionMatrixType
+#include <vtkstd/utility> // for ConfusionMatrixType
+#include <vtkstd/vector> // for GetBoundaryDistanceHistogram
 
 class vtkKWEPaintbrushData;
 class vtkContourFilter;
@@ -42,6 +51,7 @@ class vtkImageConstantPad;
 class vtkTriangleFilter;
 class vtkMassProperties;
 class vtkKWEPaintbrushStencilData;
+class vtkKWEPaintbrushLabelData;
 
 class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushDataStatistics
                                 : public vtkAlgorithm
@@ -76,6 +86,50 @@ public:
   static double GetOverlapVolume( vtkKWEPaintbrushStencilData *,
                                   vtkKWEPaintbrushStencilData * );
 
+  // Description:
+  // Get the Dice coefficient, 2 |A n B| / (|A| + |B|), or the Jaccard index,
+  // |A n B| / |A u B|, of two binary paintbrush data's. Both are 1 if the
+  // data are identical (or both empty) and 0 if they do not overlap. The
+  // same assumptions as for GetOverlapVolume are made.
+  static double GetDiceCoefficient( vtkKWEPaintbrushStencilData *,
+                                    vtkKWEPaintbrushStencilData * );
+  static double GetJaccardIndex( vtkKWEPaintbrushStencilData *,
+                                 vtkKWEPaintbrushStencilData * );
+
+  //BTX
+  // Description:
+  // Histogram of the distances from the boundary voxels of the first binary
+  // paintbrush data to the nearest boundary voxel of the second. Boundary
+  // voxels are those with a face neighbor outside the data. Bin i of the
+  // histogram counts the distances within [i * binWidth, (i+1) * binWidth),
+  // in world coordinates. Returns the largest distance, the directed
+  // Hausdorff distance, or -1 with an empty histogram if either data is
+  // empty or if binWidth is not positive. Call it both ways round for the
+  // symmetric Hausdorff distance. This allocates a distance map spanning
+  // the extents of both data.
+  static double GetBoundaryDistanceHistogram( vtkKWEPaintbrushStencilData *,
+                                         vtkKWEPaintbrushStencilData *,
+                                         double binWidth,
+                                         vtkstd::vector< vtkIdType > &histogram );
+
+  // Description:
+  // Number of voxels for each pair of labels (label in the first label map,
+  // label in the second) of two label maps with the same extent. This is
+  // the confusion matrix of a label drawing against a reference. Returns
+  // false if the extents differ.
+  typedef vtkstd::pair< vtkKWEPaintbrushEnums::LabelType,
+                        vtkKWEPaintbrushEnums::LabelType > LabelPairType;
+  typedef vtkstd::map< LabelPairType, vtkIdType > ConfusionMatrixType;
+  static bool GetConfusionMatrix( vtkKWEPaintbrushLabelData *,
+                                  vtkKWEPaintbrushLabelData *,
+                                  ConfusionMatrixType &matrix );
+
+  // Description:
+  // Get the Dice coefficient of a label from a confusion matrix.
+  static double GetDiceCoefficient( const ConfusionMatrixType &matrix,
+                                    vtkKWEPaintbrushEnums::LabelType label );
+  //ETX
+
 protected:
   vtkKWEPaintbrushDataStatistics();
   ~vtkKWEPaintbrushDataStatistics();
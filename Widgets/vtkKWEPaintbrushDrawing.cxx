@@ -224,14 +224,15 @@ int vtkKWEPaintbrushDrawing::AddNewStroke(
 }
 
 //----------------------------------------------------------------------
-void vtkKWEPaintbrushDrawing::AddShapeToCurrentStroke( int n, double p[3] )
+int vtkKWEPaintbrushDrawing::AddShapeToCurrentStroke( int n, double p[3] )
 {
   if (n < this->GetNumberOfItems() && n >= 0)
     {
     // Add (or subtract) a shape centered at 'p' to the current stroke.
     // Also add (or subtract) the same to this->PaintbrushData, as a service.
-    this->GetItem(n)->AddShapeToCurrentStroke(p, this->PaintbrushData);
+    return this->GetItem(n)->AddShapeToCurrentStroke(p, this->PaintbrushData);
     }
+  return 0;
 }
 
 //----------------------------------------------------------------------
@@ -252,7 +253,9 @@ void vtkKWEPaintbrushDrawing::SetPaintbrushData( vtkKWEPaintbrushLabelData * dat
     }
 
   // Sanity check. Make sure the scalar type of the data is correct.
-  if (data && data->GetLabelMap())
+  // Sparse label data always holds labels of the right type.
+  if (data && data->GetStorageMode() == vtkKWEPaintbrushLabelData::Dense &&
+      data->GetLabelMap())
     {
     if (data->GetLabelMap()->GetScalarType()
               != vtkKWEPaintbrushEnums::GetLabelType())
@@ -549,13 +552,13 @@ void vtkKWEPaintbrushDrawing::InitializeSketches()
     labels[i++] = a->GetLabel();
     }
 
-  vtkImageData *image = vtkKWEPaintbrushLabelData::SafeDownCast(
-                        this->PaintbrushData )->GetLabelMap();
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast( this->PaintbrushData );
 
   // Populate all the strokes at one shot
   vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
                  vtkSmartPointer< vtkKWEPaintbrushStencilData > > initialStrokes
-      =  vtkKWEPaintbrushUtilities::GetStencilsFromImage( image, labels );
+      =  vtkKWEPaintbrushUtilities::GetStencilsFromLabelData( labelData, labels );
 
   // Initialize all the sketches with their user-specified strokes.
   for ( this->Collection->InitTraversal(ait);
@@ -233,8 +233,9 @@ protected:
   void AssignUniqueLabelToSketch( vtkKWEPaintbrushSketch *s );
 
   // Description:
-  // This method will be invoked from the widget during user interaction
-  virtual void AddShapeToCurrentStroke( int n, double p[3] );
+  // This method will be invoked from the widget during user interaction.
+  // Returns 1 if the shape was added to the n'th sketch, 0 otherwise.
+  virtual int AddShapeToCurrentStroke( int n, double p[3] );
 
 private:
   vtkKWEPaintbrushDrawing(const vtkKWEPaintbrushDrawing&);  // Not implemented.
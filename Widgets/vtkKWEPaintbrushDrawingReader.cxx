@@ -0,0 +1,829 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+#include "vtkKWEPaintbrushDrawingReader.h"
+
+#include "vtkKWEPaintbrushDrawingWriter.h"
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushProperty.h"
+#include "vtkKWEPaintbrushPropertyManager.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushGrayscaleData.h"
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkKWEPaintbrushLabelBricks.h"
+#include "vtkKWEPaintbrushUtilities.h"
+#include "vtkObjectFactory.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "vtkByteSwap.h"
+#include "vtkMath.h"
+#include "vtkType.h"
+#include <vtkstd/map>
+#include <vtkstd/vector>
+#include <vtkstd/string>
+#include <vtkstd/limits>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+vtkCxxRevisionMacro(vtkKWEPaintbrushDrawingReader, "$Revision: 1774 $");
+vtkStandardNewMacro(vtkKWEPaintbrushDrawingReader);
+vtkCxxSetObjectMacro(vtkKWEPaintbrushDrawingReader, Drawing, vtkKWEPaintbrushDrawing);
+
+// Sizes of the header and of an entry of the table, see
+// vtkKWEPaintbrushDrawingWriter.
+static const vtkTypeUInt64 vtkKWEPaintbrushDrawingReaderHeaderSize = 112;
+static const vtkTypeUInt64 vtkKWEPaintbrushDrawingReaderEntrySize  = 104;
+
+//----------------------------------------------------------------------------
+// Little endian input from the mapped file.
+class vtkKWEPaintbrushDrawingReaderCursor
+{
+public:
+  vtkKWEPaintbrushDrawingReaderCursor( const unsigned char *p ) : Position(p) {}
+
+  int ReadInt()
+    {
+    vtkTypeInt32 v;
+    this->ReadBytes(&v, 4);
+    vtkByteSwap::Swap4LE(&v);
+    return static_cast< int >(v);
+    }
+  vtkTypeUInt64 ReadUInt64()
+    {
+    vtkTypeUInt64 v;
+    this->ReadBytes(&v, 8);
+    vtkByteSwap::Swap8LE(&v);
+    return v;
+    }
+  float ReadFloat()
+    {
+    float v;
+    this->ReadBytes(&v, 4);
+    vtkByteSwap::Swap4LE(&v);
+    return v;
+    }
+  double ReadDouble()
+    {
+    double v;
+    this->ReadBytes(&v, 8);
+    vtkByteSwap::Swap8LE(&v);
+    return v;
+    }
+  void ReadBytes( void *p, size_t n )
+    {
+    memcpy(p, this->Position, n);
+    this->Position += n;
+    }
+
+  const unsigned char *Position;
+};
+
+//----------------------------------------------------------------------------
+class vtkKWEPaintbrushDrawingReaderInternals
+{
+public:
+  // The entry of a sketch in the table of the file.
+  struct SketchEntry
+    {
+    int           Label;
+    double        Color[3];
+    double        Opacity;
+    int           Visibility;
+    int           Mutable;
+    float         LineWidth;
+    int           Extent[6];
+    int           ScalarType;
+    vtkTypeUInt64 IdentifierOffset;
+    int           IdentifierLength;
+    vtkTypeUInt64 DataOffset;
+    vtkTypeUInt64 DataSize;
+    bool          Loaded;
+    };
+
+  vtkKWEPaintbrushDrawingReaderInternals()
+    {
+    this->Data = NULL;
+    this->Size = 0;
+#ifdef _WIN32
+    this->File    = INVALID_HANDLE_VALUE;
+    this->Mapping = NULL;
+#else
+    this->File    = -1;
+#endif
+    this->LabelMapLoaded = false;
+    }
+  ~vtkKWEPaintbrushDrawingReaderInternals() { this->Unmap(); }
+
+  int  Map( const char *fileName );
+  void Unmap();
+
+  // Is [offset, offset + size) within the file ?
+  bool Contains( vtkTypeUInt64 offset, vtkTypeUInt64 size )
+    {
+    return offset <= this->Size && size <= this->Size - offset;
+    }
+
+  const unsigned char *Data;
+  vtkTypeUInt64        Size;
+#ifdef _WIN32
+  HANDLE               File;
+  HANDLE               Mapping;
+#else
+  int                  File;
+#endif
+
+  int           Representation;
+  int           Extent[6];
+  double        Spacing[3];
+  double        Origin[3];
+  vtkTypeUInt64 LabelMapOffset;
+  vtkTypeUInt64 LabelMapSize;
+  bool          LabelMapLoaded;
+  vtkstd::vector< SketchEntry > Sketches;
+};
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingReaderInternals::Map( const char *fileName )
+{
+  this->Unmap();
+
+#ifdef _WIN32
+  this->File = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+  LARGE_INTEGER size;
+  if (this->File == INVALID_HANDLE_VALUE ||
+      !GetFileSizeEx(this->File, &size) || size.QuadPart == 0)
+    {
+    this->Unmap();
+    return 0;
+    }
+  this->Mapping = CreateFileMapping( this->File, NULL, PAGE_READONLY,
+                                     0, 0, NULL );
+  void *data = this->Mapping ?
+    MapViewOfFile( this->Mapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+  if (!data)
+    {
+    this->Unmap();
+    return 0;
+    }
+  this->Size = static_cast< vtkTypeUInt64 >(size.QuadPart);
+#else
+  this->File = open( fileName, O_RDONLY );
+  struct stat st;
+  if (this->File < 0 || fstat(this->File, &st) != 0 || st.st_size == 0)
+    {
+    this->Unmap();
+    return 0;
+    }
+  void *data = mmap( NULL, static_cast< size_t >(st.st_size), PROT_READ,
+                     MAP_SHARED, this->File, 0 );
+  if (data == MAP_FAILED)
+    {
+    this->Unmap();
+    return 0;
+    }
+  this->Size = static_cast< vtkTypeUInt64 >(st.st_size);
+#endif
+
+  this->Data = static_cast< const unsigned char * >(data);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushDrawingReaderInternals::Unmap()
+{
+#ifdef _WIN32
+  if (this->Data)
+    {
+    UnmapViewOfFile( this->Data );
+    }
+  if (this->Mapping)
+    {
+    CloseHandle( this->Mapping );
+    }
+  if (this->File != INVALID_HANDLE_VALUE)
+    {
+    CloseHandle( this->File );
+    }
+  this->File    = INVALID_HANDLE_VALUE;
+  this->Mapping = NULL;
+#else
+  if (this->Data)
+    {
+    munmap( const_cast< unsigned char * >(this->Data),
+            static_cast< size_t >(this->Size) );
+    }
+  if (this->File >= 0)
+    {
+    close( this->File );
+    }
+  this->File = -1;
+#endif
+  this->Data = NULL;
+  this->Size = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushDrawingReader::vtkKWEPaintbrushDrawingReader()
+{
+  this->FileName     = NULL;
+  this->Drawing      = NULL;
+  this->LoadOnDemand = 1;
+  this->Internals    = new vtkKWEPaintbrushDrawingReaderInternals;
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushDrawingReader::~vtkKWEPaintbrushDrawingReader()
+{
+  delete this->Internals;
+  this->SetFileName(NULL);
+  this->SetDrawing(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushDrawingReader::Close()
+{
+  this->Internals->Unmap();
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingReader::GetNumberOfSketches()
+{
+  return static_cast< int >(this->Internals->Sketches.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingReader::IsSketchLoaded( int n )
+{
+  return (n >= 0 && n < this->GetNumberOfSketches() &&
+          this->Internals->Sketches[n].Loaded) ? 1 : 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingReader::Read()
+{
+  vtkKWEPaintbrushDrawingReaderInternals *internals = this->Internals;
+  internals->Sketches.clear();
+  internals->LabelMapLoaded = false;
+
+  if (!this->FileName)
+    {
+    vtkErrorMacro( << "No file name." );
+    return 0;
+    }
+  vtkKWEPaintbrushDrawing *drawing = this->Drawing;
+  if (!drawing || !drawing->GetImageData())
+    {
+    vtkErrorMacro( << "No drawing, or the drawing has no image data." );
+    return 0;
+    }
+  if (!internals->Map(this->FileName))
+    {
+    vtkErrorMacro( << "Unable to map " << this->FileName << "." );
+    return 0;
+    }
+
+  // Header.
+  const char *signature = vtkKWEPaintbrushDrawingWriter::GetFileSignature();
+  if (internals->Size < vtkKWEPaintbrushDrawingReaderHeaderSize ||
+      memcmp(internals->Data, signature, 8) != 0)
+    {
+    vtkErrorMacro( << this->FileName << " is not a paintbrush drawing." );
+    this->Close();
+    return 0;
+    }
+  vtkKWEPaintbrushDrawingReaderCursor c(internals->Data + 8);
+  const int version = c.ReadInt();
+  if (version < 1 || version > vtkKWEPaintbrushDrawingWriter::FileVersion)
+    {
+    vtkErrorMacro( << this->FileName << " has version " << version
+                   << " of the format, which this reader cannot read." );
+    this->Close();
+    return 0;
+    }
+  internals->Representation = c.ReadInt();
+  const int nSketches = c.ReadInt();
+  c.ReadInt(); // The labels are converted to the LabelType.
+  for (int i = 0; i < 6; i++)
+    {
+    internals->Extent[i] = c.ReadInt();
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    internals->Spacing[i] = c.ReadDouble();
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    internals->Origin[i] = c.ReadDouble();
+    }
+  internals->LabelMapOffset = c.ReadUInt64();
+  internals->LabelMapSize   = c.ReadUInt64();
+
+  int extent[6];
+  drawing->GetImageData()->GetWholeExtent(extent);
+  if (internals->Representation < vtkKWEPaintbrushEnums::Binary ||
+      internals->Representation > vtkKWEPaintbrushEnums::Label ||
+      nSketches < 0 ||
+      !internals->Contains(vtkKWEPaintbrushDrawingReaderHeaderSize,
+          static_cast< vtkTypeUInt64 >(nSketches) *
+            vtkKWEPaintbrushDrawingReaderEntrySize) ||
+      !internals->Contains(internals->LabelMapOffset, internals->LabelMapSize))
+    {
+    vtkErrorMacro( << this->FileName << " is corrupt." );
+    this->Close();
+    return 0;
+    }
+  if (!vtkKWEPaintbrushUtilities::ExtentIsEqualToExtent(
+                            extent, internals->Extent))
+    {
+    vtkErrorMacro( << "The extent of the drawing in " << this->FileName
+                   << " differs from that of the image data." );
+    this->Close();
+    return 0;
+    }
+
+  // Table.
+  internals->Sketches.resize(nSketches);
+  for (int n = 0; n < nSketches; n++)
+    {
+    vtkKWEPaintbrushDrawingReaderInternals::SketchEntry &e =
+      internals->Sketches[n];
+    e.Label = c.ReadInt();
+    for (int i = 0; i < 3; i++)
+      {
+      e.Color[i] = c.ReadDouble();
+      }
+    e.Opacity    = c.ReadDouble();
+    e.Visibility = c.ReadInt();
+    e.Mutable    = c.ReadInt();
+    e.LineWidth  = c.ReadFloat();
+    for (int i = 0; i < 6; i++)
+      {
+      e.Extent[i] = c.ReadInt();
+      }
+    e.ScalarType       = c.ReadInt();
+    e.IdentifierOffset = c.ReadUInt64();
+    e.IdentifierLength = c.ReadInt();
+    e.DataOffset       = c.ReadUInt64();
+    e.DataSize         = c.ReadUInt64();
+    e.Loaded           = false;
+
+    const bool emptyExtent = (e.Extent[0] > e.Extent[1] ||
+      e.Extent[2] > e.Extent[3] || e.Extent[4] > e.Extent[5]);
+    if (e.Label < static_cast< int >(
+          (vtkstd::numeric_limits< vtkKWEPaintbrushEnums::LabelType >::min)()) ||
+        e.Label > static_cast< int >(
+          (vtkstd::numeric_limits< vtkKWEPaintbrushEnums::LabelType >::max)()) ||
+        e.IdentifierLength < 0 ||
+        !internals->Contains(e.IdentifierOffset, e.IdentifierLength) ||
+        !internals->Contains(e.DataOffset, e.DataSize) ||
+        (!emptyExtent &&
+         !vtkMath::ExtentIsWithinOtherExtent(e.Extent, internals->Extent)))
+      {
+      vtkErrorMacro( << this->FileName << " is corrupt." );
+      internals->Sketches.clear();
+      this->Close();
+      return 0;
+      }
+    }
+
+  // The sketches, with their labels and properties, but no data yet. A
+  // label map is read into label data stored the way the drawing's was.
+  int storageMode = vtkKWEPaintbrushLabelData::Dense;
+  if (vtkKWEPaintbrushLabelData *labelData =
+      vtkKWEPaintbrushLabelData::SafeDownCast(drawing->GetPaintbrushData()))
+    {
+    storageMode = labelData->GetStorageMode();
+    }
+  drawing->SetRepresentation(internals->Representation);
+  drawing->InitializeData();
+  drawing->RemoveAllItems();
+  if (vtkKWEPaintbrushLabelData *labelData =
+      vtkKWEPaintbrushLabelData::SafeDownCast(drawing->GetPaintbrushData()))
+    {
+    labelData->SetStorageMode(storageMode);
+    }
+  for (int n = 0; n < nSketches; n++)
+    {
+    vtkKWEPaintbrushDrawingReaderInternals::SketchEntry &e =
+      internals->Sketches[n];
+    vtkKWEPaintbrushSketch *sketch = drawing->AddItem();
+    if (!sketch)
+      {
+      vtkErrorMacro( << this->FileName << " has more sketches than the "
+                     << "drawing can hold." );
+      internals->Sketches.resize(n);
+      return 0;
+      }
+    sketch->SetLabel(static_cast< vtkKWEPaintbrushEnums::LabelType >(e.Label));
+
+    vtkKWEPaintbrushProperty *property = sketch->GetPaintbrushProperty();
+    property->SetColor(e.Color);
+    property->SetOpacity(e.Opacity);
+    property->SetVisibility(e.Visibility);
+    property->SetMutable(e.Mutable);
+    property->SetLineWidth(e.LineWidth);
+    if (e.IdentifierLength)
+      {
+      vtkstd::string identifier(reinterpret_cast< const char * >(
+          internals->Data + e.IdentifierOffset), e.IdentifierLength);
+      property->SetIdentifier(identifier.c_str());
+      }
+    }
+  drawing->GetPaintbrushPropertyManager()->Update();
+
+  // The label map is shared by all the sketches, so it is not worth loading
+  // on demand.
+  if (internals->Representation == vtkKWEPaintbrushEnums::Label)
+    {
+    return this->LoadLabelMap();
+    }
+  return this->LoadOnDemand ? 1 : this->LoadAllSketches();
+}
+
+//----------------------------------------------------------------------------
+// The runs of a binary sketch, into "stencil". Returns 0 if they are
+// corrupt.
+static int vtkKWEPaintbrushDrawingReaderReadStencil(
+    const unsigned char *data, vtkTypeUInt64 size, int extent[6],
+    vtkImageStencilData *stencil )
+{
+  vtkKWEPaintbrushDrawingReaderCursor c(data);
+  const unsigned char *end = data + size;
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      if (end - c.Position < 4)
+        {
+        return 0;
+        }
+      const int nRuns = c.ReadInt();
+      if (nRuns < 0 || (end - c.Position) / 8 < nRuns)
+        {
+        return 0;
+        }
+      for (int i = 0; i < nRuns; i++)
+        {
+        const int r1 = c.ReadInt();
+        const int r2 = c.ReadInt();
+        if (r1 > r2 || r1 < extent[0] || r2 > extent[1])
+          {
+          return 0;
+          }
+        stencil->InsertNextExtent(r1, r2, y, z);
+        }
+      }
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+// The runs of labels of the label map, into "labelData", already allocated
+// with NoLabelValue: into its label map, or into its bricks in Sparse
+// storage mode. The runs of label l are also inserted in stencils[l -
+// minStencilLabel], if there is one. Returns 0 if they are corrupt.
+static int vtkKWEPaintbrushDrawingReaderReadLabelMap(
+    const unsigned char *data, vtkTypeUInt64 size, int extent[6],
+    vtkKWEPaintbrushLabelData *labelData, int minStencilLabel,
+    const vtkstd::vector< vtkImageStencilData * > &stencils )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const int minLabel =
+    static_cast< int >((vtkstd::numeric_limits< LabelType >::min)());
+  const int maxLabel =
+    static_cast< int >((vtkstd::numeric_limits< LabelType >::max)());
+  const bool sparse =
+    (labelData->GetStorageMode() == vtkKWEPaintbrushLabelData::Sparse);
+  const int nStencils = static_cast< int >(stencils.size());
+
+  vtkKWEPaintbrushDrawingReaderCursor c(data);
+  const unsigned char *end = data + size;
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      if (end - c.Position < 4)
+        {
+        return 0;
+        }
+      const int nRuns = c.ReadInt();
+      if (nRuns < 0 || (end - c.Position) / 12 < nRuns)
+        {
+        return 0;
+        }
+      LabelType *row = sparse ? NULL : static_cast< LabelType * >(
+          labelData->GetLabelMap()->GetScalarPointer(extent[0], y, z));
+      int lastX = extent[0] - 1;
+      for (int i = 0; i < nRuns; i++)
+        {
+        const int x1 = c.ReadInt();
+        const int x2 = c.ReadInt();
+        const int label = c.ReadInt();
+        if (x1 > x2 || x1 <= lastX || x2 > extent[1] ||
+            label < minLabel || label > maxLabel)
+          {
+          return 0;
+          }
+        lastX = x2;
+
+        if (sparse)
+          {
+          int run[6] = { x1, x2, y, y, z, z };
+          labelData->GetBricks()->FillExtent(
+              run, static_cast< LabelType >(label));
+          }
+        else
+          {
+          for (int x = x1; x <= x2; x++)
+            {
+            row[x - extent[0]] = static_cast< LabelType >(label);
+            }
+          }
+
+        const int index = label - minStencilLabel;
+        if (index >= 0 && index < nStencils && stencils[index])
+          {
+          stencils[index]->InsertNextExtent(x1, x2, y, z);
+          }
+        }
+      }
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingReader::LoadSketch( int n )
+{
+  vtkKWEPaintbrushDrawingReaderInternals *internals = this->Internals;
+  if (n < 0 || n >= this->GetNumberOfSketches())
+    {
+    vtkErrorMacro( << "No sketch " << n << " was read." );
+    return 0;
+    }
+  vtkKWEPaintbrushDrawingReaderInternals::SketchEntry &e =
+    internals->Sketches[n];
+  if (e.Loaded)
+    {
+    return 1;
+    }
+  if (!internals->Data)
+    {
+    vtkErrorMacro( << "The file was closed before sketch " << n
+                   << " was loaded." );
+    return 0;
+    }
+
+  vtkKWEPaintbrushDrawing *drawing = this->Drawing;
+  vtkKWEPaintbrushSketch *sketch = drawing ? drawing->GetItem(n) : NULL;
+  if (!sketch)
+    {
+    vtkErrorMacro( << "The drawing has no sketch " << n << "." );
+    return 0;
+    }
+
+  if (internals->Representation == vtkKWEPaintbrushEnums::Label)
+    {
+    return this->LoadLabelMap();
+    }
+
+  const bool emptyExtent = (e.Extent[0] > e.Extent[1] ||
+    e.Extent[2] > e.Extent[3] || e.Extent[4] > e.Extent[5]);
+  if (emptyExtent)
+    {
+    e.Loaded = true;
+    return 1;
+    }
+
+  // The data read is added to the sketch as a stroke, so that composing
+  // the strokes of the sketch, on an undo or a redo, keeps it.
+  if (internals->Representation == vtkKWEPaintbrushEnums::Binary)
+    {
+    if (!vtkKWEPaintbrushStencilData::SafeDownCast(sketch->GetPaintbrushData())
+        || !vtkKWEPaintbrushStencilData::SafeDownCast(
+                                        drawing->GetPaintbrushData()))
+      {
+      vtkErrorMacro( << "The drawing is not a binary drawing." );
+      return 0;
+      }
+
+    vtkSmartPointer< vtkKWEPaintbrushStencilData > data =
+      vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+    data->SetExtent(e.Extent);
+    data->SetSpacing(internals->Spacing);
+    data->SetOrigin(internals->Origin);
+    data->Allocate();
+    if (!vtkKWEPaintbrushDrawingReaderReadStencil(
+          internals->Data + e.DataOffset, e.DataSize, e.Extent,
+          data->GetImageStencilData()))
+      {
+      vtkErrorMacro( << "Sketch " << n << " of " << this->FileName
+                     << " is corrupt." );
+      return 0;
+      }
+    drawing->GetPaintbrushData()->Add(data);
+    sketch->AddNewStroke(vtkKWEPaintbrushEnums::Draw, data, NULL, true);
+    }
+
+  else
+    {
+    if (!vtkKWEPaintbrushGrayscaleData::SafeDownCast(
+                                        sketch->GetPaintbrushData()) ||
+        !vtkKWEPaintbrushGrayscaleData::SafeDownCast(
+                                        drawing->GetPaintbrushData()))
+      {
+      vtkErrorMacro( << "The drawing is not a grayscale drawing." );
+      return 0;
+      }
+
+    switch (e.ScalarType)
+      {
+      case VTK_CHAR:  case VTK_SIGNED_CHAR:    case VTK_UNSIGNED_CHAR:
+      case VTK_SHORT: case VTK_UNSIGNED_SHORT: case VTK_INT:
+      case VTK_UNSIGNED_INT: case VTK_FLOAT:   case VTK_DOUBLE:
+        break;
+      default:
+        vtkErrorMacro( << "Sketch " << n << " of " << this->FileName
+                       << " has an unknown scalar type." );
+        return 0;
+      }
+
+    vtkSmartPointer< vtkImageData > image =
+      vtkSmartPointer< vtkImageData >::New();
+    image->SetExtent(e.Extent);
+    image->SetSpacing(internals->Spacing);
+    image->SetOrigin(internals->Origin);
+    image->SetScalarType(e.ScalarType);
+    image->SetNumberOfScalarComponents(1);
+    const int size = image->GetScalarSize();
+    const vtkIdType nPoints = image->GetNumberOfPoints();
+    if (e.DataSize != static_cast< vtkTypeUInt64 >(nPoints) * size)
+      {
+      vtkErrorMacro( << "Sketch " << n << " of " << this->FileName
+                     << " is corrupt." );
+      return 0;
+      }
+    image->AllocateScalars();
+    void *scalars = image->GetScalarPointer();
+    memcpy(scalars, internals->Data + e.DataOffset,
+           static_cast< size_t >(e.DataSize));
+    switch (size)
+      {
+      case 2: vtkByteSwap::Swap2LERange(scalars, nPoints); break;
+      case 4: vtkByteSwap::Swap4LERange(scalars, nPoints); break;
+      case 8: vtkByteSwap::Swap8LERange(scalars, nPoints); break;
+      }
+    vtkSmartPointer< vtkKWEPaintbrushGrayscaleData > data =
+      vtkSmartPointer< vtkKWEPaintbrushGrayscaleData >::New();
+    data->SetImageData(image);
+    drawing->GetPaintbrushData()->Add(data);
+    sketch->AddNewStroke(vtkKWEPaintbrushEnums::Draw, data, NULL, true);
+    }
+
+  e.Loaded = true;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingReader::LoadLabelMap()
+{
+  vtkKWEPaintbrushDrawingReaderInternals *internals = this->Internals;
+  if (internals->LabelMapLoaded)
+    {
+    return 1;
+    }
+
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast(
+        this->Drawing->GetPaintbrushData());
+  if (!labelData)
+    {
+    vtkErrorMacro( << "The drawing is not a label map drawing." );
+    return 0;
+    }
+
+  // The labels are decoded straight into the label data, and the runs of
+  // the label of each sketch into the stencil of its initial stroke, so
+  // that composing the strokes of the drawing keeps them.
+  labelData->SetExtent(internals->Extent);
+  labelData->SetSpacing(internals->Spacing);
+  labelData->SetOrigin(internals->Origin);
+  labelData->Allocate();
+
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const int nSketches = this->Drawing->GetNumberOfItems();
+  vtkstd::map< LabelType, vtkSmartPointer< vtkKWEPaintbrushStencilData > >
+    strokes;
+  for (int n = 0; n < nSketches; n++)
+    {
+    const LabelType label = this->Drawing->GetItem(n)->GetLabel();
+    if (label != vtkKWEPaintbrushLabelData::NoLabelValue &&
+        strokes.find(label) == strokes.end())
+      {
+      vtkSmartPointer< vtkKWEPaintbrushStencilData > stroke =
+        vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+      stroke->SetLabel(label);
+      stroke->SetExtent(internals->Extent);
+      stroke->SetSpacing(internals->Spacing);
+      stroke->SetOrigin(internals->Origin);
+      stroke->Allocate();
+      strokes[label] = stroke;
+      }
+    }
+
+  // Stencils are looked up per run in a table indexed by label, rather than
+  // in the map.
+  const int minStencilLabel =
+    strokes.empty() ? 0 : static_cast< int >(strokes.begin()->first);
+  vtkstd::vector< vtkImageStencilData * > stencils(strokes.empty() ? 0 :
+    static_cast< int >(strokes.rbegin()->first) - minStencilLabel + 1,
+    static_cast< vtkImageStencilData * >(NULL));
+  for (vtkstd::map< LabelType, vtkSmartPointer<
+         vtkKWEPaintbrushStencilData > >::const_iterator it = strokes.begin();
+       it != strokes.end(); ++it)
+    {
+    stencils[static_cast< int >(it->first) - minStencilLabel] =
+      it->second->GetImageStencilData();
+    }
+
+  if (!vtkKWEPaintbrushDrawingReaderReadLabelMap(
+        internals->Data + internals->LabelMapOffset, internals->LabelMapSize,
+        internals->Extent, labelData, minStencilLabel, stencils))
+    {
+    vtkErrorMacro( << "The label map of " << this->FileName
+                   << " is corrupt." );
+    labelData->Allocate();
+    return 0;
+    }
+  labelData->GetLabelMap()->Modified();
+
+  for (int n = 0; n < nSketches; n++)
+    {
+    vtkKWEPaintbrushSketch *sketch = this->Drawing->GetItem(n);
+    if (strokes.find(sketch->GetLabel()) != strokes.end())
+      {
+      sketch->AddNewStroke(vtkKWEPaintbrushEnums::Draw,
+                           strokes[sketch->GetLabel()], NULL, true);
+      }
+    }
+
+  internals->LabelMapLoaded = true;
+  for (size_t n = 0; n < internals->Sketches.size(); n++)
+    {
+    internals->Sketches[n].Loaded = true;
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingReader::LoadAllSketches()
+{
+  const int nSketches = this->GetNumberOfSketches();
+  for (int n = 0; n < nSketches; n++)
+    {
+    if (!this->LoadSketch(n))
+      {
+      return 0;
+      }
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushDrawingReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "FileName: "
+     << (this->FileName ? this->FileName : "(none)") << "\n";
+  os << indent << "Drawing: " << this->Drawing << "\n";
+  os << indent << "LoadOnDemand: " << this->LoadOnDemand << "\n";
+  os << indent << "NumberOfSketches: " << this->GetNumberOfSketches() << "\n";
+}
@@ -0,0 +1,126 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+
+// .NAME vtkKWEPaintbrushDrawingReader - Read a drawing from a binary file
+// .SECTION Description
+// Reads the files written by vtkKWEPaintbrushDrawingWriter into a drawing.
+// The drawing must have its image data set, with the extent of the file.
+//
+// The file is memory mapped. Read() only reads the table of the sketches:
+// it sets the representation of the drawing and creates its sketches with
+// their labels and properties. The data of a sketch is read from the file
+// when LoadSketch() is called for it, so opening a drawing with many
+// sketches is quick and only the pages of the sketches loaded are read.
+// Turn LoadOnDemand off to load all the sketches in Read(). The label map
+// of a label map drawing is a single run-length encoded map shared by its
+// sketches: it is always loaded in Read(), along with the initial stroke of
+// every sketch. It is decoded straight into the label data of the drawing,
+// which keeps the storage mode it had before Read().
+//
+// The file stays mapped until Close() is called, another file is read, or
+// the reader is destroyed. Sketches that were not loaded by then stay
+// empty.
+// .SECTION See Also
+// vtkKWEPaintbrushDrawingWriter
+
+#ifndef __vtkKWEPaintbrushDrawingReader_h
+#define __vtkKWEPaintbrushDrawingReader_h
+
+#include "vtkObject.h"
+#include "VTKEdgeConfigure.h" // needed for export symbols directives
+
+class vtkKWEPaintbrushDrawing;
+class vtkKWEPaintbrushDrawingReaderInternals;
+
+class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushDrawingReader : public vtkObject
+{
+public:
+  // Description:
+  // Standard VTK methods.
+  static vtkKWEPaintbrushDrawingReader *New();
+  vtkTypeRevisionMacro(vtkKWEPaintbrushDrawingReader, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // Set/Get the name of the file to read.
+  vtkSetStringMacro( FileName );
+  vtkGetStringMacro( FileName );
+
+  // Description:
+  // Set/Get the drawing to read into. Its sketches are replaced by those of
+  // the file.
+  virtual void SetDrawing( vtkKWEPaintbrushDrawing * );
+  vtkGetObjectMacro( Drawing, vtkKWEPaintbrushDrawing );
+
+  // Description:
+  // Load the data of the sketches when they are first asked for with
+  // LoadSketch(), rather than in Read(). On by default. The label map of a
+  // label map drawing is always loaded in Read().
+  vtkSetMacro( LoadOnDemand, int );
+  vtkGetMacro( LoadOnDemand, int );
+  vtkBooleanMacro( LoadOnDemand, int );
+
+  // Description:
+  // Map the file and create the sketches of the drawing. Returns 1 on
+  // success, 0 on failure.
+  virtual int Read();
+
+  // Description:
+  // Number of sketches of the file read, in the order of the sketches of
+  // the drawing.
+  int GetNumberOfSketches();
+
+  // Description:
+  // Load the data of the n'th sketch of the drawing from the file, if it
+  // was not yet. The data is added as a draw stroke of the sketch, so that
+  // it survives an undo or redo. Returns 1 on success, 0 on failure.
+  virtual int LoadSketch( int n );
+  int IsSketchLoaded( int n );
+
+  // Description:
+  // Load the sketches that were not yet. Returns 1 on success, 0 on failure.
+  virtual int LoadAllSketches();
+
+  // Description:
+  // Unmap the file.
+  virtual void Close();
+
+protected:
+  vtkKWEPaintbrushDrawingReader();
+  ~vtkKWEPaintbrushDrawingReader();
+
+  // Description:
+  // Load the label map of a label map drawing, and the initial stroke of
+  // each of its sketches from the runs of its label.
+  int LoadLabelMap();
+
+  char                    * FileName;
+  vtkKWEPaintbrushDrawing * Drawing;
+  int                       LoadOnDemand;
+
+  vtkKWEPaintbrushDrawingReaderInternals * Internals;
+
+private:
+  vtkKWEPaintbrushDrawingReader(const vtkKWEPaintbrushDrawingReader&);  // Not implemented.
+  void operator=(const vtkKWEPaintbrushDrawingReader&);  // Not implemented.
+};
+
+#endif
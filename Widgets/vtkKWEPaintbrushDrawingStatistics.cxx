@@ -30,9 +30,6 @@
 #include "vtkKWEPaintbrushDrawing.h"
 #include "vtkKWEPaintbrushLabelData.h"
 #include "vtkKWEPaintbrushDataStatistics.h"
-#include "vtkImageData.h"
-#include "vtkDataArray.h"
-#include "vtkPointData.h"
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushDrawingStatistics, "$Revision: 3258 $");
 vtkStandardNewMacro(vtkKWEPaintbrushDrawingStatistics);
@@ -44,20 +41,11 @@ vtkKWEPaintbrushDrawingStatistics::vtkKWEPaintbrushDrawingStatistics()
   this->SetNumberOfOutputPorts(0);
   this->Volume = 0;
   this->Volumes.clear();
-  
-  this->MaximumLabelValue = 1;
-  for (int i = 0; i < sizeof( vtkKWEPaintbrushEnums::LabelType ); i++)
-    {
-    this->MaximumLabelValue *= 256;
-    }
-  this->VolumesArray = new unsigned long[this->MaximumLabelValue];
-  
 }
 
 //----------------------------------------------------------------------------
 vtkKWEPaintbrushDrawingStatistics::~vtkKWEPaintbrushDrawingStatistics()
 {
-  delete this->VolumesArray;
 }
 
 //----------------------------------------------------------------------------
@@ -93,37 +81,21 @@ int vtkKWEPaintbrushDrawingStatistics
     }
   else
     {
-
-    for (unsigned long i = 0; i < this->MaximumLabelValue; i++)
-      {
-      this->VolumesArray[i] = 0;
-      }      
-
+    // The label data keeps count of the voxels of each label, there is no
+    // need to visit them.
     vtkKWEPaintbrushLabelData *ldata = vtkKWEPaintbrushLabelData::SafeDownCast(
         inputDrawing->GetPaintbrushData());
-    vtkImageData *labelImage = ldata->GetLabelMap();
-    
-    vtkDataArray * array = labelImage->GetPointData()->GetScalars();
-    vtkKWEPaintbrushEnums::LabelType *arrayPointer =
-      static_cast<vtkKWEPaintbrushEnums::LabelType *>(array->GetVoidPointer(0));
-
-    const unsigned long size = array->GetDataSize();
-    for (unsigned long i = 0; i < size; ++i, ++arrayPointer)
-      {
-      vtkKWEPaintbrushEnums::LabelType l = *arrayPointer;
-      if (l != vtkKWEPaintbrushLabelData::NoLabelValue)
-        {
-        ++(this->VolumesArray[l]);
-        }
-      }
 
     double spacing[3];
     ldata->GetSpacing(spacing);
     const double voxelVolume = spacing[0] * spacing[1] * spacing[2];
 
-    for (unsigned long i = 0; i < this->MaximumLabelValue; i++)
+    const vtkKWEPaintbrushLabelData::LabelSetType labels = ldata->GetLabels();
+    for (vtkKWEPaintbrushLabelData::LabelSetType::const_iterator it
+          = labels.begin(); it != labels.end(); ++it)
       {
-      this->Volume += ((double)(this->VolumesArray[i]) * voxelVolume);
+      this->Volume += static_cast<double>(ldata->GetNumberOfVoxels(*it))
+                                                          * voxelVolume;
       }
     }
 
@@ -184,8 +156,8 @@ double vtkKWEPaintbrushDrawingStatistics::GetVolume(int n)
         this->GetDrawing()->GetPaintbrushData());    
     ldata->GetSpacing(spacing);
     const double voxelVolume = spacing[0] * spacing[1] * spacing[2];
-    return voxelVolume * (double)(this->VolumesArray[
-          this->GetDrawing()->GetItem(n)->GetLabel()]);
+    return voxelVolume * static_cast<double>(ldata->GetNumberOfVoxels(
+          this->GetDrawing()->GetItem(n)->GetLabel()));
     }
 }
 
@@ -205,7 +177,7 @@ double vtkKWEPaintbrushDrawingStatistics
       this->GetDrawing()->GetPaintbrushData());    
   ldata->GetSpacing(spacing);
   const double voxelVolume = spacing[0] * spacing[1] * spacing[2];
-  return voxelVolume * (double)(this->VolumesArray[l]);
+  return voxelVolume * static_cast<double>(ldata->GetNumberOfVoxels(l));
 }
 
 //----------------------------------------------------------------------------
@@ -89,8 +89,6 @@ protected:
 
   vtkstd::vector< double > Volumes;
   double                   Volume;
-  unsigned long *          VolumesArray;
-  unsigned long            MaximumLabelValue;
 
 private:
   vtkKWEPaintbrushDrawingStatistics( const vtkKWEPaintbrushDrawingStatistics& );
@@ -0,0 +1,438 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+#include "vtkKWEPaintbrushDrawingWriter.h"
+
+#include "vtkKWEPaintbrushDrawing.h"
+#include "vtkKWEPaintbrushSketch.h"
+#include "vtkKWEPaintbrushProperty.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushGrayscaleData.h"
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkObjectFactory.h"
+#include "vtkImageStencilData.h"
+#include "vtkImageData.h"
+#include "vtkSmartPointer.h"
+#include "vtkByteSwap.h"
+#include "vtkType.h"
+#include <vtkstd/vector>
+#include <string.h>
+
+vtkCxxRevisionMacro(vtkKWEPaintbrushDrawingWriter, "$Revision: 1774 $");
+vtkStandardNewMacro(vtkKWEPaintbrushDrawingWriter);
+vtkCxxSetObjectMacro(vtkKWEPaintbrushDrawingWriter, Drawing, vtkKWEPaintbrushDrawing);
+
+//----------------------------------------------------------------------------
+// Little endian output, keeping track of the offset.
+class vtkKWEPaintbrushDrawingWriterStream
+{
+public:
+  vtkKWEPaintbrushDrawingWriterStream( ostream &os ) : Stream(os), Offset(0) {}
+
+  void WriteInt( int i )
+    {
+    vtkTypeInt32 v = static_cast< vtkTypeInt32 >(i);
+    vtkByteSwap::Swap4LE(&v);
+    this->WriteBytes(&v, 4);
+    }
+  void WriteUInt64( vtkTypeUInt64 i )
+    {
+    vtkByteSwap::Swap8LE(&i);
+    this->WriteBytes(&i, 8);
+    }
+  void WriteFloat( float f )
+    {
+    vtkByteSwap::Swap4LE(&f);
+    this->WriteBytes(&f, 4);
+    }
+  void WriteDouble( double d )
+    {
+    vtkByteSwap::Swap8LE(&d);
+    this->WriteBytes(&d, 8);
+    }
+  void WriteInts( const vtkstd::vector< vtkTypeInt32 > &v )
+    {
+    if (!v.empty())
+      {
+      vtkstd::vector< vtkTypeInt32 > w(v);
+      vtkByteSwap::Swap4LERange(&w[0], static_cast< int >(w.size()));
+      this->WriteBytes(&w[0], w.size() * 4);
+      }
+    }
+  void WriteBytes( const void *p, size_t n )
+    {
+    this->Stream.write(static_cast< const char * >(p), n);
+    this->Offset += n;
+    }
+
+  ostream       &Stream;
+  vtkTypeUInt64  Offset;
+};
+
+//----------------------------------------------------------------------------
+// The entry of a sketch in the table of the file.
+struct vtkKWEPaintbrushDrawingWriterEntry
+{
+  int           Label;
+  double        Color[3];
+  double        Opacity;
+  int           Visibility;
+  int           Mutable;
+  float         LineWidth;
+  int           Extent[6];
+  int           ScalarType;
+  vtkTypeUInt64 IdentifierOffset;
+  int           IdentifierLength;
+  vtkTypeUInt64 DataOffset;
+  vtkTypeUInt64 DataSize;
+};
+
+//----------------------------------------------------------------------------
+static void vtkKWEPaintbrushDrawingWriterWriteEntry(
+    vtkKWEPaintbrushDrawingWriterStream &s,
+    const vtkKWEPaintbrushDrawingWriterEntry &e )
+{
+  s.WriteInt(e.Label);
+  for (int i = 0; i < 3; i++)
+    {
+    s.WriteDouble(e.Color[i]);
+    }
+  s.WriteDouble(e.Opacity);
+  s.WriteInt(e.Visibility);
+  s.WriteInt(e.Mutable);
+  s.WriteFloat(e.LineWidth);
+  for (int i = 0; i < 6; i++)
+    {
+    s.WriteInt(e.Extent[i]);
+    }
+  s.WriteInt(e.ScalarType);
+  s.WriteUInt64(e.IdentifierOffset);
+  s.WriteInt(e.IdentifierLength);
+  s.WriteUInt64(e.DataOffset);
+  s.WriteUInt64(e.DataSize);
+}
+
+//----------------------------------------------------------------------------
+// Bounds of the runs of the stencil within "extent". Returns 0 if it has
+// none.
+static int vtkKWEPaintbrushDrawingWriterGetStencilBounds(
+    vtkImageStencilData *stencil, int extent[6], int bounds[6] )
+{
+  int found = 0;
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      int r1, r2, iter = 0, moreSubExtents = 1;
+      while (moreSubExtents)
+        {
+        moreSubExtents = stencil->GetNextExtent(
+            r1, r2, extent[0], extent[1], y, z, iter);
+        if (r1 > r2)
+          {
+          continue;
+          }
+        if (!found)
+          {
+          bounds[0] = r1;
+          bounds[1] = r2;
+          bounds[2] = bounds[3] = y;
+          bounds[4] = bounds[5] = z;
+          found = 1;
+          continue;
+          }
+        bounds[0] = (r1 < bounds[0]) ? r1 : bounds[0];
+        bounds[1] = (r2 > bounds[1]) ? r2 : bounds[1];
+        bounds[2] = (y < bounds[2]) ? y : bounds[2];
+        bounds[3] = (y > bounds[3]) ? y : bounds[3];
+        bounds[5] = z;
+        }
+      }
+    }
+  return found;
+}
+
+//----------------------------------------------------------------------------
+// Runs of each row of the stencil, over "extent".
+static void vtkKWEPaintbrushDrawingWriterWriteStencil(
+    vtkKWEPaintbrushDrawingWriterStream &s, vtkImageStencilData *stencil,
+    int extent[6] )
+{
+  vtkstd::vector< vtkTypeInt32 > row;
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      row.resize(1);
+      int r1, r2, iter = 0, moreSubExtents = 1;
+      while (moreSubExtents)
+        {
+        moreSubExtents = stencil->GetNextExtent(
+            r1, r2, extent[0], extent[1], y, z, iter);
+        if (r1 <= r2)
+          {
+          row.push_back(r1);
+          row.push_back(r2);
+          }
+        }
+      row[0] = static_cast< vtkTypeInt32 >(row.size() / 2);
+      s.WriteInts(row);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Runs of labels of each row of the label map, over its extent.
+static void vtkKWEPaintbrushDrawingWriterWriteLabelMap(
+    vtkKWEPaintbrushDrawingWriterStream &s, vtkKWEPaintbrushLabelData *data,
+    int extent[6] )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const LabelType noLabel = vtkKWEPaintbrushLabelData::NoLabelValue;
+  vtkstd::vector< LabelType > buffer(extent[1] - extent[0] + 1);
+  vtkstd::vector< vtkTypeInt32 > row;
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      const LabelType *labels =
+        data->GetLabelRow(extent[0], extent[1], y, z, &buffer[0]);
+      const int nx = extent[1] - extent[0] + 1;
+      row.resize(1);
+      for (int x = 0; x < nx; )
+        {
+        const LabelType label = labels[x];
+        const int x1 = x;
+        while (++x < nx && labels[x] == label)
+          {
+          }
+        if (label != noLabel)
+          {
+          row.push_back(extent[0] + x1);
+          row.push_back(extent[0] + x - 1);
+          row.push_back(static_cast< vtkTypeInt32 >(label));
+          }
+        }
+      row[0] = static_cast< vtkTypeInt32 >(row.size() / 3);
+      s.WriteInts(row);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushDrawingWriter::vtkKWEPaintbrushDrawingWriter()
+{
+  this->FileName = NULL;
+  this->Drawing  = NULL;
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushDrawingWriter::~vtkKWEPaintbrushDrawingWriter()
+{
+  this->SetFileName(NULL);
+  this->SetDrawing(NULL);
+}
+
+//----------------------------------------------------------------------------
+const char *vtkKWEPaintbrushDrawingWriter::GetFileSignature()
+{
+  return "KWEPBDRW";
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushDrawingWriter::Write()
+{
+  if (!this->FileName)
+    {
+    vtkErrorMacro( << "No file name." );
+    return 0;
+    }
+  vtkKWEPaintbrushDrawing *drawing = this->Drawing;
+  if (!drawing || !drawing->GetPaintbrushData() || !drawing->GetImageData())
+    {
+    vtkErrorMacro( << "No drawing, or the drawing was not initialized." );
+    return 0;
+    }
+
+  ofstream os(this->FileName, ios::out | ios::binary);
+  if (!os)
+    {
+    vtkErrorMacro( << "Unable to open " << this->FileName << " for writing." );
+    return 0;
+    }
+
+  const int representation = drawing->GetRepresentation();
+  const int nSketches = drawing->GetNumberOfItems();
+  int extent[6];
+  double spacing[3], origin[3];
+  drawing->GetImageData()->GetWholeExtent(extent);
+  drawing->GetImageData()->GetSpacing(spacing);
+  drawing->GetImageData()->GetOrigin(origin);
+
+  // Header and table. The offsets are filled in once the data is written.
+  vtkKWEPaintbrushDrawingWriterStream s(os);
+  s.WriteBytes(vtkKWEPaintbrushDrawingWriter::GetFileSignature(), 8);
+  s.WriteInt(vtkKWEPaintbrushDrawingWriter::FileVersion);
+  s.WriteInt(representation);
+  s.WriteInt(nSketches);
+  s.WriteInt(vtkKWEPaintbrushEnums::GetLabelType());
+  for (int i = 0; i < 6; i++)
+    {
+    s.WriteInt(extent[i]);
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    s.WriteDouble(spacing[i]);
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    s.WriteDouble(origin[i]);
+    }
+  const vtkTypeUInt64 labelMapPosition = s.Offset;
+  s.WriteUInt64(0);
+  s.WriteUInt64(0);
+
+  const vtkTypeUInt64 tablePosition = s.Offset;
+  vtkstd::vector< vtkKWEPaintbrushDrawingWriterEntry > entries(nSketches);
+  for (int n = 0; n < nSketches; n++)
+    {
+    vtkKWEPaintbrushDrawingWriterWriteEntry(s, entries[n]);
+    }
+
+  // Identifiers and data of the sketches.
+  for (int n = 0; n < nSketches; n++)
+    {
+    vtkKWEPaintbrushSketch *sketch = drawing->GetItem(n);
+    vtkKWEPaintbrushProperty *property = sketch->GetPaintbrushProperty();
+    vtkKWEPaintbrushDrawingWriterEntry &e = entries[n];
+    memset(&e, 0, sizeof(e));
+    e.Label      = static_cast< int >(sketch->GetLabel());
+    property->GetColor(e.Color);
+    e.Opacity    = property->GetOpacity();
+    e.Visibility = property->GetVisibility();
+    e.Mutable    = property->GetMutable();
+    e.LineWidth  = property->GetLineWidth();
+    e.Extent[0] = e.Extent[2] = e.Extent[4] = 0;
+    e.Extent[1] = e.Extent[3] = e.Extent[5] = -1;
+
+    const char *identifier = property->GetIdentifier();
+    if (identifier)
+      {
+      e.IdentifierOffset = s.Offset;
+      e.IdentifierLength = static_cast< int >(strlen(identifier));
+      s.WriteBytes(identifier, e.IdentifierLength);
+      }
+
+    vtkKWEPaintbrushStencilData *stencilData =
+      vtkKWEPaintbrushStencilData::SafeDownCast(sketch->GetPaintbrushData());
+    vtkKWEPaintbrushGrayscaleData *grayscaleData =
+      vtkKWEPaintbrushGrayscaleData::SafeDownCast(sketch->GetPaintbrushData());
+    if (representation == vtkKWEPaintbrushEnums::Binary && stencilData)
+      {
+      // Only the rows within the bounds of the runs.
+      vtkImageStencilData *stencil = stencilData->GetImageStencilData();
+      int stencilExtent[6];
+      stencil->GetExtent(stencilExtent);
+      e.DataOffset = s.Offset;
+      if (vtkKWEPaintbrushDrawingWriterGetStencilBounds(
+                                    stencil, stencilExtent, e.Extent))
+        {
+        vtkKWEPaintbrushDrawingWriterWriteStencil(s, stencil, e.Extent);
+        }
+      e.DataSize = s.Offset - e.DataOffset;
+      }
+    else if (representation == vtkKWEPaintbrushEnums::Grayscale &&
+             grayscaleData)
+      {
+      // Only the painted part of the sketch, unless the voxels outside of
+      // it are painted too.
+      vtkSmartPointer< vtkImageData > image = grayscaleData->GetImageData();
+      if ((grayscaleData->GetBackgroundValue() -
+           grayscaleData->GetOutsideValue())
+            > grayscaleData->GetOutsideValueTolerance())
+        {
+        image = vtkSmartPointer< vtkImageData >::New();
+        grayscaleData->GetPaintbrushDataAsImageData(image);
+        }
+      if (image->GetNumberOfScalarComponents() != 1)
+        {
+        vtkErrorMacro( << "Grayscale sketches must have one component." );
+        return 0;
+        }
+      image->GetExtent(e.Extent);
+      e.ScalarType = image->GetScalarType();
+      e.DataOffset = s.Offset;
+      if (e.Extent[0] <= e.Extent[1] && e.Extent[2] <= e.Extent[3] &&
+          e.Extent[4] <= e.Extent[5])
+        {
+        const int size = image->GetScalarSize();
+        const vtkIdType n = image->GetNumberOfPoints();
+        vtkstd::vector< char > scalars(static_cast< size_t >(n) * size);
+        memcpy(&scalars[0], image->GetScalarPointer(), scalars.size());
+        switch (size)
+          {
+          case 2: vtkByteSwap::Swap2LERange(&scalars[0], n); break;
+          case 4: vtkByteSwap::Swap4LERange(&scalars[0], n); break;
+          case 8: vtkByteSwap::Swap8LERange(&scalars[0], n); break;
+          }
+        s.WriteBytes(&scalars[0], scalars.size());
+        }
+      e.DataSize = s.Offset - e.DataOffset;
+      }
+    }
+
+  // The label map, shared by all the sketches of a label map drawing.
+  vtkTypeUInt64 labelMapOffset = 0, labelMapSize = 0;
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast(drawing->GetPaintbrushData());
+  if (representation == vtkKWEPaintbrushEnums::Label && labelData)
+    {
+    labelMapOffset = s.Offset;
+    vtkKWEPaintbrushDrawingWriterWriteLabelMap(s, labelData, extent);
+    labelMapSize = s.Offset - labelMapOffset;
+    }
+
+  // Back to the offsets.
+  os.seekp(static_cast< long >(labelMapPosition));
+  s.WriteUInt64(labelMapOffset);
+  s.WriteUInt64(labelMapSize);
+  os.seekp(static_cast< long >(tablePosition));
+  for (int n = 0; n < nSketches; n++)
+    {
+    vtkKWEPaintbrushDrawingWriterWriteEntry(s, entries[n]);
+    }
+
+  os.flush();
+  if (os.fail())
+    {
+    vtkErrorMacro( << "Error writing " << this->FileName << "." );
+    return 0;
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushDrawingWriter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "FileName: "
+     << (this->FileName ? this->FileName : "(none)") << "\n";
+  os << indent << "Drawing: " << this->Drawing << "\n";
+}
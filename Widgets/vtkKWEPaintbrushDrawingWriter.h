@@ -0,0 +1,100 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+
+// .NAME vtkKWEPaintbrushDrawingWriter - Write a drawing to a binary file
+// .SECTION Description
+// Writes the sketches of a vtkKWEPaintbrushDrawing, their labels and their
+// properties to a single binary file, which vtkKWEPaintbrushDrawingReader
+// reads back. The file is little endian and made of:
+//
+// \li A header: the signature "KWEPBDRW", the version of the format, the
+// representation of the drawing, its number of sketches, the scalar type of
+// its labels, its extent, spacing and origin, and the offset and size of the
+// label map of a label map drawing.
+// \li A table with an entry per sketch: its label, color, opacity,
+// visibility, mutability and line width, the extent and scalar type of its
+// data, and the offsets and sizes of its identifier and of its data.
+// \li The identifiers and the data of the sketches, and the label map.
+//
+// The data of a binary sketch are the runs of its stencil, row after row
+// of the bounds of the runs: the number of runs of the row, then the first
+// and last x of each. The data of a grayscale sketch are the scalars of the
+// painted part of its image, see vtkKWEPaintbrushGrayscaleData. The
+// label map of a label map drawing is shared by its sketches. It is stored
+// as the runs of labels of each row of the extent of the drawing: the
+// number of runs of the row, then the first and last x and the label of
+// each. Voxels that are not in a run have no label.
+//
+// The stroke history of the sketches is not written.
+// .SECTION See Also
+// vtkKWEPaintbrushDrawingReader
+
+#ifndef __vtkKWEPaintbrushDrawingWriter_h
+#define __vtkKWEPaintbrushDrawingWriter_h
+
+#include "vtkObject.h"
+#include "VTKEdgeConfigure.h" // needed for export symbols directives
+
+class vtkKWEPaintbrushDrawing;
+
+class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushDrawingWriter : public vtkObject
+{
+public:
+  // Description:
+  // Standard VTK methods.
+  static vtkKWEPaintbrushDrawingWriter *New();
+  vtkTypeRevisionMacro(vtkKWEPaintbrushDrawingWriter, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // Set/Get the name of the file to write.
+  vtkSetStringMacro( FileName );
+  vtkGetStringMacro( FileName );
+
+  // Description:
+  // Set/Get the drawing to write.
+  virtual void SetDrawing( vtkKWEPaintbrushDrawing * );
+  vtkGetObjectMacro( Drawing, vtkKWEPaintbrushDrawing );
+
+  // Description:
+  // Write the drawing. Returns 1 on success, 0 on failure.
+  virtual int Write();
+
+  // Description:
+  // The first bytes of the files, and the version of the format written.
+  static const char *GetFileSignature();
+  //BTX
+  enum { FileVersion = 1 };
+  //ETX
+
+protected:
+  vtkKWEPaintbrushDrawingWriter();
+  ~vtkKWEPaintbrushDrawingWriter();
+
+  char                    * FileName;
+  vtkKWEPaintbrushDrawing * Drawing;
+
+private:
+  vtkKWEPaintbrushDrawingWriter(const vtkKWEPaintbrushDrawingWriter&);  // Not implemented.
+  void operator=(const vtkKWEPaintbrushDrawingWriter&);  // Not implemented.
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include "vtkKWEPaintbrushUtilities.h"
 
 #include <math.h>
+#include <vtkstd/limits>
 
 #ifndef max
 #define max(x,y) ((x>y) ? (x) : (y))
@@ -39,7 +40,6 @@
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushGrayscaleData, "$Revision: 1774 $");
 vtkStandardNewMacro(vtkKWEPaintbrushGrayscaleData);
-vtkCxxSetObjectMacro(vtkKWEPaintbrushGrayscaleData, ImageData, vtkImageData);
 
 //----------------------------------------------------------------------------
 vtkKWEPaintbrushGrayscaleData::vtkKWEPaintbrushGrayscaleData()
@@ -52,6 +52,9 @@ vtkKWEPaintbrushGrayscaleData::vtkKWEPaintbrushGrayscaleData()
 
   this->OutsideValue           = 0.0;
   this->OutsideValueTolerance = 0.01;
+  this->BackgroundValue       = 0.0;
+  this->Extent[0] = this->Extent[2] = this->Extent[4] = 0;
+  this->Extent[1] = this->Extent[3] = this->Extent[5] = -1;
 }
 
 //----------------------------------------------------------------------------
@@ -69,6 +72,21 @@ void vtkKWEPaintbrushGrayscaleData::PrintSelf(ostream& os, vtkIndent indent)
     {
     this->ImageData->PrintSelf(os,indent.GetNextIndent());
     }
+  os << indent << "Extent: (" << this->Extent[0] << ", " << this->Extent[1]
+     << ", " << this->Extent[2] << ", " << this->Extent[3] << ", "
+     << this->Extent[4] << ", " << this->Extent[5] << ")\n";
+  os << indent << "BackgroundValue: " << this->BackgroundValue << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushGrayscaleData::SetImageData( vtkImageData *image )
+{
+  vtkSetObjectBodyMacro( ImageData, vtkImageData, image );
+
+  // The extent is now that of the image.
+  this->Extent[0] = this->Extent[2] = this->Extent[4] = 0;
+  this->Extent[1] = this->Extent[3] = this->Extent[5] = -1;
+  this->BackgroundValue = this->OutsideValue;
 }
 
 //----------------------------------------------------------------------------
@@ -80,6 +98,11 @@ void vtkKWEPaintbrushGrayscaleData::ShallowCopy(vtkDataObject *o)
   if (s)
     {
     this->ImageData->ShallowCopy(s->GetImageData());
+    for (int i = 0; i < 6; i++)
+      {
+      this->Extent[i] = s->Extent[i];
+      }
+    this->BackgroundValue = s->BackgroundValue;
     }
 
   vtkDataObject::ShallowCopy(o);
@@ -94,34 +117,62 @@ void vtkKWEPaintbrushGrayscaleData::DeepCopy(vtkDataObject *o)
   if (s)
     {
     this->ImageData->DeepCopy(s->GetImageData());
+    for (int i = 0; i < 6; i++)
+      {
+      this->Extent[i] = s->Extent[i];
+      }
+    this->BackgroundValue = s->BackgroundValue;
     }
 
   vtkDataObject::DeepCopy(o);
 }
 
 //----------------------------------------------------------------------------
-// Returns 0 if nothing was added
-// Implements minkowski add and subtract operators (max and min)
-template< class T1, class T2 >
-int vtkKWEPaintbrushGrayscaleDataAdd( vtkKWEPaintbrushGrayscaleData * self,
-                                        vtkImageData *s, T1, T2 )
+// Minkowski add and subtract (max and min) and replace. Each is applied to
+// the voxels of the brush, those beyond OutsideValueTolerance of the
+// OutsideValue.
+struct vtkKWEPaintbrushGrayscaleDataMax
+{
+  template< class T > static T Apply( T a, T b ) { return max(b, a); }
+};
+struct vtkKWEPaintbrushGrayscaleDataMin
+{
+  template< class T > static T Apply( T a, T b ) { return min(b, a); }
+};
+struct vtkKWEPaintbrushGrayscaleDataReplaceValue
 {
-  const double outsideValue = self->GetOutsideValue();
-  const double outsideValueTolerance = self->GetOutsideValueTolerance();
+  template< class T > static T Apply( T, T b ) { return b; }
+};
 
-  // Not using vtkImageMathematics there cause we want to use self as the
-  // output and do a quick inplace add.
-  int extent[6];
-  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-        self->GetImageData()->GetExtent(), s->GetExtent(), extent))
-    {
-    return 0;
-    }
+//----------------------------------------------------------------------------
+// Arguments of the operators, run on slabs of the intersecting extent of
+// "Output" and "Input".
+struct vtkKWEPaintbrushGrayscaleDataArguments
+{
+  vtkImageData *Output;
+  vtkImageData *Input;
+  int           Extent[6];
+  double        OutsideValue;
+  double        OutsideValueTolerance;
+  double        Threshold;
+};
+
+//----------------------------------------------------------------------------
+// Any types: each voxel of the brush is compared as a double.
+template< class T1, class T2, class TOperator >
+void vtkKWEPaintbrushGrayscaleDataSlab( void *arguments, int z1, int z2 )
+{
+  vtkKWEPaintbrushGrayscaleDataArguments *args =
+    static_cast< vtkKWEPaintbrushGrayscaleDataArguments * >(arguments);
+  const double outsideValue = args->OutsideValue;
+  const double outsideValueTolerance = args->OutsideValueTolerance;
+  int extent[6] = { args->Extent[0], args->Extent[1],
+                    args->Extent[2], args->Extent[3], z1, z2 };
 
-  vtkImageIterator< T1 > it1(self->GetImageData(), extent);
-  vtkImageIterator< T2 > it2(s, extent);
+  vtkImageIterator< T1 > it1(args->Output, extent);
+  vtkImageIterator< T2 > it2(args->Input, extent);
 
-  while( !it2.IsAtEnd() )
+  while( !it1.IsAtEnd() )
     {
     T1 *inSI    = it1.BeginSpan();
     T1 *inSIEnd = it1.EndSpan();
@@ -131,7 +182,7 @@ int vtkKWEPaintbrushGrayscaleDataAdd( vtkKWEPaintbrushGrayscaleData * self,
       if ((static_cast< double >(*inSI2) - outsideValue)
                                   > outsideValueTolerance)
         {
-        *inSI = max(static_cast< T1 >(*inSI2), static_cast< T1 >(*inSI));
+        *inSI = TOperator::Apply(*inSI, static_cast< T1 >(*inSI2));
         }
       ++inSI;
       ++inSI2;
@@ -139,97 +190,129 @@ int vtkKWEPaintbrushGrayscaleDataAdd( vtkKWEPaintbrushGrayscaleData * self,
     it1.NextSpan();
     it2.NextSpan();
     }
-
-  self->GetImageData()->Modified();
-  self->Modified();
-
-  return 1;
 }
 
 //----------------------------------------------------------------------------
-// Returns 0 if nothing was added
-template< class T1, class T2 >
-int vtkKWEPaintbrushGrayscaleDataSubtract(vtkKWEPaintbrushGrayscaleData *self,
-                                          vtkImageData *s, T1, T2 )
+// Same integer type: the voxels of the brush are those at or above an
+// integer threshold. The loop has no branch, so that it vectorizes.
+template< class T, class TOperator >
+void vtkKWEPaintbrushGrayscaleDataThresholdSlab( void *arguments,
+                                                 int z1, int z2 )
 {
-  const double outsideValue = self->GetOutsideValue();
-  const double outsideValueTolerance = self->GetOutsideValueTolerance();
+  vtkKWEPaintbrushGrayscaleDataArguments *args =
+    static_cast< vtkKWEPaintbrushGrayscaleDataArguments * >(arguments);
+  const T threshold = static_cast< T >(args->Threshold);
+  int extent[6] = { args->Extent[0], args->Extent[1],
+                    args->Extent[2], args->Extent[3], z1, z2 };
 
-  // Not using vtkImageMathematics there cause we want to use self as the
-  // output and do a quick inplace add.
-  int extent[6];
-  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-        self->GetImageData()->GetExtent(), s->GetExtent(), extent))
-    {
-    return 0;
-    }
-
-  vtkImageIterator< T1 > it1(self->GetImageData(), extent);
-  vtkImageIterator< T2 > it2(s, extent);
+  vtkImageIterator< T > it1(args->Output, extent);
+  vtkImageIterator< T > it2(args->Input, extent);
 
   while( !it1.IsAtEnd() )
     {
-    T1 *inSI    = it1.BeginSpan();
-    T1 *inSIEnd = it1.EndSpan();
-    T2 *inSI2 = it2.BeginSpan();
-    while (inSI != inSIEnd)
+    T *inSI          = it1.BeginSpan();
+    T *inSIEnd       = it1.EndSpan();
+    const T *inSI2   = it2.BeginSpan();
+    const vtkIdType n = inSIEnd - inSI;
+    for (vtkIdType i = 0; i < n; i++)
       {
-      if ((static_cast< double >(*inSI2) - outsideValue)
-                                  > outsideValueTolerance)
-        {
-        *inSI = min(static_cast< T1 >(*inSI2), static_cast< T1 >(*inSI));
-        }
-      ++inSI;
-      ++inSI2;
+      const T a = inSI[i], b = inSI2[i];
+      inSI[i] = (b >= threshold) ? TOperator::Apply(a, b) : a;
       }
     it1.NextSpan();
     it2.NextSpan();
     }
+}
 
-  self->GetImageData()->Modified();
-  self->Modified();
+//----------------------------------------------------------------------------
+// The smallest value of T that is beyond "tolerance" of "outsideValue", as
+// compared by vtkKWEPaintbrushGrayscaleDataSlab. Returns 0 if there is
+// none, -1 if the values can't be compared this way.
+template< class T >
+int vtkKWEPaintbrushGrayscaleDataGetThreshold( double outsideValue,
+                                    double tolerance, double &threshold )
+{
+  // Larger integers are not all exact as doubles.
+  if (!vtkstd::numeric_limits< T >::is_integer || sizeof(T) > 4 ||
+      !((outsideValue - outsideValue) == 0.0) ||
+      !((tolerance - tolerance) == 0.0))
+    {
+    return -1;
+    }
 
+  const double lo = static_cast< double >((vtkstd::numeric_limits< T >::min)());
+  const double hi = static_cast< double >((vtkstd::numeric_limits< T >::max)());
+  double t = ceil(outsideValue + tolerance);
+  t = (t < lo - 1.0) ? lo - 1.0 : ((t > hi + 1.0) ? hi + 1.0 : t);
+  while (t <= hi && !((t - outsideValue) > tolerance))
+    {
+    ++t;
+    }
+  while (t > lo && ((t - 1.0 - outsideValue) > tolerance))
+    {
+    --t;
+    }
+  if (t > hi)
+    {
+    return 0;
+    }
+  threshold = (t < lo) ? lo : t;
   return 1;
 }
 
 //----------------------------------------------------------------------------
-// Returns 0 if nothing was added
-template< class T1, class T2 >
-int vtkKWEPaintbrushGrayscaleDataReplace(vtkKWEPaintbrushGrayscaleData *self,
-                                          vtkImageData *s, T1, T2 )
+template< class T1, class T2, class TOperator >
+vtkKWEPaintbrushUtilities::SlabFunctionType
+vtkKWEPaintbrushGrayscaleDataGetSlabFunction(
+    vtkKWEPaintbrushGrayscaleDataArguments *, T1 *, T2 *, TOperator * )
 {
-  const double outsideValue = self->GetOutsideValue();
-  const double outsideValueTolerance = self->GetOutsideValueTolerance();
+  return vtkKWEPaintbrushGrayscaleDataSlab< T1, T2, TOperator >;
+}
 
+template< class T, class TOperator >
+vtkKWEPaintbrushUtilities::SlabFunctionType
+vtkKWEPaintbrushGrayscaleDataGetSlabFunction(
+    vtkKWEPaintbrushGrayscaleDataArguments *args, T *, T *, TOperator * )
+{
+  switch (vtkKWEPaintbrushGrayscaleDataGetThreshold< T >(
+      args->OutsideValue, args->OutsideValueTolerance, args->Threshold))
+    {
+    case 0:
+      return NULL;
+    case 1:
+      return vtkKWEPaintbrushGrayscaleDataThresholdSlab< T, TOperator >;
+    }
+  return vtkKWEPaintbrushGrayscaleDataSlab< T, T, TOperator >;
+}
+
+//----------------------------------------------------------------------------
+// Returns 0 if nothing was added
+template< class T1, class T2, class TOperator >
+int vtkKWEPaintbrushGrayscaleDataOperate( vtkKWEPaintbrushGrayscaleData *self,
+                                          vtkImageData *s, T1 *, T2 *,
+                                          TOperator *oper )
+{
   // Not using vtkImageMathematics there cause we want to use self as the
   // output and do a quick inplace add.
-  int extent[6];
+  vtkKWEPaintbrushGrayscaleDataArguments args;
   if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-        self->GetImageData()->GetExtent(), s->GetExtent(), extent))
+        self->GetImageData()->GetExtent(), s->GetExtent(), args.Extent))
     {
     return 0;
     }
-
-  vtkImageIterator< T1 > it1(self->GetImageData(), extent);
-  vtkImageIterator< T2 > it2(s, extent);
-
-  while( !it1.IsAtEnd() )
+  args.Output                = self->GetImageData();
+  args.Input                 = s;
+  args.OutsideValue          = self->GetOutsideValue();
+  args.OutsideValueTolerance = self->GetOutsideValueTolerance();
+  args.Threshold             = 0.0;
+
+  // No function if no voxel is part of the brush.
+  vtkKWEPaintbrushUtilities::SlabFunctionType function =
+    vtkKWEPaintbrushGrayscaleDataGetSlabFunction( &args,
+        static_cast< T1 * >(0), static_cast< T2 * >(0), oper );
+  if (function)
     {
-    T1 *inSI    = it1.BeginSpan();
-    T1 *inSIEnd = it1.EndSpan();
-    T2 *inSI2 = it2.BeginSpan();
-    while (inSI != inSIEnd)
-      {
-      if ((static_cast< double >(*inSI2) - outsideValue)
-                                  > outsideValueTolerance)
-        {
-        *inSI = static_cast< T1 >(*inSI2);
-        }
-      ++inSI;
-      ++inSI2;
-      }
-    it1.NextSpan();
-    it2.NextSpan();
+    vtkKWEPaintbrushUtilities::ExecuteOnSlabs( args.Extent, function, &args );
     }
 
   self->GetImageData()->Modified();
@@ -249,9 +332,9 @@ int vtkKWEPaintbrushGrayscaleDataOper(vtkKWEPaintbrushGrayscaleData *self,
    switch (s->GetScalarType())
      {
      vtkTemplateMacro(
-       ret=vtkKWEPaintbrushGrayscaleDataAdd(self,s,
-                                            static_cast<T1>(0),
-                                            static_cast< VTK_TT >(0) ));
+       ret=vtkKWEPaintbrushGrayscaleDataOperate(self,s,
+             static_cast< T1 * >(0), static_cast< VTK_TT * >(0),
+             static_cast< vtkKWEPaintbrushGrayscaleDataMax * >(0) ));
      }
    }
  else if (oper == 1) // subtract
@@ -259,9 +342,9 @@ int vtkKWEPaintbrushGrayscaleDataOper(vtkKWEPaintbrushGrayscaleData *self,
    switch (s->GetScalarType())
      {
      vtkTemplateMacro(
-       ret=vtkKWEPaintbrushGrayscaleDataSubtract(self,s,
-                                                 static_cast<T1>(0),
-                                                 static_cast< VTK_TT >(0) ));
+       ret=vtkKWEPaintbrushGrayscaleDataOperate(self,s,
+             static_cast< T1 * >(0), static_cast< VTK_TT * >(0),
+             static_cast< vtkKWEPaintbrushGrayscaleDataMin * >(0) ));
      }
    }
  else if (oper == 2) // replace
@@ -269,9 +352,9 @@ int vtkKWEPaintbrushGrayscaleDataOper(vtkKWEPaintbrushGrayscaleData *self,
    switch (s->GetScalarType())
      {
      vtkTemplateMacro(
-       ret=vtkKWEPaintbrushGrayscaleDataReplace(self,s,
-                                                 static_cast<T1>(0),
-                                                 static_cast< VTK_TT >(0) ));
+       ret=vtkKWEPaintbrushGrayscaleDataOperate(self,s,
+             static_cast< T1 * >(0), static_cast< VTK_TT * >(0),
+             static_cast< vtkKWEPaintbrushGrayscaleDataReplaceValue * >(0) ));
      }
    }
 
@@ -283,6 +366,8 @@ int vtkKWEPaintbrushGrayscaleData::Add(vtkImageData *s,
                                        bool vtkNotUsed(forceMutable))
 {
   int ret = 0;
+  const unsigned long mtime = this->GetMTime();
+  this->GrowImageData(s, 0);
   switch(this->ImageData->GetScalarType())
     {
     vtkTemplateMacro( ret = vtkKWEPaintbrushGrayscaleDataOper(this,s,
@@ -293,6 +378,10 @@ int vtkKWEPaintbrushGrayscaleData::Add(vtkImageData *s,
        return 0;
        }
     }
+  if (ret)
+    {
+    this->ExtentModified(s->GetExtent(), mtime);
+    }
   return ret;
 }
 
@@ -301,6 +390,8 @@ int vtkKWEPaintbrushGrayscaleData::Subtract(vtkImageData *s,
                                             bool vtkNotUsed(forceMutable))
 {
   int ret = 0;
+  const unsigned long mtime = this->GetMTime();
+  this->GrowImageData(s, 1);
   switch(this->ImageData->GetScalarType())
     {
     vtkTemplateMacro( ret = vtkKWEPaintbrushGrayscaleDataOper( this, s,
@@ -311,6 +402,10 @@ int vtkKWEPaintbrushGrayscaleData::Subtract(vtkImageData *s,
        return 0;
        }
     }
+  if (ret)
+    {
+    this->ExtentModified(s->GetExtent(), mtime);
+    }
   return ret;
 }
 
@@ -319,6 +414,8 @@ int vtkKWEPaintbrushGrayscaleData::Replace(vtkImageData *s,
                                             bool vtkNotUsed(forceMutable))
 {
   int ret = 0;
+  const unsigned long mtime = this->GetMTime();
+  this->GrowImageData(s, 2);
   switch(this->ImageData->GetScalarType())
     {
     vtkTemplateMacro( ret = vtkKWEPaintbrushGrayscaleDataOper( this, s,
@@ -329,9 +426,39 @@ int vtkKWEPaintbrushGrayscaleData::Replace(vtkImageData *s,
        return 0;
        }
     }
+  if (ret)
+    {
+    this->ExtentModified(s->GetExtent(), mtime);
+    }
   return ret;
 }
 
+//----------------------------------------------------------------------------
+vtkImageData *vtkKWEPaintbrushGrayscaleData::GetBrushImageData(
+                                    vtkKWEPaintbrushGrayscaleData *s, int oper )
+{
+  // The voxels of "s" outside of its image are not part of the brush, unless
+  // they are beyond the tolerance. Even then, they change none of our values
+  // if the operator keeps every value of our scalar type with them, as the
+  // min with 255 of an erase stroke on unsigned chars.
+  vtkImageData *image = s->GetImageData();
+  const double background = s->BackgroundValue;
+  const bool noOp =
+    !((background - this->OutsideValue) > this->OutsideValueTolerance) ||
+    (oper == 0 && background <= this->ImageData->GetScalarTypeMin()) ||
+    (oper == 1 && background >= this->ImageData->GetScalarTypeMax());
+  if (s->Extent[0] <= s->Extent[1] && !noOp)
+    {
+    image = vtkImageData::New();
+    s->GetPaintbrushDataAsImageData(image);
+    image->Register(this);
+    image->Delete();
+    return image;
+    }
+  image->Register(this);
+  return image;
+}
+
 //----------------------------------------------------------------------------
 int vtkKWEPaintbrushGrayscaleData::Add(vtkKWEPaintbrushData *d,
                                        bool forceMutable)
@@ -340,7 +467,10 @@ int vtkKWEPaintbrushGrayscaleData::Add(vtkKWEPaintbrushData *d,
     vtkKWEPaintbrushGrayscaleData::SafeDownCast(d);
   if (s)
     {
-    return this->Add(s->GetImageData(), forceMutable);
+    vtkImageData *image = this->GetBrushImageData(s, 0);
+    const int ret = this->Add(image, forceMutable);
+    image->UnRegister(this);
+    return ret;
     }
   return 0;
 }
@@ -353,7 +483,10 @@ int vtkKWEPaintbrushGrayscaleData::Subtract(vtkKWEPaintbrushData *d,
     vtkKWEPaintbrushGrayscaleData::SafeDownCast(d);
   if (s)
     {
-    return this->Subtract(s->GetImageData(), forceMutable);
+    vtkImageData *image = this->GetBrushImageData(s, 1);
+    const int ret = this->Subtract(image, forceMutable);
+    image->UnRegister(this);
+    return ret;
     }
   return 0;
 }
@@ -366,7 +499,10 @@ int vtkKWEPaintbrushGrayscaleData::Replace(vtkKWEPaintbrushData *d,
     vtkKWEPaintbrushGrayscaleData::SafeDownCast(d);
   if (s)
     {
-    return this->Replace(s->GetImageData(), forceMutable);
+    vtkImageData *image = this->GetBrushImageData(s, 2);
+    const int ret = this->Replace(image, forceMutable);
+    image->UnRegister(this);
+    return ret;
     }
   return 0;
 }
@@ -498,6 +634,18 @@ template< class T > void vtkKWEPaintbrushGrayscaleDataFillBufferOutside(
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushGrayscaleData::Allocate(double fillValue)
 {
+  this->BackgroundValue = fillValue;
+  if (this->Extent[0] <= this->Extent[1] &&
+      this->Extent[2] <= this->Extent[3] &&
+      this->Extent[4] <= this->Extent[5])
+    {
+    // Nothing is painted yet.
+    this->ImageData->SetExtent(0, -1, 0, -1, 0, -1);
+    this->ImageData->AllocateScalars();
+    this->ImageData->Modified();
+    return;
+    }
+
   this->ImageData->AllocateScalars();
 
   switch(this->ImageData->GetScalarType())
@@ -523,13 +671,24 @@ void vtkKWEPaintbrushGrayscaleData::SetOrigin( double s[3] )
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushGrayscaleData::SetExtent( int extent[6] )
 {
-  this->ImageData->SetExtent(extent);
+  for (int i = 0; i < 6; i++)
+    {
+    this->Extent[i] = extent[i];
+    }
 }
 
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushGrayscaleData::GetExtent( int extent[6] )
 {
-  this->ImageData->GetExtent(extent);
+  if (this->Extent[0] > this->Extent[1])
+    {
+    this->ImageData->GetExtent(extent);
+    return;
+    }
+  for (int i = 0; i < 6; i++)
+    {
+    extent[i] = this->Extent[i];
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -539,6 +698,15 @@ int vtkKWEPaintbrushGrayscaleData::Clip( int extent[6] )
   // of saving memory. It will simply set to 0, any values in the image
   // outside the extents.
 
+  // Voxels outside of the image are outside once clipped, unless they have
+  // another value.
+  if (this->Extent[0] <= this->Extent[1] &&
+      (this->BackgroundValue - this->OutsideValue)
+                              > this->OutsideValueTolerance)
+    {
+    this->GrowImageData(this->Extent, false);
+    }
+
   int intersectingExtent[6], currentExtent[6];
   this->ImageData->GetExtent( currentExtent );
 
@@ -596,8 +764,26 @@ int vtkKWEPaintbrushGrayscaleData::IsInside( double p[3] )
       vtkTemplateMacro( vtkKWEPaintbrushGrayscaleDataGetValue(
                       ijk, value, this->ImageData, static_cast<VTK_TT>(0) ));
       }
-    return (fabs(value - this->OutsideValue)
-              < this->OutsideValueTolerance ? 0 : 1);
+    return ((value - this->OutsideValue)
+              > this->OutsideValueTolerance ? 1 : 0);
+    }
+
+  // Voxels of the extent outside of the image have the background value.
+  if (this->Extent[0] <= this->Extent[1])
+    {
+    double origin[3], spacing[3];
+    this->ImageData->GetOrigin(origin);
+    this->ImageData->GetSpacing(spacing);
+    for (int i = 0; i < 3; i++)
+      {
+      const double x = (p[i] - origin[i]) / spacing[i];
+      if (x < this->Extent[2*i] || x > this->Extent[2*i+1])
+        {
+        return 0;
+        }
+      }
+    return ((this->BackgroundValue - this->OutsideValue)
+              > this->OutsideValueTolerance ? 1 : 0);
     }
 
   return 0;
@@ -611,13 +797,6 @@ unsigned long vtkKWEPaintbrushGrayscaleData::GetMTime()
   return (mtime > t ? mtime : t);
 }
 
-//----------------------------------------------------------------------------
-void vtkKWEPaintbrushGrayscaleData::GetPaintbrushDataAsImageData(
-                                        vtkImageData *image)
-{
-  image->ShallowCopy(this->ImageData);
-}
-
 //----------------------------------------------------------------------------
 template< class T > void vtkKWEPaintbrushGrayscaleDataResize(
     vtkImageData *imageResized, vtkImageData *imageOld, int oldExtent[6], T )
@@ -641,6 +820,57 @@ template< class T > void vtkKWEPaintbrushGrayscaleDataResize(
     }
 }
 
+//----------------------------------------------------------------------------
+// Reallocate "image" to "extent", keeping the values of the voxels it
+// already had, and setting the others to "fillValue".
+static void vtkKWEPaintbrushGrayscaleDataReallocate( vtkImageData *image,
+                                        int extent[6], double fillValue )
+{
+  int oldExtent[6], copyExtent[6];
+  image->GetExtent(oldExtent);
+
+  // Shares the scalars, so that the image gets new ones.
+  vtkImageData * oldData = vtkImageData::New();
+  oldData->ShallowCopy(image);
+
+  image->SetExtent(extent);
+  image->AllocateScalars();
+  if (extent[0] <= extent[1] && extent[2] <= extent[3] && extent[4] <= extent[5])
+    {
+    switch (image->GetScalarType())
+      {
+      vtkTemplateMacro( vtkKWEPaintbrushGrayscaleDataFillBufferInside(
+                          image, static_cast< VTK_TT >(fillValue) ));
+      }
+    if (vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                          oldExtent, extent, copyExtent))
+      {
+      switch (image->GetScalarType())
+        {
+        vtkTemplateMacro( vtkKWEPaintbrushGrayscaleDataResize(
+          image, oldData, copyExtent, static_cast< VTK_TT >(0) ));
+        }
+      }
+    }
+
+  oldData->Delete();
+  image->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushGrayscaleData::GetPaintbrushDataAsImageData(
+                                        vtkImageData *image)
+{
+  image->ShallowCopy(this->ImageData);
+
+  // Voxels of the extent outside of the image have the background value.
+  if (this->Extent[0] <= this->Extent[1])
+    {
+    vtkKWEPaintbrushGrayscaleDataReallocate(
+                  image, this->Extent, this->BackgroundValue );
+    }
+}
+
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushGrayscaleData::Resize(int extent[6], double f)
 {
@@ -648,36 +878,222 @@ void vtkKWEPaintbrushGrayscaleData::Resize(int extent[6], double f)
   this->ImageData->GetExtent(oldExtent);
   if (oldExtent[1] < oldExtent[0])
     {
-    // We haven't been allocated yet. Just allocate and return.
+    // We haven't been allocated yet, or nothing was painted. Just allocate
+    // and return.
     this->SetExtent(extent);
     this->Allocate(f);
     return;
     }
 
-  if (oldExtent[0] != extent[0] ||
-      oldExtent[1] != extent[1] ||
-      oldExtent[2] != extent[2] ||
-      oldExtent[3] != extent[3] ||
-      oldExtent[4] != extent[4] ||
-      oldExtent[5] != extent[5])
+  if (this->Extent[0] <= this->Extent[1])
     {
-    vtkImageData * oldData = vtkImageData::New();
-    oldData->DeepCopy(this->ImageData);
+    if (f == this->BackgroundValue)
+      {
+      // The new voxels are background voxels. Only drop the painted voxels
+      // that fall outside of the new extent.
+      this->SetExtent(extent);
+      int clippedExtent[6];
+      if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                            oldExtent, extent, clippedExtent))
+        {
+        clippedExtent[0] = clippedExtent[2] = clippedExtent[4] = 0;
+        clippedExtent[1] = clippedExtent[3] = clippedExtent[5] = -1;
+        }
+      if (!vtkKWEPaintbrushUtilities::ExtentIsEqualToExtent(
+                            clippedExtent, oldExtent))
+        {
+        vtkKWEPaintbrushGrayscaleDataReallocate( this->ImageData,
+                            clippedExtent, this->BackgroundValue );
+        }
+      this->Modified();
+      return;
+      }
 
+    // The background and the new voxels differ, the whole extent is stored.
+    this->GrowImageData(this->Extent, false);
+    this->ImageData->GetExtent(oldExtent);
     this->SetExtent(extent);
-    this->Allocate(f);
+    this->BackgroundValue = f;
+    }
 
-    switch (this->ImageData->GetScalarType())
+  if (!vtkKWEPaintbrushUtilities::ExtentIsEqualToExtent(oldExtent, extent))
+    {
+    vtkKWEPaintbrushGrayscaleDataReallocate( this->ImageData, extent, f );
+    }
+
+  this->ImageData->Modified();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+// Bounding box of the voxels of "image" within "extent" that lie beyond
+// "tolerance" of "outsideValue" and that change "backgroundValue" through
+// the operator. Returns 0 if there is none.
+template< class T, class TOperator >
+int vtkKWEPaintbrushGrayscaleDataGetBounds( vtkImageData *image, T *,
+                              TOperator *, int extent[6], double outsideValue,
+                              double tolerance, double backgroundValue,
+                              int bounds[6] )
+{
+  const int nComponents = image->GetNumberOfScalarComponents();
+  const int rowLength = (extent[1] - extent[0] + 1) * nComponents;
+  int found = 0;
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
       {
-      vtkTemplateMacro( vtkKWEPaintbrushGrayscaleDataResize(
-        this->ImageData, oldData, extent, static_cast<VTK_TT>(0) ));
+      const T *row = static_cast< T * >(
+                        image->GetScalarPointer(extent[0], y, z));
+      int first = -1, last = -1;
+      for (int i = 0; i < rowLength; i++)
+        {
+        const double v = static_cast< double >(row[i]);
+        if ((v - outsideValue) > tolerance &&
+            TOperator::Apply(backgroundValue, v) != backgroundValue)
+          {
+          first = (first < 0) ? i : first;
+          last = i;
+          }
+        }
+      if (first < 0)
+        {
+        continue;
+        }
+
+      const int x1 = extent[0] + first / nComponents;
+      const int x2 = extent[0] + last / nComponents;
+      if (!found)
+        {
+        bounds[0] = x1;
+        bounds[1] = x2;
+        bounds[2] = bounds[3] = y;
+        bounds[4] = bounds[5] = z;
+        found = 1;
+        continue;
+        }
+      bounds[0] = (x1 < bounds[0]) ? x1 : bounds[0];
+      bounds[1] = (x2 > bounds[1]) ? x2 : bounds[1];
+      bounds[3] = y > bounds[3] ? y : bounds[3];
+      bounds[2] = y < bounds[2] ? y : bounds[2];
+      bounds[5] = z;
       }
+    }
+  return found;
+}
 
-    oldData->Delete();
+//----------------------------------------------------------------------------
+template< class TOperator >
+int vtkKWEPaintbrushGrayscaleDataGetBrushBounds( vtkImageData *brush,
+                              TOperator *oper, int extent[6],
+                              double outsideValue, double tolerance,
+                              double backgroundValue, int bounds[6] )
+{
+  switch (brush->GetScalarType())
+    {
+    vtkTemplateMacro( return vtkKWEPaintbrushGrayscaleDataGetBounds(
+        brush, static_cast< VTK_TT * >(0), oper, extent, outsideValue,
+        tolerance, backgroundValue, bounds ));
     }
+  return 0;
+}
 
-  this->ImageData->Modified();
-  this->Modified();
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushGrayscaleData::GrowImageData( vtkImageData *brush,
+                                                   int oper )
+{
+  int extent[6], bounds[6];
+  if (this->Extent[0] > this->Extent[1] ||
+      !vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+            brush->GetExtent(), this->Extent, extent))
+    {
+    return;
+    }
+
+  // Only the voxels that the operator changes need to be stored. The
+  // others keep the background value.
+  int found = 0;
+  if (oper == 0)
+    {
+    found = vtkKWEPaintbrushGrayscaleDataGetBrushBounds( brush,
+        static_cast< vtkKWEPaintbrushGrayscaleDataMax * >(0), extent,
+        this->OutsideValue, this->OutsideValueTolerance,
+        this->BackgroundValue, bounds );
+    }
+  else if (oper == 1)
+    {
+    found = vtkKWEPaintbrushGrayscaleDataGetBrushBounds( brush,
+        static_cast< vtkKWEPaintbrushGrayscaleDataMin * >(0), extent,
+        this->OutsideValue, this->OutsideValueTolerance,
+        this->BackgroundValue, bounds );
+    }
+  else
+    {
+    found = vtkKWEPaintbrushGrayscaleDataGetBrushBounds( brush,
+        static_cast< vtkKWEPaintbrushGrayscaleDataReplaceValue * >(0), extent,
+        this->OutsideValue, this->OutsideValueTolerance,
+        this->BackgroundValue, bounds );
+    }
+
+  if (found)
+    {
+    // A voxel all around, so that the painted voxels are surrounded by
+    // background voxels, as they are in the whole extent.
+    for (int i = 0; i < 3; i++)
+      {
+      --bounds[2*i];
+      ++bounds[2*i+1];
+      }
+    this->GrowImageData(bounds, true);
+    }
 }
 
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushGrayscaleData::GrowImageData( int extent[6],
+                                                   bool geometric )
+{
+  int needed[6], current[6], grown[6];
+  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                            extent, this->Extent, needed))
+    {
+    return;
+    }
+
+  this->ImageData->GetExtent(current);
+  if (current[0] > current[1] || current[2] > current[3] ||
+      current[4] > current[5])
+    {
+    vtkKWEPaintbrushGrayscaleDataReallocate( this->ImageData, needed,
+                                             this->BackgroundValue );
+    return;
+    }
+  if (vtkMath::ExtentIsWithinOtherExtent(needed, current))
+    {
+    return;
+    }
+
+  // Grow by half the current size at least on each side that grows, so
+  // that the image is copied a logarithmic number of times.
+  for (int i = 0; i < 3; i++)
+    {
+    const int size = geometric ? (current[2*i+1] - current[2*i] + 1) / 2 : 0;
+    grown[2*i]   = current[2*i];
+    grown[2*i+1] = current[2*i+1];
+    if (needed[2*i] < current[2*i])
+      {
+      grown[2*i] = (needed[2*i] < current[2*i] - size) ?
+                    needed[2*i] : current[2*i] - size;
+      }
+    if (needed[2*i+1] > current[2*i+1])
+      {
+      grown[2*i+1] = (needed[2*i+1] > current[2*i+1] + size) ?
+                      needed[2*i+1] : current[2*i+1] + size;
+      }
+    grown[2*i]   = (grown[2*i] < this->Extent[2*i]) ?
+                    this->Extent[2*i] : grown[2*i];
+    grown[2*i+1] = (grown[2*i+1] > this->Extent[2*i+1]) ?
+                    this->Extent[2*i+1] : grown[2*i+1];
+    }
 
+  vtkKWEPaintbrushGrayscaleDataReallocate( this->ImageData, grown,
+                                           this->BackgroundValue );
+}
@@ -41,7 +41,10 @@ public:
   // Set/Get the image data externally.. usually the image data is created
   // internally during every stroke.. This method allows you to load an
   // external segmentation and initialize the PaintbrushData with that
-  // segmentation.
+  // segmentation. The extent of the data is then that of the image.
+  // When the data is allocated by Allocate() instead, the image only covers
+  // the part of the extent that was painted, see Allocate(). Voxels of the
+  // extent outside of the image have the BackgroundValue.
   virtual void SetImageData( vtkImageData * );
   vtkGetObjectMacro( ImageData, vtkImageData );
 
@@ -61,9 +64,18 @@ public:
   virtual int Clip( int extent[6] );
 
   // Description:
-  // Allocate the grayscale image. Destroys existing data, if any
+  // Allocate the grayscale image. Destroys existing data, if any. If the
+  // extent was set with SetExtent(), no voxel is allocated: the whole
+  // extent has the value "fillValue", which becomes the BackgroundValue.
+  // The image then grows to cover the voxels painted by Add, Subtract and
+  // Replace, plus a voxel all around, geometrically so that a stroke made
+  // of many small brushes is not copied over and over.
   virtual void Allocate( double fillValue = 0.0 );
 
+  // Description:
+  // Value of the voxels of the extent that lie outside of the image.
+  vtkGetMacro(BackgroundValue, double);
+
   // Description:
   // Resize. Unlike allocate, this will allocate to conform to the new
   // extents, while preserving existing data. If you are calling
@@ -106,10 +118,35 @@ protected:
   vtkKWEPaintbrushGrayscaleData();
   ~vtkKWEPaintbrushGrayscaleData();
 
+  // Description:
+  // Grow the image to cover the voxels of "brush" within the extent that
+  // are beyond OutsideValueTolerance of the OutsideValue and that change
+  // the BackgroundValue through the operator "oper": 0 to add (max), 1 to
+  // subtract (min), 2 to replace.
+  void GrowImageData( vtkImageData *brush, int oper );
+
+  // Description:
+  // Grow the image to cover "extent", clipped to the Extent.
+  void GrowImageData( int extent[6], bool geometric );
+
+  // Description:
+  // The image of "s" to operate with through "oper". That is the whole
+  // extent of "s" if its BackgroundValue is beyond the tolerance and may
+  // change our values through the operator, its ImageData otherwise.
+  // The caller must UnRegister it.
+  vtkImageData *GetBrushImageData( vtkKWEPaintbrushGrayscaleData *s,
+                                   int oper );
+
   // Description:
   // Stores the bulk data
   vtkImageData *ImageData;
 
+  // Description:
+  // Extent of the data, set by SetExtent(). Empty if the extent is that of
+  // the ImageData.
+  int Extent[6];
+  double BackgroundValue;
+
   double OutsideValue;
   double OutsideValueTolerance;
 
@@ -0,0 +1,647 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+#include "vtkKWEPaintbrushLabelBricks.h"
+
+#include "vtkImageData.h"
+#include "vtkObjectFactory.h"
+
+#include <string.h>
+
+vtkCxxRevisionMacro(vtkKWEPaintbrushLabelBricks, "$Revision: 1 $");
+vtkStandardNewMacro(vtkKWEPaintbrushLabelBricks);
+
+//----------------------------------------------------------------------------
+// Number of voxels of brick "index", ie. its dimensions clipped to the extent
+static vtkIdType vtkKWEPaintbrushLabelBricksGetBrickSize(
+    const int extent[6], const int numberOfBricks[3], vtkIdType index )
+{
+  const int b[3] = {
+    static_cast< int >(index % numberOfBricks[0]),
+    static_cast< int >((index / numberOfBricks[0]) % numberOfBricks[1]),
+    static_cast< int >(index / (numberOfBricks[0] * numberOfBricks[1])) };
+  vtkIdType size = 1;
+  for (int i = 0; i < 3; i++)
+    {
+    const int first = extent[2*i] + (b[i] << vtkKWEPaintbrushLabelBricks::BrickShift);
+    int last = first + vtkKWEPaintbrushLabelBricks::BrickSize - 1;
+    last = (last > extent[2*i+1]) ? extent[2*i+1] : last;
+    size *= (last - first + 1);
+    }
+  return size;
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelBricks::vtkKWEPaintbrushLabelBricks()
+{
+  for (int i = 0; i < 3; i++)
+    {
+    this->Extent[2*i]       = 0;
+    this->Extent[2*i+1]     = -1;
+    this->NumberOfBricks[i] = 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelBricks::~vtkKWEPaintbrushLabelBricks()
+{
+  this->Initialize();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::Initialize()
+{
+  for (vtkstd::vector< vtkKWEPaintbrushLabelBrick >::iterator it
+        = this->Bricks.begin(); it != this->Bricks.end(); ++it)
+    {
+    delete [] it->Labels;
+    }
+  vtkstd::vector< vtkKWEPaintbrushLabelBrick >().swap(this->Bricks);
+
+  for (int i = 0; i < 3; i++)
+    {
+    this->Extent[2*i]       = 0;
+    this->Extent[2*i+1]     = -1;
+    this->NumberOfBricks[i] = 0;
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::Allocate( int extent[6], LabelType label )
+{
+  this->Initialize();
+  if (extent[1] < extent[0] || extent[3] < extent[2] || extent[5] < extent[4])
+    {
+    return;
+    }
+
+  for (int i = 0; i < 3; i++)
+    {
+    this->Extent[2*i]       = extent[2*i];
+    this->Extent[2*i+1]     = extent[2*i+1];
+    this->NumberOfBricks[i] =
+      ((extent[2*i+1] - extent[2*i]) >> BrickShift) + 1;
+    }
+
+  vtkKWEPaintbrushLabelBrick brick;
+  brick.Labels = NULL;
+  brick.Label  = label;
+  this->Bricks.resize( static_cast< vtkstd::vector<
+      vtkKWEPaintbrushLabelBrick >::size_type >(this->NumberOfBricks[0]) *
+      this->NumberOfBricks[1] * this->NumberOfBricks[2], brick );
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::GetExtent( int extent[6] )
+{
+  for (int i = 0; i < 6; i++)
+    {
+    extent[i] = this->Extent[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::DeepCopy( vtkKWEPaintbrushLabelBricks *b )
+{
+  if (b == this)
+    {
+    return;
+    }
+
+  this->Initialize();
+  if (!b || !b->IsAllocated())
+    {
+    return;
+    }
+
+  for (int i = 0; i < 3; i++)
+    {
+    this->Extent[2*i]       = b->Extent[2*i];
+    this->Extent[2*i+1]     = b->Extent[2*i+1];
+    this->NumberOfBricks[i] = b->NumberOfBricks[i];
+    }
+
+  this->Bricks = b->Bricks;
+  for (vtkIdType i = 0; i < this->GetNumberOfBricks(); i++)
+    {
+    if (b->Bricks[i].Labels)
+      {
+      const vtkIdType size = vtkKWEPaintbrushLabelBricksGetBrickSize(
+                          this->Extent, this->NumberOfBricks, i );
+      this->Bricks[i].Labels = new LabelType[size];
+      memcpy( this->Bricks[i].Labels, b->Bricks[i].Labels,
+              size * sizeof(LabelType) );
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelBricks::vtkKWEPaintbrushLabelBrick &
+vtkKWEPaintbrushLabelBricks::GetBrick( int x, int y, int z )
+{
+  return this->Bricks[
+    (static_cast< vtkIdType >((z - this->Extent[4]) >> BrickShift) *
+       this->NumberOfBricks[1] + ((y - this->Extent[2]) >> BrickShift)) *
+       this->NumberOfBricks[0] + ((x - this->Extent[0]) >> BrickShift) ];
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::GetBrickExtent( int x, int y, int z,
+                                                  int brickExtent[6] )
+{
+  const int p[3] = { x, y, z };
+  for (int i = 0; i < 3; i++)
+    {
+    brickExtent[2*i] = this->Extent[2*i] +
+      (((p[i] - this->Extent[2*i]) >> BrickShift) << BrickShift);
+    brickExtent[2*i+1] = brickExtent[2*i] + BrickSize - 1;
+    if (brickExtent[2*i+1] > this->Extent[2*i+1])
+      {
+      brickExtent[2*i+1] = this->Extent[2*i+1];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::AllocateBrick(
+        vtkKWEPaintbrushLabelBrick &brick, int e[6] )
+{
+  const vtkIdType size = static_cast< vtkIdType >(e[1] - e[0] + 1) *
+                         (e[3] - e[2] + 1) * (e[5] - e[4] + 1);
+  brick.Labels = new LabelType[size];
+  LabelType *ptr = brick.Labels, *ptrEnd = brick.Labels + size;
+  while (ptr != ptrEnd)
+    {
+    *ptr++ = brick.Label;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelBricks::LabelType
+vtkKWEPaintbrushLabelBricks::GetLabel( int x, int y, int z )
+{
+  int x2;
+  LabelType label;
+  if (LabelType *ptr = this->GetBrickRow( x, y, z, x2, label ))
+    {
+    return *ptr;
+    }
+  return label;
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelBricks::LabelType *
+vtkKWEPaintbrushLabelBricks::GetBrickRow( int x, int y, int z,
+                                          int &x2, LabelType &label )
+{
+  int e[6];
+  this->GetBrickExtent( x, y, z, e );
+  x2 = e[1];
+
+  vtkKWEPaintbrushLabelBrick &brick = this->GetBrick( x, y, z );
+  if (!brick.Labels)
+    {
+    label = brick.Label;
+    return NULL;
+    }
+  return brick.Labels + (static_cast< vtkIdType >(z - e[4]) *
+           (e[3] - e[2] + 1) + (y - e[2])) * (e[1] - e[0] + 1) + (x - e[0]);
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelBricks::LabelType *
+vtkKWEPaintbrushLabelBricks::AllocateBrickRow( int x, int y, int z )
+{
+  int e[6];
+  this->GetBrickExtent( x, y, z, e );
+
+  vtkKWEPaintbrushLabelBrick &brick = this->GetBrick( x, y, z );
+  if (!brick.Labels)
+    {
+    this->AllocateBrick( brick, e );
+    }
+  return brick.Labels + (static_cast< vtkIdType >(z - e[4]) *
+           (e[3] - e[2] + 1) + (y - e[2])) * (e[1] - e[0] + 1) + (x - e[0]);
+}
+
+//----------------------------------------------------------------------------
+const vtkKWEPaintbrushLabelBricks::LabelType *
+vtkKWEPaintbrushLabelBricks::GetRow( int x1, int x2, int y, int z,
+                                     LabelType *buffer )
+{
+  int last;
+  LabelType label;
+  LabelType *ptr = this->GetBrickRow( x1, y, z, last, label );
+  if (ptr && last >= x2)
+    {
+    // The row lies within an allocated brick.
+    return ptr;
+    }
+
+  LabelType *out = buffer;
+  for (int x = x1; x <= x2; x = last + 1)
+    {
+    ptr = this->GetBrickRow( x, y, z, last, label );
+    last = (last > x2) ? x2 : last;
+    const int n = last - x + 1;
+    if (ptr)
+      {
+      memcpy( out, ptr, n * sizeof(LabelType) );
+      out += n;
+      }
+    else
+      {
+      for (int i = 0; i < n; i++)
+        {
+        *out++ = label;
+        }
+      }
+    }
+  return buffer;
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::FillExtent( int extent[6], LabelType label )
+{
+  int e[6];
+  for (int i = 0; i < 3; i++)
+    {
+    e[2*i]   = (extent[2*i] < this->Extent[2*i])
+                  ? this->Extent[2*i] : extent[2*i];
+    e[2*i+1] = (extent[2*i+1] > this->Extent[2*i+1])
+                  ? this->Extent[2*i+1] : extent[2*i+1];
+    if (e[2*i] > e[2*i+1])
+      {
+      return;
+      }
+    }
+
+  int be[6];
+  for (int bz = e[4]; bz <= e[5]; bz = be[5] + 1)
+    {
+    for (int by = e[2]; by <= e[3]; by = be[3] + 1)
+      {
+      for (int bx = e[0]; bx <= e[1]; bx = be[1] + 1)
+        {
+        this->GetBrickExtent( bx, by, bz, be );
+        vtkKWEPaintbrushLabelBrick &brick = this->GetBrick( bx, by, bz );
+
+        // The part of the brick within the extent
+        const int x1 = (be[0] < e[0]) ? e[0] : be[0];
+        const int x2 = (be[1] > e[1]) ? e[1] : be[1];
+        const int y1 = (be[2] < e[2]) ? e[2] : be[2];
+        const int y2 = (be[3] > e[3]) ? e[3] : be[3];
+        const int z1 = (be[4] < e[4]) ? e[4] : be[4];
+        const int z2 = (be[5] > e[5]) ? e[5] : be[5];
+
+        if (x1 == be[0] && x2 == be[1] && y1 == be[2] &&
+            y2 == be[3] && z1 == be[4] && z2 == be[5])
+          {
+          // The whole brick is filled.
+          delete [] brick.Labels;
+          brick.Labels = NULL;
+          brick.Label  = label;
+          continue;
+          }
+
+        if (!brick.Labels)
+          {
+          if (brick.Label == label)
+            {
+            continue;
+            }
+          this->AllocateBrick( brick, be );
+          }
+
+        const int dx = be[1] - be[0] + 1, dy = be[3] - be[2] + 1;
+        for (int z = z1; z <= z2; z++)
+          {
+          for (int y = y1; y <= y2; y++)
+            {
+            LabelType *ptr = brick.Labels +
+              (static_cast< vtkIdType >(z - be[4]) * dy + (y - be[2])) * dx;
+            for (int x = x1; x <= x2; x++)
+              {
+              ptr[x - be[0]] = label;
+              }
+            }
+          }
+        }
+      }
+    }
+
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::FillVoxels( vtkIdType offset,
+                                vtkIdType length, LabelType label )
+{
+  const vtkIdType dx = this->Extent[1] - this->Extent[0] + 1;
+  const vtkIdType dy = this->Extent[3] - this->Extent[2] + 1;
+
+  while (length > 0)
+    {
+    // Fill up to the end of the row.
+    const int x = static_cast< int >(offset % dx) + this->Extent[0];
+    const int y = static_cast< int >((offset / dx) % dy) + this->Extent[2];
+    const int z = static_cast< int >(offset / (dx * dy)) + this->Extent[4];
+    vtkIdType n = dx - (x - this->Extent[0]);
+    n = (n > length) ? length : n;
+    const int xEnd = x + static_cast< int >(n) - 1;
+
+    int last;
+    for (int x1 = x; x1 <= xEnd; x1 = last + 1)
+      {
+      LabelType brickLabel;
+      LabelType *ptr = this->GetBrickRow( x1, y, z, last, brickLabel );
+      last = (last > xEnd) ? xEnd : last;
+      if (!ptr)
+        {
+        if (brickLabel == label)
+          {
+          continue;
+          }
+        ptr = this->AllocateBrickRow( x1, y, z );
+        }
+      for (int i = x1; i <= last; i++)
+        {
+        *ptr++ = label;
+        }
+      }
+
+    offset += n;
+    length -= n;
+    }
+
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::Squeeze( int extent[6] )
+{
+  int e[6];
+  for (int i = 0; i < 3; i++)
+    {
+    e[2*i]   = (extent[2*i] < this->Extent[2*i])
+                  ? this->Extent[2*i] : extent[2*i];
+    e[2*i+1] = (extent[2*i+1] > this->Extent[2*i+1])
+                  ? this->Extent[2*i+1] : extent[2*i+1];
+    if (e[2*i] > e[2*i+1])
+      {
+      return;
+      }
+    }
+
+  int be[6];
+  for (int bz = e[4]; bz <= e[5]; bz = be[5] + 1)
+    {
+    for (int by = e[2]; by <= e[3]; by = be[3] + 1)
+      {
+      for (int bx = e[0]; bx <= e[1]; bx = be[1] + 1)
+        {
+        this->GetBrickExtent( bx, by, bz, be );
+        vtkKWEPaintbrushLabelBrick &brick = this->GetBrick( bx, by, bz );
+        if (!brick.Labels)
+          {
+          continue;
+          }
+
+        const vtkIdType size = static_cast< vtkIdType >(be[1] - be[0] + 1) *
+                               (be[3] - be[2] + 1) * (be[5] - be[4] + 1);
+        const LabelType label = brick.Labels[0];
+        const LabelType *ptr = brick.Labels, *ptrEnd = brick.Labels + size;
+        while (ptr != ptrEnd && *ptr == label)
+          {
+          ++ptr;
+          }
+        if (ptr == ptrEnd)
+          {
+          delete [] brick.Labels;
+          brick.Labels = NULL;
+          brick.Label  = label;
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::ReplaceLabel( LabelType from, LabelType to )
+{
+  for (vtkIdType i = 0; i < this->GetNumberOfBricks(); i++)
+    {
+    vtkKWEPaintbrushLabelBrick &brick = this->Bricks[i];
+    if (!brick.Labels)
+      {
+      brick.Label = (brick.Label == from) ? to : brick.Label;
+      continue;
+      }
+
+    LabelType *ptr = brick.Labels, *ptrEnd = brick.Labels +
+      vtkKWEPaintbrushLabelBricksGetBrickSize(
+          this->Extent, this->NumberOfBricks, i );
+    for (; ptr != ptrEnd; ++ptr)
+      {
+      if (*ptr == from)
+        {
+        *ptr = to;
+        }
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::Relabel(
+                const vtkstd::vector< LabelType > &lut )
+{
+  for (vtkIdType i = 0; i < this->GetNumberOfBricks(); i++)
+    {
+    vtkKWEPaintbrushLabelBrick &brick = this->Bricks[i];
+    if (!brick.Labels)
+      {
+      brick.Label = lut[vtkKWEPaintbrushLabelBricks::GetLabelIndex(brick.Label)];
+      continue;
+      }
+
+    LabelType *ptr = brick.Labels, *ptrEnd = brick.Labels +
+      vtkKWEPaintbrushLabelBricksGetBrickSize(
+          this->Extent, this->NumberOfBricks, i );
+    for (; ptr != ptrEnd; ++ptr)
+      {
+      *ptr = lut[vtkKWEPaintbrushLabelBricks::GetLabelIndex(*ptr)];
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::GetLabels( vtkstd::set< LabelType > &labels )
+{
+  for (vtkIdType i = 0; i < this->GetNumberOfBricks(); i++)
+    {
+    vtkKWEPaintbrushLabelBrick &brick = this->Bricks[i];
+    if (!brick.Labels)
+      {
+      labels.insert(brick.Label);
+      continue;
+      }
+
+    // Labels are mostly in runs, only insert when the label changes.
+    const LabelType *ptr = brick.Labels, *ptrEnd = brick.Labels +
+      vtkKWEPaintbrushLabelBricksGetBrickSize(
+          this->Extent, this->NumberOfBricks, i );
+    LabelType lastLabel = *ptr;
+    labels.insert(lastLabel);
+    for (; ptr != ptrEnd; ++ptr)
+      {
+      if (*ptr != lastLabel)
+        {
+        lastLabel = *ptr;
+        labels.insert(lastLabel);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::CopyFromImage( vtkImageData *image )
+{
+  int be[6];
+  for (int bz = this->Extent[4]; bz <= this->Extent[5]; bz = be[5] + 1)
+    {
+    for (int by = this->Extent[2]; by <= this->Extent[3]; by = be[3] + 1)
+      {
+      for (int bx = this->Extent[0]; bx <= this->Extent[1]; bx = be[1] + 1)
+        {
+        this->GetBrickExtent( bx, by, bz, be );
+        vtkKWEPaintbrushLabelBrick &brick = this->GetBrick( bx, by, bz );
+        const int dx = be[1] - be[0] + 1;
+
+        // Is the brick uniform ?
+        const LabelType label = *static_cast< LabelType * >(
+                        image->GetScalarPointer(be[0], be[2], be[4]));
+        bool uniform = true;
+        for (int z = be[4]; z <= be[5] && uniform; z++)
+          {
+          for (int y = be[2]; y <= be[3] && uniform; y++)
+            {
+            const LabelType *ptr = static_cast< LabelType * >(
+                                  image->GetScalarPointer(be[0], y, z));
+            for (int x = 0; x < dx; x++)
+              {
+              if (ptr[x] != label)
+                {
+                uniform = false;
+                break;
+                }
+              }
+            }
+          }
+
+        delete [] brick.Labels;
+        brick.Labels = NULL;
+        brick.Label  = label;
+        if (uniform)
+          {
+          continue;
+          }
+
+        this->AllocateBrick( brick, be );
+        LabelType *out = brick.Labels;
+        for (int z = be[4]; z <= be[5]; z++)
+          {
+          for (int y = be[2]; y <= be[3]; y++, out += dx)
+            {
+            memcpy( out, image->GetScalarPointer(be[0], y, z),
+                    dx * sizeof(LabelType) );
+            }
+          }
+        }
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::CopyToImage( vtkImageData *image )
+{
+  const int dx = this->Extent[1] - this->Extent[0] + 1;
+  for (int z = this->Extent[4]; z <= this->Extent[5]; z++)
+    {
+    for (int y = this->Extent[2]; y <= this->Extent[3]; y++)
+      {
+      LabelType *row = static_cast< LabelType * >(
+                image->GetScalarPointer(this->Extent[0], y, z));
+      const LabelType *labels = this->GetRow(
+                this->Extent[0], this->Extent[1], y, z, row );
+      if (labels != row)
+        {
+        memcpy( row, labels, dx * sizeof(LabelType) );
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkKWEPaintbrushLabelBricks::GetNumberOfAllocatedBricks()
+{
+  vtkIdType n = 0;
+  for (vtkstd::vector< vtkKWEPaintbrushLabelBrick >::const_iterator it
+        = this->Bricks.begin(); it != this->Bricks.end(); ++it)
+    {
+    n += (it->Labels ? 1 : 0);
+    }
+  return n;
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkKWEPaintbrushLabelBricks::GetActualMemorySize()
+{
+  double size = static_cast< double >(
+      this->Bricks.capacity() * sizeof(vtkKWEPaintbrushLabelBrick));
+  for (vtkIdType i = 0; i < this->GetNumberOfBricks(); i++)
+    {
+    if (this->Bricks[i].Labels)
+      {
+      size += static_cast< double >(sizeof(LabelType)) *
+        vtkKWEPaintbrushLabelBricksGetBrickSize(
+            this->Extent, this->NumberOfBricks, i );
+      }
+    }
+  return static_cast< unsigned long >(size / 1024.0);
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelBricks::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Extent: ("
+     << this->Extent[0] << ", " << this->Extent[1] << ", "
+     << this->Extent[2] << ", " << this->Extent[3] << ", "
+     << this->Extent[4] << ", " << this->Extent[5] << ")" << endl;
+  os << indent << "NumberOfBricks: " << this->GetNumberOfBricks() << endl;
+  os << indent << "NumberOfAllocatedBricks: "
+     << this->GetNumberOfAllocatedBricks() << endl;
+}
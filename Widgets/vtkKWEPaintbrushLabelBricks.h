@@ -0,0 +1,190 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// .NAME vtkKWEPaintbrushLabelBricks - Sparse storage of a label map
+// .SECTION Description
+// vtkKWEPaintbrushLabelBricks stores a label map in bricks of 32x32x32
+// voxels. A brick whose voxels all have the same label is stored as that
+// label alone, its voxels are only allocated once they differ. Segmentations
+// usually cover a small part of the volume, so most bricks hold nothing but
+// the NoLabelValue and cost a few bytes.
+//
+// The bricks are used by vtkKWEPaintbrushLabelData in its Sparse storage
+// mode. Voxels are addressed by their structured coordinates, within the
+// extent of the label map. Voxels of different bricks may be written from
+// different threads.
+// .SECTION See Also
+// vtkKWEPaintbrushLabelData
+
+#ifndef __vtkKWEPaintbrushLabelBricks_h
+#define __vtkKWEPaintbrushLabelBricks_h
+
+#include "VTKEdgeConfigure.h" // needed for export symbols directives
+#include "vtkKWEPaintbrushEnums.h"
+#include "vtkObject.h"
+#include <vtkstd/set> // for GetLabels
+#include <vtkstd/vector> // for the bricks
+#include <limits> // for GetLabelIndex
+
+class vtkImageData;
+
+class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushLabelBricks : public vtkObject
+{
+public:
+  static vtkKWEPaintbrushLabelBricks *New();
+  vtkTypeRevisionMacro(vtkKWEPaintbrushLabelBricks, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  //BTX
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+
+  // Bricks have 1 << BrickShift voxels along each axis.
+  enum { BrickShift = 5, BrickSize = 32 };
+  //ETX
+
+  // Description:
+  // Cover the supplied extent with bricks, all of the supplied label. Any
+  // previous contents are discarded.
+  void Allocate( int extent[6], LabelType label );
+
+  // Description:
+  // Release all the bricks.
+  void Initialize();
+
+  // Description:
+  // Are there any bricks ?
+  int IsAllocated() { return this->Bricks.empty() ? 0 : 1; }
+
+  // Description:
+  // Extent covered by the bricks.
+  void GetExtent( int extent[6] );
+
+  // Description:
+  // Copy the bricks of another instance.
+  void DeepCopy( vtkKWEPaintbrushLabelBricks * );
+
+  // Description:
+  // Label of a voxel.
+  LabelType GetLabel( int x, int y, int z );
+
+  // Description:
+  // Labels of the voxels x1 to x2 of a row. The returned pointer is either
+  // into a brick, if the row lies within an allocated brick, or to
+  // "buffer", which must have room for x2 - x1 + 1 labels.
+  const LabelType *GetRow( int x1, int x2, int y, int z, LabelType *buffer );
+
+  // Description:
+  // Voxels of a row within the brick containing voxel (x, y, z). Returns a
+  // pointer to the voxel in the brick, or NULL if the brick is uniform, in
+  // which case its label is returned in "label". "x2" is set to the last
+  // voxel of the row in that brick.
+  LabelType *GetBrickRow( int x, int y, int z, int &x2, LabelType &label );
+
+  // Description:
+  // Same as above, but allocate the brick if it is uniform. The voxels of
+  // the brick are initialized with its label.
+  LabelType *AllocateBrickRow( int x, int y, int z );
+
+  // Description:
+  // Set the label of all the voxels in an extent. Bricks entirely within
+  // the extent become uniform.
+  void FillExtent( int extent[6], LabelType label );
+
+  // Description:
+  // Set the label of "length" voxels, starting at "offset" voxels from the
+  // first one of the extent, in the order in which voxels are stored in a
+  // vtkImageData.
+  void FillVoxels( vtkIdType offset, vtkIdType length, LabelType label );
+
+  // Description:
+  // Bricks within the supplied extent whose voxels all have the same label
+  // are collapsed to that label.
+  void Squeeze( int extent[6] );
+
+  // Description:
+  // Replace every occurrence of label "from" with label "to".
+  void ReplaceLabel( LabelType from, LabelType to );
+
+  //BTX
+  // Description:
+  // Index of label l in a table covering every value of LabelType, which
+  // may be signed.
+  static vtkIdType GetLabelIndex( LabelType l )
+    {
+    return static_cast< vtkIdType >(l) - static_cast< vtkIdType >(
+      std::numeric_limits< LabelType >::min());
+    }
+
+  // Description:
+  // Replace every label l by lut[GetLabelIndex(l)]. "lut" must cover every
+  // value of LabelType.
+  void Relabel( const vtkstd::vector< LabelType > &lut );
+
+  // Description:
+  // Insert the labels present in the bricks in "labels".
+  void GetLabels( vtkstd::set< LabelType > &labels );
+  //ETX
+
+  // Description:
+  // Copy the voxels from or to an image of the same extent, and of the
+  // label type.
+  void CopyFromImage( vtkImageData * );
+  void CopyToImage( vtkImageData * );
+
+  // Description:
+  // Number of bricks, number of bricks whose voxels are allocated, and
+  // memory used in kilobytes.
+  vtkIdType GetNumberOfBricks()
+    { return static_cast< vtkIdType >(this->Bricks.size()); }
+  vtkIdType GetNumberOfAllocatedBricks();
+  unsigned long GetActualMemorySize();
+
+protected:
+  vtkKWEPaintbrushLabelBricks();
+  ~vtkKWEPaintbrushLabelBricks();
+
+  //BTX
+  struct vtkKWEPaintbrushLabelBrick
+    {
+    LabelType *Labels; // NULL if the brick is uniform
+    LabelType  Label;  // label of the voxels of a uniform brick
+    };
+  vtkstd::vector< vtkKWEPaintbrushLabelBrick > Bricks;
+  //ETX
+
+  int Extent[6];
+  int NumberOfBricks[3];
+
+  // Description:
+  // Brick containing voxel (x, y, z), and the extent of that brick, clipped
+  // to our extent.
+  vtkKWEPaintbrushLabelBrick &GetBrick( int x, int y, int z );
+  void GetBrickExtent( int x, int y, int z, int brickExtent[6] );
+
+  // Description:
+  // Allocate the voxels of a uniform brick.
+  void AllocateBrick( vtkKWEPaintbrushLabelBrick &, int brickExtent[6] );
+
+private:
+  vtkKWEPaintbrushLabelBricks(const vtkKWEPaintbrushLabelBricks&);  //Not implemented
+  void operator=(const vtkKWEPaintbrushLabelBricks&);  //Not implemented
+};
+
+#endif
@@ -20,6 +20,8 @@
 //=============================================================================
 #include "vtkKWEPaintbrushLabelData.h"
 
+#include "vtkKWEPaintbrushLabelDelta.h"
+#include "vtkKWEPaintbrushLabelBricks.h"
 #include "vtkKWEPaintbrushUtilities.h"
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkKWEPaintbrushEnums.h"
@@ -35,7 +37,11 @@
 #include "vtkImageCast.h"
 
 #include <math.h>
+#include <string.h>
 #include <limits>
+#include <vtkstd/algorithm>
+#include <vtkstd/map>
+#include <vtkstd/vector>
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushLabelData, "$Revision: 3550 $");
 vtkStandardNewMacro(vtkKWEPaintbrushLabelData);
@@ -43,11 +49,27 @@ vtkStandardNewMacro(vtkKWEPaintbrushLabelData);
 //----------------------------------------------------------------------------
 vtkKWEPaintbrushEnums::LabelType vtkKWEPaintbrushLabelData::NoLabelValue = 0;
 
+//----------------------------------------------------------------------------
+// Index of a label in the label counts. The label type may be signed.
+static inline vtkIdType vtkKWEPaintbrushLabelDataCountIndex(
+                          vtkKWEPaintbrushEnums::LabelType l )
+{
+  return vtkKWEPaintbrushLabelBricks::GetLabelIndex(l);
+}
+
 //----------------------------------------------------------------------------
 vtkKWEPaintbrushLabelData::vtkKWEPaintbrushLabelData()
 {
   this->LabelMap = vtkImageData::New();
   this->LabelMap->SetScalarType( vtkKWEPaintbrushEnums::GetLabelType() );
+  this->Bricks = vtkKWEPaintbrushLabelBricks::New();
+  this->StorageMode = vtkKWEPaintbrushLabelData::Dense;
+  this->DeltaRecorder = NULL;
+  this->RecordedLabelMapMTime = 0;
+  this->LabelCountsMTime = 0;
+  this->CheckLabelCounts = 0;
+  this->Threader = vtkMultiThreader::New();
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
 
   this->Information->Set( vtkDataObject::DATA_EXTENT_TYPE(), VTK_3D_EXTENT );
   this->Information->Set( vtkDataObject::DATA_EXTENT(),
@@ -62,12 +84,16 @@ vtkKWEPaintbrushLabelData::~vtkKWEPaintbrushLabelData()
     this->LabelMap->Delete();
     this->LabelMap = NULL;
     }
+  this->Bricks->Delete();
+  this->Threader->Delete();
 }
 
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushLabelData::Initialize()
 {
   this->LabelMap->Initialize();
+  this->Bricks->Initialize();
+  this->UnrecordedModificationTime.Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -132,7 +158,10 @@ void vtkKWEPaintbrushLabelData::ShallowCopy(vtkDataObject *o)
   vtkKWEPaintbrushLabelData *s = vtkKWEPaintbrushLabelData::SafeDownCast(o);
   if (s)
     {
-    this->LabelMap->ShallowCopy(s->GetLabelMap());
+    this->LabelMap->ShallowCopy(s->LabelMap);
+    this->StorageMode = s->StorageMode;
+    vtkSetObjectBodyMacro( Bricks, vtkKWEPaintbrushLabelBricks, s->Bricks );
+    this->UnrecordedModificationTime.Modified();
     }
 
   vtkDataObject::ShallowCopy(o);
@@ -144,7 +173,22 @@ void vtkKWEPaintbrushLabelData::DeepCopy(vtkDataObject *o)
   vtkKWEPaintbrushLabelData *s = vtkKWEPaintbrushLabelData::SafeDownCast(o);
   if (s)
     {
-    this->LabelMap->DeepCopy(s->GetLabelMap());
+    this->LabelMap->DeepCopy(s->LabelMap);
+    this->StorageMode = s->StorageMode;
+
+    // The bricks may be shared with another instance, copy them to new ones.
+    vtkKWEPaintbrushLabelBricks *bricks = vtkKWEPaintbrushLabelBricks::New();
+    bricks->DeepCopy(s->Bricks);
+    vtkSetObjectBodyMacro( Bricks, vtkKWEPaintbrushLabelBricks, bricks );
+    bricks->Delete();
+    this->UnrecordedModificationTime.Modified();
+
+    if (s->LabelCountsMTime == s->LabelMap->GetMTime())
+      {
+      this->LabelCounts      = s->LabelCounts;
+      this->PresentLabels    = s->PresentLabels;
+      this->LabelCountsMTime = this->LabelMap->GetMTime();
+      }
     }
 
   vtkDataObject::DeepCopy(o);
@@ -153,6 +197,20 @@ void vtkKWEPaintbrushLabelData::DeepCopy(vtkDataObject *o)
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushLabelData::Allocate( double value )
 {
+  // The labels are usually written right after, without the label map being
+  // marked modified. Count them when first needed.
+  this->LabelCountsMTime = 0;
+
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    int extent[6];
+    this->LabelMap->GetExtent(extent);
+    this->Bricks->Allocate( extent,
+        static_cast<vtkKWEPaintbrushEnums::LabelType>(value) );
+    this->UnrecordedModificationTime.Modified();
+    return;
+    }
+
   // Allocate
   this->LabelMap->AllocateScalars();
 
@@ -168,12 +226,36 @@ void vtkKWEPaintbrushLabelData::Allocate( double value )
     *arrayPointer = static_cast<vtkKWEPaintbrushEnums::LabelType>(value);
     ++arrayPointer;
     }
+
+  this->UnrecordedModificationTime.Modified();
 }
 
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushLabelData::Clear( vtkKWEPaintbrushEnums::LabelType label )
 {
-  if (this->LabelMap->GetPointData()->GetScalars() == NULL)
+  // The voxels of the label all go to NoLabelValue.
+  const bool counted = this->LabelCountsAreValid();
+  const vtkIdType n = counted ? this->LabelCounts[
+                  vtkKWEPaintbrushLabelDataCountIndex(label)] : 0;
+
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    if (!this->Bricks->IsAllocated())
+      {
+      this->Allocate(0.0);
+      }
+    else
+      {
+      this->Bricks->ReplaceLabel( label, vtkKWEPaintbrushLabelData::NoLabelValue );
+      this->LabelMapModified();
+      if (counted)
+        {
+        this->ChangeLabelCount( label, -n );
+        this->ChangeLabelCount( vtkKWEPaintbrushLabelData::NoLabelValue, n );
+        }
+      }
+    }
+  else if (this->LabelMap->GetPointData()->GetScalars() == NULL)
     {
     // Data hasn't been allocated yet. Allocate and be done
     this->Allocate(0.0);
@@ -197,7 +279,12 @@ void vtkKWEPaintbrushLabelData::Clear( vtkKWEPaintbrushEnums::LabelType label )
       ++arrayPointer;
       }
 
-    this->LabelMap->Modified();
+    this->LabelMapModified();
+    if (counted)
+      {
+      this->ChangeLabelCount( label, -n );
+      this->ChangeLabelCount( vtkKWEPaintbrushLabelData::NoLabelValue, n );
+      }
     }
 }
 
@@ -215,662 +302,726 @@ vtkKWEPaintbrushLabelData* vtkKWEPaintbrushLabelData::GetData(vtkInformationVect
 }
 
 //----------------------------------------------------------------------------
-int vtkKWEPaintbrushLabelData::Add( vtkKWEPaintbrushData * data, bool forceMutable )
+// Operations applied by vtkKWEPaintbrushLabelData::ExecuteOperation
+enum
 {
-  int extentToBeAdded[6], currentExtent[6], extent[6];
-  data->GetExtent(extentToBeAdded);
-  this->GetExtent(currentExtent);
+  VTK_KWE_LABEL_DATA_ADD = 0,
+  VTK_KWE_LABEL_DATA_SUBTRACT,
+  VTK_KWE_LABEL_DATA_REPLACE
+};
 
-  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-             currentExtent, extentToBeAdded, extent ))
-    {
-    // The stuff we are adding is entirely outside our bounds.
-    // Nothing to add.
-    return 0;
-    }
+// Regions smaller than this many voxels per slab are not worth a thread.
+#define VTK_KWE_LABEL_DATA_MIN_VOXELS_PER_SLAB 65536
 
-  // Handle Immubtability of sketches.
-  // For details, see vtkKWEPaintbrushProperty::SetMubtale
-  const bool mutableLabelsPresent = (this->ImmutableLabels.size() > 0);
-  vtkstd::set< vtkKWEPaintbrushEnums::LabelType >::const_iterator
-                    iterEnd = this->ImmutableLabels.end();
+//----------------------------------------------------------------------------
+// Changes to the number of voxels of each label made by a slab. Voxels
+// changed from one label to another tend to be contiguous, so runs of the
+// same change are accumulated before being added to the map.
+class vtkKWEPaintbrushLabelDataCounts
+{
+public:
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  typedef vtkstd::map< LabelType, vtkIdType > ChangesType;
 
+  vtkKWEPaintbrushLabelDataCounts() : From(0), To(0), Count(0) {}
 
-  if (vtkKWEPaintbrushLabelData *labelData =
-      vtkKWEPaintbrushLabelData::SafeDownCast(data))
+  void Change( LabelType from, LabelType to )
     {
-    // PaintbrushLabelData + PaintbrushLabelData
-
-    vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > it2(
-                    labelData->GetLabelMap(), extent );
-    vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > it1(
-                    this->LabelMap, extent );
-
-    bool immutableLabel = false;
-    vtkKWEPaintbrushEnums::LabelType lastLabel =
-                                  vtkKWEPaintbrushLabelData::NoLabelValue;
-    while( !it1.IsAtEnd() )
+    if (from != this->From || to != this->To)
       {
-      vtkKWEPaintbrushEnums::LabelType *inSI    = it1.BeginSpan();
-      vtkKWEPaintbrushEnums::LabelType *inSI2   = it2.BeginSpan();
-      vtkKWEPaintbrushEnums::LabelType *inSIEnd = it1.EndSpan();
-      if( mutableLabelsPresent && !forceMutable )
-        {
-        while (inSI != inSIEnd)
-          {
-          vtkKWEPaintbrushEnums::LabelType l = *inSI2;
-          if (l != vtkKWEPaintbrushLabelData::NoLabelValue)
-            {
-            if( lastLabel != *inSI )
-              {
-              lastLabel = *inSI;
-              if( this->ImmutableLabels.find(*inSI) == iterEnd )
-                {
-                immutableLabel = false;
-                }
-              else
-                {
-                immutableLabel = true;
-                }
-              }
-            if( !immutableLabel )
-              {
-              *inSI = l;
-              }
-            }
-          ++inSI;
-          ++inSI2;
-          }
-        }
-      else
-        {
-        while (inSI != inSIEnd)
-          {
-          vtkKWEPaintbrushEnums::LabelType l = *inSI2;
-          if (l != vtkKWEPaintbrushLabelData::NoLabelValue)
-            {
-            *inSI = l;
-            }
-          ++inSI;
-          ++inSI2;
-          }
-        }
-      it1.NextSpan();
-      it2.NextSpan();
+      this->Flush();
+      this->From = from;
+      this->To   = to;
       }
+    ++this->Count;
     }
 
-  else if (vtkKWEPaintbrushStencilData *binaryPaintbrushData =
-           vtkKWEPaintbrushStencilData::SafeDownCast(data))
+  void Flush()
     {
-    this->AddStencil( binaryPaintbrushData, forceMutable );
+    if (this->Count)
+      {
+      this->Changes[this->From] -= this->Count;
+      this->Changes[this->To]   += this->Count;
+      this->Count = 0;
+      }
     }
 
-  this->LabelMap->Modified();
-  this->Modified();
-  return 1;
-}
+  ChangesType Changes;
+
+private:
+  LabelType From, To;
+  vtkIdType Count;
+};
 
 //----------------------------------------------------------------------------
-int vtkKWEPaintbrushLabelData::
-AddStencil( vtkKWEPaintbrushStencilData * data, bool forceMutable )
+// Everything a slab needs to apply an operation. Dense label maps are
+// addressed through the pointer to the first voxel of the extent and the
+// increments along Y and Z, rather than through GetScalarPointer.
+struct vtkKWEPaintbrushLabelDataThreadStruct
 {
-  int extentToBeAdded[6], currentExtent[6], extent[6];
-  data->GetExtent(extentToBeAdded);
-  this->GetExtent(currentExtent);
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
 
-  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-             currentExtent, extentToBeAdded, extent ))
-    {
-    // The stuff we are adding is entirely outside our bounds.
-    // Nothing to add.
-    return 0;
-    }
+  int                  Operation;
+  int                  Extent[6];
+  LabelType            Label;
+
+  // Slab i covers slices SlabBounds[i] to SlabBounds[i+1] - 1.
+  int                  NumberOfSlabs;
+  int                  SlabBounds[VTK_MAX_THREADS + 1];
+
+  // Our label map, at (Extent[0], Extent[2], Extent[4]) if dense, or its
+  // bricks if sparse.
+  LabelType                   *Labels;
+  vtkKWEPaintbrushLabelBricks *Bricks;
+
+  // Offset of voxel (Extent[0], Extent[2], Extent[4]) in our label map, and
+  // increments of the label map along Y and Z. Changes are recorded with
+  // these offsets.
+  vtkIdType            Offset;
+  vtkIdType            Increments[2];
+
+  // The label data being applied, if any. Its labels are at
+  // (Extent[0], Extent[2], Extent[4]) if dense.
+  vtkKWEPaintbrushLabelData *Source;
+  const LabelType     *SourceLabels;
+  vtkIdType            SourceIncrements[2];
+
+  // The stencil being applied, if any. Runs of voxels that were not changed
+  // are removed from TrimmedStencil, if set. vtkImageStencilData is not
+  // thread safe: each slab lists the runs in UnchangedRuns (x1, x2, y, z
+  // for each run), and they are removed once all the slabs are done.
+  vtkImageStencilData *Stencil;
+  vtkImageStencilData *TrimmedStencil;
+  vtkstd::vector< int > UnchangedRuns[VTK_MAX_THREADS];
+
+  // NULL if every label is mutable.
+  const vtkKWEPaintbrushLabelData::LabelSetType *ImmutableLabels;
+
+  // Changes made by each slab are recorded in the slab's own delta.
+  vtkKWEPaintbrushLabelDelta *Recorders[VTK_MAX_THREADS];
+
+  // Changes to the label counts made by each slab, NULL if the labels are
+  // not counted.
+  vtkKWEPaintbrushLabelDataCounts *Counts;
+};
 
-  // Handle Immubtability of sketches.
-  // For details, see vtkKWEPaintbrushProperty::SetMubtale
-  const bool mutableLabelsPresent = (this->ImmutableLabels.size() > 0);
-  vtkstd::set< vtkKWEPaintbrushEnums::LabelType >::const_iterator
-                    iterEnd = this->ImmutableLabels.end();
-  
-  // PaintbrushLabelData + PaintbrushStencilData
+//----------------------------------------------------------------------------
+// Caches the mutability of the last label looked up. Voxels with the same
+// label tend to be contiguous.
+class vtkKWEPaintbrushLabelDataMutability
+{
+public:
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
 
-  vtkImageStencilData *stencilData = data->GetImageStencilData();
+  vtkKWEPaintbrushLabelDataMutability(
+      const vtkKWEPaintbrushLabelData::LabelSetType *immutableLabels )
+    {
+    this->ImmutableLabels = immutableLabels;
+    this->LastLabel       = vtkKWEPaintbrushLabelData::NoLabelValue;
+    this->LastMutable     = !immutableLabels ||
+      immutableLabels->find(this->LastLabel) == immutableLabels->end();
+    }
 
-  // Compute incremental deltas for Undo-Redo, if requested.
-  vtkSmartPointer< vtkImageStencilData > tempData = stencilData;
-  if (this->ComputeDelta)
+  bool IsMutable( LabelType l )
     {
-    tempData = vtkSmartPointer< vtkImageStencilData >::New();
-    tempData->DeepCopy(stencilData);
+    if (this->ImmutableLabels && l != this->LastLabel)
+      {
+      this->LastLabel   = l;
+      this->LastMutable = (this->ImmutableLabels->find(l) ==
+                           this->ImmutableLabels->end());
+      }
+    return this->LastMutable;
     }
 
-  vtkKWEPaintbrushEnums::LabelType l = data->GetLabel();
+private:
+  const vtkKWEPaintbrushLabelData::LabelSetType *ImmutableLabels;
+  LabelType                                      LastLabel;
+  bool                                           LastMutable;
+};
+
+//----------------------------------------------------------------------------
+// Apply the operation to voxels x1 to x2 of a row. "row" and "source" point
+// to voxel x1 of our labels and of the labels applied (NULL for a stencil),
+// "offset" is the offset of voxel x1 in our label map.
+static void vtkKWEPaintbrushLabelDataExecuteRow(
+    vtkKWEPaintbrushLabelDataThreadStruct *str,
+    vtkKWEPaintbrushLabelDelta *recorder,
+    vtkKWEPaintbrushLabelDataCounts *counts,
+    vtkstd::vector< int > *unchangedRuns,
+    vtkKWEPaintbrushLabelDataMutability &mutability,
+    vtkKWEPaintbrushEnums::LabelType *row,
+    const vtkKWEPaintbrushEnums::LabelType *source,
+    vtkIdType offset, int x1, int x2, int y, int z )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const LabelType noLabel = vtkKWEPaintbrushLabelData::NoLabelValue;
+  const LabelType label = str->Label;
+  const int n = x2 - x1 + 1;
 
-  int r1, r2, moreSubExtents, iter;
-  bool immutableLabel = false;
-  vtkKWEPaintbrushEnums::LabelType lastLabel =
-                                vtkKWEPaintbrushLabelData::NoLabelValue;
-  for (int z=extent[4]; z <= extent[5]; z++)
+  if (source)
     {
-    for (int y=extent[2]; y <= extent[3]; y++)
+    // PaintbrushLabelData op PaintbrushLabelData
+
+    for (int i = 0; i < n; i++)
       {
-      iter = 0;
-      moreSubExtents = 1;
-      while( moreSubExtents )
+      const LabelType l = source[i];
+      LabelType &v = row[i];
+      switch (str->Operation)
         {
-        moreSubExtents = tempData->GetNextExtent(
-          r1, r2, extent[0], extent[1], y, z, iter);
-
-        int removeStart = -1, removeEnd = -1;
-
-        // sanity check
-        if (r1 <= r2)
-          {
-          vtkKWEPaintbrushEnums::LabelType *beginExtent =
-            static_cast<vtkKWEPaintbrushEnums::LabelType *>(this->LabelMap->GetScalarPointer(r1, y, z));
-          vtkKWEPaintbrushEnums::LabelType *endExtent   =
-            static_cast<vtkKWEPaintbrushEnums::LabelType *>(this->LabelMap->GetScalarPointer(r2, y, z));
-          if( mutableLabelsPresent && !forceMutable )
+        case VTK_KWE_LABEL_DATA_ADD:
+          if (l != noLabel && mutability.IsMutable(v) && v != l)
             {
-            while (beginExtent <= endExtent)
+            if (recorder)
               {
-              // If this voxel is mutable..
-              if( lastLabel != *beginExtent )
-                {
-                lastLabel = *beginExtent;
-                if( this->ImmutableLabels.find(*beginExtent) == iterEnd )
-                  {
-                  immutableLabel = false;
-                  }
-                else
-                  {
-                  immutableLabel = true;
-                  }
-                }
-              if( !immutableLabel )
-                {
-                if (*beginExtent != l)
-                  {
-                  *beginExtent = l;
-
-                  // This scan line already exists on the data. Remove it from
-                  // the stroke
-                  if (this->ComputeDelta && removeStart != -1 && removeEnd == -1 && removeStart < r1)
-                    {
-                    stencilData->RemoveExtent( removeStart, r1-1, y, z );
-                    removeStart = removeEnd = -1; // reset them.
-                    }
-                  }
-                else
-                  {
-                  if (removeStart == -1)
-                    {
-                    removeStart = r1;
-                    }
-                  }
-                }
-              else // this pixel is locked to any changes
-                {
-                if (removeStart == -1)
-                  {
-                  removeStart = r1;
-                  }
-                }
-              ++beginExtent;
-              ++r1;
+              recorder->Record(offset + i, v);
               }
-
-            // This scan line already exists on the data. Remove it from the
-            // stroke
-            if (this->ComputeDelta && removeStart != -1 && removeEnd == -1)
+            if (counts)
               {
-              stencilData->RemoveExtent( removeStart, r1 - 1, y, z );
+              counts->Change(v, l);
               }
-
+            v = l;
             }
-          else
+          break;
+
+        case VTK_KWE_LABEL_DATA_SUBTRACT:
+          if (l != noLabel && mutability.IsMutable(v) && v != noLabel)
             {
-            while (beginExtent <= endExtent)
+            if (recorder)
               {
-              if (*beginExtent != l)
-                {
-                *beginExtent = l;
-
-                // This scan line already exists on the data. Remove it from
-                // the stroke
-                if (this->ComputeDelta && removeStart != -1 && removeEnd == -1 && removeStart < r1)
-                  {
-                  stencilData->RemoveExtent( removeStart, r1-1, y, z );
-                  removeStart = removeEnd = -1; // reset them.
-                  }
-                }
-              else
-                {
-                if (removeStart == -1)
-                  {
-                  removeStart = r1;
-                  }
-                }
-              ++beginExtent;
-              ++r1;
+              recorder->Record(offset + i, v);
               }
-
-            // This scan line already exists on the data. Remove it from the
-            // stroke
-            if (this->ComputeDelta && removeStart != -1 && removeEnd == -1)
+            if (counts)
               {
-              stencilData->RemoveExtent( removeStart, r1 - 1, y, z );
+              counts->Change(v, noLabel);
               }
-
+            v = noLabel;
             }
-          }
-        } // end for each extent tuple
-      } // end for each scan line
-    } // end of each slice
-}
-
-//----------------------------------------------------------------------------
-int vtkKWEPaintbrushLabelData::Subtract( vtkKWEPaintbrushData * data, bool forceMutable )
-{
-  int extentToBeSubtracted[6], currentExtent[6], extent[6];
-  data->GetExtent(extentToBeSubtracted);
-  this->GetExtent(currentExtent);
-
-  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-         currentExtent, extentToBeSubtracted, extent ))
-    {
-    // The stuff we are removing is entirely outside our bounds.
-    // Nothing to add.
-    return 0;
-    }
-
-  // Handle Immubtability of sketches.
-  // For details, see vtkKWEPaintbrushProperty::SetMubtale
-  const bool mutableLabelsPresent = (this->ImmutableLabels.size() > 0);
-  vtkstd::set< vtkKWEPaintbrushEnums::LabelType >::const_iterator
-                    iterEnd = this->ImmutableLabels.end();
+          break;
 
-
-  if (vtkKWEPaintbrushLabelData *labelData =
-      vtkKWEPaintbrushLabelData::SafeDownCast(data))
-    {
-  
-    vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > it2(
-                    labelData->GetLabelMap(), extent );
-    vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > it1(
-                    this->LabelMap, extent );
-    bool immutableLabel = false;
-    vtkKWEPaintbrushEnums::LabelType lastLabel =
-                                  vtkKWEPaintbrushLabelData::NoLabelValue;
-    while( !it1.IsAtEnd() )
-      {
-      vtkKWEPaintbrushEnums::LabelType *inSI    = it1.BeginSpan();
-      vtkKWEPaintbrushEnums::LabelType *inSI2   = it2.BeginSpan();
-      vtkKWEPaintbrushEnums::LabelType *inSIEnd = it1.EndSpan();
-      if( mutableLabelsPresent && !forceMutable )
-        {
-        while (inSI != inSIEnd)
-          {
-          if (*inSI2 != vtkKWEPaintbrushLabelData::NoLabelValue)
+        case VTK_KWE_LABEL_DATA_REPLACE:
+          if (mutability.IsMutable(v))
             {
-            // If this voxel is mutable..
-            if( lastLabel != *inSI )
+            const LabelType newLabel = (l == label) ? label :
+                                       (v == label) ? noLabel : v;
+            if (v != newLabel)
               {
-              lastLabel = *inSI;
-              if( this->ImmutableLabels.find(*inSI) == iterEnd )
+              if (recorder)
                 {
-                immutableLabel = false;
+                recorder->Record(offset + i, v);
                 }
-              else
+              if (counts)
                 {
-                immutableLabel = true;
+                counts->Change(v, newLabel);
                 }
-              }
-            if( !immutableLabel )
-              {
-              *inSI = vtkKWEPaintbrushLabelData::NoLabelValue;
+              v = newLabel;
               }
             }
-          ++inSI;
-          ++inSI2;
-          }
+          break;
         }
-      else
+      }
+    return;
+    }
+
+  // PaintbrushLabelData op PaintbrushStencilData
+
+  if (str->Operation == VTK_KWE_LABEL_DATA_REPLACE)
+    {
+    // The label is cleared from the whole row, and then drawn where the
+    // stencil is.
+    for (int i = 0; i < n; i++)
+      {
+      if (row[i] == label)
         {
-        while (inSI != inSIEnd)
+        if (recorder)
           {
-          if (*inSI2 != vtkKWEPaintbrushLabelData::NoLabelValue)
-            {
-            // If this voxel is mutable..
-            *inSI = vtkKWEPaintbrushLabelData::NoLabelValue;
-            }
-          ++inSI;
-          ++inSI2;
+          recorder->Record(offset + i, row[i]);
           }
+        if (counts)
+          {
+          counts->Change(row[i], noLabel);
+          }
+        row[i] = noLabel;
         }
-      it1.NextSpan();
-      it2.NextSpan();
       }
     }
 
-  else if (vtkKWEPaintbrushStencilData *binaryPaintbrushData =
-           vtkKWEPaintbrushStencilData::SafeDownCast(data))
-    {
-    vtkImageStencilData *stencilData
-      = binaryPaintbrushData->GetImageStencilData();
+  const LabelType newLabel =
+    (str->Operation == VTK_KWE_LABEL_DATA_SUBTRACT) ? noLabel : label;
 
+  int r1, r2, iter = 0, moreSubExtents = 1;
+  while (moreSubExtents)
+    {
+    moreSubExtents = str->Stencil->GetNextExtent(
+      r1, r2, x1, x2, y, z, iter);
 
-    // Compute incremental deltas for Undo-Redo, if requested.
-    vtkSmartPointer< vtkImageStencilData > tempData = stencilData;
-    if (this->ComputeDelta)
+    // sanity check
+    if (r1 > r2)
       {
-      tempData = vtkSmartPointer< vtkImageStencilData >::New();
-      tempData->DeepCopy(stencilData);
+      continue;
       }
 
-    int r1, r2, moreSubExtents, iter;
-    bool immutableLabel = false;
-    vtkKWEPaintbrushEnums::LabelType lastLabel =
-                                  vtkKWEPaintbrushLabelData::NoLabelValue;
-    for (int z=extent[4]; z <= extent[5]; z++)
+    // Runs of voxels that did not change are to be removed from the trimmed
+    // stencil, so that it only holds the voxels actually changed.
+    int removeStart = -1;
+    LabelType *v = row + (r1 - x1);
+    for (int x = r1; x <= r2; ++x, ++v)
       {
-      for (int y=extent[2]; y <= extent[3]; y++)
+      if (*v != newLabel && mutability.IsMutable(*v))
         {
-        iter = 0;
-        moreSubExtents = 1;
-        while( moreSubExtents )
+        if (recorder)
+          {
+          recorder->Record(offset + (x - x1), *v);
+          }
+        if (counts)
           {
-          moreSubExtents = tempData->GetNextExtent(
-            r1, r2, extent[0], extent[1], y, z, iter);
+          counts->Change(*v, newLabel);
+          }
+        *v = newLabel;
 
-          // sanity check
-          if (r1 <= r2)
-            {
+        if (unchangedRuns && removeStart != -1)
+          {
+          unchangedRuns->push_back(removeStart);
+          unchangedRuns->push_back(x - 1);
+          unchangedRuns->push_back(y);
+          unchangedRuns->push_back(z);
+          removeStart = -1;
+          }
+        }
+      else if (removeStart == -1)
+        {
+        removeStart = x;
+        }
+      }
 
-            int removeStart = -1, removeEnd = -1;
-            vtkKWEPaintbrushEnums::LabelType *beginExtent =
-              static_cast<vtkKWEPaintbrushEnums::LabelType *>(this->LabelMap->GetScalarPointer(r1, y, z));
-            vtkKWEPaintbrushEnums::LabelType *endExtent   =
-              static_cast<vtkKWEPaintbrushEnums::LabelType *>(this->LabelMap->GetScalarPointer(r2, y, z));
-            if( mutableLabelsPresent && !forceMutable )
-              {
-              while (beginExtent <= endExtent)
-                {
-                if( lastLabel != *beginExtent )
-                  {
-                  lastLabel = *beginExtent;
-                  if( this->ImmutableLabels.find(*beginExtent) == iterEnd )
-                    {
-                    immutableLabel = false;
-                    }
-                  else
-                    {
-                    immutableLabel = true;
-                    }
-                  }
-                if( !immutableLabel )
-                  {
-                  if (*beginExtent != vtkKWEPaintbrushLabelData::NoLabelValue)
-                    {
-                    *beginExtent = vtkKWEPaintbrushLabelData::NoLabelValue;
-
-                    // This scan line already exists on the data. Remove it from
-                    // the stroke
-                    if (this->ComputeDelta && removeStart != -1 && removeEnd == -1 && removeStart < r1)
-                      {
-                      stencilData->RemoveExtent( removeStart, r1-1, y, z );
-                      removeStart = removeEnd = -1; // reset them.
-                      }
-                    }
-                  else
-                    {
-                    if (removeStart == -1)
-                      {
-                      removeStart = r1;
-                      }
-                    }
-                  }
-                else // this pixel is locked to any changes
-                  {
-                  if (removeStart == -1)
-                    {
-                    removeStart = r1;
-                    }
-                  }
-
-                ++beginExtent;
-                ++r1;
-                }
-              }
-            else
-              {
-              while (beginExtent <= endExtent)
-                {
+    if (unchangedRuns && removeStart != -1)
+      {
+      unchangedRuns->push_back(removeStart);
+      unchangedRuns->push_back(r2);
+      unchangedRuns->push_back(y);
+      unchangedRuns->push_back(z);
+      }
+    } // end for each extent tuple
+}
 
-                if (*beginExtent != vtkKWEPaintbrushLabelData::NoLabelValue)
-                  {
-                  *beginExtent = vtkKWEPaintbrushLabelData::NoLabelValue;
-
-                  // This scan line already exists on the data. Remove it from
-                  // the stroke
-                  if (this->ComputeDelta && removeStart != -1 && removeEnd == -1 && removeStart < r1)
-                    {
-                    stencilData->RemoveExtent( removeStart, r1-1, y, z );
-                    removeStart = removeEnd = -1; // reset them.
-                    }
-                  }
-                else
-                  {
-                  if (removeStart == -1)
-                    {
-                    removeStart = r1;
-                    }
-                  }
-                ++beginExtent;
-                ++r1;
-                }
-              }
+//----------------------------------------------------------------------------
+// Apply the operation to the rows of slices z1 to z2.
+static void vtkKWEPaintbrushLabelDataExecuteSlab(
+    vtkKWEPaintbrushLabelDataThreadStruct *str,
+    vtkKWEPaintbrushLabelDelta *recorder,
+    vtkKWEPaintbrushLabelDataCounts *counts,
+    vtkstd::vector< int > *unchangedRuns, int z1, int z2 )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const int *extent = str->Extent;
+  vtkKWEPaintbrushLabelDataMutability mutability(str->ImmutableLabels);
 
-            // This scan line already exists on the data. Remove it from the
-            // stroke
-            if (this->ComputeDelta && removeStart != -1 && removeEnd == -1)
-              {
-              stencilData->RemoveExtent( removeStart, r1 - 1, y, z );
-              }
+  // Rows of sparse labels, and of the uniform bricks being operated upon.
+  vtkstd::vector< LabelType > sourceRow(
+      str->Source && !str->SourceLabels ? extent[1] - extent[0] + 1 : 0);
+  vtkstd::vector< LabelType > brickRow(
+      str->Bricks ? vtkKWEPaintbrushLabelBricks::BrickSize : 0);
+
+  for (int z = z1; z <= z2; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      const vtkIdType offset = str->Offset +
+        (y - extent[2]) * str->Increments[0] +
+        (z - extent[4]) * str->Increments[1];
+
+      const LabelType *source = NULL;
+      if (str->SourceLabels)
+        {
+        source = str->SourceLabels +
+          (y - extent[2]) * str->SourceIncrements[0] +
+          (z - extent[4]) * str->SourceIncrements[1];
+        }
+      else if (str->Source)
+        {
+        source = str->Source->GetLabelRow(
+            extent[0], extent[1], y, z, &sourceRow[0]);
+        }
+
+      if (!str->Bricks)
+        {
+        LabelType *row = str->Labels +
+          (y - extent[2]) * str->Increments[0] +
+          (z - extent[4]) * str->Increments[1];
+        vtkKWEPaintbrushLabelDataExecuteRow( str, recorder, counts,
+            unchangedRuns, mutability, row, source, offset,
+            extent[0], extent[1], y, z );
+        continue;
+        }
+
+      // Sparse labels are operated upon one brick at a time.
+      int x2;
+      for (int x1 = extent[0]; x1 <= extent[1]; x1 = x2 + 1)
+        {
+        LabelType uniformLabel;
+        LabelType *row = str->Bricks->GetBrickRow(
+                                x1, y, z, x2, uniformLabel );
+        x2 = (x2 > extent[1]) ? extent[1] : x2;
+        const LabelType *brickSource =
+          source ? source + (x1 - extent[0]) : NULL;
+
+        if (row)
+          {
+          vtkKWEPaintbrushLabelDataExecuteRow( str, recorder, counts,
+              unchangedRuns, mutability, row, brickSource,
+              offset + (x1 - extent[0]), x1, x2, y, z );
+          continue;
+          }
+
+        // The brick is uniform. Operate on a copy of its row, and allocate
+        // it only if a voxel changed.
+        const int n = x2 - x1 + 1;
+        for (int i = 0; i < n; i++)
+          {
+          brickRow[i] = uniformLabel;
+          }
+        vtkKWEPaintbrushLabelDataExecuteRow( str, recorder, counts,
+            unchangedRuns, mutability, &brickRow[0], brickSource,
+            offset + (x1 - extent[0]), x1, x2, y, z );
 
+        for (int i = 0; i < n; i++)
+          {
+          if (brickRow[i] != uniformLabel)
+            {
+            memcpy( str->Bricks->AllocateBrickRow( x1, y, z ), &brickRow[0],
+                    n * sizeof(LabelType) );
+            break;
             }
-          } // end for each extent tuple
-        } // end for each scan line
-      } // end of each slice
+          }
+        }
+      } // end for each scan line
+    } // end of each slice
+}
+
+//----------------------------------------------------------------------------
+// This is the threaded function. Each thread applies the operation to its
+// own slab of slices.
+static VTK_THREAD_RETURN_TYPE vtkKWEPaintbrushLabelDataThreadedExecute(
+                                                                void *arg )
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast< vtkMultiThreader::ThreadInfo * >(arg);
+  vtkKWEPaintbrushLabelDataThreadStruct *str =
+    static_cast< vtkKWEPaintbrushLabelDataThreadStruct * >(info->UserData);
+
+  const int slab = info->ThreadID;
+  if (slab < str->NumberOfSlabs)
+    {
+    vtkKWEPaintbrushLabelDataExecuteSlab( str, str->Recorders[slab],
+      str->Counts ? str->Counts + slab : NULL,
+      str->TrimmedStencil ? str->UnchangedRuns + slab : NULL,
+      str->SlabBounds[slab], str->SlabBounds[slab + 1] - 1 );
     }
 
-  this->LabelMap->Modified();
-  this->Modified();
-  return 1;
+  return VTK_THREAD_RETURN_VALUE;
 }
 
 //----------------------------------------------------------------------------
-int vtkKWEPaintbrushLabelData::Replace( vtkKWEPaintbrushData * data, bool forceMutable )
+void vtkKWEPaintbrushLabelData::ExecuteOperation( int operation,
+    vtkKWEPaintbrushData *data, int extent[6], bool forceMutable )
 {
-  int extentToBeReplaced[6], currentExtent[6], extent[6];
-  data->GetExtent(extentToBeReplaced);
-  this->GetExtent(currentExtent);
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
 
-  if( !vtkKWEPaintbrushUtilities::GetIntersectingExtents(
-         currentExtent, extentToBeReplaced, extent ) )
+  int labelMapExtent[6];
+  this->LabelMap->GetExtent(labelMapExtent);
+
+  vtkKWEPaintbrushLabelDataThreadStruct str;
+  str.Operation = operation;
+  for (int i = 0; i < 6; i++)
     {
-    // The stuff we are removing is entirely outside our bounds.
-    // Nothing to add.
-    return 0;
+    str.Extent[i] = extent[i];
     }
 
   // Handle Immubtability of sketches.
   // For details, see vtkKWEPaintbrushProperty::SetMubtale
-  const bool mutableLabelsPresent = (this->ImmutableLabels.size() > 0);
-  vtkstd::set< vtkKWEPaintbrushEnums::LabelType >::const_iterator
-                    iterEnd = this->ImmutableLabels.end();
+  str.ImmutableLabels = (this->ImmutableLabels.size() > 0 && !forceMutable)
+                                        ? &this->ImmutableLabels : NULL;
+
+  str.Increments[0] = labelMapExtent[1] - labelMapExtent[0] + 1;
+  str.Increments[1] = str.Increments[0] *
+                      (labelMapExtent[3] - labelMapExtent[2] + 1);
+  str.Offset = (extent[0] - labelMapExtent[0]) +
+               (extent[2] - labelMapExtent[2]) * str.Increments[0] +
+               (extent[4] - labelMapExtent[4]) * str.Increments[1];
+
+  str.Labels = NULL;
+  str.Bricks = NULL;
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    int bricksExtent[6];
+    this->Bricks->GetExtent(bricksExtent);
+    if (!vtkMath::ExtentIsWithinOtherExtent(labelMapExtent, bricksExtent))
+      {
+      vtkErrorMacro( << "The label data has not been allocated." );
+      return;
+      }
+    str.Bricks = this->Bricks;
+    }
+  else
+    {
+    str.Labels = static_cast< LabelType * >(
+        this->LabelMap->GetScalarPointer()) + str.Offset;
+    }
+
+  str.Source         = NULL;
+  str.SourceLabels   = NULL;
+  str.Stencil        = NULL;
+  str.TrimmedStencil = NULL;
 
+  // Replace works with our own label, the other operations with that of
+  // the data being applied.
+  str.Label = (operation == VTK_KWE_LABEL_DATA_REPLACE)
+                              ? this->GetLabel() : data->GetLabel();
 
+  vtkSmartPointer< vtkImageStencilData > tempData;
   if (vtkKWEPaintbrushLabelData *labelData =
       vtkKWEPaintbrushLabelData::SafeDownCast(data))
     {
-    vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > it2(
-                    labelData->GetLabelMap(), extent );
-    vtkImageIterator< vtkKWEPaintbrushEnums::LabelType > it1(
-                    this->LabelMap, extent );
-    bool immutableLabel = false;
-    vtkKWEPaintbrushEnums::LabelType lastLabel =
-                                  vtkKWEPaintbrushLabelData::NoLabelValue;
-    while( !it1.IsAtEnd() )
+    str.Source = labelData;
+    if (labelData->StorageMode == vtkKWEPaintbrushLabelData::Dense)
       {
-      vtkKWEPaintbrushEnums::LabelType *inSI    = it1.BeginSpan();
-      vtkKWEPaintbrushEnums::LabelType *inSI2   = it2.BeginSpan();
-      vtkKWEPaintbrushEnums::LabelType *inSIEnd = it1.EndSpan();
-      if( mutableLabelsPresent && !forceMutable )
-        {
-        while (inSI != inSIEnd)
-          {
-          // If this voxel is mutable..
-          if( lastLabel != *inSI )
-            {
-            lastLabel = *inSI;
-            if( this->ImmutableLabels.find(*inSI) == iterEnd )
-              {
-              immutableLabel = false;
-              }
-            else
-              {
-              immutableLabel = true;
-              }
-            }
-          if( !immutableLabel )
-            {
-            if( *inSI2 == this->GetLabel() )
-              {
-              *inSI = this->GetLabel();
-              }
-            else
-              {
-              if( *inSI == this->GetLabel() )
-                {
-                *inSI = vtkKWEPaintbrushLabelData::NoLabelValue;
-                }
-              }
-            }
-          ++inSI;
-          ++inSI2;
-          }
-        }
-      else
-        {
-        while (inSI != inSIEnd)
-          {
-          if( *inSI2 == this->GetLabel() )
-            {
-            *inSI = this->GetLabel();
-            }
-          else
-            {
-            if( *inSI == this->GetLabel() )
-              {
-              *inSI = vtkKWEPaintbrushLabelData::NoLabelValue;
-              }
-            }
-          ++inSI;
-          ++inSI2;
-          }
-        }
-      it1.NextSpan();
-      it2.NextSpan();
+      int sourceExtent[6];
+      labelData->LabelMap->GetExtent(sourceExtent);
+      str.SourceIncrements[0] = sourceExtent[1] - sourceExtent[0] + 1;
+      str.SourceIncrements[1] = str.SourceIncrements[0] *
+                                (sourceExtent[3] - sourceExtent[2] + 1);
+      str.SourceLabels = static_cast< LabelType * >(
+          labelData->LabelMap->GetScalarPointer()) +
+        (extent[0] - sourceExtent[0]) +
+        (extent[2] - sourceExtent[2]) * str.SourceIncrements[0] +
+        (extent[4] - sourceExtent[4]) * str.SourceIncrements[1];
       }
     }
-  else if (vtkKWEPaintbrushStencilData *binaryPaintbrushData =
+  else if (vtkKWEPaintbrushStencilData *stencilData =
            vtkKWEPaintbrushStencilData::SafeDownCast(data))
     {
-    vtkImageStencilData *stencilData
-      = binaryPaintbrushData->GetImageStencilData();
+    str.Stencil = stencilData->GetImageStencilData();
 
-    int r1, r2, moreSubExtents, iter;
-    bool immutableLabel = false;
-    vtkKWEPaintbrushEnums::LabelType lastLabel =
-                                  vtkKWEPaintbrushLabelData::NoLabelValue;
-    for (int z=extent[4]; z <= extent[5]; z++)
+    // Compute incremental deltas for Undo-Redo, if requested. The stencil is
+    // read from a copy, while voxels that did not change are removed from
+    // the original.
+    if (this->ComputeDelta && operation != VTK_KWE_LABEL_DATA_REPLACE)
       {
-      for (int y=extent[2]; y <= extent[3]; y++)
+      tempData = vtkSmartPointer< vtkImageStencilData >::New();
+      tempData->DeepCopy(str.Stencil);
+      str.TrimmedStencil = str.Stencil;
+      str.Stencil = tempData;
+      }
+    }
+  else
+    {
+    return;
+    }
+
+  // Voxels changed are recorded here, if requested. See SetDeltaRecorder.
+  this->CheckForUnrecordedModifications();
+
+  // Split the extent into slabs along Z, as long as each of them is large
+  // enough to be worth a thread. Sparse labels are split between layers of
+  // bricks, so that no brick is allocated by two threads.
+  const int nz = extent[5] - extent[4] + 1;
+  int numberOfLayers = nz, firstLayer = 0;
+  if (str.Bricks)
+    {
+    firstLayer = (extent[4] - labelMapExtent[4]) >>
+                   vtkKWEPaintbrushLabelBricks::BrickShift;
+    numberOfLayers = ((extent[5] - labelMapExtent[4]) >>
+                   vtkKWEPaintbrushLabelBricks::BrickShift) - firstLayer + 1;
+    }
+
+  const double numberOfVoxels =
+    static_cast< double >(extent[1] - extent[0] + 1) *
+    static_cast< double >(extent[3] - extent[2] + 1) * nz;
+  int numberOfSlabs = static_cast< int >(
+      numberOfVoxels / VTK_KWE_LABEL_DATA_MIN_VOXELS_PER_SLAB);
+  numberOfSlabs = (numberOfSlabs > this->NumberOfThreads)
+                                    ? this->NumberOfThreads : numberOfSlabs;
+  numberOfSlabs = (numberOfSlabs > numberOfLayers)
+                                    ? numberOfLayers : numberOfSlabs;
+  str.NumberOfSlabs = (numberOfSlabs < 1) ? 1 : numberOfSlabs;
+
+  str.SlabBounds[0] = extent[4];
+  str.SlabBounds[str.NumberOfSlabs] = extent[5] + 1;
+  for (int i = 1; i < str.NumberOfSlabs; i++)
+    {
+    const int layer = (numberOfLayers * i) / str.NumberOfSlabs;
+    str.SlabBounds[i] = str.Bricks ? labelMapExtent[4] + ((firstLayer + layer)
+                         << vtkKWEPaintbrushLabelBricks::BrickShift)
+                                   : extent[4] + layer;
+    }
+
+  // The label counts are updated along, if they are valid.
+  vtkstd::vector< vtkKWEPaintbrushLabelDataCounts > counts;
+  str.Counts = NULL;
+  if (this->LabelCountsAreValid())
+    {
+    counts.resize(str.NumberOfSlabs);
+    str.Counts = &counts[0];
+    }
+
+  if (str.NumberOfSlabs == 1)
+    {
+    vtkKWEPaintbrushLabelDataExecuteSlab( &str, this->DeltaRecorder,
+      str.Counts, str.TrimmedStencil ? str.UnchangedRuns : NULL,
+      extent[4], extent[5] );
+    }
+  else
+    {
+    // Each slab records its changes separately. They are appended to our
+    // recorder in slab order, which is the order they would have been
+    // recorded in, had the operation not been threaded.
+    str.Recorders[0] = this->DeltaRecorder;
+    for (int i = 1; i < str.NumberOfSlabs; i++)
+      {
+      str.Recorders[i] = this->DeltaRecorder ?
+                         vtkKWEPaintbrushLabelDelta::New() : NULL;
+      }
+
+    this->Threader->SetNumberOfThreads(str.NumberOfSlabs);
+    this->Threader->SetSingleMethod(
+        vtkKWEPaintbrushLabelDataThreadedExecute, &str);
+    this->Threader->SingleMethodExecute();
+
+    for (int i = 1; i < str.NumberOfSlabs; i++)
+      {
+      if (str.Recorders[i])
         {
-        vtkKWEPaintbrushEnums::LabelType *beginExtent = static_cast<vtkKWEPaintbrushEnums::LabelType *>(
-                                                       this->LabelMap->GetScalarPointer(extent[0], y, z) );
-        vtkKWEPaintbrushEnums::LabelType *endExtent   = static_cast<vtkKWEPaintbrushEnums::LabelType *>(
-                                                       this->LabelMap->GetScalarPointer(extent[1], y, z) );
-        while( beginExtent < endExtent )
-          {
-          if( *beginExtent == this->GetLabel() )
-            {
-            *beginExtent = vtkKWEPaintbrushLabelData::NoLabelValue;
-            }
-          ++beginExtent;
-          }
-        iter = 0;
-        moreSubExtents = 1;
-        while( moreSubExtents )
-          {
-          moreSubExtents = stencilData->GetNextExtent(
-            r1, r2, extent[0], extent[1], y, z, iter);
+        this->DeltaRecorder->Append(str.Recorders[i]);
+        str.Recorders[i]->Delete();
+        }
+      }
+    }
 
-          // sanity check
-          if (r1 <= r2)
-            {
-            beginExtent = static_cast<vtkKWEPaintbrushEnums::LabelType *>(
-                                this->LabelMap->GetScalarPointer(r1, y, z));
-            endExtent   = static_cast<vtkKWEPaintbrushEnums::LabelType *>(
-                                this->LabelMap->GetScalarPointer(r2, y, z));
-            if( mutableLabelsPresent && !forceMutable )
-              {
-              while (beginExtent <= endExtent)
-                {
-                if( lastLabel != *beginExtent )
-                  {
-                  lastLabel = *beginExtent;
-                  if( this->ImmutableLabels.find(*beginExtent) == iterEnd )
-                    {
-                    immutableLabel = false;
-                    }
-                  else
-                    {
-                    immutableLabel = true;
-                    }
-                  }
-                if( !immutableLabel )
-                  {
-                  *beginExtent = this->GetLabel();
-                  }
-                ++beginExtent;
-                }
-              }
-            else
-              {
-              while (beginExtent <= endExtent)
-                {
-                *beginExtent = this->GetLabel();
-                ++beginExtent;
-                }
-              }
-            }
-          } // end for each extent tuple
-        } // end for each scan line
-      } // end of each slice
+  // Trim the stencil of the runs that did not change, one slab at a time.
+  if (str.TrimmedStencil)
+    {
+    for (int i = 0; i < str.NumberOfSlabs; i++)
+      {
+      const vtkstd::vector< int > &runs = str.UnchangedRuns[i];
+      for (size_t r = 0; r < runs.size(); r += 4)
+        {
+        str.TrimmedStencil->RemoveExtent(
+          runs[r], runs[r+1], runs[r+2], runs[r+3] );
+        }
+      }
     }
 
-  this->LabelMap->Modified();
-  this->Modified();
+  for (size_t i = 0; i < counts.size(); i++)
+    {
+    counts[i].Flush();
+    vtkKWEPaintbrushLabelDataCounts::ChangesType::const_iterator it;
+    for (it = counts[i].Changes.begin(); it != counts[i].Changes.end(); ++it)
+      {
+      this->ChangeLabelCount( it->first, it->second );
+      }
+    }
+
+  // Release the bricks that the operation made uniform.
+  if (str.Bricks)
+    {
+    this->Bricks->Squeeze(extent);
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushLabelData::Add( vtkKWEPaintbrushData * data, bool forceMutable )
+{
+  int extentToBeAdded[6], currentExtent[6], extent[6];
+  const unsigned long mtime = this->GetMTime();
+  data->GetExtent(extentToBeAdded);
+  this->GetExtent(currentExtent);
+
+  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+             currentExtent, extentToBeAdded, extent ))
+    {
+    // The stuff we are adding is entirely outside our bounds.
+    // Nothing to add.
+    return 0;
+    }
+
+  this->ExecuteOperation( VTK_KWE_LABEL_DATA_ADD, data, extent, forceMutable );
+
+  this->LabelMapModified();
+  this->ExtentModified(extent, mtime);
   return 1;
 }
 
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushLabelData::Subtract( vtkKWEPaintbrushData * data, bool forceMutable )
+{
+  int extentToBeSubtracted[6], currentExtent[6], extent[6];
+  const unsigned long mtime = this->GetMTime();
+  data->GetExtent(extentToBeSubtracted);
+  this->GetExtent(currentExtent);
+
+  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+         currentExtent, extentToBeSubtracted, extent ))
+    {
+    // The stuff we are removing is entirely outside our bounds.
+    // Nothing to add.
+    return 0;
+    }
+
+  this->ExecuteOperation( VTK_KWE_LABEL_DATA_SUBTRACT, data, extent,
+                          forceMutable );
+
+  this->LabelMapModified();
+  this->ExtentModified(extent, mtime);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushLabelData::Replace( vtkKWEPaintbrushData * data, bool forceMutable )
+{
+  int extentToBeReplaced[6], currentExtent[6], extent[6];
+  const unsigned long mtime = this->GetMTime();
+  data->GetExtent(extentToBeReplaced);
+  this->GetExtent(currentExtent);
+
+  if( !vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+         currentExtent, extentToBeReplaced, extent ) )
+    {
+    // The stuff we are removing is entirely outside our bounds.
+    // Nothing to add.
+    return 0;
+    }
+
+  this->ExecuteOperation( VTK_KWE_LABEL_DATA_REPLACE, data, extent,
+                          forceMutable );
+
+  this->LabelMapModified();
+  this->ExtentModified(extent, mtime);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+// Blank out "n" contiguous labels, recording the changes to the label counts
+// in "counts", if not NULL.
+static void vtkKWEPaintbrushLabelDataClear( vtkKWEPaintbrushEnums::LabelType *ptr,
+    vtkIdType n, vtkKWEPaintbrushLabelDataCounts *counts )
+{
+  if (n <= 0)
+    {
+    return;
+    }
+  if (counts)
+    {
+    for (vtkIdType i = 0; i < n; i++)
+      {
+      counts->Change( ptr[i], vtkKWEPaintbrushLabelData::NoLabelValue );
+      }
+    }
+  vtkstd::fill( ptr, ptr + n, vtkKWEPaintbrushLabelData::NoLabelValue );
+}
+
 //----------------------------------------------------------------------------
 int vtkKWEPaintbrushLabelData::Clip( int extent[6] )
 {
-  int currentExtent[6], idy, idz, idx;
+  int currentExtent[6];
   this->Update();
   this->GetExtent( currentExtent );
 
@@ -881,41 +1032,108 @@ int vtkKWEPaintbrushLabelData::Clip( int extent[6] )
     }
 
 
-  // Does not resize the current allocation if the clipped region is smaller.
-  // It simply blanks out data outside the extents specified.
-  // TODO: Check if this has an impact on memory or performance.
+  // Does not resize the current allocation if the clipped region is smaller,
+  // our extents remain those of the image being drawn on. It simply blanks
+  // out data outside the extents specified.
+
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    // Blank out the slabs on either side of the clipping extent, along
+    // each axis. Bricks entirely outside become uniform.
+    int slab[6];
+    for (int i = 0; i < 3; i++)
+      {
+      for (int j = 0; j < 2; j++)
+        {
+        for (int k = 0; k < 6; k++)
+          {
+          slab[k] = currentExtent[k];
+          }
+        if (j == 0)
+          {
+          slab[2*i+1] = extent[2*i] - 1;
+          }
+        else
+          {
+          slab[2*i] = extent[2*i+1] + 1;
+          }
+        if (slab[2*i] <= slab[2*i+1])
+          {
+          this->Bricks->FillExtent( slab, vtkKWEPaintbrushLabelData::NoLabelValue );
+          }
+        }
+      }
+    this->LabelMapModified();
+    this->LabelCountsMTime = 0; // labels will be counted again
+    this->Modified();
+    return 1;
+    }
 
-  bool remove = false, removed = false;
+  // The labels outside the clipping extents are blanked out, a slab or a
+  // row at a time. The label counts, if valid, are updated along.
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  vtkKWEPaintbrushLabelDataCounts counts;
+  vtkKWEPaintbrushLabelDataCounts *c =
+    this->LabelCountsAreValid() ? &counts : NULL;
 
-  vtkKWEPaintbrushEnums::LabelType *ptr =
-    static_cast<vtkKWEPaintbrushEnums::LabelType *>(this->LabelMap->GetScalarPointer());
+  LabelType *ptr = static_cast< LabelType * >(
+                        this->LabelMap->GetScalarPointer());
+  const vtkIdType nx = currentExtent[1] - currentExtent[0] + 1;
+  const vtkIdType incZ = nx * (currentExtent[3] - currentExtent[2] + 1);
 
-  for (idz=currentExtent[4]; idz<=currentExtent[5]; idz++)
+  int clipExtent[6];
+  if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+         currentExtent, extent, clipExtent ))
+    {
+    vtkKWEPaintbrushLabelDataClear( ptr,
+        incZ * (currentExtent[5] - currentExtent[4] + 1), c );
+    }
+  else
     {
-    remove = (idz < extent[4] || idz > extent[5]);
-    for (idy = currentExtent[2]; idy <= currentExtent[3]; idy++)
+    // Slices below and above the clipping extents.
+    vtkKWEPaintbrushLabelDataClear( ptr,
+        incZ * (clipExtent[4] - currentExtent[4]), c );
+    vtkKWEPaintbrushLabelDataClear(
+        ptr + incZ * (clipExtent[5] + 1 - currentExtent[4]),
+        incZ * (currentExtent[5] - clipExtent[5]), c );
+
+    const vtkIdType left  = clipExtent[0] - currentExtent[0];
+    const vtkIdType right = currentExtent[1] - clipExtent[1];
+    for (int idz = clipExtent[4]; idz <= clipExtent[5]; idz++)
       {
-      remove |= (idy < extent[2] || idy > extent[3]);
-      for (idx = currentExtent[4]; idx <= currentExtent[5]; idx++)
+      LabelType *slice = ptr + incZ * (idz - currentExtent[4]);
+
+      // Rows in front of and behind the clipping extents.
+      vtkKWEPaintbrushLabelDataClear( slice,
+          nx * (clipExtent[2] - currentExtent[2]), c );
+      vtkKWEPaintbrushLabelDataClear(
+          slice + nx * (clipExtent[3] + 1 - currentExtent[2]),
+          nx * (currentExtent[3] - clipExtent[3]), c );
+
+      // Voxels on either side of the clipping extents, in the other rows.
+      if (left || right)
         {
-        remove |= (idx < extent[4] || idx > extent[5]);
-        if (remove)
+        for (int idy = clipExtent[2]; idy <= clipExtent[3]; idy++)
           {
-          *ptr = vtkKWEPaintbrushLabelData::NoLabelValue;
+          LabelType *row = slice + nx * (idy - currentExtent[2]);
+          vtkKWEPaintbrushLabelDataClear( row, left, c );
+          vtkKWEPaintbrushLabelDataClear( row + nx - right, right, c );
           }
-        removed |= remove;
-        ++ptr;
         }
       }
     }
 
-  if (removed)
+  this->LabelMapModified();
+  this->Modified();
+
+  counts.Flush();
+  vtkKWEPaintbrushLabelDataCounts::ChangesType::const_iterator it;
+  for (it = counts.Changes.begin(); it != counts.Changes.end(); ++it)
     {
-    this->LabelMap->Modified();
-    this->Modified();
+    this->ChangeLabelCount( it->first, it->second );
     }
 
-  return (removed ? 1 : 0);
+  return 1;
 }
 
 //----------------------------------------------------------------------------
@@ -936,6 +1154,12 @@ int vtkKWEPaintbrushLabelData::IsInside(double p[3])
       }
     }
 
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    return this->Bricks->IsAllocated() ? static_cast<int>(
+      this->Bricks->GetLabel(pixelPos[0], pixelPos[1], pixelPos[2])) : 0;
+    }
+
   return static_cast<int>(*(static_cast<vtkKWEPaintbrushEnums::LabelType *>
                 (this->LabelMap->GetScalarPointer(pixelPos))));
 }
@@ -967,7 +1191,18 @@ void vtkKWEPaintbrushLabelData::GetOrigin( double s[3] )
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushLabelData::GetPaintbrushDataAsImageData(vtkImageData *image)
 {
-  image->ShallowCopy(this->LabelMap);
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Dense ||
+      !this->Bricks->IsAllocated())
+    {
+    image->ShallowCopy(this->LabelMap);
+    return;
+    }
+
+  image->CopyStructure( this->LabelMap );
+  image->SetScalarType( vtkKWEPaintbrushEnums::GetLabelType() );
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  this->Bricks->CopyToImage( image );
 }
 
 //----------------------------------------------------------------------------
@@ -975,9 +1210,87 @@ unsigned long vtkKWEPaintbrushLabelData::GetMTime()
 {
   unsigned long t = this->LabelMap->GetMTime();
   unsigned long mtime = vtkObject::GetMTime();
+  if (t > mtime)
+    {
+    mtime = t;
+    }
+  t = this->Bricks->GetMTime();
   return (mtime > t ? mtime : t);
 }
 
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::SetStorageMode( int mode )
+{
+  mode = (mode == Sparse) ? Sparse : Dense;
+  if (mode == this->StorageMode)
+    {
+    return;
+    }
+
+  // Changing the storage does not change any label, so recorded deltas and
+  // label counts remain valid.
+  this->CheckForUnrecordedModifications();
+  const bool counted = this->LabelCountsAreValid();
+  this->StorageMode = mode;
+
+  if (mode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    if (this->LabelMap->GetPointData()->GetScalars())
+      {
+      this->MoveLabelMapToBricks();
+      }
+    }
+  else
+    {
+    if (this->Bricks->IsAllocated())
+      {
+      this->LabelMap->SetScalarType( vtkKWEPaintbrushEnums::GetLabelType() );
+      this->LabelMap->SetNumberOfScalarComponents(1);
+      this->LabelMap->AllocateScalars();
+      this->Bricks->CopyToImage( this->LabelMap );
+      this->Bricks->Initialize();
+      }
+    }
+
+  this->RecordedLabelMapMTime = this->LabelMap->GetMTime();
+  if (counted)
+    {
+    this->LabelCountsMTime = this->LabelMap->GetMTime();
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::MoveLabelMapToBricks()
+{
+  int extent[6];
+  this->LabelMap->GetExtent(extent);
+  this->Bricks->Allocate( extent, vtkKWEPaintbrushLabelData::NoLabelValue );
+  this->Bricks->CopyFromImage( this->LabelMap );
+
+  // Keep the geometry of the label map, not its scalars. The label map may
+  // belong to the application, so replace it rather than release them.
+  vtkImageData *geometry = vtkImageData::New();
+  geometry->CopyStructure( this->LabelMap );
+  geometry->SetScalarType( vtkKWEPaintbrushEnums::GetLabelType() );
+  geometry->SetNumberOfScalarComponents(1);
+  vtkSetObjectBodyMacro( LabelMap, vtkImageData, geometry );
+  geometry->Delete();
+}
+
+//----------------------------------------------------------------------------
+const vtkKWEPaintbrushEnums::LabelType *vtkKWEPaintbrushLabelData
+::GetLabelRow( int x1, int x2, int y, int z,
+               vtkKWEPaintbrushEnums::LabelType *buffer )
+{
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    return this->Bricks->GetRow( x1, x2, y, z, buffer );
+    }
+  return static_cast< vtkKWEPaintbrushEnums::LabelType * >(
+      this->LabelMap->GetScalarPointer( x1, y, z ));
+}
+
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushLabelData::SetNoLabelValue(
                   vtkKWEPaintbrushEnums::LabelType label )
@@ -1006,25 +1319,364 @@ int vtkKWEPaintbrushLabelData::IsMutable(
   return (this->ImmutableLabels.find(label) == this->ImmutableLabels.end()) ? 0 : 1;
 }
 
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::SetDeltaRecorder(
+                          vtkKWEPaintbrushLabelDelta *recorder )
+{
+  this->DeltaRecorder = recorder;
+  if (recorder)
+    {
+    recorder->SetNumberOfVoxels( this->LabelMap->GetNumberOfPoints() );
+    }
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkKWEPaintbrushLabelData::GetUnrecordedModificationTime()
+{
+  this->CheckForUnrecordedModifications();
+  return this->UnrecordedModificationTime.GetMTime();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::CheckForUnrecordedModifications()
+{
+  const unsigned long labelMapMTime = this->LabelMap->GetMTime();
+  if (labelMapMTime > this->RecordedLabelMapMTime)
+    {
+    this->UnrecordedModificationTime.Modified();
+    this->RecordedLabelMapMTime = labelMapMTime;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::LabelMapModified()
+{
+  // The label counts, if valid, were updated along with the labels.
+  const bool counted = (this->LabelCountsMTime == this->LabelMap->GetMTime());
+  this->LabelMap->Modified();
+  if (counted)
+    {
+    this->LabelCountsMTime = this->LabelMap->GetMTime();
+    }
+  if (!this->DeltaRecorder)
+    {
+    this->UnrecordedModificationTime.Modified();
+    }
+  this->RecordedLabelMapMTime = this->LabelMap->GetMTime();
+}
+
 //----------------------------------------------------------------------------
 vtkKWEPaintbrushLabelData::LabelSetType vtkKWEPaintbrushLabelData::GetLabels()
 {
-  LabelSetType labels;
-  vtkDataArray * array = this->LabelMap->GetPointData()->GetScalars();
-  vtkKWEPaintbrushEnums::LabelType *arrayPointer =
-    static_cast<vtkKWEPaintbrushEnums::LabelType *>(array->GetVoidPointer(0));
+  this->UpdateLabelCounts();
+  LabelSetType labels = this->PresentLabels;
+  labels.erase( NoLabelValue );
+  return labels;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkKWEPaintbrushLabelData::GetNumberOfVoxels(
+                       vtkKWEPaintbrushEnums::LabelType label )
+{
+  this->UpdateLabelCounts();
+  return this->LabelCounts[vtkKWEPaintbrushLabelDataCountIndex(label)];
+}
+
+//----------------------------------------------------------------------------
+bool vtkKWEPaintbrushLabelData::LabelCountsAreValid()
+{
+  return !this->LabelCounts.empty() &&
+         this->LabelCountsMTime == this->LabelMap->GetMTime();
+}
 
-  const unsigned long size = array->GetDataSize();
-  for (unsigned long i = 0; i < size; ++i, ++arrayPointer)
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::UpdateLabelCounts()
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  vtkstd::vector< vtkIdType > counts;
+
+  if (this->LabelCountsAreValid())
     {
-    vtkKWEPaintbrushEnums::LabelType l = *arrayPointer;
-    if (l != NoLabelValue)
+    if (!this->CheckLabelCounts)
+      {
+      return;
+      }
+    this->CountLabels(counts);
+    if (counts == this->LabelCounts)
       {
-      labels.insert(l);
+      return;
       }
+    vtkErrorMacro( << "The label counts do not match the labels." );
+    }
+  else
+    {
+    this->CountLabels(counts);
     }
 
-  return labels;
+  this->LabelCounts.swap(counts);
+  this->PresentLabels.clear();
+  const vtkIdType n = static_cast< vtkIdType >(this->LabelCounts.size());
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    if (this->LabelCounts[i])
+      {
+      this->PresentLabels.insert( static_cast< LabelType >(i +
+          static_cast< vtkIdType >(std::numeric_limits< LabelType >::min())));
+      }
+    }
+  this->LabelCountsMTime = this->LabelMap->GetMTime();
+}
+
+//----------------------------------------------------------------------------
+// Everything needed to count or relabel every voxel from several threads.
+// Dense labels are split into pieces of consecutive voxels, sparse labels
+// into slabs of slices.
+struct vtkKWEPaintbrushLabelDataVoxelsStruct
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+
+  int                          NumberOfPieces;
+
+  // Our labels if dense, or their bricks, spanning Extent, if sparse.
+  LabelType                   *Labels;
+  vtkIdType                    NumberOfVoxels;
+  vtkKWEPaintbrushLabelBricks *Bricks;
+  int                          Extent[6];
+
+  // If set, labels are replaced through this table, indexed by
+  // vtkKWEPaintbrushLabelDataCountIndex. If not, piece i counts the voxels
+  // of each label into Counts[i].
+  const LabelType             *Lut;
+  vtkstd::vector< vtkIdType > *Counts;
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE vtkKWEPaintbrushLabelDataVoxelsThreadedExecute(
+                                                                void *arg )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast< vtkMultiThreader::ThreadInfo * >(arg);
+  vtkKWEPaintbrushLabelDataVoxelsStruct *str =
+    static_cast< vtkKWEPaintbrushLabelDataVoxelsStruct * >(info->UserData);
+
+  const int piece = info->ThreadID;
+  if (piece >= str->NumberOfPieces)
+    {
+    return VTK_THREAD_RETURN_VALUE;
+    }
+
+  if (str->Labels)
+    {
+    LabelType *ptr = str->Labels +
+      str->NumberOfVoxels * piece / str->NumberOfPieces;
+    LabelType *ptrEnd = str->Labels +
+      str->NumberOfVoxels * (piece + 1) / str->NumberOfPieces;
+    if (str->Lut)
+      {
+      const LabelType *lut = str->Lut;
+      for (; ptr != ptrEnd; ++ptr)
+        {
+        *ptr = lut[vtkKWEPaintbrushLabelDataCountIndex(*ptr)];
+        }
+      }
+    else
+      {
+      vtkIdType *counts = &str->Counts[piece][0];
+      for (; ptr != ptrEnd; ++ptr)
+        {
+        ++counts[vtkKWEPaintbrushLabelDataCountIndex(*ptr)];
+        }
+      }
+    return VTK_THREAD_RETURN_VALUE;
+    }
+
+  const int *extent = str->Extent;
+  const int nz = extent[5] - extent[4] + 1;
+  const int z1 = extent[4] + nz * piece / str->NumberOfPieces;
+  const int z2 = extent[4] + nz * (piece + 1) / str->NumberOfPieces - 1;
+  vtkstd::vector< LabelType > buffer( extent[1] - extent[0] + 1 );
+  vtkIdType *counts = &str->Counts[piece][0];
+  for (int z = z1; z <= z2; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      const LabelType *row = str->Bricks->GetRow(
+                      extent[0], extent[1], y, z, &buffer[0] );
+      for (size_t i = 0; i < buffer.size(); i++)
+        {
+        ++counts[vtkKWEPaintbrushLabelDataCountIndex(row[i])];
+        }
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+// Split the voxels into as many pieces as they are worth threads.
+static void vtkKWEPaintbrushLabelDataSetNumberOfPieces(
+    vtkKWEPaintbrushLabelDataVoxelsStruct *str, int numberOfThreads )
+{
+  const vtkIdType maxPieces = str->Labels ? str->NumberOfVoxels :
+                              str->Extent[5] - str->Extent[4] + 1;
+  vtkIdType numberOfPieces =
+    str->NumberOfVoxels / VTK_KWE_LABEL_DATA_MIN_VOXELS_PER_SLAB;
+  numberOfPieces = (numberOfPieces > numberOfThreads)
+                                    ? numberOfThreads : numberOfPieces;
+  numberOfPieces = (numberOfPieces > maxPieces) ? maxPieces : numberOfPieces;
+  str->NumberOfPieces = (numberOfPieces < 1)
+                            ? 1 : static_cast< int >(numberOfPieces);
+}
+
+//----------------------------------------------------------------------------
+// Count or relabel the voxels, one piece per thread.
+static void vtkKWEPaintbrushLabelDataExecuteOnVoxels(
+    vtkKWEPaintbrushLabelDataVoxelsStruct *str, vtkMultiThreader *threader )
+{
+  if (str->NumberOfPieces == 1)
+    {
+    vtkMultiThreader::ThreadInfo info;
+    info.ThreadID = 0;
+    info.UserData = str;
+    vtkKWEPaintbrushLabelDataVoxelsThreadedExecute(&info);
+    return;
+    }
+
+  threader->SetNumberOfThreads(str->NumberOfPieces);
+  threader->SetSingleMethod(
+      vtkKWEPaintbrushLabelDataVoxelsThreadedExecute, str);
+  threader->SingleMethodExecute();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::CountLabels( vtkstd::vector< vtkIdType > &counts )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  const size_t numberOfLabels = static_cast< size_t >(
+    vtkKWEPaintbrushLabelDataCountIndex(std::numeric_limits< LabelType >::max()) + 1);
+  counts.assign( numberOfLabels, 0 );
+
+  vtkKWEPaintbrushLabelDataVoxelsStruct str;
+  str.Labels = NULL;
+  str.Bricks = NULL;
+  str.Lut    = NULL;
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Dense)
+    {
+    vtkDataArray * array = this->LabelMap->GetPointData()->GetScalars();
+    if (!array)
+      {
+      return;
+      }
+    str.Labels = static_cast< LabelType * >(array->GetVoidPointer(0));
+    str.NumberOfVoxels = array->GetDataSize();
+    }
+  else
+    {
+    if (!this->Bricks->IsAllocated())
+      {
+      return;
+      }
+    str.Bricks = this->Bricks;
+    this->Bricks->GetExtent(str.Extent);
+    str.NumberOfVoxels =
+      static_cast< vtkIdType >(str.Extent[1] - str.Extent[0] + 1) *
+      (str.Extent[3] - str.Extent[2] + 1) * (str.Extent[5] - str.Extent[4] + 1);
+    }
+
+  // Each piece counts into its own table. The tables are then summed.
+  vtkKWEPaintbrushLabelDataSetNumberOfPieces( &str, this->NumberOfThreads );
+  vtkstd::vector< vtkstd::vector< vtkIdType > > pieceCounts( str.NumberOfPieces );
+  str.Counts = &pieceCounts[0];
+  pieceCounts[0].swap(counts);
+  for (int i = 1; i < str.NumberOfPieces; i++)
+    {
+    pieceCounts[i].assign( numberOfLabels, 0 );
+    }
+
+  vtkKWEPaintbrushLabelDataExecuteOnVoxels( &str, this->Threader );
+
+  counts.swap(pieceCounts[0]);
+  for (int i = 1; i < str.NumberOfPieces; i++)
+    {
+    const vtkIdType *pieceCount = &pieceCounts[i][0];
+    for (size_t l = 0; l < numberOfLabels; l++)
+      {
+      counts[l] += pieceCount[l];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::ChangeLabelCount(
+    vtkKWEPaintbrushEnums::LabelType label, vtkIdType n )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  if (n == 0)
+    {
+    return;
+    }
+  if (this->LabelCounts.empty())
+    {
+    this->LabelCounts.resize( static_cast< size_t >(
+      vtkKWEPaintbrushLabelDataCountIndex(
+        std::numeric_limits< LabelType >::max()) + 1), 0 );
+    }
+
+  vtkIdType &count = this->LabelCounts[vtkKWEPaintbrushLabelDataCountIndex(label)];
+  const bool wasPresent = (count != 0);
+  count += n;
+  if (count && !wasPresent)
+    {
+    this->PresentLabels.insert(label);
+    }
+  else if (!count && wasPresent)
+    {
+    this->PresentLabels.erase(label);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelData::CountLabelsReplaced( vtkIdType offset,
+    vtkIdType length, vtkKWEPaintbrushEnums::LabelType label )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  if (!this->LabelCountsAreValid())
+    {
+    return;
+    }
+
+  int extent[6];
+  this->LabelMap->GetExtent(extent);
+  const vtkIdType dx = extent[1] - extent[0] + 1;
+  const vtkIdType dy = extent[3] - extent[2] + 1;
+  vtkstd::vector< LabelType > buffer( static_cast< size_t >(dx) );
+  vtkKWEPaintbrushLabelDataCounts counts;
+
+  while (length > 0)
+    {
+    // Up to the end of the row.
+    const int x = static_cast< int >(offset % dx) + extent[0];
+    const int y = static_cast< int >((offset / dx) % dy) + extent[2];
+    const int z = static_cast< int >(offset / (dx * dy)) + extent[4];
+    vtkIdType n = dx - (x - extent[0]);
+    n = (n > length) ? length : n;
+
+    const LabelType *row = this->GetLabelRow(
+        x, x + static_cast< int >(n) - 1, y, z, &buffer[0] );
+    for (vtkIdType i = 0; i < n; i++)
+      {
+      counts.Change( row[i], label );
+      }
+    offset += n;
+    length -= n;
+    }
+
+  counts.Flush();
+  vtkKWEPaintbrushLabelDataCounts::ChangesType::const_iterator it;
+  for (it = counts.Changes.begin(); it != counts.Changes.end(); ++it)
+    {
+    this->ChangeLabelCount( it->first, it->second );
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -1062,25 +1714,62 @@ void vtkKWEPaintbrushLabelData::RelabelDataToContiguousLabels()
 
   // Now visit every label in the image and re-map it to its contiguous value.
 
-  if (!isContiguous)
+  if (isContiguous)
     {
-    vtkDataArray * array = this->LabelMap->GetPointData()->GetScalars();
-    vtkKWEPaintbrushEnums::LabelType *arrayPointer =
-      static_cast<vtkKWEPaintbrushEnums::LabelType *>(array->GetVoidPointer(0));
+    return;
+    }
 
-    const unsigned long size = array->GetDataSize();
-    for (unsigned long i = 0; i < size; ++i, ++arrayPointer)
-      {
-      vtkKWEPaintbrushEnums::LabelType l = *arrayPointer;
-      if (l != NoLabelValue)
-        {
-        *arrayPointer = relabelMap[l];
-        }
-      }
+  // A table covering every value of the label type, negative ones included,
+  // so that voxels are looked up without a test. Labels not present,
+  // NoLabelValue among them, map to themselves.
+  vtkstd::vector< LabelType > lut( static_cast< size_t >(
+    vtkKWEPaintbrushLabelDataCountIndex(std::numeric_limits< LabelType >::max()) + 1) );
+  for (size_t l = 0; l < lut.size(); l++)
+    {
+    lut[l] = static_cast< LabelType >(static_cast< vtkIdType >(l) +
+        static_cast< vtkIdType >(std::numeric_limits< LabelType >::min()));
+    }
+  for (RelabelMapType::const_iterator rit = relabelMap.begin();
+       rit != relabelMap.end(); ++rit)
+    {
+    lut[vtkKWEPaintbrushLabelDataCountIndex(rit->first)] = rit->second;
+    }
 
-    this->LabelMap->Modified();
-    this->Modified();
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    this->Bricks->Relabel( lut );
+    }
+  else
+    {
+    vtkDataArray * array = this->LabelMap->GetPointData()->GetScalars();
+    vtkKWEPaintbrushLabelDataVoxelsStruct str;
+    str.Labels = static_cast< LabelType * >(array->GetVoidPointer(0));
+    str.NumberOfVoxels = array->GetDataSize();
+    str.Bricks = NULL;
+    str.Lut    = &lut[0];
+    str.Counts = NULL;
+    vtkKWEPaintbrushLabelDataSetNumberOfPieces( &str, this->NumberOfThreads );
+    vtkKWEPaintbrushLabelDataExecuteOnVoxels( &str, this->Threader );
     }
+
+  // Move the label counts along with the labels. GetLabels made them
+  // valid.
+  vtkstd::vector< vtkstd::pair< LabelType, vtkIdType > > moved;
+  for (RelabelMapType::const_iterator rit = relabelMap.begin();
+       rit != relabelMap.end(); ++rit)
+    {
+    const vtkIdType n = this->LabelCounts[
+      vtkKWEPaintbrushLabelDataCountIndex(rit->first)];
+    this->ChangeLabelCount( rit->first, -n );
+    moved.push_back( vtkstd::pair< LabelType, vtkIdType >(rit->second, n) );
+    }
+  for (size_t m = 0; m < moved.size(); m++)
+    {
+    this->ChangeLabelCount( moved[m].first, moved[m].second );
+    }
+
+  this->LabelMapModified();
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -1147,12 +1836,26 @@ void vtkKWEPaintbrushLabelData::SetLabelMap( vtkImageData * labelMap )
 
     }
 
+  if (this->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    this->MoveLabelMapToBricks();
+    }
+
+  // The labels will be counted again.
+  this->LabelCountsMTime = 0;
+
+  this->UnrecordedModificationTime.Modified();
 }
 
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushLabelData::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "StorageMode: "
+     << (this->StorageMode == Sparse ? "Sparse" : "Dense") << "\n";
+  os << indent << "Bricks: " << this->Bricks << "\n";
+  os << indent << "CheckLabelCounts: " << this->CheckLabelCounts << "\n";
   os << indent << "LabelMap:\n";
   if (this->LabelMap)
     {
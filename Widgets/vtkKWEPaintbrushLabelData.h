@@ -29,17 +29,22 @@
 #define __vtkKWEPaintbrushLabelData_h
 
 #include "vtkKWEPaintbrushData.h"
+#include "vtkMultiThreader.h" // for VTK_MAX_THREADS
 #include <vtkstd/set>
+#include <vtkstd/vector> // for LabelCounts
 
 class vtkImageData;
 class vtkKWEPaintbrushSketch;
 class vtkKWEPaintbrushStencilData;
+class vtkKWEPaintbrushLabelDelta;
+class vtkKWEPaintbrushLabelBricks;
 
 class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushLabelData
                                  : public vtkKWEPaintbrushData
 {
   //BTX
   friend class vtkKWEPaintbrushSketch;
+  friend class vtkKWEPaintbrushLabelDelta;
   //ETX
 public:
   static vtkKWEPaintbrushLabelData *New();
@@ -49,13 +54,44 @@ public:
   void DeepCopy(vtkDataObject *o);
   void ShallowCopy(vtkDataObject *f);
 
+  // Description:
+  // How the labels are stored. Dense (default) stores them in a
+  // vtkImageData covering the whole extent. Sparse stores them in bricks of
+  // 32x32x32 voxels, collapsed to a single label when uniform, which takes
+  // a fraction of the memory when the segmentation covers a small part of
+  // the volume. See vtkKWEPaintbrushLabelBricks. Changing the storage mode
+  // converts the current labels.
+  //BTX
+  enum StorageModeType { Dense = 0, Sparse };
+  //ETX
+  virtual void SetStorageMode( int );
+  vtkGetMacro( StorageMode, int );
+  void SetStorageModeToDense()  { this->SetStorageMode(Dense); }
+  void SetStorageModeToSparse() { this->SetStorageMode(Sparse); }
+
   // Description:
   // Set/Get the label map.
   // This method should be used if you wish to initialize the class from an
-  // existing label map.
+  // existing label map. In Sparse storage mode, the label map returned only
+  // holds the extent, origin and spacing. Read the labels through
+  // GetLabelRow, or copy them with GetPaintbrushDataAsImageData.
   virtual void SetLabelMap( vtkImageData * );
   vtkGetObjectMacro( LabelMap, vtkImageData );
 
+  // Description:
+  // The bricks holding the labels in Sparse storage mode.
+  vtkGetObjectMacro( Bricks, vtkKWEPaintbrushLabelBricks );
+
+  //BTX
+  // Description:
+  // Labels of the voxels x1 to x2 of a row, in either storage mode. The
+  // returned pointer is either into the labels themselves, or to "buffer",
+  // which must have room for x2 - x1 + 1 labels. The row must lie within
+  // the extent. This is safe to call from several threads.
+  const vtkKWEPaintbrushEnums::LabelType *GetLabelRow( int x1, int x2,
+      int y, int z, vtkKWEPaintbrushEnums::LabelType *buffer );
+  //ETX
+
   // Description:
   // Minkowski operations.
   // The arguments can be both vtkKWEPaintbrushStencilData or
@@ -64,6 +100,15 @@ public:
   virtual int  Subtract( vtkKWEPaintbrushData *, bool forceMutable=false );
   virtual int  Replace( vtkKWEPaintbrushData *, bool forceMutable=false );
 
+  // Description:
+  // Maximum number of threads used by Add, Subtract and Replace. The region
+  // operated upon is split into slabs along Z, one per thread. Small regions
+  // are processed in fewer slabs, or in the calling thread. The result,
+  // including the changes recorded for undo, does not depend on the number
+  // of threads. Defaults to the number of processors.
+  vtkSetClampMacro( NumberOfThreads, int, 1, VTK_MAX_THREADS );
+  vtkGetMacro( NumberOfThreads, int );
+
   // Description:
   // Clip self with supplied extents. Return 1 if something changed
   virtual int Clip( int extent[6] );
@@ -98,7 +143,8 @@ public:
   // Description:
   // Get the label data as an image data. This is present merely to satisfy the
   // superclass requirement. It is preferred that you use the method above
-  // instead.
+  // instead. In Sparse storage mode, the labels are copied into the image
+  // every time this is called.
   virtual void GetPaintbrushDataAsImageData( vtkImageData * );
 
   // Description:
@@ -137,14 +183,43 @@ public:
   static void SetNoLabelValue( vtkKWEPaintbrushEnums::LabelType label );
   static vtkKWEPaintbrushEnums::LabelType NoLabelValue;
 
+  // Description:
+  // INTERNAL - Do not use.
+  // While a delta recorder is set, every voxel whose label is changed by
+  // Add, Subtract or Replace is recorded in it, along with its previous
+  // label. Sketches use this to undo strokes incrementally. The recorder is
+  // not reference counted.
+  void SetDeltaRecorder( vtkKWEPaintbrushLabelDelta * );
+  vtkKWEPaintbrushLabelDelta *GetDeltaRecorder() { return this->DeltaRecorder; }
+
+  // Description:
+  // INTERNAL - Do not use.
+  // Time of the last change to the label map that was not recorded in a
+  // delta. Deltas older than this may no longer be undone.
+  unsigned long GetUnrecordedModificationTime();
+
   //BTX
   // Description:
-  // Get the labels that are present in this image. This will visit every single
-  // voxel in the LabelMap and add it to the resulting set.
+  // Get the labels that are present in this image. See GetNumberOfVoxels.
   typedef vtkstd::set< vtkKWEPaintbrushEnums::LabelType > LabelSetType;
   LabelSetType GetLabels();
   //ETX
 
+  // Description:
+  // Number of voxels with the supplied label. The number of voxels of each
+  // label is updated as labels are changed by this class, so that this and
+  // GetLabels do not need to visit the voxels. After the label map was
+  // changed by others, the voxels are counted again on the next query.
+  vtkIdType GetNumberOfVoxels( vtkKWEPaintbrushEnums::LabelType label );
+
+  // Description:
+  // Debugging aid. If on, the number of voxels of each label is checked
+  // against a count of every voxel, each time it is queried. Mismatches are
+  // reported as errors. Off by default.
+  vtkSetMacro( CheckLabelCounts, int );
+  vtkGetMacro( CheckLabelCounts, int );
+  vtkBooleanMacro( CheckLabelCounts, int );
+
   // Description:
   // Convenience method to collapse the labels in a label map. Consider a label
   // map with labels of 32, 64, 125, 255 and a NoLabelValue of 0. This will
@@ -160,10 +235,75 @@ protected:
   void CopyOriginAndSpacingFromPipeline();
 
   // Description:
-  // The actual 'data' is stored here.
-  vtkImageData *LabelMap;
+  // The actual 'data' is stored here. In Sparse storage mode, the label map
+  // has no scalars and only holds the extent, origin and spacing, while the
+  // labels are in the bricks.
+  vtkImageData                *LabelMap;
+  vtkKWEPaintbrushLabelBricks *Bricks;
+  int                          StorageMode;
+
+  // Description:
+  // Move the labels of the label map to the bricks, and replace the label
+  // map with one holding its geometry only.
+  void MoveLabelMapToBricks();
 
-  int AddStencil( vtkKWEPaintbrushStencilData * s, bool forceMutable );
+  // See SetDeltaRecorder
+  vtkKWEPaintbrushLabelDelta *DeltaRecorder;
+  vtkTimeStamp                UnrecordedModificationTime;
+  unsigned long               RecordedLabelMapMTime;
+
+  // Description:
+  // Changes made to the LabelMap by others than this class are not
+  // recorded. Detect them by comparing the modified time of the LabelMap
+  // with its value after the last recorded change.
+  void CheckForUnrecordedModifications();
+
+  // Description:
+  // To be called after the LabelMap was changed.
+  void LabelMapModified();
+
+  // Description:
+  // Apply one of the Minkowski operations to the supplied "extent", which
+  // must lie within our own extent and that of "data". Threaded over slabs.
+  void ExecuteOperation( int operation, vtkKWEPaintbrushData *data,
+                         int extent[6], bool forceMutable );
+
+  int               NumberOfThreads;
+  vtkMultiThreader *Threader;
+
+  //BTX
+  // Description:
+  // Number of voxels of each label, indexed by the label less the smallest
+  // value of the label type, and the labels present, ie. whose number of
+  // voxels is not 0. They are valid as long as LabelCountsMTime is the
+  // modified time of the LabelMap.
+  vtkstd::vector< vtkIdType > LabelCounts;
+  LabelSetType                PresentLabels;
+  unsigned long               LabelCountsMTime;
+  int                         CheckLabelCounts;
+  //ETX
+
+  // Description:
+  // Are the label counts valid ? UpdateLabelCounts counts the labels again
+  // if they are not, and checks them if CheckLabelCounts is on.
+  bool LabelCountsAreValid();
+  void UpdateLabelCounts();
+
+  // Description:
+  // Count the voxels of each label, visiting every voxel.
+  //BTX
+  void CountLabels( vtkstd::vector< vtkIdType > &counts );
+  //ETX
+
+  // Description:
+  // Add "n" to the number of voxels of a label.
+  void ChangeLabelCount( vtkKWEPaintbrushEnums::LabelType label, vtkIdType n );
+
+  // Description:
+  // Update the label counts for "length" voxels about to be set to "label",
+  // starting at voxel "offset" of the label map. Used to undo deltas.
+  void CountLabelsReplaced( vtkIdType offset, vtkIdType length,
+                            vtkKWEPaintbrushEnums::LabelType label );
 
 private:
   vtkKWEPaintbrushLabelData(const vtkKWEPaintbrushLabelData&);  // Not implemented.
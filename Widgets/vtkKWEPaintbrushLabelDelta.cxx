@@ -0,0 +1,197 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+#include "vtkKWEPaintbrushLabelDelta.h"
+
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkKWEPaintbrushLabelBricks.h"
+#include "vtkImageData.h"
+#include "vtkObjectFactory.h"
+
+vtkCxxRevisionMacro(vtkKWEPaintbrushLabelDelta, "$Revision: 1 $");
+vtkStandardNewMacro(vtkKWEPaintbrushLabelDelta);
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelDelta::vtkKWEPaintbrushLabelDelta()
+{
+  this->Complete       = 1;
+  this->NumberOfVoxels = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkKWEPaintbrushLabelDelta::~vtkKWEPaintbrushLabelDelta()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelDelta::Initialize()
+{
+  // Swap with an empty vector, so that the memory is actually released.
+  vtkstd::vector< vtkKWEPaintbrushLabelDeltaRun >().swap(this->Runs);
+  this->Complete = 1;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelDelta::Invalidate()
+{
+  vtkstd::vector< vtkKWEPaintbrushLabelDeltaRun >().swap(this->Runs);
+  this->Complete = 0;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkKWEPaintbrushLabelDelta::Undo( vtkKWEPaintbrushLabelData *labelData )
+{
+  if (!this->Complete || !labelData || !labelData->LabelMap)
+    {
+    return 0;
+    }
+
+  vtkImageData *labelMap = labelData->LabelMap;
+  if (!this->Runs.empty() &&
+      labelMap->GetNumberOfPoints() != this->NumberOfVoxels)
+    {
+    vtkErrorMacro( << "The delta was recorded on a label map with "
+      << this->NumberOfVoxels << " voxels, cannot undo it on one with "
+      << labelMap->GetNumberOfPoints() << " voxels.");
+    return 0;
+    }
+
+  // Restore in the reverse order of recording, so that a voxel changed more
+  // than once ends up with the label it had first.
+  vtkstd::vector< vtkKWEPaintbrushLabelDeltaRun >::reverse_iterator rit;
+  const bool counted = labelData->LabelCountsAreValid();
+  const unsigned long mtime = labelData->GetMTime();
+  vtkIdType first = VTK_LARGE_ID, last = -1;
+  if (labelData->StorageMode == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    vtkKWEPaintbrushLabelBricks *bricks = labelData->Bricks;
+    for (rit = this->Runs.rbegin(); rit != this->Runs.rend(); ++rit)
+      {
+      labelData->CountLabelsReplaced( rit->Offset, rit->Length, rit->Label );
+      bricks->FillVoxels( rit->Offset, rit->Length, rit->Label );
+      first = (rit->Offset < first) ? rit->Offset : first;
+      last = (rit->Offset + rit->Length - 1 > last)
+                  ? rit->Offset + rit->Length - 1 : last;
+      }
+    }
+  else
+    {
+    vtkKWEPaintbrushEnums::LabelType *labels =
+      static_cast< vtkKWEPaintbrushEnums::LabelType * >(
+                            labelMap->GetScalarPointer());
+    for (rit = this->Runs.rbegin(); rit != this->Runs.rend(); ++rit)
+      {
+      labelData->CountLabelsReplaced( rit->Offset, rit->Length, rit->Label );
+      vtkKWEPaintbrushEnums::LabelType *ptr    = labels + rit->Offset;
+      vtkKWEPaintbrushEnums::LabelType *ptrEnd = ptr + rit->Length;
+      const vtkKWEPaintbrushEnums::LabelType l = rit->Label;
+      while (ptr != ptrEnd)
+        {
+        *ptr++ = l;
+        }
+      first = (rit->Offset < first) ? rit->Offset : first;
+      last = (rit->Offset + rit->Length - 1 > last)
+                  ? rit->Offset + rit->Length - 1 : last;
+      }
+    }
+
+  // The slices touched, or the rows touched if that is a single slice.
+  int extent[6];
+  labelMap->GetExtent(extent);
+  const vtkIdType rowSize = extent[1] - extent[0] + 1;
+  const vtkIdType sliceSize = rowSize * (extent[3] - extent[2] + 1);
+  if (first <= last)
+    {
+    const int z0 = extent[4], y0 = extent[2];
+    extent[4] = z0 + static_cast< int >(first / sliceSize);
+    extent[5] = z0 + static_cast< int >(last / sliceSize);
+    if (extent[4] == extent[5])
+      {
+      extent[2] = y0 + static_cast< int >((first % sliceSize) / rowSize);
+      extent[3] = y0 + static_cast< int >((last % sliceSize) / rowSize);
+      }
+    }
+
+  // Collapse the bricks that became uniform again.
+  if (labelData->StorageMode == vtkKWEPaintbrushLabelData::Sparse &&
+      first <= last)
+    {
+    labelData->Bricks->Squeeze(extent);
+    }
+
+  // Restoring the labels is a recorded change, it leaves the other deltas
+  // valid. The label counts were updated along.
+  labelMap->Modified();
+  labelData->RecordedLabelMapMTime = labelMap->GetMTime();
+  if (counted)
+    {
+    labelData->LabelCountsMTime = labelMap->GetMTime();
+    }
+  if (first <= last)
+    {
+    labelData->ExtentModified(extent, mtime);
+    }
+  else
+    {
+    labelData->Modified();
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelDelta::Append( vtkKWEPaintbrushLabelDelta *delta )
+{
+  if (!delta || delta->Runs.empty())
+    {
+    return;
+    }
+
+  // The first appended run may continue our last one.
+  vtkstd::vector< vtkKWEPaintbrushLabelDeltaRun >::const_iterator
+                                          it = delta->Runs.begin();
+  if (!this->Runs.empty())
+    {
+    vtkKWEPaintbrushLabelDeltaRun &run = this->Runs.back();
+    if (run.Offset + run.Length == it->Offset && run.Label == it->Label)
+      {
+      run.Length += it->Length;
+      ++it;
+      }
+    }
+  this->Runs.insert(this->Runs.end(), it, delta->Runs.end());
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkKWEPaintbrushLabelDelta::GetActualMemorySize()
+{
+  return static_cast< unsigned long >(
+      (this->Runs.capacity() * sizeof(vtkKWEPaintbrushLabelDeltaRun)) / 1024);
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushLabelDelta::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Complete: " << this->Complete << endl;
+  os << indent << "NumberOfRuns: " << this->Runs.size() << endl;
+  os << indent << "NumberOfVoxels: " << this->NumberOfVoxels << endl;
+}
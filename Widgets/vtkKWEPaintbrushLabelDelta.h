@@ -0,0 +1,140 @@
+//=============================================================================
+//   This file is part of VTKEdge. See vtkedge.org for more information.
+//
+//   Copyright (c) 2010 Kitware, Inc.
+//
+//   VTKEdge may be used under the terms of the BSD License
+//   Please see the file Copyright.txt in the root directory of
+//   VTKEdge for further information.
+//
+//   Alternatively, you may see:
+//
+//   http://www.vtkedge.org/vtkedge/project/license.html
+//
+//
+//   For custom extensions, consulting services, or training for
+//   this or any other Kitware supported open source project, please
+//   contact Kitware at sales@kitware.com.
+//
+//
+//=============================================================================
+// .NAME vtkKWEPaintbrushLabelDelta - Reversible record of the voxels changed in a label map
+// .SECTION Description
+// vtkKWEPaintbrushLabelDelta records, in run length encoded form, the voxels
+// of a vtkKWEPaintbrushLabelData whose label was changed by a stroke, along
+// with the label each of them had before. Restoring those labels undoes the
+// stroke at a cost proportional to the size of the stroke, rather than to
+// the size of the label map or the number of strokes in the drawing.
+//
+// Recording is done by the label data itself, while the delta is set as its
+// recorder (see vtkKWEPaintbrushLabelData::SetDeltaRecorder). Each sketch
+// maintains one delta per stroke, for undo/redo on label maps.
+// .SECTION See Also
+// vtkKWEPaintbrushSketch vtkKWEPaintbrushLabelData
+
+#ifndef __vtkKWEPaintbrushLabelDelta_h
+#define __vtkKWEPaintbrushLabelDelta_h
+
+#include "VTKEdgeConfigure.h" // needed for export symbols directives
+#include "vtkKWEPaintbrushEnums.h"
+#include "vtkObject.h"
+#include <vtkstd/vector> // for the runs
+
+class vtkKWEPaintbrushLabelData;
+
+class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushLabelDelta : public vtkObject
+{
+public:
+  static vtkKWEPaintbrushLabelDelta *New();
+  vtkTypeRevisionMacro(vtkKWEPaintbrushLabelDelta, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // Discard all recorded runs. The delta is complete after this call; ie it
+  // accounts for every change made since, as long as it is being recorded.
+  void Initialize();
+
+  // Description:
+  // Discard all recorded runs and mark the delta as incomplete. This must be
+  // called when changes were made without recording them, or when the
+  // recorded labels may no longer be the ones preceding the stroke.
+  void Invalidate();
+
+  // Description:
+  // Does the delta account for every change made by its stroke ? Only
+  // complete deltas can be undone.
+  vtkGetMacro( Complete, int );
+
+  // Description:
+  // Restore the recorded labels in the label data, in the reverse order of
+  // their recording. Returns 0 if the delta is incomplete or was recorded
+  // on a label map of a different size.
+  int Undo( vtkKWEPaintbrushLabelData * );
+
+  // Description:
+  // Number of runs and approximate memory used by the delta, in kilobytes.
+  vtkIdType GetNumberOfRuns()
+    { return static_cast< vtkIdType >(this->Runs.size()); }
+  unsigned long GetActualMemorySize();
+
+  // Description:
+  // INTERNAL - Do not use.
+  // Number of voxels in the label map being recorded. Set by the label data
+  // when recording starts.
+  vtkSetMacro( NumberOfVoxels, vtkIdType );
+
+  // Description:
+  // INTERNAL - Do not use.
+  // Append the runs recorded in another delta, as if they had been recorded
+  // in this one after its own runs. The label data records each slab of a
+  // threaded operation in its own delta and appends them in slab order.
+  void Append( vtkKWEPaintbrushLabelDelta * );
+
+  //BTX
+  // Description:
+  // INTERNAL - Do not use.
+  // Record that the voxel at "offset" in the label map is about to change
+  // from "previousLabel". Consecutive voxels with the same previous label
+  // are merged into one run.
+  void Record( vtkIdType offset, vtkKWEPaintbrushEnums::LabelType previousLabel )
+    {
+    if (!this->Runs.empty())
+      {
+      vtkKWEPaintbrushLabelDeltaRun &run = this->Runs.back();
+      if (run.Offset + run.Length == offset && run.Label == previousLabel)
+        {
+        ++run.Length;
+        return;
+        }
+      }
+    vtkKWEPaintbrushLabelDeltaRun run;
+    run.Offset = offset;
+    run.Length = 1;
+    run.Label  = previousLabel;
+    this->Runs.push_back(run);
+    }
+  //ETX
+
+protected:
+  vtkKWEPaintbrushLabelDelta();
+  ~vtkKWEPaintbrushLabelDelta();
+
+  //BTX
+  struct vtkKWEPaintbrushLabelDeltaRun
+    {
+    vtkIdType                        Offset;
+    vtkIdType                        Length;
+    vtkKWEPaintbrushEnums::LabelType Label;
+    };
+  vtkstd::vector< vtkKWEPaintbrushLabelDeltaRun > Runs;
+  //ETX
+
+  int       Complete;
+  vtkIdType NumberOfVoxels;
+
+private:
+  vtkKWEPaintbrushLabelDelta(const vtkKWEPaintbrushLabelDelta&);  //Not implemented
+  void operator=(const vtkKWEPaintbrushLabelDelta&);  //Not implemented
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include "vtkKWEPaintbrushOperation.h"
 #include "vtkKWEPaintbrushShapeEllipsoid.h"
 #include "vtkKWEPaintbrushData.h"
+#include "vtkKWEPaintbrushStencilData.h"
 #include "vtkImageData.h"
 #include "vtkMath.h"
 #include "vtkObjectFactory.h"
@@ -37,6 +38,7 @@ vtkKWEPaintbrushOperation::vtkKWEPaintbrushOperation()
   this->PaintbrushShape    = NULL;
   this->Extent[0] = this->Extent[2] = this->Extent[4] = 0;
   this->Extent[1] = this->Extent[3] = this->Extent[5] = -1;
+  this->SweepStrokes       = 0;
 
   // Set a default shape
   vtkKWEPaintbrushShapeEllipsoid * paintbrushShape = vtkKWEPaintbrushShapeEllipsoid::New();
@@ -104,6 +106,59 @@ GetPaintbrushData(vtkKWEPaintbrushData *paintbrushData, double p[3],
     }
 }
 
+//----------------------------------------------------------------------
+int vtkKWEPaintbrushOperation::
+GetSweptPaintbrushData(vtkKWEPaintbrushData *paintbrushData,
+                       double p0[3], double p1[3],
+                       vtkKWEPaintbrushEnums::OperationType & op )
+{
+  vtkKWEPaintbrushStencilData *stencilData =
+    vtkKWEPaintbrushStencilData::SafeDownCast(paintbrushData);
+  if (!this->PaintbrushShape || !stencilData)
+    {
+    return 0;
+    }
+
+  // The segment must lie within the bounding extents, if any. Since they
+  // are convex, it suffices to check its end points.
+
+  const bool uninitializedExtent = (this->Extent[0] > this->Extent[1]);
+  if (!uninitializedExtent)
+    {
+    double spacing[3], origin[3];
+    this->PaintbrushShape->GetSpacing(spacing);
+    this->PaintbrushShape->GetOrigin(origin);
+
+    double bounds[6] =
+      { this->Extent[0] * spacing[0] + origin[0],
+        this->Extent[1] * spacing[0] + origin[0],
+        this->Extent[2] * spacing[1] + origin[1],
+        this->Extent[3] * spacing[1] + origin[1],
+        this->Extent[4] * spacing[2] + origin[2],
+        this->Extent[5] * spacing[2] + origin[2]  };
+
+    double tolerance[3] = {1e-10, 1e-10, 1e-10};
+    if (!vtkMath::PointIsWithinBounds( p0, bounds, tolerance ) ||
+        !vtkMath::PointIsWithinBounds( p1, bounds, tolerance ))
+      {
+      return 0;
+      }
+    }
+
+  if (!this->PaintbrushShape->GetSweptStencil(
+        stencilData->GetImageStencilData(), p0, p1))
+    {
+    return 0;
+    }
+
+  op = vtkKWEPaintbrushEnums::Add;
+  if (!uninitializedExtent)
+    {
+    paintbrushData->Clip( this->Extent );
+    }
+  return 1;
+}
+
 //----------------------------------------------------------------------
 void vtkKWEPaintbrushOperation::
 DoOperation( vtkKWEPaintbrushData *data, double p[3],
@@ -133,6 +188,7 @@ void vtkKWEPaintbrushOperation::DeepCopy(vtkKWEPaintbrushOperation *op)
     {
     this->PaintbrushShape->DeepCopy(op->PaintbrushShape);
     }
+  this->SweepStrokes = op->SweepStrokes;
   this->Modified();
 }
 
@@ -140,5 +196,6 @@ void vtkKWEPaintbrushOperation::DeepCopy(vtkKWEPaintbrushOperation *op)
 void vtkKWEPaintbrushOperation::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "SweepStrokes: " << this->SweepStrokes << endl;
 }
 
@@ -71,6 +71,27 @@ public:
   virtual void GetPaintbrushData(vtkKWEPaintbrushData *, double p[3],
                                  vtkKWEPaintbrushEnums::OperationType & op );
 
+  // Description:
+  // Sweep the shape along the segment between consecutive positions of a
+  // stroke, instead of stamping it at each position. This leaves no gaps
+  // when the mouse moves fast and rasterizes every segment once. Used only
+  // by binary (and label map) strokes, when both the shape and the operation
+  // support it. Defaults to OFF.
+  vtkSetMacro( SweepStrokes, int );
+  vtkGetMacro( SweepStrokes, int );
+  vtkBooleanMacro( SweepStrokes, int );
+
+  // Description:
+  // INTERNAL - Do not use.
+  // Get the paintbrush data swept by the shape moving from 'p0' to 'p1',
+  // filtered through this operation. Returns 0 if this cannot be done, in
+  // which case GetPaintbrushData must be used for each position instead.
+  // This class supports binary data, if the shape does. Subclasses that
+  // filter the data at each position should override this to return 0.
+  virtual int GetSweptPaintbrushData(vtkKWEPaintbrushData *,
+                                     double p0[3], double p1[3],
+                                     vtkKWEPaintbrushEnums::OperationType & op );
+
   // Description:
   // The default behaviour is "You are allowed to paint everywhere."
   // Optionally, you may retrict this via extents. ie. the operation will
@@ -96,6 +117,7 @@ protected:
   vtkImageData                 *ImageData;
   vtkKWEPaintbrushShape           *PaintbrushShape;
   int                           Extent[6];
+  int                           SweepStrokes;
 
 private:
   vtkKWEPaintbrushOperation(const vtkKWEPaintbrushOperation&);  //Not implemented
@@ -20,20 +20,274 @@
 //=============================================================================
 #include "vtkKWEPaintbrushOperationFloodFill.h"
 #include "vtkKWEPaintbrushShape.h"
+#include "vtkKWEPaintbrushStencilData.h"
+#include "vtkKWEPaintbrushLabelData.h"
+#include "vtkKWEPaintbrushUtilities.h"
+#include "vtkImageStencilData.h"
 #include "vtkImageData.h"
+#include "vtkMath.h"
 #include "vtkObjectFactory.h"
+#include <vtkstd/vector>
+#include <vtkstd/map>
+#include <vtkstd/algorithm>
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushOperationFloodFill, "$Revision: 1774 $");
 vtkStandardNewMacro(vtkKWEPaintbrushOperationFloodFill);
+vtkCxxSetObjectMacro(vtkKWEPaintbrushOperationFloodFill,LabelData,vtkKWEPaintbrushLabelData);
+
+//----------------------------------------------------------------------
+// Runs of filled voxels of a row, sorted along x. Runs are as long as the
+// criterion allows, so two runs of a row never touch.
+typedef vtkstd::pair< int, int > vtkKWEPaintbrushFloodFillRun;
+typedef vtkstd::vector< vtkKWEPaintbrushFloodFillRun >
+                                 vtkKWEPaintbrushFloodFillRuns;
+
+// Runs of the rows reached by the fill, keyed by (z,y), so that only those
+// rows are stored and they are visited in the order of a stencil.
+typedef vtkstd::map< vtkstd::pair< int, int >, vtkKWEPaintbrushFloodFillRuns >
+                                 vtkKWEPaintbrushFloodFillRows;
+
+// Voxels X1 to X2 of a row, left to explore.
+struct vtkKWEPaintbrushFloodFillSegment
+{
+  int X1, X2, Y, Z;
+};
+
+static bool vtkKWEPaintbrushFloodFillRunEndsBefore(
+  const vtkKWEPaintbrushFloodFillRun &run, int x )
+{
+  return run.second < x;
+}
+
+//----------------------------------------------------------------------
+// Voxels whose first component lies within [Min,Max].
+template <class T>
+class vtkKWEPaintbrushFloodFillIntensity
+{
+public:
+  vtkKWEPaintbrushFloodFillIntensity( vtkImageData *image,
+                                      double min, double max )
+    {
+    this->Min = min;
+    this->Max = max;
+    image->GetExtent(this->Extent);
+    image->GetIncrements(this->Increments);
+    this->Scalars = static_cast< T * >(image->GetScalarPointer());
+    this->Row = this->Scalars;
+    }
+
+  inline void SetRow( int y, int z )
+    {
+    this->Row = this->Scalars
+      + (y - this->Extent[2]) * this->Increments[1]
+      + (z - this->Extent[4]) * this->Increments[2];
+    }
+
+  inline bool IsInside( int x ) const
+    {
+    const double v = static_cast< double >(
+      this->Row[(x - this->Extent[0]) * this->Increments[0]]);
+    return v >= this->Min && v <= this->Max;
+    }
+
+private:
+  double    Min, Max;
+  int       Extent[6];
+  vtkIdType Increments[3];
+  T        *Scalars;
+  T        *Row;
+};
+
+//----------------------------------------------------------------------
+// Voxels of a given label. Rows of labels are read through
+// vtkKWEPaintbrushLabelData::GetLabelRow, so that either storage mode
+// works.
+class vtkKWEPaintbrushFloodFillLabel
+{
+public:
+  vtkKWEPaintbrushFloodFillLabel( vtkKWEPaintbrushLabelData *labelData,
+                                  vtkKWEPaintbrushEnums::LabelType label,
+                                  int x1, int x2 )
+    : Buffer(x2 - x1 + 1)
+    {
+    this->LabelData = labelData;
+    this->Label = label;
+    this->X1 = x1;
+    this->X2 = x2;
+    this->Row = NULL;
+    }
+
+  inline void SetRow( int y, int z )
+    {
+    this->Row = this->LabelData->GetLabelRow(
+                  this->X1, this->X2, y, z, &this->Buffer[0] );
+    }
+
+  inline bool IsInside( int x ) const
+    {
+    return this->Row[x - this->X1] == this->Label;
+    }
+
+private:
+  vtkKWEPaintbrushLabelData                        *LabelData;
+  vtkKWEPaintbrushEnums::LabelType                  Label;
+  int                                               X1, X2;
+  vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > Buffer;
+  const vtkKWEPaintbrushEnums::LabelType           *Row;
+};
+
+//----------------------------------------------------------------------
+// Scanline flood fill from "seed" within "extent". Each row reached gets
+// the runs of voxels filled. A segment of a row is popped from the
+// stack at a time; every voxel of it that satisfies the criterion and is
+// not filled yet starts a new run, which is grown along x as far as the
+// criterion allows. The run is recorded, and the same span on the four
+// neighbouring rows is pushed to be explored. Voxels already filled are
+// skipped a run at a time. "bounds" gets the extent of the voxels filled.
+template <class TCriterion>
+void vtkKWEPaintbrushFloodFillExecute(
+  TCriterion &criterion, const int extent[6], const int seed[3],
+  vtkKWEPaintbrushFloodFillRows &rows, int bounds[6] )
+{
+  rows.clear();
+  bounds[0] = bounds[2] = bounds[4] = VTK_INT_MAX;
+  bounds[1] = bounds[3] = bounds[5] = VTK_INT_MIN;
+
+  vtkstd::vector< vtkKWEPaintbrushFloodFillSegment > stack;
+  vtkKWEPaintbrushFloodFillSegment segment =
+    { seed[0], seed[0], seed[1], seed[2] };
+  stack.push_back(segment);
+
+  while (!stack.empty())
+    {
+    segment = stack.back();
+    stack.pop_back();
+
+    vtkKWEPaintbrushFloodFillRuns &runs =
+      rows[vtkstd::pair< int, int >(segment.Z, segment.Y)];
+    criterion.SetRow(segment.Y, segment.Z);
+
+    // The first run that ends at or after X1.
+    size_t i = vtkstd::lower_bound( runs.begin(), runs.end(), segment.X1,
+               vtkKWEPaintbrushFloodFillRunEndsBefore ) - runs.begin();
+
+    int x = segment.X1;
+    while (x <= segment.X2)
+      {
+      if (i < runs.size() && runs[i].first <= x)
+        {
+        // Already filled.
+        x = runs[i].second + 1;
+        ++i;
+        continue;
+        }
+      if (!criterion.IsInside(x))
+        {
+        ++x;
+        continue;
+        }
+
+      int x1 = x, x2 = x;
+      while (x1 > extent[0] && criterion.IsInside(x1 - 1))
+        {
+        --x1;
+        }
+      while (x2 < extent[1] && criterion.IsInside(x2 + 1))
+        {
+        ++x2;
+        }
+      runs.insert(runs.begin() + i, vtkKWEPaintbrushFloodFillRun(x1, x2));
+      ++i;
+
+      bounds[0] = (x1 < bounds[0]) ? x1 : bounds[0];
+      bounds[1] = (x2 > bounds[1]) ? x2 : bounds[1];
+      bounds[2] = (segment.Y < bounds[2]) ? segment.Y : bounds[2];
+      bounds[3] = (segment.Y > bounds[3]) ? segment.Y : bounds[3];
+      bounds[4] = (segment.Z < bounds[4]) ? segment.Z : bounds[4];
+      bounds[5] = (segment.Z > bounds[5]) ? segment.Z : bounds[5];
+
+      vtkKWEPaintbrushFloodFillSegment neighbour = { x1, x2, 0, 0 };
+      if (segment.Y > extent[2])
+        {
+        neighbour.Y = segment.Y - 1; neighbour.Z = segment.Z;
+        stack.push_back(neighbour);
+        }
+      if (segment.Y < extent[3])
+        {
+        neighbour.Y = segment.Y + 1; neighbour.Z = segment.Z;
+        stack.push_back(neighbour);
+        }
+      if (segment.Z > extent[4])
+        {
+        neighbour.Y = segment.Y; neighbour.Z = segment.Z - 1;
+        stack.push_back(neighbour);
+        }
+      if (segment.Z < extent[5])
+        {
+        neighbour.Y = segment.Y; neighbour.Z = segment.Z + 1;
+        stack.push_back(neighbour);
+        }
+
+      x = x2 + 1;
+      }
+    }
+}
+
+//----------------------------------------------------------------------
+template <class T>
+void vtkKWEPaintbrushFloodFillIntensityExecute(
+  vtkImageData *image, double min, double max,
+  const int extent[6], const int seed[3],
+  vtkKWEPaintbrushFloodFillRows &rows, int bounds[6], T * )
+{
+  vtkKWEPaintbrushFloodFillIntensity< T > criterion(image, min, max);
+  vtkKWEPaintbrushFloodFillExecute(criterion, extent, seed, rows, bounds);
+}
 
 //----------------------------------------------------------------------
 vtkKWEPaintbrushOperationFloodFill::vtkKWEPaintbrushOperationFloodFill()
 {
+  this->FillCriterion      = IntensityRangeCriterion;
+  this->IntensityRange[0]  = 1.0;
+  this->IntensityRange[1]  = 0.0;
+  this->IntensityTolerance = 0.0;
+  this->LabelData          = NULL;
+  this->FillDimension      = 3;
+  this->SliceAxis          = 2;
 }
 
 //----------------------------------------------------------------------
 vtkKWEPaintbrushOperationFloodFill::~vtkKWEPaintbrushOperationFloodFill()
 {
+  this->SetLabelData(NULL);
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushOperationFloodFill::
+DoOperation( vtkKWEPaintbrushData *data, double p[3],
+             vtkKWEPaintbrushEnums::OperationType & op )
+{
+  op = vtkKWEPaintbrushEnums::Add;
+
+  // Only binary data can be filled.
+  vtkKWEPaintbrushStencilData *sdata =
+      vtkKWEPaintbrushStencilData::SafeDownCast(data);
+  if (!sdata || !this->ImageData)
+    {
+    return;
+    }
+
+  double spacing[3], origin[3];
+  this->ImageData->GetSpacing(spacing);
+  this->ImageData->GetOrigin(origin);
+  int seed[3];
+  for (int i = 0; i < 3; i++)
+    {
+    seed[i] = vtkMath::Floor((p[i] - origin[i]) / spacing[i] + 0.5);
+    }
+
+  this->DoOperationOnStencil( sdata->GetImageStencilData(),
+                              seed[0], seed[1], seed[2] );
 }
 
 //----------------------------------------------------------------------
@@ -41,21 +295,138 @@ void vtkKWEPaintbrushOperationFloodFill::
 DoOperationOnStencil(vtkImageStencilData *stencilData,
                                           int x, int y, int z)
 {
-  this->Superclass::DoOperationOnStencil( stencilData, x, y, z );
-
   if (!this->ImageData)
     {
     return;
     }
 
-  // Now do the floodfill on the image data
+  // The stencil starts empty, at the seed.
+  const int seed[3] = { x, y, z };
+  int extent[6] = { x, x, y, y, z, z };
+  stencilData->SetSpacing(this->ImageData->GetSpacing());
+  stencilData->SetOrigin(this->ImageData->GetOrigin());
+  stencilData->SetExtent(extent);
+  stencilData->AllocateExtents();
+
+  // The extent to fill: the image, the operation's extent if any, the
+  // labels if they are used, and the slice of the seed in 2D.
+  this->ImageData->GetExtent(extent);
+  if (this->Extent[0] <= this->Extent[1] &&
+      !vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                                     extent, this->Extent, extent))
+    {
+    return;
+    }
+  if (this->FillCriterion == LabelBoundaryCriterion)
+    {
+    if (!this->LabelData)
+      {
+      vtkErrorMacro( << "Set the label data prior to filling label regions" );
+      return;
+      }
+    int labelExtent[6];
+    this->LabelData->GetExtent(labelExtent);
+    if (!vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                                     extent, labelExtent, extent))
+      {
+      return;
+      }
+    }
+  if (this->FillDimension == 2)
+    {
+    extent[2*this->SliceAxis] = extent[2*this->SliceAxis+1]
+                              = seed[this->SliceAxis];
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    if (seed[i] < extent[2*i] || seed[i] > extent[2*i+1])
+      {
+      return;
+      }
+    }
+
+  vtkKWEPaintbrushFloodFillRows rows;
+  int bounds[6];
+  if (this->FillCriterion == LabelBoundaryCriterion)
+    {
+    vtkKWEPaintbrushEnums::LabelType buffer;
+    const vtkKWEPaintbrushEnums::LabelType label =
+      *this->LabelData->GetLabelRow( x, x, y, z, &buffer );
+    vtkKWEPaintbrushFloodFillLabel criterion(
+      this->LabelData, label, extent[0], extent[1] );
+    vtkKWEPaintbrushFloodFillExecute( criterion, extent, seed, rows, bounds );
+    }
+  else
+    {
+    double range[2] = { this->IntensityRange[0], this->IntensityRange[1] };
+    if (range[0] > range[1])
+      {
+      const double v = this->ImageData->GetScalarComponentAsDouble(x, y, z, 0);
+      range[0] = v - this->IntensityTolerance;
+      range[1] = v + this->IntensityTolerance;
+      }
+    switch (this->ImageData->GetScalarType())
+      {
+      vtkTemplateMacro( vtkKWEPaintbrushFloodFillIntensityExecute(
+        this->ImageData, range[0], range[1], extent, seed, rows, bounds,
+        static_cast< VTK_TT * >(0)) );
 
+      default:
+        vtkErrorMacro( << "Unknown ScalarType" );
+        return;
+      }
+    }
+
+  if (bounds[0] > bounds[1])
+    {
+    return;
+    }
+
+  // Copy the runs into the stencil, row by row.
+  stencilData->SetExtent(bounds);
+  stencilData->AllocateExtents();
+  for (vtkKWEPaintbrushFloodFillRows::const_iterator row = rows.begin();
+       row != rows.end(); ++row)
+    {
+    const vtkKWEPaintbrushFloodFillRuns &runs = row->second;
+    for (vtkKWEPaintbrushFloodFillRuns::const_iterator it = runs.begin();
+         it != runs.end(); ++it)
+      {
+      stencilData->InsertNextExtent( it->first, it->second,
+                                     row->first.second, row->first.first );
+      }
+    }
 }
 
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushOperationFloodFill::DeepCopy(vtkKWEPaintbrushOperation *op)
+{
+  vtkKWEPaintbrushOperationFloodFill *o =
+    vtkKWEPaintbrushOperationFloodFill::SafeDownCast(op);
+  if (o && o != this && this->ImageData == o->ImageData)
+    {
+    this->FillCriterion      = o->FillCriterion;
+    this->IntensityRange[0]  = o->IntensityRange[0];
+    this->IntensityRange[1]  = o->IntensityRange[1];
+    this->IntensityTolerance = o->IntensityTolerance;
+    this->FillDimension      = o->FillDimension;
+    this->SliceAxis          = o->SliceAxis;
+    this->SetLabelData(o->LabelData);
+    }
+  this->Superclass::DeepCopy(op);
+}
 
 //----------------------------------------------------------------------
 void vtkKWEPaintbrushOperationFloodFill::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "FillCriterion: "
+     << (this->FillCriterion == LabelBoundaryCriterion
+         ? "LabelBoundary" : "IntensityRange") << endl;
+  os << indent << "IntensityRange: (" << this->IntensityRange[0] << ", "
+     << this->IntensityRange[1] << ")" << endl;
+  os << indent << "IntensityTolerance: " << this->IntensityTolerance << endl;
+  os << indent << "LabelData: " << this->LabelData << endl;
+  os << indent << "FillDimension: " << this->FillDimension << endl;
+  os << indent << "SliceAxis: " << this->SliceAxis << endl;
 }
-
@@ -18,15 +18,33 @@
 //
 //
 //=============================================================================
-// .NAME vtkKWEPaintbrushOperationFloodFill -
+// .NAME vtkKWEPaintbrushOperationFloodFill - Flood fill from the cursor
 // .SECTION Description
+// This operation fills the region connected to the voxel under the cursor,
+// instead of drawing the shape of the brush. Voxels are connected to their
+// 6 face neighbours. The region is made of the voxels whose first component
+// in the image data lies within the IntensityRange, or, if the criterion is
+// LabelBoundary, of the voxels that share the label of the seed voxel in
+// the LabelData. The fill is bounded by the Extent of the operation, if
+// set, and by the extent of the image data.
+//
+// The fill runs along scan lines: each run of connected voxels found along
+// a row is added to the stencil as a whole, and only the runs left to
+// explore on the neighbouring rows are kept on a stack. Only the rows the
+// fill reaches are stored, so neither a per-voxel mask nor a per-row table
+// of the volume is allocated.
+//
+// Only binary (stencil) paintbrush data is filled. Strokes are not swept.
 // .SECTION See Also
+// vtkKWEITKConnectedThresholdPaintbrushOperation
 
 #ifndef __vtkKWEPaintbrushOperationFloodFill_h
 #define __vtkKWEPaintbrushOperationFloodFill_h
 
 #include "vtkKWEPaintbrushOperation.h"
 
+class vtkKWEPaintbrushLabelData;
+
 class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushOperationFloodFill
                            : public vtkKWEPaintbrushOperation
 {
@@ -42,13 +60,80 @@ public:
                                 vtkKWEPaintbrushOperation);
   void PrintSelf(ostream& os, vtkIndent indent);
 
+  // Description:
+  // How the region is delimited. IntensityRange (default) fills voxels
+  // whose intensity lies within IntensityRange. LabelBoundary fills voxels
+  // that have the label of the seed voxel in LabelData.
+  //BTX
+  enum FillCriterionType
+    {
+    IntensityRangeCriterion = 0,
+    LabelBoundaryCriterion
+    };
+  //ETX
+  vtkSetClampMacro( FillCriterion, int, IntensityRangeCriterion,
+                    LabelBoundaryCriterion );
+  vtkGetMacro( FillCriterion, int );
+  void SetFillCriterionToIntensityRange()
+    { this->SetFillCriterion(IntensityRangeCriterion); }
+  void SetFillCriterionToLabelBoundary()
+    { this->SetFillCriterion(LabelBoundaryCriterion); }
+
+  // Description:
+  // Range of intensities filled. If the range is empty (min > max, the
+  // default), the intensity of the seed voxel, give or take
+  // IntensityTolerance, is used.
+  vtkSetVector2Macro( IntensityRange, double );
+  vtkGetVector2Macro( IntensityRange, double );
+  vtkSetMacro( IntensityTolerance, double );
+  vtkGetMacro( IntensityTolerance, double );
+
+  // Description:
+  // The labels used by the LabelBoundary criterion.
+  virtual void SetLabelData( vtkKWEPaintbrushLabelData * );
+  vtkGetObjectMacro( LabelData, vtkKWEPaintbrushLabelData );
+
+  // Description:
+  // Fill in 3D (default), or in 2D, within the slice through the seed
+  // orthogonal to SliceAxis (0, 1 or 2 for X, Y or Z).
+  vtkSetClampMacro( FillDimension, int, 2, 3 );
+  vtkGetMacro( FillDimension, int );
+  vtkSetClampMacro( SliceAxis, int, 0, 2 );
+  vtkGetMacro( SliceAxis, int );
+
+  // Description:
+  // The fill depends on where it starts, strokes are never swept.
+  virtual int GetSweptPaintbrushData(vtkKWEPaintbrushData *,
+                                     double *, double *,
+                                     vtkKWEPaintbrushEnums::OperationType &)
+    { return 0; }
+
+  // Description:
+  // INTERNAL: Do not use.
+  // Deep copy.. Synchronizes states etc.
+  virtual void DeepCopy(vtkKWEPaintbrushOperation *);
+
 protected:
   vtkKWEPaintbrushOperationFloodFill();
   ~vtkKWEPaintbrushOperationFloodFill();
 
+  // Description:
+  // Fill the region connected to the voxel (x,y,z) into the stencil.
   virtual void DoOperationOnStencil(
       vtkImageStencilData *, int x, int y, int z);
 
+  // Description:
+  // See superclass Doc
+  virtual void DoOperation( vtkKWEPaintbrushData *, double p[3],
+                            vtkKWEPaintbrushEnums::OperationType & op );
+
+  int                        FillCriterion;
+  double                     IntensityRange[2];
+  double                     IntensityTolerance;
+  vtkKWEPaintbrushLabelData *LabelData;
+  int                        FillDimension;
+  int                        SliceAxis;
+
 private:
   vtkKWEPaintbrushOperationFloodFill(const vtkKWEPaintbrushOperationFloodFill&);  //Not implemented
   void operator=(const vtkKWEPaintbrushOperationFloodFill&);  //Not implemented
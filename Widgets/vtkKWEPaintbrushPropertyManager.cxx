@@ -26,6 +26,7 @@
 #include "vtkKWEPaintbrushData.h"
 #include "vtkProperty.h"
 #include "vtkObjectFactory.h"
+#include <vtkstd/limits>
 
 //----------------------------------------------------------------------------
 vtkCxxRevisionMacro(vtkKWEPaintbrushPropertyManager, "$Revision: 3416 $");
@@ -93,11 +94,31 @@ vtkKWEPaintbrushPropertyManager::vtkKWEPaintbrushPropertyManager()
       this->LabelToOpacityMapUC[i] = 1.0;
       }
     }
+
+  // The dense table of label colors, with an entry per label value. Labels
+  // without a sketch are black and opaque, as in the UCHAR table above.
+  const int nLabels = 1 << (8 * sizeof(vtkKWEPaintbrushEnums::LabelType));
+  this->LabelColorsOffset = -static_cast< int >(
+    vtkstd::numeric_limits< vtkKWEPaintbrushEnums::LabelType >::min());
+  this->LabelColorsBuffer = new vtkKWEPaintbrushLabelColor[nLabels + 8];
+  const size_t misalignment =
+    reinterpret_cast< size_t >(this->LabelColorsBuffer) % 64;
+  this->LabelColors = this->LabelColorsBuffer + (misalignment ?
+    (64 - misalignment) / sizeof(vtkKWEPaintbrushLabelColor) : 0);
+  for (int i = 0; i < nLabels; i++)
+    {
+    vtkKWEPaintbrushLabelColor &c = this->LabelColors[i];
+    c.Color[0] = c.Color[1] = c.Color[2] = 0;
+    c.Padding = 0;
+    c.Opacity = 256;
+    c.Padding2 = 0;
+    }
 }
 
 //----------------------------------------------------------------------------
 vtkKWEPaintbrushPropertyManager::~vtkKWEPaintbrushPropertyManager()
 {
+  delete [] this->LabelColorsBuffer;
 }
 
 //----------------------------------------------------------------------------
@@ -250,7 +271,64 @@ void vtkKWEPaintbrushPropertyManager::UpdateLabelToColorMap()
           = vtkKWEPaintbrushLabelMapColor(rgb, opacity);
         }
       }
+
+    this->UpdateLabelColors();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushPropertyManager::UpdateLabelColors()
+{
+  // The colors of the labels of the sketches.
+  LabelColorsSetType labelColors;
+  for (int n = 0; n < this->PaintbrushDrawing->GetNumberOfItems(); n++)
+    {
+    vtkKWEPaintbrushSketch * s = this->PaintbrushDrawing->GetItem(n);
+    vtkKWEPaintbrushProperty *property = s->GetPaintbrushProperty();
+    vtkKWEPaintbrushLabelColor c;
+    property->GetColor(c.Color);
+    c.Padding = 0;
+
+    // round opacity to a value in the range [0,256], because division
+    // by 256 can be efficiently achieved by bit-shifting by 8 bits
+    const double opacity =
+      property->GetVisibility() ? property->GetOpacity() : 0.0;
+    c.Opacity = static_cast< unsigned short >(256*opacity + 0.5);
+    c.Padding2 = 0;
+    labelColors.push_back(LabelColorsSetType::value_type(s->GetLabel(), c));
+    }
+
+  // Only touch the table if something changed.
+  bool changed = (labelColors.size() != this->LabelColorsSet.size());
+  for (size_t i = 0; !changed && i < labelColors.size(); i++)
+    {
+    const vtkKWEPaintbrushLabelColor &a = labelColors[i].second;
+    const vtkKWEPaintbrushLabelColor &b = this->LabelColorsSet[i].second;
+    changed = (labelColors[i].first != this->LabelColorsSet[i].first ||
+               a.Color[0] != b.Color[0] || a.Color[1] != b.Color[1] ||
+               a.Color[2] != b.Color[2] || a.Opacity != b.Opacity);
+    }
+  if (!changed)
+    {
+    return;
+    }
+
+  // Reset the entries of the labels of the previous sketches, then fill
+  // those of the current ones.
+  LabelColorsSetType::const_iterator it;
+  for (it = this->LabelColorsSet.begin(); it != this->LabelColorsSet.end(); ++it)
+    {
+    vtkKWEPaintbrushLabelColor &c =
+      this->LabelColors[static_cast< int >(it->first) + this->LabelColorsOffset];
+    c.Color[0] = c.Color[1] = c.Color[2] = 0;
+    c.Opacity = 256;
+    }
+  for (it = labelColors.begin(); it != labelColors.end(); ++it)
+    {
+    this->LabelColors[static_cast< int >(it->first) + this->LabelColorsOffset]
+      = it->second;
     }
+  this->LabelColorsSet.swap(labelColors);
 }
 
 //----------------------------------------------------------------------------
@@ -34,6 +34,7 @@
 #include "vtkKWEPaintbrushEnums.h"
 #include "vtkObject.h"
 #include <vtkstd/map>
+#include <vtkstd/vector> // for LabelColorsSet
 
 class vtkKWEPaintbrushSketch;
 class vtkKWEPaintbrushDrawing;
@@ -107,6 +108,26 @@ public:
   typedef vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
                vtkKWEPaintbrushLabelMapColor > LabelToColorMapType;
 
+  // Description:
+  // INTERNAL - Do not use
+  // Color of a label and its opacity in the range [0,256], as used by the
+  // blender. Entries take 8 bytes, a cache line holds 8 of them.
+  struct vtkKWEPaintbrushLabelColor
+    {
+    unsigned char  Color[3];
+    unsigned char  Padding;
+    unsigned short Opacity;
+    unsigned short Padding2;
+    };
+
+  // Description:
+  // INTERNAL - Do not use
+  // Look up the color of a label, in a table covering all the label values.
+  // Labels without a sketch are black.
+  const vtkKWEPaintbrushLabelColor &
+    GetLabelColor( vtkKWEPaintbrushEnums::LabelType l ) const
+    { return this->LabelColors[static_cast< int >(l) + this->LabelColorsOffset]; }
+
 protected:
   static vtkKWEPaintbrushPropertyManager *New( vtkKWEPaintbrushDrawing * );
   static vtkKWEPaintbrushPropertyManager *New();
@@ -172,6 +193,19 @@ private:
   unsigned char        LabelToColorMapUC[256][3];
   double               LabelToOpacityMapUC[256];
   LabelToColorMapType  LabelToColorMap;
+
+  // Dense table of label colors, whatever the LabelType, aligned on a cache
+  // line. The labels of the sketches are remembered, to reset their entries
+  // when the sketches change.
+  vtkKWEPaintbrushLabelColor *LabelColors;
+  vtkKWEPaintbrushLabelColor *LabelColorsBuffer;
+  int                         LabelColorsOffset;
+  //BTX
+  typedef vtkstd::vector< vtkstd::pair< vtkKWEPaintbrushEnums::LabelType,
+                          vtkKWEPaintbrushLabelColor > > LabelColorsSetType;
+  LabelColorsSetType          LabelColorsSet;
+  //ETX
+  void UpdateLabelColors();
 };
 
 #endif
@@ -311,9 +311,9 @@ int vtkKWEPaintbrushRepresentation
 }
 
 //----------------------------------------------------------------------
-void vtkKWEPaintbrushRepresentation::AddShapeToCurrentStroke( double p[3] )
+int vtkKWEPaintbrushRepresentation::AddShapeToCurrentStroke( double p[3] )
 {
-  this->PaintbrushDrawing->AddShapeToCurrentStroke( this->SketchIndex, p );
+  return this->PaintbrushDrawing->AddShapeToCurrentStroke( this->SketchIndex, p );
 }
 
 //----------------------------------------------------------------------
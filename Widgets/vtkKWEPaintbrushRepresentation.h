@@ -172,8 +172,8 @@ public:
   // INTERNAL - Do not use.
   // Add a shape centered at "p" to the currently active sketch's current
   // stroke. This method is called by the widget whenever we interactively
-  // trace.
-  virtual void AddShapeToCurrentStroke( double p[3] );
+  // trace. Returns 1 if the shape was added, 0 otherwise.
+  virtual int AddShapeToCurrentStroke( double p[3] );
 
   // Description:
   // INTERNAL - Do not use
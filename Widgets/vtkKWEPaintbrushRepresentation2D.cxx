@@ -432,7 +432,7 @@ int vtkKWEPaintbrushRepresentation2D::ActivateShapeOutline( int x, int y )
 }
 
 //----------------------------------------------------------------------
-void vtkKWEPaintbrushRepresentation2D::AddShapeToCurrentStroke( double p[3] )
+int vtkKWEPaintbrushRepresentation2D::AddShapeToCurrentStroke( double p[3] )
 {
   // If we are doing a slice by slice segmentation, do a clip with the 
   // current slice.
@@ -448,7 +448,7 @@ void vtkKWEPaintbrushRepresentation2D::AddShapeToCurrentStroke( double p[3] )
   this->PaintbrushDrawing->GetPaintbrushOperation()->
             GetPaintbrushShape()->SetClipExtent(extent);
 
-  this->Superclass::AddShapeToCurrentStroke(p);
+  return this->Superclass::AddShapeToCurrentStroke(p);
 }
 
 //----------------------------------------------------------------------
@@ -769,8 +769,7 @@ int vtkKWEPaintbrushRepresentation2D
   vtkKWEPaintbrushLabelData *lData =
     vtkKWEPaintbrushLabelData::SafeDownCast(
         this->PaintbrushDrawing->GetPaintbrushData());
-  vtkImageData *labelImage = lData->GetLabelMap();
-  labelImage->GetExtent(labelImageExtent);
+  lData->GetExtent(labelImageExtent);
 
   if (!vtkMath::ExtentIsWithinOtherExtent(targetSliceExt, labelImageExtent))
     {
@@ -821,8 +820,7 @@ int vtkKWEPaintbrushRepresentation2D
   vtkKWEPaintbrushLabelData *lData =
     vtkKWEPaintbrushLabelData::SafeDownCast(
         this->PaintbrushDrawing->GetPaintbrushData());
-  vtkImageData *labelImage = lData->GetLabelMap();
-  labelImage->GetExtent(labelImageExtent);
+  lData->GetExtent(labelImageExtent);
 
   if (!vtkMath::ExtentIsWithinOtherExtent(targetSliceExt, labelImageExtent))
     {
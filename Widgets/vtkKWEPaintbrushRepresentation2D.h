@@ -224,7 +224,7 @@ public:
   // This method is called from vtkKWEPaintbrushWidget whenever we draw using
   // a shape centered at the location "p". Here we override the superclass
   // method.
-  virtual void AddShapeToCurrentStroke( double p[3] );
+  virtual int AddShapeToCurrentStroke( double p[3] );
 
 protected:
   vtkKWEPaintbrushRepresentation2D();
@@ -31,29 +31,62 @@
 #include "vtkKWEPaintbrushProperty.h"
 #include "vtkKWEPaintbrushOperation.h"
 #include "vtkKWEPaintbrushShape.h"
-#include "vtkContourFilter.h"
 #include "vtkPolyDataMapper.h"
+#include "vtkPolyData.h"
+#include "vtkPoints.h"
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkIntArray.h"
+#include "vtkUnsignedCharArray.h"
 #include "vtkActor.h"
 #include "vtkObjectFactory.h"
 #include "vtkProperty.h"
 #include "vtkImageData.h"
-#include "vtkImageExtractComponents.h"
-#include "vtkImageClip.h"
 #include "vtkImageActor.h"
 #include "vtkImageActorPointPlacer.h"
 #include "vtkSmartPointer.h"
 #include "vtkActorCollection.h"
 #include "vtkMapperCollection.h"
+#include <vtkstd/algorithm>
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushRepresentationGrayscale2D, "$Revision: 1774 $");
 vtkStandardNewMacro(vtkKWEPaintbrushRepresentationGrayscale2D);
 
+//----------------------------------------------------------------------
+// The state of the vtkProperty of a sketch that the contour actors render,
+// except for the color, which is given per cell. The edge color, the
+// inverse of the color, only shows when the edges are visible, as when the
+// sketch is highlighted with StippledInvertedHighlight.
+class vtkKWEPaintbrushRepresentationGrayscale2DStyle
+{
+public:
+  vtkKWEPaintbrushRepresentationGrayscale2DStyle( vtkProperty *property )
+    {
+    this->Values[0] = property->GetLineWidth();
+    this->Values[1] = property->GetOpacity();
+    this->Values[2] = property->GetLineStipplePattern();
+    this->Values[3] = property->GetLineStippleRepeatFactor();
+    this->Values[4] = property->GetEdgeVisibility();
+    this->Values[5] = this->Values[6] = this->Values[7] = 0.0;
+    if (property->GetEdgeVisibility())
+      {
+      property->GetEdgeColor(this->Values + 5);
+      }
+    }
+
+  bool operator<( const vtkKWEPaintbrushRepresentationGrayscale2DStyle &s ) const
+    {
+    return vtkstd::lexicographical_compare(
+      this->Values, this->Values + 8, s.Values, s.Values + 8 );
+    }
+
+private:
+  double Values[8];
+};
+
 //----------------------------------------------------------------------
 vtkKWEPaintbrushRepresentationGrayscale2D::vtkKWEPaintbrushRepresentationGrayscale2D()
 {
-  this->ContourFilters         = vtkCollection::New();
-  this->ExtractComponents      = vtkCollection::New();
-  this->ImageClips             = vtkCollection::New();
   this->ContourPolyDataMappers = vtkMapperCollection::New();
   this->ContourPolyDataActors  = vtkActorCollection::New();
   this->IsoValue               = 127.5;
@@ -76,175 +109,365 @@ vtkKWEPaintbrushRepresentationGrayscale2D::vtkKWEPaintbrushRepresentationGraysca
 //----------------------------------------------------------------------
 vtkKWEPaintbrushRepresentationGrayscale2D::~vtkKWEPaintbrushRepresentationGrayscale2D()
 {
-  this->ExtractComponents->Delete();
-  this->ImageClips->Delete();
-  this->ContourFilters->Delete();
   this->ContourPolyDataMappers->Delete();
   this->ContourPolyDataActors->Delete();
 }
 
 //----------------------------------------------------------------------
-void vtkKWEPaintbrushRepresentationGrayscale2D::BuildRepresentation()
+// Marching squares on the first component of "image", over the slices of
+// "extent" normal to "axis". Points on an edge are shared by the cells on
+// either side of it. Points are appended to "points" in world coordinates,
+// and lines to "lines" as pairs of point indices.
+template < class T >
+void vtkKWEPaintbrushRepresentationGrayscale2DContour( vtkImageData *image,
+                      T *, int extent[6], int axis, double isoValue,
+                      vtkstd::vector< double > &points,
+                      vtkstd::vector< vtkIdType > &lines )
 {
-  // The pipeline is as follows :
-  //
-  //  SketchImage_0 --> ExtractFirstComponent_0 --> ImageClip_0 -->
-  //             ContourFilter_0 --> PolyDataMapper_0 --> Actor_0
-  //
-  //  SketchImage_1 --> ExtractFirstComponent_1 --> ImageClip_1 -->
-  //             ContourFilter_1 --> PolyDataMapper_1 --> Actor_1
-  // ....
-  // ....
+  // Pairs of edges joined by a segment, for each configuration of the
+  // corners (u,v), (u+1,v), (u+1,v+1) and (u,v+1) at or above the isovalue.
+  // Edges 0 and 2 run along U, on rows v and v+1, 1 and 3 along V, at u+1
+  // and u.
+  static const int segments[16][5] = {
+    { -1 }, { 3, 0, -1 }, { 0, 1, -1 }, { 3, 1, -1 },
+    { 1, 2, -1 }, { 3, 0, 1, 2, -1 }, { 0, 2, -1 }, { 3, 2, -1 },
+    { 2, 3, -1 }, { 0, 2, -1 }, { 0, 1, 2, 3, -1 }, { 1, 2, -1 },
+    { 1, 3, -1 }, { 0, 1, -1 }, { 0, 3, -1 }, { -1 } };
+  static const int edgeCorners[4][2] = { { 0, 1 }, { 1, 2 }, { 3, 2 }, { 0, 3 } };
+
+  const int u = (axis == 0) ? 1 : 0, v = (axis == 2) ? 1 : 2;
+  const int nu = extent[2*u+1] - extent[2*u] + 1;
+  if (nu < 2 || extent[2*v] == extent[2*v+1])
+    {
+    return;
+    }
 
-  vtkImageClip *ic;
-  vtkActor *ac;
-  vtkImageExtractComponents *a;
-  vtkContourFilter * cf;
-  vtkCollectionSimpleIterator ait;
+  vtkIdType *increments = image->GetIncrements();
+  const vtkIdType incU = increments[u], incV = increments[v];
+  double origin[3], spacing[3];
+  image->GetOrigin(origin);
+  image->GetSpacing(spacing);
 
-  const int nSketches = this->PaintbrushDrawing->GetNumberOfItems();
+  // Points on the edges along U of rows v and v+1, and along V between them.
+  vtkstd::vector< vtkIdType > uEdges[2], vEdges(nu);
+  uEdges[0].resize(nu - 1);
+  uEdges[1].resize(nu - 1);
+
+  for (int k = extent[2*axis]; k <= extent[2*axis+1]; k++)
+    {
+    int ijk[3];
+    ijk[axis] = k;
+    ijk[u] = extent[2*u];
+    vtkstd::fill( uEdges[0].begin(), uEdges[0].end(), -1 );
+    for (int j = extent[2*v]; j < extent[2*v+1]; j++)
+      {
+      ijk[v] = j;
+      const T *row = static_cast< T * >(image->GetScalarPointer(ijk));
+      vtkstd::fill( uEdges[1].begin(), uEdges[1].end(), -1 );
+      vtkstd::fill( vEdges.begin(), vEdges.end(), -1 );
+
+      for (int i = 0; i < nu - 1; i++, row += incU)
+        {
+        const double s[4] = { static_cast< double >(row[0]),
+                              static_cast< double >(row[incU]),
+                              static_cast< double >(row[incU + incV]),
+                              static_cast< double >(row[incV]) };
+        const int index = (s[0] >= isoValue ? 1 : 0) | (s[1] >= isoValue ? 2 : 0) |
+                          (s[2] >= isoValue ? 4 : 0) | (s[3] >= isoValue ? 8 : 0);
+        if (index == 0 || index == 15)
+          {
+          continue;
+          }
+
+        vtkIdType *edgePoints[4] = { &uEdges[0][i], &vEdges[i+1],
+                                     &uEdges[1][i], &vEdges[i] };
+        for (const int *edge = segments[index]; *edge >= 0; edge++)
+          {
+          vtkIdType &id = *edgePoints[*edge];
+          if (id >= 0)
+            {
+            continue;
+            }
+
+          // Interpolate the isovalue between the corners of the edge.
+          const int c0 = edgeCorners[*edge][0], c1 = edgeCorners[*edge][1];
+          const double t = (isoValue - s[c0]) / (s[c1] - s[c0]);
+          double p[3];
+          p[axis] = k;
+          p[u] = extent[2*u] + i + ((c0 == 1 || c0 == 2) ? 1.0 : 0.0);
+          p[v] = j + ((c0 >= 2) ? 1.0 : 0.0);
+          p[(*edge == 0 || *edge == 2) ? u : v] += t;
+          id = static_cast< vtkIdType >(points.size() / 3);
+          for (int c = 0; c < 3; c++)
+            {
+            points.push_back(origin[c] + spacing[c] * p[c]);
+            }
+          }
+
+        for (const int *edge = segments[index]; *edge >= 0; edge += 2)
+          {
+          lines.push_back(*edgePoints[edge[0]]);
+          lines.push_back(*edgePoints[edge[1]]);
+          }
+        }
 
+      // Row v+1 becomes row v of the next pair of rows.
+      uEdges[0].swap(uEdges[1]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------
+bool vtkKWEPaintbrushRepresentationGrayscale2D::UpdateSketchContours(
+                                                       int extent[6] )
+{
+  // Contour the slices normal to the thinnest axis, Z if there is a tie.
+  int axis = 2;
+  for (int i = 1; i >= 0; i--)
+    {
+    if (extent[2*i+1] - extent[2*i] < extent[2*axis+1] - extent[2*axis])
+      {
+      axis = i;
+      }
+    }
+
+  bool changed = false;
+  const int nSketches = this->PaintbrushDrawing->GetNumberOfItems();
   for (int i = 0; i < nSketches; i++)
     {
     vtkKWEPaintbrushSketch * sketch = this->PaintbrushDrawing->GetItem(i);
     vtkKWEPaintbrushGrayscaleData *mask = vtkKWEPaintbrushGrayscaleData::
           SafeDownCast(sketch->GetPaintbrushData());
+    SketchContoursType::iterator it = this->SketchContours.find(sketch);
+    if (!mask || it == this->SketchContours.end())
+      {
+      continue;
+      }
 
-    if (mask)
+    SketchContourType &contour = it->second;
+    const unsigned long mtime = mask->GetMTime();
+    if (contour.MTime == mtime && contour.IsoValue == this->IsoValue &&
+        vtkKWEPaintbrushUtilities::ExtentIsEqualToExtent(contour.Extent, extent))
       {
-      vtkImageData * image = mask->GetImageData();
-      bool found = false;
+      continue;
+      }
 
-      for ( this->ExtractComponents->InitTraversal(ait);
-             (a=static_cast< vtkImageExtractComponents * >(
-                this->ExtractComponents->GetNextItemAsObject(ait))); )
-        {
-        if (a->GetInput() == image)
-          {
-          found = true;
-          break;
-          }
-        }
+    contour.Points.clear();
+    contour.Lines.clear();
+    contour.MTime = mtime;
+    contour.IsoValue = this->IsoValue;
+    for (int j = 0; j < 6; j++)
+      {
+      contour.Extent[j] = extent[j];
+      }
+    changed = true;
 
-      if (!found)
+    vtkImageData * image = mask->GetImageData();
+    int imageExtent[6], clippedExtent[6];
+    image->GetExtent(imageExtent);
+    if (vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+                      extent, imageExtent, clippedExtent))
+      {
+      switch (image->GetScalarType())
         {
-        vtkImageExtractComponents * extractComponents = vtkImageExtractComponents::New();
-        vtkImageClip * imageClip = vtkImageClip::New();
-        vtkContourFilter * contourFilter = vtkContourFilter::New();
-        vtkPolyDataMapper * mapper = vtkPolyDataMapper::New();
-        vtkActor * actor = vtkActor::New();
-
-        extractComponents->SetInput( image );
-        extractComponents->SetComponents(0);
-        imageClip->SetClipData(1);
-        imageClip->SetInput(extractComponents->GetOutput());
-        contourFilter->SetInput(imageClip->GetOutput());
-        contourFilter->SetValue(0, this->IsoValue);
-        imageClip->Update();
-        contourFilter->Update();
-        mapper->SetInput(contourFilter->GetOutput());
-        mapper->SetResolveCoincidentTopologyToPolygonOffset();
-        mapper->ScalarVisibilityOff();
-        actor->SetMapper(mapper);
-
-        vtkProperty * property = vtkProperty::New();
-        property->SetColor( 0.0, 0.0, 0.0 );
-        actor->SetProperty( property );
-        property->Delete();
-
-        this->ContourPolyDataActors->AddItem(actor);
-        this->ContourPolyDataMappers->AddItem(mapper);
-        this->ExtractComponents->AddItem(extractComponents);
-        this->ImageClips->AddItem(imageClip);
-        this->ContourFilters->AddItem(contourFilter);
-
-        imageClip->Delete();
-        extractComponents->Delete();
-        contourFilter->Delete();
-        mapper->Delete();
-        actor->Delete();
+        vtkTemplateMacro( vtkKWEPaintbrushRepresentationGrayscale2DContour(
+            image, static_cast< VTK_TT * >(0), clippedExtent, axis,
+            this->IsoValue, contour.Points, contour.Lines ) );
+        default:
+          vtkErrorMacro( << "Unknown ScalarType" );
         }
       }
     }
 
-  // Now remove old unused ones, if any
+  return changed;
+}
 
-  std::vector< int > indicesToRemove;
-  int j = 0;
-  for ( this->ExtractComponents->InitTraversal(ait);
-         (a=static_cast< vtkImageExtractComponents * >(
-            this->ExtractComponents->GetNextItemAsObject(ait))); j++)
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushRepresentationGrayscale2D::BuildContourPolyData()
+{
+  // Apart from the color, the properties of the sketches are properties of
+  // the actor. Sketches of the same style, usually all but the highlighted
+  // ones, share a polydata, rendered with the property of the first of them.
+  typedef vtkKWEPaintbrushRepresentationGrayscale2DStyle StyleType;
+  typedef vtkstd::map< StyleType,
+    vtkstd::pair< vtkPolyData *, vtkProperty * > > StylesType;
+  StylesType styles;
+
+  const int nSketches = this->PaintbrushDrawing->GetNumberOfItems();
+  for (int i = 0; i < nSketches; i++)
     {
-    bool found = false;
-    for (int i = 0; i < nSketches; i++)
+    vtkKWEPaintbrushSketch * sketch = this->PaintbrushDrawing->GetItem(i);
+    SketchContoursType::const_iterator it = this->SketchContours.find(sketch);
+    if (it == this->SketchContours.end() || it->second.Lines.empty())
       {
-      if (vtkKWEPaintbrushGrayscaleData *mask = vtkKWEPaintbrushGrayscaleData::
-          SafeDownCast(this->PaintbrushDrawing->GetItem(i)->GetPaintbrushData()))
-        {
-        if (a->GetInput() == mask->GetImageData())
-          {
-          found = true;
-          break;
-          }
-        }
+      continue;
       }
+    const SketchContourType &contour = it->second;
 
-    if (!found)
+    vtkProperty *property = sketch->GetPaintbrushProperty()->GetProperty();
+    vtkstd::pair< vtkPolyData *, vtkProperty * > &style =
+      styles[StyleType(property)];
+    if (!style.first)
       {
-      indicesToRemove.push_back(j);
+      style.first = vtkPolyData::New();
+      style.second = property;
+      vtkPolyData *pd = style.first;
+      vtkPoints *points = vtkPoints::New();
+      vtkCellArray *lines = vtkCellArray::New();
+      vtkIntArray *sketchIds = vtkIntArray::New();
+      sketchIds->SetName("SketchId");
+      vtkUnsignedCharArray *colors = vtkUnsignedCharArray::New();
+      colors->SetName("Colors");
+      colors->SetNumberOfComponents(3);
+      pd->SetPoints(points);
+      pd->SetLines(lines);
+      pd->GetCellData()->AddArray(sketchIds);
+      pd->GetCellData()->SetScalars(colors);
+      points->Delete();
+      lines->Delete();
+      sketchIds->Delete();
+      colors->Delete();
+      }
+
+    vtkPolyData *pd = style.first;
+    vtkPoints *points = pd->GetPoints();
+    vtkCellArray *lines = pd->GetLines();
+    vtkIntArray *sketchIds = static_cast< vtkIntArray * >(
+                       pd->GetCellData()->GetArray("SketchId"));
+    vtkDataArray *colors = pd->GetCellData()->GetScalars();
+
+    const vtkIdType offset = points->GetNumberOfPoints();
+    const vtkIdType nPoints = static_cast< vtkIdType >(contour.Points.size() / 3);
+    for (vtkIdType j = 0; j < nPoints; j++)
+      {
+      points->InsertNextPoint(&contour.Points[3*j]);
+      }
+
+    double rgb[3];
+    property->GetColor(rgb);
+    const vtkIdType nLines = static_cast< vtkIdType >(contour.Lines.size() / 2);
+    for (vtkIdType j = 0; j < nLines; j++)
+      {
+      vtkIdType pts[2] = { contour.Lines[2*j] + offset,
+                           contour.Lines[2*j+1] + offset };
+      lines->InsertNextCell(2, pts);
+      sketchIds->InsertNextValue(i);
+      colors->InsertNextTuple3(255.0 * rgb[0], 255.0 * rgb[1], 255.0 * rgb[2]);
       }
     }
 
-  for (std::vector< int >::const_iterator it = indicesToRemove.begin();
-         it != indicesToRemove.end(); ++it)
+  // One actor per polydata.
+  const int nStyles = static_cast< int >(styles.size());
+  while (this->ContourPolyDataActors->GetNumberOfItems() < nStyles)
+    {
+    vtkPolyDataMapper * mapper = vtkPolyDataMapper::New();
+    vtkActor * actor = vtkActor::New();
+    mapper->SetResolveCoincidentTopologyToPolygonOffset();
+    mapper->SetScalarModeToUseCellData();
+    actor->SetMapper(mapper);
+    this->ContourPolyDataActors->AddItem(actor);
+    this->ContourPolyDataMappers->AddItem(mapper);
+    mapper->Delete();
+    actor->Delete();
+    }
+  while (this->ContourPolyDataActors->GetNumberOfItems() > nStyles)
     {
-    int indexToRemove = *it;
-
-    // We need to get rid of this actor and its associated pipeline
-    this->ContourPolyDataActors->RemoveItem(indexToRemove);
-    this->ContourPolyDataMappers->RemoveItem(indexToRemove);
-    this->ExtractComponents->RemoveItem(indexToRemove);
-    this->ImageClips->RemoveItem(indexToRemove);
-    this->ContourFilters->RemoveItem(indexToRemove);
+    this->ContourPolyDataActors->RemoveItem(nStyles);
+    this->ContourPolyDataMappers->RemoveItem(nStyles);
     }
 
-  // Now, for the new actors we created, we need to set reasonable colors,
-  // preferably not the same colors as the ones the other actors use. So
-  // let's go about working some magic to get new colors.
+  int j = 0;
+  for (StylesType::iterator it = styles.begin(); it != styles.end(); ++it, ++j)
+    {
+    vtkActor * actor = static_cast< vtkActor * >(
+        this->ContourPolyDataActors->GetItemAsObject(j));
+    static_cast< vtkPolyDataMapper * >(this->ContourPolyDataMappers->
+        GetItemAsObject(j))->SetInput(it->second.first);
+    actor->GetProperty()->DeepCopy(it->second.second);
+    it->second.first->Delete();
+    }
 
-  // Clear our table.
-  this->PaintbrushDrawing->GetPaintbrushPropertyManager()->Initialize();
+  this->ContourPolyDataBuildTime.Modified();
+}
 
-  // These are all the actors that were created long ago.
-  for ( this->ContourPolyDataActors->InitTraversal(ait);
-          (ac=this->ContourPolyDataActors->GetNextActor(ait)); )
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushRepresentationGrayscale2D::BuildRepresentation()
+{
+  // The pipeline is as follows :
+  //
+  //  SketchImage_0 --> SketchContour_0 --\
+  //  SketchImage_1 --> SketchContour_1 ---+--> PolyData_0 --> Actor_0
+  //  ....                                  \-> PolyData_1 --> Actor_1
+  //
+  // The isolines of each sketch are kept in SketchContours, and contoured
+  // again only when the sketch changes. They are gathered in one polydata
+  // per style of sketch property, with the colors of the sketches as cell
+  // data.
+
+  const int nSketches = this->PaintbrushDrawing->GetNumberOfItems();
+  bool changed = false;
+
+  // Forget the sketches that were removed from the drawing.
+  for (SketchContoursType::iterator it = this->SketchContours.begin();
+       it != this->SketchContours.end(); )
     {
-    this->PaintbrushDrawing->GetPaintbrushPropertyManager()->AddUsedColor(
-        ac->GetProperty());
+    if (this->PaintbrushDrawing->IsItemPresent(it->first))
+      {
+      ++it;
+      }
+    else
+      {
+      this->SketchContours.erase(it++);
+      changed = true;
+      }
     }
 
-  // Visit all the newly created actors and assign properties.
-  for ( this->ContourPolyDataActors->InitTraversal(ait);
-         (ac=this->ContourPolyDataActors->GetNextActor(ait));)
+  // Now, for the new sketches, we need to set reasonable colors, preferably
+  // not the same colors as the ones the other sketches use.
+  vtkstd::vector< vtkKWEPaintbrushSketch * > newSketches;
+  unsigned long propertyMTime = 0;
+  for (int i = 0; i < nSketches; i++)
     {
-    double rgb[3];
-    ac->GetProperty()->GetColor(rgb);
-    if (rgb[0] == 0.0 && rgb[1] == 0.0 && rgb[2] == 0.0)
+    vtkKWEPaintbrushSketch * sketch = this->PaintbrushDrawing->GetItem(i);
+    if (!vtkKWEPaintbrushGrayscaleData::SafeDownCast(sketch->GetPaintbrushData()))
+      {
+      continue;
+      }
+    if (this->SketchContours.find(sketch) == this->SketchContours.end())
       {
+      newSketches.push_back(sketch);
+      }
+    const unsigned long mtime = sketch->GetPaintbrushProperty()->GetMTime();
+    propertyMTime = (mtime > propertyMTime) ? mtime : propertyMTime;
+    }
 
-      // This is a newly created actor, with no color set yet. Request a
-      // possibly unique color for the sketch that this actor is rendering
-      // and assign it to the actor's property.
+  if (!newSketches.empty())
+    {
+    vtkKWEPaintbrushPropertyManager *manager =
+      this->PaintbrushDrawing->GetPaintbrushPropertyManager();
+    manager->Initialize();
+    for (SketchContoursType::const_iterator it = this->SketchContours.begin();
+         it != this->SketchContours.end(); ++it)
+      {
+      manager->AddUsedColor(it->first->GetPaintbrushProperty()->GetProperty());
+      }
 
-      ac->SetProperty( this->PaintbrushDrawing->GetPaintbrushPropertyManager()->
-          RequestColorForSketch( this->GetSketch(ac) )->GetProperty());
+    for (vtkstd::vector< vtkKWEPaintbrushSketch * >::const_iterator it =
+         newSketches.begin(); it != newSketches.end(); ++it)
+      {
+      manager->RequestColorForSketch(*it);
+      SketchContourType &contour = this->SketchContours[*it];
+      contour.MTime = 0;
+      contour.IsoValue = this->IsoValue;
+      contour.Extent[0] = contour.Extent[2] = contour.Extent[4] = 0;
+      contour.Extent[1] = contour.Extent[3] = contour.Extent[5] = -1;
       }
+    changed = true;
     }
 
-
-  // Set the update extent to the extent of the image actor. That's all we
-  // can see anyway. If the image actor's extents are outside the canvas
-  // turn the visibility off.
+  // Contour the extent of the image actor. That's all we can see anyway. If
+  // the image actor's extents are outside the canvas turn the visibility
+  // off.
 
   int imageActorExtents[6], imageDataExtents[6], intersectingExtents[6];
   this->ImageActor->GetDisplayExtent( imageActorExtents );
@@ -257,66 +480,20 @@ void vtkKWEPaintbrushRepresentationGrayscale2D::BuildRepresentation()
 
   if (visible)
     {
-    for ( this->ImageClips->InitTraversal(ait);
-          (ic=static_cast< vtkImageClip * >(
-            this->ImageClips->GetNextItemAsObject(ait))); )
+    changed |= this->UpdateSketchContours( intersectingExtents );
+    if (changed || propertyMTime > this->ContourPolyDataBuildTime.GetMTime())
       {
-      ic->SetOutputWholeExtent( intersectingExtents );
+      this->BuildContourPolyData();
       }
-
-    // Set the isovalue of the contour filters to the isovalue and update the
-    // contour filter.
-    for ( this->ContourFilters->InitTraversal(ait);
-           (cf=static_cast< vtkContourFilter * >(
-              this->ContourFilters->GetNextItemAsObject(ait))); )
-      {
-      cf->SetValue(0, this->IsoValue);
-      cf->Update();
-      }
-    }
-
-  for ( this->ContourPolyDataActors->InitTraversal(ait);
-         (ac=this->ContourPolyDataActors->GetNextActor(ait));)
-    {
-    ac->SetVisibility( visible );
     }
-}
 
-//----------------------------------------------------------------------
-vtkKWEPaintbrushSketch * vtkKWEPaintbrushRepresentationGrayscale2D::
-GetSketch( vtkActor * a )
-{
   vtkActor *ac;
   vtkCollectionSimpleIterator ait;
-  int i = 0;
-  vtkImageData * image = NULL;
-  const int nSketches = this->PaintbrushDrawing->GetNumberOfItems();
-
   for ( this->ContourPolyDataActors->InitTraversal(ait);
-         (ac=this->ContourPolyDataActors->GetNextActor(ait)); ++i)
-    {
-    if (ac == a)
-      {
-      image = static_cast< vtkImageData *>((
-          static_cast< vtkImageExtractComponents * >(
-            this->ExtractComponents->GetItemAsObject(i)))->GetInput());
-      }
-    }
-
-  for (i = 0; i < nSketches; i++)
+         (ac=this->ContourPolyDataActors->GetNextActor(ait));)
     {
-    vtkKWEPaintbrushSketch * sketch = this->PaintbrushDrawing->GetItem(i);
-    if (vtkKWEPaintbrushGrayscaleData *mask = vtkKWEPaintbrushGrayscaleData::
-        SafeDownCast(sketch->GetPaintbrushData()))
-      {
-      if (image == mask->GetImageData())
-        {
-        return sketch;
-        }
-      }
+    ac->SetVisibility( visible );
     }
-
-  return NULL;
 }
 
 //----------------------------------------------------------------------
@@ -23,11 +23,12 @@
 #define __vtkKWEPaintbrushRepresentationGrayscale2D_h
 
 #include "vtkKWEPaintbrushRepresentation2D.h"
+#include "vtkTimeStamp.h"
+#include <vtkstd/map>
+#include <vtkstd/vector>
 
 class vtkActorCollection;
 class vtkMapperCollection;
-class vtkContourFilter;
-class vtkCollection;
 class vtkKWEPaintbrushSketch;
 
 class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushRepresentationGrayscale2D
@@ -87,19 +88,44 @@ protected:
   ~vtkKWEPaintbrushRepresentationGrayscale2D();
 
   double                IsoValue;
-  vtkCollection       * ContourFilters;
   vtkMapperCollection * ContourPolyDataMappers;
   vtkActorCollection  * ContourPolyDataActors;
-  vtkCollection       * ExtractComponents;
-  vtkCollection       * ImageClips;
+  vtkTimeStamp          ContourPolyDataBuildTime;
+
+  //BTX
+  // Description:
+  // Isolines of a sketch on the displayed extent, in world coordinates.
+  // They are contoured again only when the sketch, the displayed extent or
+  // the isovalue change.
+  struct SketchContourType
+    {
+    vtkstd::vector< double >    Points;
+    vtkstd::vector< vtkIdType > Lines;
+    unsigned long               MTime;
+    int                         Extent[6];
+    double                      IsoValue;
+    };
+  typedef vtkstd::map< vtkKWEPaintbrushSketch *,
+                       SketchContourType > SketchContoursType;
+  SketchContoursType SketchContours;
+  //ETX
+
+  // Description:
+  // Contour the sketches that changed since they were last contoured on
+  // "extent". Returns true if any did.
+  bool UpdateSketchContours( int extent[6] );
+
+  // Description:
+  // Gather the isolines of all the sketches into one polydata per style of
+  // sketch property (line width, opacity, stipple and edges), with the
+  // sketch index and color of each line as cell data. These are rendered by
+  // ContourPolyDataActors, with the property of their sketches.
+  void BuildContourPolyData();
 
 private:
   vtkKWEPaintbrushRepresentationGrayscale2D(
       const vtkKWEPaintbrushRepresentationGrayscale2D&);  //Not implemented
   void operator=(const vtkKWEPaintbrushRepresentationGrayscale2D&); //Not implemented
-
-  // Given an actor, it finds the sketch that its a rendition of.
-  vtkKWEPaintbrushSketch * GetSketch( vtkActor * );
 };
 
 #endif
@@ -23,10 +23,44 @@
 #include "vtkKWEPaintbrushGrayscaleData.h"
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkImageData.h"
+#include "vtkImageStencilData.h"
 #include "vtkObjectFactory.h"
+#include <vtkstd/map>
+#include <vtkstd/vector>
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushShape, "$Revision: 3282 $");
 
+// Footprints are computed for centers quantized to 1/8th of a voxel.
+#define VTK_KWE_FOOTPRINT_SUBDIVISIONS 8
+
+// Maximum number of footprints cached for each representation. When
+// exceeded, the cache is emptied.
+#define VTK_KWE_FOOTPRINT_CACHE_SIZE 128
+
+//----------------------------------------------------------------------
+class vtkKWEPaintbrushShapeFootprint
+{
+public:
+  // Extent of the footprint, relative to the voxel it is attached to.
+  int Extent[6];
+
+  // Binary footprints: x1, x2, y, z of each run.
+  vtkstd::vector< int > Runs;
+
+  // Grayscale footprints: value of each voxel in the extent.
+  vtkstd::vector< float > Values;
+};
+
+//----------------------------------------------------------------------
+class vtkKWEPaintbrushShapeFootprintCache
+{
+public:
+  typedef vtkstd::map< int, vtkKWEPaintbrushShapeFootprint > FootprintMapType;
+
+  // Indexed by quantized sub-voxel phase. [0] binary, [1] grayscale.
+  FootprintMapType Footprints[2];
+};
+
 //----------------------------------------------------------------------
 vtkKWEPaintbrushShape::vtkKWEPaintbrushShape()
 {
@@ -43,11 +77,276 @@ vtkKWEPaintbrushShape::vtkKWEPaintbrushShape()
   this->ClipExtent[1]    = VTK_INT_MAX;
   this->ClipExtent[3]    = VTK_INT_MAX;
   this->ClipExtent[5]    = VTK_INT_MAX;
+  this->FootprintCache   = new vtkKWEPaintbrushShapeFootprintCache;
 }
 
 //----------------------------------------------------------------------
 vtkKWEPaintbrushShape::~vtkKWEPaintbrushShape()
 {
+  delete this->FootprintCache;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShape::Modified()
+{
+  this->Superclass::Modified();
+  this->FootprintCache->Footprints[0].clear();
+  this->FootprintCache->Footprints[1].clear();
+}
+
+//----------------------------------------------------------------------
+double vtkKWEPaintbrushShape::EvaluateFootprint(
+    const double vtkNotUsed(d)[3], int vtkNotUsed(grayscale) )
+{
+  return 0.0;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShape::GetFootprintRadius(
+    double r[3], int vtkNotUsed(grayscale) )
+{
+  double *width = this->GetWidth();
+  for (int i = 0; i < 3; i++)
+    {
+    r[i] = width[i] / 2.0;
+    }
+}
+
+//----------------------------------------------------------------------
+const vtkKWEPaintbrushShapeFootprint *
+vtkKWEPaintbrushShape::GetFootprint( double p[3], int grayscale, int base[3] )
+{
+  const int subdivisions = VTK_KWE_FOOTPRINT_SUBDIVISIONS;
+
+  // Split the position into the voxel below it and a quantized phase.
+  int phase[3];
+  for (int i = 0; i < 3; i++)
+    {
+    const double u = (p[i] - this->Origin[i]) / this->Spacing[i];
+    base[i] = static_cast< int >(floor(u));
+    phase[i] = static_cast< int >((u - base[i]) * subdivisions + 0.5);
+    if (phase[i] == subdivisions)
+      {
+      ++base[i];
+      phase[i] = 0;
+      }
+    }
+
+  vtkKWEPaintbrushShapeFootprintCache::FootprintMapType &footprints =
+    this->FootprintCache->Footprints[grayscale ? 1 : 0];
+  const int key = phase[0] + subdivisions * (phase[1] + subdivisions * phase[2]);
+  vtkKWEPaintbrushShapeFootprintCache::FootprintMapType::iterator it =
+    footprints.find(key);
+  if (it != footprints.end())
+    {
+    return &(it->second);
+    }
+
+  if (footprints.size() >= VTK_KWE_FOOTPRINT_CACHE_SIZE)
+    {
+    footprints.clear();
+    }
+
+  // Sample the shape about the quantized center.
+
+  vtkKWEPaintbrushShapeFootprint &footprint = footprints[key];
+  double radius[3], center[3];
+  this->GetFootprintRadius(radius, grayscale);
+  for (int i = 0; i < 3; i++)
+    {
+    center[i] = static_cast< double >(phase[i]) / subdivisions;
+    footprint.Extent[2*i] = static_cast< int >(
+        floor(center[i] - radius[i] / this->Spacing[i]));
+    footprint.Extent[2*i+1] = static_cast< int >(
+        ceil(center[i] + radius[i] / this->Spacing[i]));
+    }
+
+  const int *e = footprint.Extent;
+  if (grayscale)
+    {
+    footprint.Values.reserve(
+        (e[1]-e[0]+1) * (e[3]-e[2]+1) * (e[5]-e[4]+1));
+    }
+
+  double d[3];
+  for (int z = e[4]; z <= e[5]; z++)
+    {
+    d[2] = (z - center[2]) * this->Spacing[2];
+    for (int y = e[2]; y <= e[3]; y++)
+      {
+      d[1] = (y - center[1]) * this->Spacing[1];
+
+      if (grayscale)
+        {
+        for (int x = e[0]; x <= e[1]; x++)
+          {
+          d[0] = (x - center[0]) * this->Spacing[0];
+          footprint.Values.push_back(
+              static_cast< float >(this->EvaluateFootprint(d, 1)));
+          }
+        continue;
+        }
+
+      // There is at most one run per scan line in our shapes.
+      int x1 = 0, x2 = 0;
+      bool found = false;
+      for (int x = e[0]; x <= e[1]; x++)
+        {
+        d[0] = (x - center[0]) * this->Spacing[0];
+        if (this->EvaluateFootprint(d, 0) != 0.0)
+          {
+          if (!found)
+            {
+            x1 = x;
+            found = true;
+            }
+          x2 = x;
+          }
+        else if (found)
+          {
+          break;
+          }
+        }
+      if (found)
+        {
+        footprint.Runs.push_back(x1);
+        footprint.Runs.push_back(x2);
+        footprint.Runs.push_back(y);
+        footprint.Runs.push_back(z);
+        }
+      }
+    }
+
+  return &footprint;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShape::GetStencilFromFootprint(
+    vtkImageStencilData *stencilData, double p[3], int extent[6] )
+{
+  stencilData->SetExtent(extent);
+  stencilData->SetSpacing(this->Spacing);
+  stencilData->SetOrigin(this->Origin);
+  stencilData->AllocateExtents();
+
+  int base[3];
+  const vtkKWEPaintbrushShapeFootprint *footprint =
+    this->GetFootprint(p, 0, base);
+
+  // Translate the runs of the footprint and clip them to the extent.
+  const vtkstd::vector< int > &runs = footprint->Runs;
+  for (unsigned int r = 0; r < runs.size(); r += 4)
+    {
+    const int y = runs[r+2] + base[1];
+    const int z = runs[r+3] + base[2];
+    if (y < extent[2] || y > extent[3] || z < extent[4] || z > extent[5])
+      {
+      continue;
+      }
+    int x1 = runs[r] + base[0], x2 = runs[r+1] + base[0];
+    if (x1 < extent[0])
+      {
+      x1 = extent[0];
+      }
+    if (x2 > extent[1])
+      {
+      x2 = extent[1];
+      }
+    if (x1 <= x2)
+      {
+      stencilData->InsertNextExtent(x1, x2, y, z);
+      }
+    }
+}
+
+//----------------------------------------------------------------------
+int vtkKWEPaintbrushShape::GetSweptStencil( vtkImageStencilData *,
+    double vtkNotUsed(p0)[3], double vtkNotUsed(p1)[3] )
+{
+  return 0;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShape::AllocateSweptStencil(
+    vtkImageStencilData *stencilData, double p0[3], double p1[3],
+    double r[3], int extent[6] )
+{
+  for (int i = 0; i < 3; i++)
+    {
+    const double lo = (p0[i] < p1[i] ? p0[i] : p1[i]) - r[i];
+    const double hi = (p0[i] < p1[i] ? p1[i] : p0[i]) + r[i];
+    extent[2*i]   = static_cast< int >(ceil((lo - this->Origin[i])/this->Spacing[i]));
+    extent[2*i+1] = static_cast< int >(floor((hi - this->Origin[i])/this->Spacing[i]));
+
+    // Clip the extents with the clip extent.
+    if (extent[2*i] < this->ClipExtent[2*i])
+      {
+      extent[2*i] = this->ClipExtent[2*i];
+      }
+    if (extent[2*i+1] > this->ClipExtent[2*i+1])
+      {
+      extent[2*i+1] = this->ClipExtent[2*i+1];
+      }
+    }
+
+  stencilData->SetExtent(extent);
+  stencilData->SetSpacing(this->Spacing);
+  stencilData->SetOrigin(this->Origin);
+  stencilData->AllocateExtents();
+}
+
+//----------------------------------------------------------------------
+template < class T >
+void vtkKWEPaintbrushShapeFillFromFootprint(
+    vtkImageData *imageData, T *, int extent[6],
+    const vtkKWEPaintbrushShapeFootprint *footprint, int base[3] )
+{
+  const int *e = footprint->Extent;
+  const int nx = e[1] - e[0] + 1, ny = e[3] - e[2] + 1;
+
+  for (int k = extent[4]; k <= extent[5]; k++)
+    {
+    const int z = k - base[2];
+    for (int j = extent[2]; j <= extent[3]; j++)
+      {
+      const int y = j - base[1];
+      T * np = static_cast< T* >(imageData->GetScalarPointer(extent[0],j,k));
+
+      // Voxels outside the footprint are outside the shape.
+      const float *row = NULL;
+      if (y >= e[2] && y <= e[3] && z >= e[4] && z <= e[5])
+        {
+        row = &(footprint->Values[((z - e[4]) * ny + (y - e[2])) * nx]);
+        }
+      for (int i = extent[0]; i <= extent[1]; ++i, ++np)
+        {
+        const int x = i - base[0];
+        *np = (row && x >= e[0] && x <= e[1]) ?
+          static_cast< T >(row[x - e[0]]) : static_cast< T >(0.0);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShape::GetGrayscaleDataFromFootprint(
+    vtkImageData *imageData, double p[3], int extent[6] )
+{
+  imageData->SetSpacing(this->Spacing);
+  imageData->SetOrigin(this->Origin);
+  imageData->SetExtent(extent);
+  imageData->SetScalarType(this->GetScalarType());
+  imageData->AllocateScalars();
+
+  int base[3];
+  const vtkKWEPaintbrushShapeFootprint *footprint =
+    this->GetFootprint(p, 1, base);
+
+  switch (imageData->GetScalarType())
+    {
+    vtkTemplateMacro( vtkKWEPaintbrushShapeFillFromFootprint(
+        imageData, static_cast< VTK_TT * >(0), extent, footprint, base ));
+    }
 }
 
 //----------------------------------------------------------------------
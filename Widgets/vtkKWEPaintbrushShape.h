@@ -41,6 +41,8 @@ class vtkImageStencilData;
 class vtkImageData;
 class vtkKWEPaintbrushData;
 class vtkPlane;
+class vtkKWEPaintbrushShapeFootprint;
+class vtkKWEPaintbrushShapeFootprintCache;
 
 class VTKEdge_WIDGETS_EXPORT vtkKWEPaintbrushShape : public vtkObject
 {
@@ -167,10 +169,58 @@ public:
   // Get the extents of a shape drawn at the current location.
   virtual void GetExtent( int extent[6], double p[3] ) = 0;
 
+  // Description:
+  // INTERNAL - Do not use.
+  // Get the volume swept by the shape as it moves from "p0" to "p1", as a
+  // binary stencil. Returns 0 if the shape does not support sweeping.
+  virtual int GetSweptStencil( vtkImageStencilData *,
+                               double p0[3], double p1[3] );
+
+  // Description:
+  // Overridden to discard the cached footprints of the shape.
+  virtual void Modified();
+
 protected:
   vtkKWEPaintbrushShape();
   ~vtkKWEPaintbrushShape();
 
+  // Description:
+  // Footprints: the shape is sampled once at the voxels around a center
+  // quantized to a fraction of a voxel. Consecutive positions of a stroke
+  // differ only by an integer translation and a sub-voxel phase, so the
+  // footprint for a phase is cached and translated to each position. The
+  // cache is discarded whenever the shape is modified.
+  //   Subclasses supply the value of the shape at an offset "d" (in world
+  // coordinates) from its center, 0 being outside. In binary mode, any other
+  // value is inside. In grayscale mode, the value is the grayscale value.
+  // They also supply the half size of the region where the value may be
+  // non-zero.
+  virtual double EvaluateFootprint( const double d[3], int grayscale );
+  virtual void GetFootprintRadius( double r[3], int grayscale );
+
+  // Description:
+  // Fill the stencil / image with the shape centered at "p", within
+  // "extent", using the cached footprints.
+  void GetStencilFromFootprint( vtkImageStencilData *,
+                                double p[3], int extent[6] );
+  void GetGrayscaleDataFromFootprint( vtkImageData *,
+                                      double p[3], int extent[6] );
+
+  // Description:
+  // Allocate the stencil over the extent swept by a shape of half size "r"
+  // moving from "p0" to "p1", clipped with the ClipExtent. The extent is
+  // returned.
+  void AllocateSweptStencil( vtkImageStencilData *, double p0[3],
+                             double p1[3], double r[3], int extent[6] );
+
+  //BTX
+  // Description:
+  // Get the footprint for a shape centered at "p". "base" is set to the
+  // voxel the footprint is relative to.
+  const vtkKWEPaintbrushShapeFootprint *GetFootprint(
+      double p[3], int grayscale, int base[3] );
+  //ETX
+
   double         Spacing[3];
   double         Origin[3];
   int            ScalarType;
@@ -180,6 +230,8 @@ protected:
   double         MaxWidth[3];
   int            ClipExtent[6];
 
+  vtkKWEPaintbrushShapeFootprintCache *FootprintCache;
+
 private:
   vtkKWEPaintbrushShape(const vtkKWEPaintbrushShape&);  //Not implemented
   void operator=(const vtkKWEPaintbrushShape&);  //Not implemented
@@ -210,74 +210,86 @@ void vtkKWEPaintbrushShapeBox::GetStencil(
 }
 
 //----------------------------------------------------------------------
-// This really returns the distance map from an ellipsoid of similar size
-// as the cuboid.. Who the hell will use a box shaped rectangular image
-// data anyway.. Its got singularities.. noone doing image processing
-// for sure.. !!
-template < class T >
-int vtkKWEPaintbrushShapeBoxFillBuffer( vtkKWEPaintbrushShapeBox * self,
-                   vtkImageData *imageData, T, int extent[6], double p[3] )
+int vtkKWEPaintbrushShapeBox::GetSweptStencil(
+    vtkImageStencilData *stencilData, double p0[3], double p1[3])
 {
-  // Polarity of the shape
-  bool state = false;
-  if (self->GetPolarity() == vtkKWEPaintbrushEnums::Draw)
+  // GetExtent() rounds the bounds of the box to the nearest voxel below, so
+  // that GetStencil() holds the voxels whose center lies in the box moved
+  // back by half a voxel. Sweep that box, so that the swept volume is the
+  // union of the stencils along the segment.
+  double q0[3], q1[3];
+  for (int i = 0; i < 3; i++)
     {
-    state = true;
+    q0[i] = p0[i] - 0.5 * this->Spacing[i];
+    q1[i] = p1[i] - 0.5 * this->Spacing[i];
     }
 
-  const double r1square = 0.25 * self->GetWidth()[0]*self->GetWidth()[0];
-  const double r2square = 0.25 * self->GetWidth()[1]*self->GetWidth()[1];
-  const double r3square = 0.25 * self->GetWidth()[2]*self->GetWidth()[2];
+  double r[3] = { this->Width[0]/2.0, this->Width[1]/2.0, this->Width[2]/2.0 };
+  int extent[6];
+  this->AllocateSweptStencil(stencilData, q0, q1, r, extent);
+  if (r[0] <= 0.0 || r[1] <= 0.0 || r[2] <= 0.0)
+    {
+    return 1;
+    }
 
-  double value;
+  // In coordinates centered on q0 and normalized by the half widths, the
+  // box is the cube [-1,1]^3 and a voxel q is swept if |q_i - t v_i| <= 1
+  // along each axis for some t in [0,1]. The y and z axes restrict t to an
+  // interval for each scan line, which in turn gives the run along x.
 
-  for (int k= extent[4]; k<=extent[5]; k++)
+  double v[3];
+  for (int i = 0; i < 3; i++)
     {
-    for (int j= extent[2]; j<=extent[3]; j++)
-      {
-      for (int i= extent[0]; i<=extent[1]; i++)
-        {
-        T * np = static_cast< T* >(imageData->GetScalarPointer(i,j,k));
+    v[i] = (q1[i] - q0[i]) / r[i];
+    }
 
-        double px = (i *
-            self->GetSpacing()[0] + self->GetOrigin()[0]) - p[0];
-        double py = (j *
-            self->GetSpacing()[1] + self->GetOrigin()[1]) - p[1];
-        double pz = (k *
-            self->GetSpacing()[2] + self->GetOrigin()[2]) - p[2];
+  double c[3];
+  for (int z = extent[4]; z <= extent[5]; z++)
+    {
+    c[2] = (z * this->Spacing[2] + this->Origin[2] - q0[2]) / r[2];
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      c[1] = (y * this->Spacing[1] + this->Origin[1] - q0[1]) / r[1];
 
-        if ( (px*px/r1square + py*py/r2square + pz*pz/r3square) > 2.0 )
+      double tMin = 0.0, tMax = 1.0;
+      for (int i = 1; i < 3; i++)
+        {
+        if (v[i] == 0.0)
           {
-          // Outside the ellipse
-          *np = static_cast< T >(0.0);
+          if (fabs(c[i]) > 1.0)
+            {
+            tMin = 1.0;
+            tMax = 0.0;
+            }
           continue;
           }
-
-        // Normalized distance of the point from the surface of the ellipse.
-        // This is 1.0 at the surface, 0.0 at the center, 2.0 at twice the
-        // distance from the surface...
-        double distance = sqrt(px*px/r1square + py*py/r2square + pz*pz/r3square);
-
-        if (state)
-          {
-          value = 255.0 - 127.5 * distance;
-          }
-        else
-          {
-          value = 127.5 * distance;
-          }
-
-        // clamp value
-        if( value < 1.0 )
-          {
-          value = 1.0;
-          }
-        else if( value > 254.0 )
+        double t1 = (c[i] - 1.0) / v[i], t2 = (c[i] + 1.0) / v[i];
+        if (t1 > t2)
           {
-          value = 254.0;
+          const double tmp = t1;
+          t1 = t2;
+          t2 = tmp;
           }
+        tMin = (t1 > tMin) ? t1 : tMin;
+        tMax = (t2 < tMax) ? t2 : tMax;
+        }
+      if (tMin > tMax)
+        {
+        continue;
+        }
 
-        *np = static_cast< T >(value);
+      // Range of x along the scan line, in voxels.
+      const double u1 = (v[0] < 0.0 ? tMax : tMin) * v[0] - 1.0;
+      const double u2 = (v[0] < 0.0 ? tMin : tMax) * v[0] + 1.0;
+      const double xMin = (u1 * r[0] + q0[0] - this->Origin[0]) / this->Spacing[0];
+      const double xMax = (u2 * r[0] + q0[0] - this->Origin[0]) / this->Spacing[0];
+      int x1 = static_cast< int >(ceil(xMin));
+      int x2 = static_cast< int >(floor(xMax));
+      x1 = (x1 < extent[0]) ? extent[0] : x1;
+      x2 = (x2 > extent[1]) ? extent[1] : x2;
+      if (x1 <= x2)
+        {
+        stencilData->InsertNextExtent(x1, x2, y, z);
         }
       }
     }
@@ -286,25 +298,67 @@ int vtkKWEPaintbrushShapeBoxFillBuffer( vtkKWEPaintbrushShapeBox * self,
 }
 
 //----------------------------------------------------------------------
-void vtkKWEPaintbrushShapeBox::GetGrayscaleData(
-          vtkImageData *imageData, double p[3])
+// This really returns the distance map from an ellipsoid of similar size
+// as the cuboid.. Who the hell will use a box shaped rectangular image
+// data anyway.. Its got singularities.. noone doing image processing
+// for sure.. !!
+double vtkKWEPaintbrushShapeBox::EvaluateFootprint(
+    const double d[3], int vtkNotUsed(grayscale) )
 {
-  // Compute the extents of the an image centered about p.
-  int extent[6];
-  this->GetExtent( extent, p );
+  // Polarity of the shape
+  const bool state = (this->Polarity == vtkKWEPaintbrushEnums::Draw);
 
-  imageData->SetSpacing(this->Spacing);
-  imageData->SetOrigin(this->Origin);
-  imageData->SetExtent(extent);
+  const double r1square = 0.25 * this->Width[0]*this->Width[0];
+  const double r2square = 0.25 * this->Width[1]*this->Width[1];
+  const double r3square = 0.25 * this->Width[2]*this->Width[2];
 
-  imageData->SetScalarType(this->GetScalarType());
-  imageData->AllocateScalars();
+  const double distanceSq =
+    d[0]*d[0]/r1square + d[1]*d[1]/r2square + d[2]*d[2]/r3square;
+  if ( distanceSq > 2.0 )
+    {
+    // Outside the ellipse
+    return 0.0;
+    }
+
+  // Normalized distance of the point from the surface of the ellipse.
+  // This is 1.0 at the surface, 0.0 at the center, 2.0 at twice the
+  // distance from the surface...
+  const double distance = sqrt(distanceSq);
 
-  switch (imageData->GetScalarType())
+  double value = state ? (255.0 - 127.5 * distance) : (127.5 * distance);
+
+  // clamp value
+  if( value < 1.0 )
     {
-    vtkTemplateMacro( vtkKWEPaintbrushShapeBoxFillBuffer(
-                this, imageData, static_cast< VTK_TT >(0), extent, p ));
+    value = 1.0;
     }
+  else if( value > 254.0 )
+    {
+    value = 254.0;
+    }
+
+  return value;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShapeBox::GetFootprintRadius(
+    double r[3], int vtkNotUsed(grayscale) )
+{
+  // The grayscale profile extends to sqrt(2) times the half width.
+  for (int i = 0; i < 3; i++)
+    {
+    r[i] = sqrt(2.0) * this->Width[i] / 2.0;
+    }
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShapeBox::GetGrayscaleData(
+          vtkImageData *imageData, double p[3])
+{
+  // Compute the extents of the an image centered about p.
+  int extent[6];
+  this->GetExtent( extent, p );
+  this->GetGrayscaleDataFromFootprint( imageData, p, extent );
 }
 
 //----------------------------------------------------------------------
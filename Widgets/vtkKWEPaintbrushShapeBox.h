@@ -60,6 +60,10 @@ public:
   virtual void GetStencil(vtkImageStencilData *, double p[3]);
   virtual void GetGrayscaleData(vtkImageData  *, double p[3]);
 
+  // Description:
+  // Get the volume swept by the box from p0 to p1 as a stencil.
+  virtual int GetSweptStencil(vtkImageStencilData *, double p0[3], double p1[3]);
+
   //Description:
   //Set new shape width
   virtual void SetWidth( double newWidthX, double newWidthY, double newWidthZ );
@@ -92,6 +96,12 @@ protected:
   vtkKWEPaintbrushShapeBox();
   ~vtkKWEPaintbrushShapeBox();
 
+  // Description:
+  // See vtkKWEPaintbrushShape. The box stencil is inserted row by row from
+  // its extent, so only grayscale footprints are ever requested.
+  virtual double EvaluateFootprint( const double d[3], int grayscale );
+  virtual void GetFootprintRadius( double r[3], int grayscale );
+
   double         Width[3];
 
 private:
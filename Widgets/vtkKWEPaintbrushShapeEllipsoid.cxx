@@ -270,166 +270,229 @@ void vtkKWEPaintbrushShapeEllipsoid::GetStencil(
       }
     }
 
-  // A.2 Allocate the stencil
+  // A.2 Fill the stencil with the cached footprint of the ellipsoid
 
-  stencilData->SetExtent(ellipsoidExtent);
-  stencilData->SetSpacing(this->Spacing);
-  stencilData->SetOrigin(this->Origin);
-  stencilData->AllocateExtents();
+  this->GetStencilFromFootprint(stencilData, p, ellipsoidExtent);
+}
 
-  // A.3 Fill the stencil with an ellipsoid
+//----------------------------------------------------------------------
+// Restrict [lo, hi] to the values of x where a x^2 + 2 b x + c <= 0, with
+// a >= 0. Returns false if the result is empty.
+static bool vtkKWEPaintbrushShapeEllipsoidClipToQuadratic(
+    double a, double b, double c, double &lo, double &hi )
+{
+  if (a < 1e-12)
+    {
+    // Degenerates to 2 b x + c <= 0.
+    if (fabs(b) < 1e-12)
+      {
+      return (c <= 0.0);
+      }
+    const double x = -c / (2.0 * b);
+    if (b > 0.0)
+      {
+      hi = (hi < x) ? hi : x;
+      }
+    else
+      {
+      lo = (lo > x) ? lo : x;
+      }
+    return (lo <= hi);
+    }
 
-  int xIdx, yIdx, zIdx, ends[2];
-  double startPt[3], inc[3];
+  const double discriminant = b * b - a * c;
+  if (discriminant < 0.0)
+    {
+    return false;
+    }
+  const double s = sqrt(discriminant);
+  const double x1 = (-b - s) / a, x2 = (-b + s) / a;
+  lo = (lo > x1) ? lo : x1;
+  hi = (hi < x2) ? hi : x2;
+  return (lo <= hi);
+}
 
-  for (int i = 0; i < 3; i++)
+//----------------------------------------------------------------------
+int vtkKWEPaintbrushShapeEllipsoid::GetSweptStencil(
+    vtkImageStencilData *stencilData, double p0[3], double p1[3])
+{
+  double r[3] = { this->Width[0]/2.0, this->Width[1]/2.0, this->Width[2]/2.0 };
+  int extent[6];
+  this->AllocateSweptStencil(stencilData, p0, p1, r, extent);
+  if (r[0] <= 0.0 || r[1] <= 0.0 || r[2] <= 0.0)
     {
-    startPt[i] = 2.0 * (((double)ellipsoidExtent[2*i])*this->Spacing[i] +
-        this->Origin[i] - p[i])/this->Width[i];
-    inc[i] = 2.0 * this->Spacing[i] / this->Width[i];
+    return 1;
     }
 
-  double yInc = inc[1], xInc = inc[0], zInc = inc[2], zDist = startPt[2], xDist, yDist;
-  double zDistSq, zyDistSq, distSq;
+  // Work in coordinates centered on p0 and normalized by the radii. The
+  // ellipsoid is then the unit sphere and the swept volume is a capsule of
+  // radius 1 around the segment [0, v]. Along a scan line, the voxels are
+  // at q = c + x e, where e = (k, 0, 0), and the capsule is an interval
+  // of x: the hull of the intervals within the two end spheres and within
+  // the cylinder between them.
 
-  // A.4 Rasterize
+  double v[3], vv = 0.0;
+  for (int i = 0; i < 3; i++)
+    {
+    v[i] = (p1[i] - p0[i]) / r[i];
+    vv += v[i] * v[i];
+    }
+  const double k = this->Spacing[0] / r[0];
 
-  for (zIdx = ellipsoidExtent[4]; zIdx <= ellipsoidExtent[5]; zIdx++, zDist += zInc)
+  double c[3];
+  c[0] = (this->Origin[0] - p0[0]) / r[0];
+  for (int z = extent[4]; z <= extent[5]; z++)
     {
-    zDistSq = zDist * zDist;
-    yDist = startPt[1];
-    for (yIdx = ellipsoidExtent[2]; yIdx <= ellipsoidExtent[3]; yIdx++, yDist += yInc)
+    c[2] = (z * this->Spacing[2] + this->Origin[2] - p0[2]) / r[2];
+    for (int y = extent[2]; y <= extent[3]; y++)
       {
-      zyDistSq = zDistSq + (yDist * yDist);
+      c[1] = (y * this->Spacing[1] + this->Origin[1] - p0[1]) / r[1];
 
-      xDist = startPt[0];
-      ends[0] = ends[1] = -1;
+      double xMin = VTK_DOUBLE_MAX, xMax = -VTK_DOUBLE_MAX;
 
-      for (xIdx = ellipsoidExtent[0]; xIdx <= ellipsoidExtent[1]; xIdx++, xDist += xInc)
+      // The end spheres
+      for (int end = 0; end < 2; end++)
         {
-        distSq = zyDistSq + (xDist * xDist);
-
-        if (ends[0] == -1 && distSq <= 1.0)
+        const double d[3] = { c[0] - end * v[0],
+                              c[1] - end * v[1],
+                              c[2] - end * v[2] };
+        double lo = -VTK_DOUBLE_MAX, hi = VTK_DOUBLE_MAX;
+        if (vtkKWEPaintbrushShapeEllipsoidClipToQuadratic( k * k, d[0] * k,
+              d[0] * d[0] + d[1] * d[1] + d[2] * d[2] - 1.0, lo, hi ))
           {
-          // found the start
-          ends[0] = xIdx;
-          continue;
+          xMin = (xMin < lo) ? xMin : lo;
+          xMax = (xMax > hi) ? xMax : hi;
           }
-        if (ends[0] != -1 && distSq > 1.0)
+        }
+
+      // The cylinder: distance to the axis within 1 and projection on the
+      // axis, t = (q.v)/(v.v), within [0, 1].
+      if (vv > 0.0)
+        {
+        const double cv = c[0] * v[0] + c[1] * v[1] + c[2] * v[2];
+        const double cc = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+        const double ev = k * v[0];
+        double lo = -VTK_DOUBLE_MAX, hi = VTK_DOUBLE_MAX;
+        bool inside = vtkKWEPaintbrushShapeEllipsoidClipToQuadratic(
+            k * k - ev * ev / vv, c[0] * k - cv * ev / vv,
+            cc - cv * cv / vv - 1.0, lo, hi);
+        inside = inside && vtkKWEPaintbrushShapeEllipsoidClipToQuadratic(
+            0.0, -0.5 * ev, -cv, lo, hi);                     // t >= 0
+        inside = inside && vtkKWEPaintbrushShapeEllipsoidClipToQuadratic(
+            0.0, 0.5 * ev, cv - vv, lo, hi);                  // t <= 1
+        if (inside)
           {
-          // found the end, jump to to the next scan line. There can be only one
-          // segment per scan line in an ellipse.
-          ends[1] = xIdx;
-          stencilData->InsertNextExtent(ends[0], ends[1]-1, yIdx, zIdx);
-          break;
+          xMin = (xMin < lo) ? xMin : lo;
+          xMax = (xMax > hi) ? xMax : hi;
           }
         }
 
-      if (ends[1] == -1 && ends[0] != -1)
+      if (xMin > xMax)
+        {
+        continue;
+        }
+      xMin = (xMin > extent[0]) ? xMin : extent[0];
+      xMax = (xMax < extent[1]) ? xMax : extent[1];
+      const int x1 = static_cast< int >(ceil(xMin));
+      const int x2 = static_cast< int >(floor(xMax));
+      if (x1 <= x2)
         {
-        // scan line never completed.
-        stencilData->InsertNextExtent(ends[0], ellipsoidExtent[1], yIdx, zIdx);
+        stencilData->InsertNextExtent(x1, x2, y, z);
         }
       }
     }
+
+  return 1;
 }
 
 //----------------------------------------------------------------------
-template < class T >
-int vtkKWEPaintbrushShapeEllipsoidFillBuffer( vtkKWEPaintbrushShapeEllipsoid * self,
-                   vtkImageData *imageData, T, int extent[6], double p[3] )
+double vtkKWEPaintbrushShapeEllipsoid::EvaluateFootprint(
+    const double d[3], int grayscale )
 {
-  // Polarity of the shape
-  const bool state = (self->GetPolarity() == vtkKWEPaintbrushEnums::Draw);
+  // Normalized squared distance from the center. 1.0 on the surface.
+  double distanceSq = 0.0;
+  for (int i = 0; i < 3; i++)
+    {
+    const double x = 2.0 * d[i] / this->Width[i];
+    distanceSq += x * x;
+    }
 
-  // Get the radius along each axis = halfwidth ^ 2
-  const double r1square = 0.25 * self->GetWidth()[0]*self->GetWidth()[0];
-  const double r2square = 0.25 * self->GetWidth()[1]*self->GetWidth()[1];
-  const double r3square = 0.25 * self->GetWidth()[2]*self->GetWidth()[2];
+  if (!grayscale)
+    {
+    return (distanceSq <= 1.0) ? 1.0 : 0.0;
+    }
 
-  // get metadata
-  double spacing[3], origin[3], value;
-  self->GetSpacing(spacing);
-  self->GetOrigin(origin);
+  // Polarity of the shape
+  const bool state = (this->Polarity == vtkKWEPaintbrushEnums::Draw);
 
   // The grayscale values in the brush will extend to maxRadiusFactor times
   // the brush width along any direction.
-  const double transitionRegion = self->GetTransitionRegion();
+  const double transitionRegion = this->TransitionRegion;
   const double maxRadiusFactor = 1.0 + transitionRegion;
-  const double maxRadiusFactorSq = maxRadiusFactor * maxRadiusFactor;
   const double polarity = (state ? 1.0 : -1.0);
 
-  for (int k= extent[4]; k<=extent[5]; k++)
+  if ( distanceSq > maxRadiusFactor * maxRadiusFactor )
     {
-    for (int j= extent[2]; j<=extent[3]; j++)
-      {
-      T * np = static_cast< T* >(imageData->GetScalarPointer(extent[0],j,k));
-      for (int i= extent[0]; i<=extent[1]; ++i, ++np)
-        {
-        double px = i * spacing[0] + origin[0] - p[0];
-        double py = j * spacing[1] + origin[1] - p[1];
-        double pz = k * spacing[2] + origin[2] - p[2];
+    // Outside the ellipse
+    return 0.0;
+    }
 
-        const double distanceSq = px*px/r1square +
-                                  py*py/r2square +
-                                  pz*pz/r3square;
+  // Normalized distance of the point from the surface of the ellipse.
+  // This is 1.0 at the surface, 0.0 at the center, 2.0 at twice the
+  // distance from the surface...
+  const double distance = sqrt(distanceSq);
 
-        if ( distanceSq > maxRadiusFactorSq )
-          {
-          // Outside the ellipse
-          *np = static_cast< T >(0.0);
-          continue;
-          }
-
-        // Normalized distance of the point from the surface of the ellipse.
-        // This is 1.0 at the surface, 0.0 at the center, 2.0 at twice the
-        // distance from the surface...
-        const double distance = sqrt(distanceSq);
+  double value;
+  if (distance <= (1.0 - transitionRegion))
+    {
+    value = state ? 255.0 : 0.0;
+    }
+  else
+    {
+    value = 127.5 * (1.0 + polarity * (1-distance)/transitionRegion);
+    }
 
-        if (distance <= (1.0 - transitionRegion))
-          {
-          value = state ? 255.0 : 0.0;
-          }
-        else
-          {
-          value = 127.5 * (1.0 + polarity * (1-distance)/transitionRegion);
-          }
+  //  Positive brush profile              Negarive brush profile
+  //
+  //
+  // 255   -           /\                       ----        ----
+  //                  /  \                          \      /
+  // 127.5 -         /    \                          \    /
+  //                /      \                          \  /
+  // 0     _   ____/        \____                      \/
+  //
+  //               |    |    |                      |   |   |
+  //             -2r    0    2r                   -2r   0   2r
+  //
+  // value = state ? (255.0 - 127.5 * distance) : 127.5 * distance;
+
+
+  // Don't use 0. So we shrink the range within the shape by 1 on
+  // each end. 1 - 254. The reason is 0 is used to indicate an
+  // outside value (outside the brush). See vtkKWEPaintbrushGrayscaleData
+  //
+  // clamp value [1 - 254]
+  if( value < 1.0 )
+    {
+    value = 1.0;
+    }
+  else if( value > 254.0 )
+    {
+    value = 254.0;
+    }
 
-        //  Positive brush profile              Negarive brush profile
-        //
-        //
-        // 255   -           /\                       ----        ----
-        //                  /  \                          \      /
-        // 127.5 -         /    \                          \    /
-        //                /      \                          \  /
-        // 0     _   ____/        \____                      \/
-        //
-        //               |    |    |                      |   |   |
-        //             -2r    0    2r                   -2r   0   2r
-        //
-        // value = state ? (255.0 - 127.5 * distance) : 127.5 * distance;
-
-
-        // Don't use 0. So we shrink the range within the shape by 1 on
-        // each end. 1 - 254. The reason is 0 is used to indicate an
-        // outside value (outside the brush). See vtkKWEPaintbrushGrayscaleData
-        //
-        // clamp value [1 - 254]
-        if( value < 1.0 )
-          {
-          value = 1.0;
-          }
-        else if( value > 254.0 )
-          {
-          value = 254.0;
-          }
+  return value;
+}
 
-        *np = static_cast< T >(value);
-        }
-      }
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushShapeEllipsoid::GetFootprintRadius(
+    double r[3], int grayscale )
+{
+  const double factor = grayscale ? (1.0 + this->TransitionRegion) : 1.0;
+  for (int i = 0; i < 3; i++)
+    {
+    r[i] = factor * this->Width[i] / 2.0;
     }
-
-  return 1;
 }
 
 //----------------------------------------------------------------------
@@ -439,18 +502,7 @@ void vtkKWEPaintbrushShapeEllipsoid::GetGrayscaleData(
   // Compute the extents of the an image centered about p.
   int extent[6];
   this->GetExtent( extent, p );
-  imageData->SetSpacing(this->Spacing);
-  imageData->SetOrigin(this->Origin);
-  imageData->SetExtent(extent);
-
-  imageData->SetScalarType(this->GetScalarType());
-  imageData->AllocateScalars();
-
-  switch (imageData->GetScalarType())
-    {
-    vtkTemplateMacro( vtkKWEPaintbrushShapeEllipsoidFillBuffer(
-                this, imageData, static_cast< VTK_TT >(0), extent, p ));
-    }
+  this->GetGrayscaleDataFromFootprint( imageData, p, extent );
 }
 
 //----------------------------------------------------------------------
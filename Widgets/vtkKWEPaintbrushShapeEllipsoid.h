@@ -63,6 +63,10 @@ public:
   // Get the shape as a grayscale image data
   virtual void GetGrayscaleData(vtkImageData  *, double p[3]);
 
+  // Description:
+  // Get the capsule swept by the ellipsoid from p0 to p1 as a stencil.
+  virtual int GetSweptStencil(vtkImageStencilData *, double p0[3], double p1[3]);
+
   //Description:
   //Set new shape width
   virtual void SetWidth( double newWidthX, double newWidthY, double newWidthZ );
@@ -102,6 +106,11 @@ protected:
   vtkKWEPaintbrushShapeEllipsoid();
   ~vtkKWEPaintbrushShapeEllipsoid();
 
+  // Description:
+  // See vtkKWEPaintbrushShape.
+  virtual double EvaluateFootprint( const double d[3], int grayscale );
+  virtual void GetFootprintRadius( double r[3], int grayscale );
+
   double         Width[3];
   int            Resolution;
   double         TransitionRegion;
@@ -25,6 +25,8 @@
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkKWEPaintbrushGrayscaleData.h"
 #include "vtkKWEPaintbrushLabelData.h"
+#include "vtkKWEPaintbrushLabelDelta.h"
+#include "vtkKWEPaintbrushLabelBricks.h"
 #include "vtkKWEPaintbrushShape.h"
 #include "vtkKWEPaintbrushDrawing.h"
 #include "vtkKWEPaintbrushProperty.h"
@@ -32,7 +34,9 @@
 #include "vtkObjectFactory.h"
 #include "vtkMath.h"
 #include "vtkImageData.h"
+#include "vtkImageStencilData.h"
 #include "vtkProperty.h"
+#include <vtkstd/algorithm>
 
 #define max(x,y) ((x>y) ? (x) : (y))
 
@@ -51,6 +55,7 @@ vtkKWEPaintbrushSketch::vtkKWEPaintbrushSketch()
   this->CurrentStroke            = -1;
   this->Representation           = vtkKWEPaintbrushEnums::Binary;
   this->HistoryLength            = 4;
+  this->HistoryMemoryLimit       = 0;
   this->Label                    = vtkKWEPaintbrushLabelData::NoLabelValue;
   this->PaintbrushDrawing        = NULL;
 }
@@ -141,11 +146,8 @@ void vtkKWEPaintbrushSketch::Initialize( vtkKWEPaintbrushLabelData *labelMap )
   // Extract all voxels in the label map with this->Label and store
   // it in strokeData.
 
-  vtkKWEPaintbrushUtilities::GetStencilFromImage<
-      vtkKWEPaintbrushUtilities::vtkFunctorEqualTo >(
-                  labelMap->GetLabelMap(),
-                  strokeData->GetImageStencilData(),
-                  this->Label );
+  vtkKWEPaintbrushUtilities::GetStencilFromLabelData(
+                  labelMap, strokeData->GetImageStencilData(), this->Label );
 
   // Add the initial segmentation as a stroke to this sketch.
   this->AddNewStroke( vtkKWEPaintbrushEnums::Draw, strokeData, NULL, true );
@@ -209,32 +211,7 @@ int vtkKWEPaintbrushSketch::AddNewStroke(
     {
     if (this->HistoryLength > 0)
       {
-      vtkKWEPaintbrushStroke * stroke0 = this->Strokes[0];
-      vtkKWEPaintbrushStroke * stroke1 = this->Strokes[1];
-      stroke0->GetPaintbrushData()->SetLabel(this->Label);
-      stroke1->GetPaintbrushData()->SetLabel(this->Label);
-
-      // Merge, keeping the polarity in mind. Stroke 0 has to be of positive
-      // polarity.
-      if (stroke1->GetState() == vtkKWEPaintbrushEnums::Erase)
-        {
-        stroke0->GetPaintbrushData()->Subtract(stroke1->GetPaintbrushData(), forceMutable);
-        }
-      else
-        {
-        stroke0->GetPaintbrushData()->Add(stroke1->GetPaintbrushData(), forceMutable);
-        }
-
-      // Update stroke0's draw time to the most recent of stroke0 and stroke1.
-      // Of course the more recent one is stroke1.
-      stroke0->SetDrawTime( stroke1->GetDrawTime() );
-
-      // Now that we've merged, remove the stroke. So if we have 5 strokes:
-      //       0, 1, 2, 3, 4.
-      // 1 is merged into 0. Then 1 is removed. We will end up with 4 strokes:7
-      //     (0 U 1), 2, 3, 4
-      this->Strokes.erase(this->Strokes.begin()+1);
-      stroke1->UnRegister(this);
+      this->MergeOldestStrokes(forceMutable);
       }
 
     // We are at the end of the queue.
@@ -248,8 +225,20 @@ int vtkKWEPaintbrushSketch::AddNewStroke(
     // sequence, you forget about the last undo), exactly like MSWord
     this->EraseStrokes(
       this->CurrentStroke, static_cast<int>(this->Strokes.size()-1));
+
+    // Keep the history within its memory budget by merging the oldest
+    // strokes.
+    while (this->HistoryMemoryLimit && this->Strokes.size() > 1 &&
+           this->GetHistoryMemorySize() > this->HistoryMemoryLimit)
+      {
+      this->MergeOldestStrokes(forceMutable);
+      --this->CurrentStroke;
+      }
     }
 
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast(this->PaintbrushData);
+
   // 'stroke' will represent the stroke on which we will now etch.
   vtkSmartPointer< vtkKWEPaintbrushStroke > stroke = NULL;
 
@@ -278,6 +267,15 @@ int vtkKWEPaintbrushSketch::AddNewStroke(
 
     stroke->SetImageData(this->ImageData);
 
+    // Start recording the changes made by this stroke to the label map.
+    // Query the label map first for unrecorded changes, so that those
+    // made before this stroke aren't held against it.
+    if (labelData)
+      {
+      labelData->GetUnrecordedModificationTime();
+      stroke->GetLabelDelta()->Initialize();
+      }
+
     // Push it onto our history queue.
     stroke->Register(this);
     this->Strokes.push_back(stroke);
@@ -290,7 +288,15 @@ int vtkKWEPaintbrushSketch::AddNewStroke(
     // Initialize stroke with user specified data, if provided. This allows
     // user provided initializations to be undone/redone as well.
     stroke->SetPaintbrushData(initialization);
+    if (labelData && this->HistoryLength)
+      {
+      labelData->SetDeltaRecorder(stroke->GetLabelDelta());
+      }
     this->PaintbrushData->Add(initialization, forceMutable);
+    if (labelData)
+      {
+      labelData->SetDeltaRecorder(NULL);
+      }
     }
 
   return 1;
@@ -340,11 +346,8 @@ void vtkKWEPaintbrushSketch::Add( vtkKWEPaintbrushSketch * sketch )
     // Extract all voxels in the label map with this->Label and store
     // it in strokeData.
 
-    vtkKWEPaintbrushUtilities::GetStencilFromImage<
-        vtkKWEPaintbrushUtilities::vtkFunctorEqualTo >(
-                    labelMap->GetLabelMap(),
-                    strokeData->GetImageStencilData(),
-                    sketch->GetLabel() );
+    vtkKWEPaintbrushUtilities::GetStencilFromLabelData(
+        labelMap, strokeData->GetImageStencilData(), sketch->GetLabel() );
 
     // Add the initial segmentation as a stroke to this sketch.
     this->AddNewStroke( vtkKWEPaintbrushEnums::Draw, strokeData, NULL, true );
@@ -384,6 +387,12 @@ int vtkKWEPaintbrushSketch::PopStroke()
     {
     return 0;
     }
+  if (this->UndoStrokeIncrementally(this->CurrentStroke))
+    {
+    this->CurrentStroke--;
+    return 1;
+    }
+
   this->CurrentStroke--;
 
   this->ComposeStrokes();
@@ -402,8 +411,12 @@ int vtkKWEPaintbrushSketch::PushStroke()
 
   if (this->Representation == vtkKWEPaintbrushEnums::Label)
     {
-    // Need to compose all strokes for multi-label undo/redo.
-    this->ComposeStrokes();
+    // Need to compose all strokes for multi-label undo/redo, unless the
+    // stroke can be simply re-applied.
+    if (!this->RedoStrokeIncrementally(this->CurrentStroke))
+      {
+      this->ComposeStrokes();
+      }
     }
   else
     {
@@ -435,11 +448,20 @@ int vtkKWEPaintbrushSketch::DeleteLastStroke()
     return 0;
     }
 
-  vtkKWEPaintbrushStroke *stroke = this->Strokes[this->Strokes.size()-1];
+  // If the last stroke is the current one, it may be undone without
+  // composing the drawing.
+  const int lastStroke = static_cast<int>(this->Strokes.size()) - 1;
+  const bool undone = (lastStroke == this->CurrentStroke &&
+                       this->UndoStrokeIncrementally(lastStroke));
+
+  vtkKWEPaintbrushStroke *stroke = this->Strokes[lastStroke];
   stroke->UnRegister(this);
   this->Strokes.pop_back();
 
-  this->ComposeStrokes();
+  if (!undone)
+    {
+    this->ComposeStrokes();
+    }
 
   if (this->CurrentStroke >= 0)
     {
@@ -500,14 +522,14 @@ void vtkKWEPaintbrushSketch::ComposeStrokes()
 }
 
 //----------------------------------------------------------------------
-void vtkKWEPaintbrushSketch::AddShapeToCurrentStroke(double p[3],
+int vtkKWEPaintbrushSketch::AddShapeToCurrentStroke(double p[3],
                                                   vtkKWEPaintbrushData *auxData)
 {
   if (!this->Strokes.size() || this->CurrentStroke < 0 ||
       this->CurrentStroke >= static_cast<int>(this->Strokes.size()) ||
       !this->PaintbrushData)
     {
-    return;
+    return 0;
     }
 
   vtkKWEPaintbrushStroke *stroke = this->Strokes[this->CurrentStroke];
@@ -520,10 +542,22 @@ void vtkKWEPaintbrushSketch::AddShapeToCurrentStroke(double p[3],
   // current location.
   //   Hey, you need some hacks for speed right :) !
 
-  if (!stroke->AddShapeAtPosition(p, this->PaintbrushData, auxData))
+  // Record the changes made to label maps, so that the stroke can be undone
+  // cheaply.
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast(this->PaintbrushData);
+  if (labelData && this->HistoryLength)
     {
-    return;
+    labelData->SetDeltaRecorder(stroke->GetLabelDelta());
     }
+
+  const int added = stroke->AddShapeAtPosition(p, this->PaintbrushData, auxData);
+
+  if (labelData)
+    {
+    labelData->SetDeltaRecorder(NULL);
+    }
+  return added;
 }
 
 //----------------------------------------------------------------------
@@ -634,32 +668,7 @@ void vtkKWEPaintbrushSketch::CollapseHistory()
     // one stroke left.
     while (this->Strokes.size() > 1)
       {
-      vtkKWEPaintbrushStroke * stroke0 = this->Strokes[0];
-      vtkKWEPaintbrushStroke * stroke1 = this->Strokes[1];
-      stroke0->GetPaintbrushData()->SetLabel(this->Label);
-      stroke1->GetPaintbrushData()->SetLabel(this->Label);
-
-      // Merge, keeping the polarity in mind. Stroke 0 has to be of positive
-      // polarity.
-      if (stroke1->GetState() == vtkKWEPaintbrushEnums::Erase)
-        {
-        stroke0->GetPaintbrushData()->Subtract(stroke1->GetPaintbrushData());
-        }
-      else
-        {
-        stroke0->GetPaintbrushData()->Add(stroke1->GetPaintbrushData());
-        }
-
-      // Update stroke0's draw time to the most recent of stroke0 and stroke1.
-      // Of course the more recent one is stroke1.
-      stroke0->SetDrawTime( stroke1->GetDrawTime() );
-
-      // Now that we've merged, remove the stroke. So if we have 5 strokes:
-      //       0, 1, 2, 3, 4.
-      // 1 is merged into 0. Then 1 is removed. We will end up with 4 strokes:7
-      //     (0 U 1), 2, 3, 4
-      this->Strokes.erase(this->Strokes.begin()+1);
-      stroke1->UnRegister(this);
+      this->MergeOldestStrokes();
       }
 
     this->CurrentStroke = 0;
@@ -675,11 +684,12 @@ void vtkKWEPaintbrushSketch::CollapseHistory()
             vtkKWEPaintbrushStencilData::SafeDownCast(
                 this->Strokes[0]->GetPaintbrushData()))
           {
-          vtkKWEPaintbrushUtilities::GetStencilFromImage<
-            vtkKWEPaintbrushUtilities::vtkFunctorEqualTo >(
-                  labelMap->GetLabelMap(),
-                  stencilData->GetImageStencilData(),
-                  this->Label );
+          vtkKWEPaintbrushUtilities::GetStencilFromLabelData(
+                  labelMap, stencilData->GetImageStencilData(), this->Label );
+
+          int extent[6];
+          stencilData->GetExtent(extent);
+          this->Strokes[0]->ExpandDrawnExtent(extent);
           }
         }
       }      
@@ -702,15 +712,13 @@ void vtkKWEPaintbrushSketch::CopySketchFromExtentToExtent(
 
   vtkKWEPaintbrushLabelData *labelData =
     vtkKWEPaintbrushLabelData::SafeDownCast(this->PaintbrushData);
-  vtkImageData *labelImage = labelData->GetLabelMap();
-  
+
   typedef vtkKWEPaintbrushEnums::LabelType LabelType;
-  typedef vtkImageIterator< LabelType > IteratorType;
 
   // Copy over.. We won't do any extent checking..
   int labelImageExtent[6];
-  labelImage->GetExtent(labelImageExtent);
-  
+  labelData->GetExtent(labelImageExtent);
+
   if (!vtkMath::ExtentIsWithinOtherExtent(sourceExtent, labelImageExtent) ||
       !vtkMath::ExtentIsWithinOtherExtent(targetExtent, labelImageExtent))
     {
@@ -718,35 +726,235 @@ void vtkKWEPaintbrushSketch::CopySketchFromExtentToExtent(
     return;
     }
 
-  IteratorType it1(labelImage, sourceExtent);
-  IteratorType it2(labelImage, targetExtent);
-  while( !it1.IsAtEnd() )
+  // Rows are read through GetLabelRow and the runs of our label are written
+  // into the label map, or into the bricks of sparse label data.
+  const bool sparse =
+    (labelData->GetStorageMode() == vtkKWEPaintbrushLabelData::Sparse);
+  vtkImageData *labelImage = labelData->GetLabelMap();
+  const int nx = sourceExtent[1] - sourceExtent[0] + 1;
+  const int dx = targetExtent[0] - sourceExtent[0];
+  const int dy = targetExtent[2] - sourceExtent[2];
+  const int dz = targetExtent[4] - sourceExtent[4];
+  vtkstd::vector< LabelType > buffer(nx);
+
+  for (int z = sourceExtent[4]; z <= sourceExtent[5]; z++)
     {
-    LabelType *inSI1    = it1.BeginSpan();
-    LabelType *inSIEnd1 = it1.EndSpan();
-    LabelType *inSI2    = it2.BeginSpan();
-    while (inSI1 != inSIEnd1)
+    for (int y = sourceExtent[2]; y <= sourceExtent[3]; y++)
       {
-      LabelType l = *inSI1;
-      if (l == this->Label)
+      // The source row is copied, since writing the target row may move it.
+      const LabelType *row = labelData->GetLabelRow(
+          sourceExtent[0], sourceExtent[1], y, z, &buffer[0] );
+      if (row != &buffer[0])
         {
-        *inSI2 = l;
+        vtkstd::copy( row, row + nx, buffer.begin() );
+        }
+
+      int x = 0;
+      while (x < nx)
+        {
+        while (x < nx && buffer[x] != this->Label)
+          {
+          ++x;
+          }
+        if (x == nx)
+          {
+          break;
+          }
+        const int start = x;
+        while (x < nx && buffer[x] == this->Label)
+          {
+          ++x;
+          }
+
+        int run[6] = { sourceExtent[0] + dx + start,
+                       sourceExtent[0] + dx + x - 1,
+                       y + dy, y + dy, z + dz, z + dz };
+        if (sparse)
+          {
+          labelData->GetBricks()->FillExtent( run, this->Label );
+          }
+        else
+          {
+          LabelType *target = static_cast< LabelType * >(
+              labelImage->GetScalarPointer( run[0], run[2], run[4] ));
+          vtkstd::fill( target, target + (x - start), this->Label );
+          }
         }
-      ++inSI1;
-      ++inSI2;
       }
-    it1.NextSpan();    
-    it2.NextSpan();    
     }
 
+  // The label map holds the modification time of the labels in either
+  // storage mode.
+  labelImage->Modified();
   this->Modified();
 }
 
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushSketch::MergeOldestStrokes( bool forceMutable )
+{
+  vtkKWEPaintbrushStroke * stroke0 = this->Strokes[0];
+  vtkKWEPaintbrushStroke * stroke1 = this->Strokes[1];
+  stroke0->GetPaintbrushData()->SetLabel(this->Label);
+  stroke1->GetPaintbrushData()->SetLabel(this->Label);
+
+  // Merge, keeping the polarity in mind. Stroke 0 has to be of positive
+  // polarity.
+  if (stroke1->GetState() == vtkKWEPaintbrushEnums::Erase)
+    {
+    stroke0->GetPaintbrushData()->Subtract(stroke1->GetPaintbrushData(), forceMutable);
+    }
+  else
+    {
+    stroke0->GetPaintbrushData()->Add(stroke1->GetPaintbrushData(), forceMutable);
+    }
+
+  // Update stroke0's draw time to the most recent of stroke0 and stroke1.
+  // Of course the more recent one is stroke1.
+  stroke0->SetDrawTime( stroke1->GetDrawTime() );
+  stroke0->ExpandDrawnExtent( stroke1->GetDrawnExtent() );
+
+  // The first stroke is never undone, no need to keep its changes.
+  stroke0->GetLabelDelta()->Invalidate();
+
+  // Now that we've merged, remove the stroke. So if we have 5 strokes:
+  //       0, 1, 2, 3, 4.
+  // 1 is merged into 0. Then 1 is removed. We will end up with 4 strokes:7
+  //     (0 U 1), 2, 3, 4
+  this->Strokes.erase(this->Strokes.begin()+1);
+  stroke1->UnRegister(this);
+}
+
+//----------------------------------------------------------------------
+unsigned long vtkKWEPaintbrushSketch::GetHistoryMemorySize()
+{
+  unsigned long size = 0;
+  for (unsigned int i = 0; i < this->Strokes.size(); i++)
+    {
+    vtkKWEPaintbrushData *data = this->Strokes[i]->GetPaintbrushData();
+    if (vtkKWEPaintbrushStencilData *stencilData =
+          vtkKWEPaintbrushStencilData::SafeDownCast(data))
+      {
+      size += stencilData->GetImageStencilData()->GetActualMemorySize();
+      }
+    else if (vtkKWEPaintbrushGrayscaleData *grayscaleData =
+          vtkKWEPaintbrushGrayscaleData::SafeDownCast(data))
+      {
+      size += grayscaleData->GetImageData()->GetActualMemorySize();
+      }
+    size += this->Strokes[i]->GetLabelDelta()->GetActualMemorySize();
+    }
+  return size;
+}
+
+//----------------------------------------------------------------------
+int vtkKWEPaintbrushSketch::
+IsStrokeOverlappedByLaterStrokes( vtkKWEPaintbrushStroke *stroke )
+{
+  int *extent = stroke->GetDrawnExtent(), intersection[6];
+  if (extent[1] < extent[0])
+    {
+    return 0; // Nothing drawn
+    }
+
+  // All the strokes, from every sketch, that haven't been undone.
+  vtkstd::vector< vtkKWEPaintbrushStroke * > strokes;
+  if (this->PaintbrushDrawing)
+    {
+    for (int i = 0; i < this->PaintbrushDrawing->GetNumberOfItems(); i++)
+      {
+      this->PaintbrushDrawing->GetItem(i)->GetStrokes( strokes );
+      }
+    }
+  else
+    {
+    this->GetStrokes( strokes );
+    }
+
+  vtkstd::vector< vtkKWEPaintbrushStroke * >::const_iterator it;
+  for (it = strokes.begin(); it != strokes.end(); ++it)
+    {
+    int *otherExtent = (*it)->GetDrawnExtent();
+    if (*it != stroke &&
+        (*it)->GetDrawTime() > stroke->GetDrawTime() &&
+        otherExtent[1] >= otherExtent[0] &&
+        vtkKWEPaintbrushUtilities::GetIntersectingExtents(
+          extent, otherExtent, intersection ))
+      {
+      return 1;
+      }
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------
+int vtkKWEPaintbrushSketch::UndoStrokeIncrementally( int n )
+{
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast(this->PaintbrushData);
+  if (!labelData || n < 0 || n >= static_cast<int>(this->Strokes.size()))
+    {
+    return 0;
+    }
+
+  vtkKWEPaintbrushStroke *stroke = this->Strokes[n];
+  vtkKWEPaintbrushLabelDelta *delta = stroke->GetLabelDelta();
+
+  // The recorded labels are those the stroke overwrote. They can be
+  // restored only if nothing else changed these voxels since.
+  if (!delta->GetComplete() ||
+      labelData->GetUnrecordedModificationTime() >= delta->GetMTime() ||
+      this->IsStrokeOverlappedByLaterStrokes(stroke))
+    {
+    return 0;
+    }
+
+  return delta->Undo(labelData);
+}
+
+//----------------------------------------------------------------------
+int vtkKWEPaintbrushSketch::RedoStrokeIncrementally( int n )
+{
+  vtkKWEPaintbrushLabelData *labelData =
+    vtkKWEPaintbrushLabelData::SafeDownCast(this->PaintbrushData);
+  if (!labelData || n < 0 || n >= static_cast<int>(this->Strokes.size()))
+    {
+    return 0;
+    }
+
+  // Re-applying the stroke on top of the current label map yields the same
+  // result as composing the drawing, if no later stroke overlaps it.
+  vtkKWEPaintbrushStroke *stroke = this->Strokes[n];
+  if (this->IsStrokeOverlappedByLaterStrokes(stroke))
+    {
+    return 0;
+    }
+
+  // Record the changes again, so that the stroke may be undone.
+  labelData->GetUnrecordedModificationTime();
+  stroke->GetLabelDelta()->Initialize();
+  labelData->SetDeltaRecorder(stroke->GetLabelDelta());
+
+  stroke->GetPaintbrushData()->SetLabel(this->Label);
+  if (stroke->GetState() == vtkKWEPaintbrushEnums::Erase)
+    {
+    labelData->Subtract(stroke->GetPaintbrushData());
+    }
+  else
+    {
+    labelData->Add(stroke->GetPaintbrushData());
+    }
+
+  labelData->SetDeltaRecorder(NULL);
+  return 1;
+}
+
 //----------------------------------------------------------------------
 void vtkKWEPaintbrushSketch::PrintSelf(ostream& os, vtkIndent indent)
 {
   //Superclass typedef defined in vtkTypeMacro() found in vtkSetGet.h
   os << indent << "PaintbrushOperation: " << this->PaintbrushOperation << endl;
+  os << indent << "HistoryLength: " << this->HistoryLength << endl;
+  os << indent << "HistoryMemoryLimit: " << this->HistoryMemoryLimit << endl;
   if (this->PaintbrushOperation)
     {
     this->PaintbrushOperation->PrintSelf( os, indent.GetNextIndent() );
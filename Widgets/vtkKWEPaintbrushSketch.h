@@ -102,13 +102,27 @@ public:
   // Description:
   // The sketch maintains a history of strokes made, to facilitate undo/redo
   // of edits. A larger history length implies more memory. A length of 0
-  // implies that no undo-redo functionality is possible.
+  // implies that no undo-redo functionality is possible. See also
+  // HistoryMemoryLimit.
   // Defaults to 4.
   // If you choose to set this, do so once before using the sketch. DO NOT
   // change it midway.
-  vtkSetClampMacro( HistoryLength, int, 0, 10 );
+  vtkSetClampMacro( HistoryLength, int, 0, VTK_INT_MAX );
   vtkGetMacro( HistoryLength, int );
 
+  // Description:
+  // Upper bound, in kilobytes, on the memory used by the history of strokes.
+  // When a new stroke is added and the history exceeds this, the oldest
+  // strokes are merged together, until it fits or a single stroke remains.
+  // This allows a long history of small strokes to be kept. A value of 0
+  // implies no limit, other than the HistoryLength. Defaults to 0.
+  vtkSetMacro( HistoryMemoryLimit, unsigned long );
+  vtkGetMacro( HistoryMemoryLimit, unsigned long );
+
+  // Description:
+  // Memory, in kilobytes, used by the history of strokes.
+  unsigned long GetHistoryMemorySize();
+
   // Description:
   // Get the property of the sketch. You may use this to change colors etc.
   vtkGetObjectMacro( PaintbrushProperty, vtkKWEPaintbrushProperty );
@@ -147,6 +161,10 @@ public:
   // Used to maintain the undo/redo functionality.. Pop sequence pops a
   // sequence out of the list during undo. Push pushes the last undone
   // sequence back into the list. (essentially does a redo).
+  // When editing label maps, a stroke is undone by restoring the labels it
+  // changed, and redone by re-applying it, as long as no stroke drawn
+  // after it, in any sketch of the drawing, overlaps it. Otherwise, all the
+  // strokes of the drawing are composed again.
   virtual int PopStroke();
   virtual int PushStroke();
 
@@ -181,6 +199,7 @@ protected:
    int                                  CurrentStroke;
    int                                  Representation;
    int                                  HistoryLength;
+   unsigned long                        HistoryMemoryLimit;
    vtkKWEPaintbrushDrawing                *PaintbrushDrawing;
 
   // This is used only if our sketch's representation is of type: Label
@@ -189,8 +208,9 @@ protected:
   // Description:
   // INTERNAL - Do not use.
   // Invoked by a user draw/erase interaction.
-  // Adds a shape to the current stroke at position "p"
-  virtual void AddShapeToCurrentStroke(
+  // Adds a shape to the current stroke at position "p". Returns 1 if the
+  // shape was added, 0 otherwise.
+  virtual int AddShapeToCurrentStroke(
        double p[3],
        vtkKWEPaintbrushData * auxData = NULL);
 
@@ -220,6 +240,21 @@ private:
   // Get all the strokes upto the current stroke.
   void GetStrokes(vtkstd::vector< vtkKWEPaintbrushStroke * > &strokes);
   //ETX
+
+  // Description:
+  // Merge the second stroke in the history into the first one.
+  void MergeOldestStrokes( bool forceMutable = false );
+
+  // Description:
+  // Undo/redo the n'th stroke on a label map without composing the drawing.
+  // Return 0 if this cannot be done, in which case nothing is changed.
+  int UndoStrokeIncrementally( int n );
+  int RedoStrokeIncrementally( int n );
+
+  // Description:
+  // Is any stroke of the drawing, drawn after this one and not undone,
+  // overlapping it ?
+  int IsStrokeOverlappedByLaterStrokes( vtkKWEPaintbrushStroke * );
 };
 
 #endif
@@ -92,7 +92,9 @@ int vtkKWEPaintbrushStencilData::Add(vtkImageStencilData *s,
 {
   // FIXME Must actually be vtkImageStencilData::InternalAdd here
   // Make the protected method public later and give it a sensible name
+  const unsigned long mtime = this->GetMTime();
   this->ImageStencilData->Add(s);
+  this->ExtentModified(s->GetExtent(), mtime);
   return 1;
 }
 
@@ -100,7 +102,9 @@ int vtkKWEPaintbrushStencilData::Add(vtkImageStencilData *s,
 int vtkKWEPaintbrushStencilData::Subtract(vtkImageStencilData *s,
                                           bool vtkNotUsed(forceMutable))
 {
+  const unsigned long mtime = this->GetMTime();
   this->ImageStencilData->Subtract(s);
+  this->ExtentModified(s->GetExtent(), mtime);
   return 1;
 }
 
@@ -108,7 +112,9 @@ int vtkKWEPaintbrushStencilData::Subtract(vtkImageStencilData *s,
 int vtkKWEPaintbrushStencilData::Replace(vtkImageStencilData *s,
                                           bool vtkNotUsed(forceMutable))
 {
+  const unsigned long mtime = this->GetMTime();
   this->ImageStencilData->Replace(s);
+  this->ExtentModified(s->GetExtent(), mtime);
   return 1;
 }
 
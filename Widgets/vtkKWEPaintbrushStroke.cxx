@@ -25,15 +25,126 @@
 #include "vtkKWEPaintbrushData.h"
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkKWEPaintbrushGrayscaleData.h"
+#include "vtkKWEPaintbrushLabelDelta.h"
 #include "vtkImageData.h"
 #include "vtkKWEPaintbrushOperation.h"
 #include "vtkKWEPaintbrushShape.h"
 
+//----------------------------------------------------------------------
+// Hash of the grid cell containing p, the cell being offset by "d".
+static unsigned long vtkKWEPaintbrushStrokeNodeHashKey(
+    const double p[3], double tolerance, const int d[3])
+{
+  unsigned long key = 0;
+  static const unsigned long primes[3] = { 73856093, 19349663, 83492791 };
+  for (int i = 0; i < 3; i++)
+    {
+    const vtkTypeInt64 cell =
+      static_cast< vtkTypeInt64 >(floor(p[i] / tolerance)) + d[i];
+    key ^= static_cast< unsigned long >(cell) * primes[i];
+    }
+  return key;
+}
+
+//----------------------------------------------------------------------
+bool vtkKWEPaintbrushStrokeInternals
+::HasNodeNear( const double p[3], double tolerance )
+{
+  if (tolerance <= 0.0)
+    {
+    return false;
+    }
+  if (tolerance != this->CellSize)
+    {
+    this->RebuildNodeHash(tolerance);
+    }
+
+  // Any node within tolerance lies in the cell of p or in one of its
+  // neighbours. Different cells may hash to the same key, so we still
+  // compare the actual positions.
+  int d[3];
+  for (d[2] = -1; d[2] <= 1; d[2]++)
+    {
+    for (d[1] = -1; d[1] <= 1; d[1]++)
+      {
+      for (d[0] = -1; d[0] <= 1; d[0]++)
+        {
+        NodeHashType::const_iterator it = this->NodeHash.find(
+          vtkKWEPaintbrushStrokeNodeHashKey(p, tolerance, d));
+        if (it == this->NodeHash.end())
+          {
+          continue;
+          }
+        const vtkstd::vector< unsigned int > &nodes = it->second;
+        for (unsigned int i = 0; i < nodes.size(); i++)
+          {
+          const double *q = this->Node[nodes[i]]->WorldPosition;
+          if (   fabs(q[0] - p[0]) < tolerance
+              && fabs(q[1] - p[1]) < tolerance
+              && fabs(q[2] - p[2]) < tolerance)
+            {
+            return true;
+            }
+          }
+        }
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushStrokeInternals
+::AddNode( const double p[3], double tolerance )
+{
+  vtkKWEPaintbrushStrokeNode *node = new vtkKWEPaintbrushStrokeNode;
+  node->WorldPosition[0] = p[0];
+  node->WorldPosition[1] = p[1];
+  node->WorldPosition[2] = p[2];
+  this->Node.push_back(node);
+
+  // The hash is rebuilt when the tolerance changed since the last node, so
+  // that its cells stay as large as the tolerance nodes are looked up with.
+  if (tolerance > 0.0 && tolerance != this->CellSize)
+    {
+    this->RebuildNodeHash(tolerance); // Hashes the new node too.
+    }
+  else if (this->CellSize > 0.0)
+    {
+    static const int d[3] = { 0, 0, 0 };
+    this->NodeHash[vtkKWEPaintbrushStrokeNodeHashKey(p, this->CellSize, d)]
+      .push_back(static_cast< unsigned int >(this->Node.size() - 1));
+    }
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushStrokeInternals::ClearNodes()
+{
+  for (unsigned int i=0; i<this->Node.size(); i++)
+    {
+    delete this->Node[i];
+    }
+  this->Node.clear();
+  this->NodeHash.clear();
+  this->CellSize = 0.0;
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushStrokeInternals::RebuildNodeHash( double cellSize )
+{
+  static const int d[3] = { 0, 0, 0 };
+  this->NodeHash.clear();
+  this->CellSize = cellSize;
+  for (unsigned int i = 0; i < this->Node.size(); i++)
+    {
+    this->NodeHash[vtkKWEPaintbrushStrokeNodeHashKey(
+      this->Node[i]->WorldPosition, cellSize, d)].push_back(i);
+    }
+}
+
 vtkCxxRevisionMacro(vtkKWEPaintbrushStroke, "$Revision: 3550 $");
 vtkStandardNewMacro(vtkKWEPaintbrushStroke);
 vtkCxxSetObjectMacro(vtkKWEPaintbrushStroke,PaintbrushOperation,
                                       vtkKWEPaintbrushOperation);
-vtkCxxSetObjectMacro(vtkKWEPaintbrushStroke,PaintbrushData,vtkKWEPaintbrushData);
 
 //----------------------------------------------------------------------
 vtkKWEPaintbrushStroke::vtkKWEPaintbrushStroke()
@@ -48,6 +159,14 @@ vtkKWEPaintbrushStroke::vtkKWEPaintbrushStroke()
   this->Extent[3]                = 0;
   this->Extent[4]                = -1;
   this->Extent[5]                = 0;
+  this->DrawnExtent[0]           = 0;
+  this->DrawnExtent[1]           = -1;
+  this->DrawnExtent[2]           = 0;
+  this->DrawnExtent[3]           = -1;
+  this->DrawnExtent[4]           = 0;
+  this->DrawnExtent[5]           = -1;
+  this->LabelDelta               = vtkKWEPaintbrushLabelDelta::New();
+  this->SweptData                = NULL;
   this->Representation           = vtkKWEPaintbrushEnums::Binary;
   this->Tolerance                = 1e-4;
   this->Label                    = 1;
@@ -60,15 +179,59 @@ vtkKWEPaintbrushStroke::~vtkKWEPaintbrushStroke()
   this->SetPaintbrushData(NULL);
 
   // Delete the internals.
-  for (unsigned int i=0; i<this->Internals->Node.size(); i++)
-    {
-    delete this->Internals->Node[i];
-    }
-  this->Internals->Node.clear();
+  this->Internals->ClearNodes();
   delete this->Internals;
 
   this->SetPaintbrushOperation(NULL);
   this->SetImageData(NULL);
+  this->LabelDelta->Delete();
+  if (this->SweptData)
+    {
+    this->SweptData->Delete();
+    }
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushStroke::SetPaintbrushData( vtkKWEPaintbrushData * data )
+{
+  vtkSetObjectBodyMacro( PaintbrushData, vtkKWEPaintbrushData, data );
+
+  // The data supplied may have anything in it. Assume that it spans its
+  // whole extent.
+  if (data)
+    {
+    int extent[6];
+    data->GetExtent(extent);
+    this->ExpandDrawnExtent(extent);
+    }
+}
+
+//----------------------------------------------------------------------
+void vtkKWEPaintbrushStroke::ExpandDrawnExtent( int extent[6] )
+{
+  if (extent[1] < extent[0] || extent[3] < extent[2] || extent[5] < extent[4])
+    {
+    return;
+    }
+  if (this->DrawnExtent[1] < this->DrawnExtent[0])
+    {
+    for (int i = 0; i < 6; i++)
+      {
+      this->DrawnExtent[i] = extent[i];
+      }
+    return;
+    }
+  for (int i = 0; i < 6; i += 2)
+    {
+    if (extent[i] < this->DrawnExtent[i])
+      {
+      this->DrawnExtent[i] = extent[i];
+      }
+    if (extent[i+1] > this->DrawnExtent[i+1])
+      {
+      this->DrawnExtent[i+1] = extent[i+1];
+      }
+    }
 }
 
 //----------------------------------------------------------------------
@@ -115,14 +278,9 @@ int vtkKWEPaintbrushStroke::AddShapeAtPosition( double p[3],
 
   // Check if the point is already in the sequence
 
-  for (unsigned int i=0; i<this->Internals->Node.size(); i++)
+  if (this->Internals->HasNodeNear(p, this->Tolerance))
     {
-    if (   fabs(this->Internals->Node[i]->WorldPosition[0] - p[0]) < this->Tolerance
-        && fabs(this->Internals->Node[i]->WorldPosition[1] - p[1]) < this->Tolerance
-        && fabs(this->Internals->Node[i]->WorldPosition[2] - p[2]) < this->Tolerance)
-      {
-      return 0;
-      } 
+    return 0;
     }
 
   // Make sure that auxiliaryData1 and auxiliaryData2 aren't the same, so that
@@ -142,29 +300,60 @@ int vtkKWEPaintbrushStroke::AddShapeAtPosition( double p[3],
     auxData2->SetLabel(this->Label);
     }
 
-  // Add the a template stencil at the given point to the current stencil
+  vtkKWEPaintbrushData * data = NULL;
+  vtkKWEPaintbrushEnums::OperationType op;
 
-  vtkKWEPaintbrushData * data;
-  if (this->Representation == vtkKWEPaintbrushEnums::Binary)
-    {
-    data = vtkKWEPaintbrushStencilData::New();
-    }
-  else if (this->Representation == vtkKWEPaintbrushEnums::Grayscale)
+  // If the operation allows it, sweep the shape from the previous position
+  // of the stroke to this one. The stencil is reused from one segment to
+  // the next.
+
+  if (this->Representation == vtkKWEPaintbrushEnums::Binary &&
+      this->PaintbrushOperation->GetSweepStrokes() &&
+      !this->Internals->Node.empty())
     {
-    data = vtkKWEPaintbrushGrayscaleData::New();
+    if (!this->SweptData)
+      {
+      this->SweptData = vtkKWEPaintbrushStencilData::New();
+      }
+    this->SweptData->SetLabel( this->Label );
+    if (this->PaintbrushOperation->GetSweptPaintbrushData(this->SweptData,
+          this->Internals->Node.back()->WorldPosition, p, op))
+      {
+      data = this->SweptData;
+      data->Register(this);
+      data->Modified();
+      }
     }
-  else
+
+  // Otherwise, add the a template stencil at the given point to the current
+  // stencil
+
+  if (!data)
     {
-    cerr << "ERROR: Unsupported paintbrush representation type." << std::endl;
-    return 0;
+    if (this->Representation == vtkKWEPaintbrushEnums::Binary)
+      {
+      data = vtkKWEPaintbrushStencilData::New();
+      }
+    else if (this->Representation == vtkKWEPaintbrushEnums::Grayscale)
+      {
+      data = vtkKWEPaintbrushGrayscaleData::New();
+      }
+    else
+      {
+      cerr << "ERROR: Unsupported paintbrush representation type." << std::endl;
+      return 0;
+      }
+    data->SetLabel( this->Label );
+
+    // Get the paintbrush data filtered through the operation. This allows us
+    // to support in-place smart filters etc..
+    // This operation may change the value of op.
+    this->PaintbrushOperation->GetPaintbrushData(data, p, op);
     }
-  data->SetLabel( this->Label );
 
-  // Get the paintbrush data filtered through the operation. This allows us 
-  // to support in-place smart filters etc..
-  vtkKWEPaintbrushEnums::OperationType op;
-  // This operation may change the value of op.
-  this->PaintbrushOperation->GetPaintbrushData(data, p, op);
+  int dataExtent[6];
+  data->GetExtent(dataExtent);
+  this->ExpandDrawnExtent(dataExtent);
 
   if( op == vtkKWEPaintbrushEnums::Replace )  
     {
@@ -251,15 +440,11 @@ int vtkKWEPaintbrushStroke::AddShapeAtPosition( double p[3],
   // and see if the shape moved since the last draw. This is done to avoid
   // multiple brush compositions at the same point, therby buying minor
   // speedups.
-  vtkKWEPaintbrushStrokeNode *node = new vtkKWEPaintbrushStrokeNode;
-  node->WorldPosition[0] = p[0];
-  node->WorldPosition[1] = p[1];
-  node->WorldPosition[2] = p[2];
-  this->Internals->Node.push_back(node);
+  this->Internals->AddNode(p, this->Tolerance);
 
   this->DrawTime = data->GetMTime(); // Update the draw time.
 
-  data->Delete();
+  data->UnRegister(this);
   return 1;
 }
 
@@ -406,6 +591,11 @@ void vtkKWEPaintbrushStroke::PrintSelf(ostream& os, vtkIndent indent)
      << this->Extent[0] << "," << this->Extent[1] << ","
      << this->Extent[2] << "," << this->Extent[3] << "," 
      << this->Extent[4] << "," << this->Extent[5] << ")" << endl;
+  os << indent << "DrawnExtent: ("
+     << this->DrawnExtent[0] << "," << this->DrawnExtent[1] << ","
+     << this->DrawnExtent[2] << "," << this->DrawnExtent[3] << ","
+     << this->DrawnExtent[4] << "," << this->DrawnExtent[5] << ")" << endl;
+  os << indent << "LabelDelta: " << this->LabelDelta << endl;
   os << indent << "ImageData: ";
   if (this->ImageData) 
     {
@@ -34,9 +34,12 @@
 #include "vtkKWEPaintbrushEnums.h"
 #include "vtkObject.h"
 #include <vtkstd/vector>
+#include <vtksys/hash_map.hxx>
 
 class vtkKWEPaintbrushOperation;
 class vtkKWEPaintbrushData;
+class vtkKWEPaintbrushStencilData;
+class vtkKWEPaintbrushLabelDelta;
 class vtkImageData;
 
 //BTX
@@ -49,9 +52,35 @@ public:
 class vtkKWEPaintbrushStrokeInternals
 {
 public:
-  vtkKWEPaintbrushStrokeInternals() : State( vtkKWEPaintbrushEnums::Draw ) {}
+  vtkKWEPaintbrushStrokeInternals() :
+    State( vtkKWEPaintbrushEnums::Draw ), CellSize( 0.0 ) {}
   vtkstd::vector<vtkKWEPaintbrushStrokeNode * > Node;
   vtkKWEPaintbrushEnums::BrushType              State; // Erase or Draw ?
+
+  // Description:
+  // Is there a node within "tolerance" of "p" along each axis ?
+  bool HasNodeNear( const double p[3], double tolerance );
+
+  // Description:
+  // Append a node at "p" to Node and to the spatial hash.
+  void AddNode( const double p[3], double tolerance );
+
+  // Description:
+  // Delete all the nodes.
+  void ClearNodes();
+
+  // Node indices hashed by the cell of a grid of "CellSize" sized voxels
+  // they fall into. Nodes within tolerance of a point lie in the 27 cells
+  // around the point's cell, as long as CellSize is the tolerance.
+  typedef vtksys::hash_map< unsigned long,
+                            vtkstd::vector< unsigned int > > NodeHashType;
+  NodeHashType NodeHash;
+  double       CellSize;
+
+  // Description:
+  // Re-hash all the nodes on a grid of "cellSize" sized voxels. Called when
+  // the tolerance of the stroke changes while it is being drawn.
+  void RebuildNodeHash( double cellSize );
 };
 //ETX
 
@@ -121,6 +150,17 @@ public:
   virtual void SetExtent( int extent[6] );
   vtkGetVector6Macro( Extent, int );
 
+  // Description:
+  // Bounding extent of everything drawn in this stroke so far. This is
+  // generally a lot smaller than the Extent. Empty (min > max) if nothing
+  // has been drawn yet.
+  vtkGetVector6Macro( DrawnExtent, int );
+
+  // Description:
+  // The changes made by this stroke to a label map, used to undo the stroke
+  // without recomposing the drawing. Relevant only when editing label maps.
+  vtkGetObjectMacro( LabelDelta, vtkKWEPaintbrushLabelDelta );
+
 protected:
   vtkKWEPaintbrushStroke();
   ~vtkKWEPaintbrushStroke();
@@ -130,6 +170,9 @@ protected:
   vtkKWEPaintbrushData               *PaintbrushData;
   vtkImageData                    *ImageData;
   int                              Extent[6];
+  int                              DrawnExtent[6];
+  vtkKWEPaintbrushLabelDelta         *LabelDelta;
+  vtkKWEPaintbrushStencilData        *SweptData;
   int                              Representation;
   double                           Tolerance;
   vtkKWEPaintbrushEnums::LabelType    Label;
@@ -162,6 +205,10 @@ protected:
   static bool IsRecent( const vtkKWEPaintbrushStroke *a,
                         const vtkKWEPaintbrushStroke *b );
 
+  // Description:
+  // Grow the DrawnExtent to include the supplied extent.
+  void ExpandDrawnExtent( int extent[6] );
+
 private:
   vtkKWEPaintbrushStroke(const vtkKWEPaintbrushStroke&);  //Not implemented
   void operator=(const vtkKWEPaintbrushStroke&);  //Not implemented
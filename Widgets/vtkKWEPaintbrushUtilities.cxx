@@ -19,7 +19,12 @@
 //
 //=============================================================================
 #include "vtkKWEPaintbrushUtilities.h"
+#include "vtkKWEPaintbrushLabelBricks.h"
 #include "vtkObjectFactory.h"
+#include "vtkPointData.h"
+#include "vtkImageIterator.h"
+#include "vtkMultiThreader.h"
+#include "vtkSmartPointer.h"
 
 vtkCxxRevisionMacro(vtkKWEPaintbrushUtilities, "$Revision: 1774 $");
 vtkStandardNewMacro(vtkKWEPaintbrushUtilities);
@@ -62,6 +67,254 @@ int vtkKWEPaintbrushUtilities::GetIntersectingExtents( int extent1[6],
   return 1;
 }
 
+//----------------------------------------------------------------------------
+// Slabs smaller than this many voxels are not worth a thread.
+#define VTK_KWE_PAINTBRUSH_UTILITIES_MIN_VOXELS_PER_SLAB 65536
+
+// Slab i covers slices SlabBounds[i] to SlabBounds[i+1] - 1.
+struct vtkKWEPaintbrushUtilitiesSlabStruct
+{
+  vtkKWEPaintbrushUtilities::SlabFunctionType Function;
+  void *Arguments;
+  int   NumberOfSlabs;
+  int   SlabBounds[VTK_MAX_THREADS + 1];
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE vtkKWEPaintbrushUtilitiesThreadedExecute(
+                                                                void *arg )
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast< vtkMultiThreader::ThreadInfo * >(arg);
+  vtkKWEPaintbrushUtilitiesSlabStruct *str =
+    static_cast< vtkKWEPaintbrushUtilitiesSlabStruct * >(info->UserData);
+
+  const int slab = info->ThreadID;
+  if (slab < str->NumberOfSlabs)
+    {
+    (*str->Function)( str->Arguments, str->SlabBounds[slab],
+                      str->SlabBounds[slab + 1] - 1 );
+    }
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushUtilities::ExecuteOnSlabs( int extent[6],
+            SlabFunctionType function, void *arguments )
+{
+  const int nz = extent[5] - extent[4] + 1;
+  if (extent[1] < extent[0] || extent[3] < extent[2] || nz < 1)
+    {
+    return;
+    }
+
+  const double numberOfVoxels =
+    static_cast< double >(extent[1] - extent[0] + 1) *
+    static_cast< double >(extent[3] - extent[2] + 1) * nz;
+  int numberOfSlabs = static_cast< int >(
+      numberOfVoxels / VTK_KWE_PAINTBRUSH_UTILITIES_MIN_VOXELS_PER_SLAB);
+  const int numberOfThreads =
+    vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  numberOfSlabs = (numberOfSlabs > numberOfThreads)
+                                    ? numberOfThreads : numberOfSlabs;
+  numberOfSlabs = (numberOfSlabs > nz) ? nz : numberOfSlabs;
+
+  if (numberOfSlabs <= 1)
+    {
+    (*function)( arguments, extent[4], extent[5] );
+    return;
+    }
+
+  vtkKWEPaintbrushUtilitiesSlabStruct str;
+  str.Function      = function;
+  str.Arguments     = arguments;
+  str.NumberOfSlabs = numberOfSlabs;
+  for (int i = 0; i <= numberOfSlabs; i++)
+    {
+    str.SlabBounds[i] = extent[4] + (nz * i) / numberOfSlabs;
+    }
+
+  vtkSmartPointer< vtkMultiThreader > threader =
+    vtkSmartPointer< vtkMultiThreader >::New();
+  threader->SetNumberOfThreads(numberOfSlabs);
+  threader->SetSingleMethod( vtkKWEPaintbrushUtilitiesThreadedExecute, &str );
+  threader->SingleMethodExecute();
+}
+
+//----------------------------------------------------------------------------
+// Arguments of vtkKWEPaintbrushUtilitiesStencilsFromLabelDataSlab. The
+// stencil of label l is Stencils[l - MinimumLabel], NULL if label l was not
+// requested.
+struct vtkKWEPaintbrushUtilitiesLabelDataStruct
+{
+  vtkKWEPaintbrushLabelData *LabelData;
+  int                        Extent[6];
+  int                        MinimumLabel;
+  int                        NumberOfStencils;
+  vtkImageStencilData      **Stencils;
+};
+
+//----------------------------------------------------------------------------
+// Insert the runs of labels of slices z1 to z2 into the stencils of their
+// labels.
+static void vtkKWEPaintbrushUtilitiesStencilsFromLabelDataSlab(
+                                    void *arguments, int z1, int z2 )
+{
+  typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+  vtkKWEPaintbrushUtilitiesLabelDataStruct *args =
+    static_cast< vtkKWEPaintbrushUtilitiesLabelDataStruct * >(arguments);
+  const int *extent = args->Extent;
+  const int nx = extent[1] - extent[0] + 1;
+  vtkstd::vector< LabelType > buffer(nx);
+
+  for (int z = z1; z <= z2; z++)
+    {
+    for (int y = extent[2]; y <= extent[3]; y++)
+      {
+      const LabelType *row = args->LabelData->GetLabelRow(
+          extent[0], extent[1], y, z, &buffer[0] );
+      int x = 0;
+      while (x < nx)
+        {
+        const LabelType label = row[x];
+        const int start = x;
+        while (++x < nx && row[x] == label)
+          {
+          }
+
+        if (label != vtkKWEPaintbrushLabelData::NoLabelValue)
+          {
+          const int index = static_cast< int >(label) - args->MinimumLabel;
+          if (index >= 0 && index < args->NumberOfStencils &&
+              args->Stencils[index])
+            {
+            args->Stencils[index]->InsertNextExtent(
+                extent[0] + start, extent[0] + x - 1, y, z);
+            }
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Have the labels of the label data been allocated ?
+static bool vtkKWEPaintbrushUtilitiesHasLabels(
+                          vtkKWEPaintbrushLabelData *labelData )
+{
+  if (labelData->GetStorageMode() == vtkKWEPaintbrushLabelData::Sparse)
+    {
+    return labelData->GetBricks()->IsAllocated() != 0;
+    }
+  return labelData->GetLabelMap()->GetPointData()->GetScalars() != NULL;
+}
+
+//----------------------------------------------------------------------------
+vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
+             vtkSmartPointer< vtkKWEPaintbrushStencilData > >
+vtkKWEPaintbrushUtilities::GetStencilsFromLabelData(
+      vtkKWEPaintbrushLabelData *labelData,
+      vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > labels )
+{
+  int extent[6];
+  double spacing[3], origin[3];
+  labelData->GetExtent(extent);
+  labelData->GetSpacing(spacing);
+  labelData->GetOrigin(origin);
+
+  vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
+               vtkSmartPointer< vtkKWEPaintbrushStencilData > > pstrokeDatas;
+  if (labels.empty())
+    {
+    return pstrokeDatas;
+    }
+
+  int minLabel = static_cast< int >(labels[0]);
+  int maxLabel = minLabel;
+  for (vtkstd::vector< vtkKWEPaintbrushEnums::LabelType >::const_iterator lit = labels.begin();
+       lit != labels.end(); ++lit)
+    {
+    vtkKWEPaintbrushEnums::LabelType l = *lit;
+    minLabel = (static_cast< int >(l) < minLabel) ? static_cast< int >(l) : minLabel;
+    maxLabel = (static_cast< int >(l) > maxLabel) ? static_cast< int >(l) : maxLabel;
+    pstrokeDatas[l] = vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
+    pstrokeDatas[l]->SetLabel(*lit);
+    pstrokeDatas[l]->SetExtent(extent);
+    pstrokeDatas[l]->SetSpacing(spacing);
+    pstrokeDatas[l]->SetOrigin(origin);
+    pstrokeDatas[l]->Allocate();
+    }
+
+  if (!vtkKWEPaintbrushUtilitiesHasLabels(labelData))
+    {
+    return pstrokeDatas;
+    }
+
+  // Stencils are looked up per run in a table indexed by label, rather
+  // than in the map.
+  vtkstd::vector< vtkImageStencilData * > strokeDatas(
+      maxLabel - minLabel + 1, static_cast< vtkImageStencilData * >(NULL));
+  for (vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
+         vtkSmartPointer< vtkKWEPaintbrushStencilData > >::const_iterator
+         sit = pstrokeDatas.begin(); sit != pstrokeDatas.end(); ++sit)
+    {
+    strokeDatas[static_cast< int >(sit->first) - minLabel] =
+      sit->second->GetImageStencilData();
+    }
+
+  vtkKWEPaintbrushUtilitiesLabelDataStruct args;
+  args.LabelData = labelData;
+  for (int i = 0; i < 6; i++)
+    {
+    args.Extent[i] = extent[i];
+    }
+  args.MinimumLabel     = minLabel;
+  args.NumberOfStencils = static_cast< int >(strokeDatas.size());
+  args.Stencils         = &strokeDatas[0];
+
+  vtkKWEPaintbrushUtilities::ExecuteOnSlabs( extent,
+      vtkKWEPaintbrushUtilitiesStencilsFromLabelDataSlab, &args );
+
+  return pstrokeDatas;
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEPaintbrushUtilities::GetStencilFromLabelData(
+                          vtkKWEPaintbrushLabelData *labelData,
+                          vtkImageStencilData *stencilData,
+                          vtkKWEPaintbrushEnums::LabelType label )
+{
+  int extent[6];
+  double spacing[3], origin[3];
+  labelData->GetExtent(extent);
+  labelData->GetSpacing(spacing);
+  labelData->GetOrigin(origin);
+
+  stencilData->SetExtent(extent);
+  stencilData->SetSpacing(spacing);
+  stencilData->SetOrigin(origin);
+  stencilData->AllocateExtents();
+
+  if (!vtkKWEPaintbrushUtilitiesHasLabels(labelData))
+    {
+    return;
+    }
+
+  vtkKWEPaintbrushUtilitiesLabelDataStruct args;
+  args.LabelData = labelData;
+  for (int i = 0; i < 6; i++)
+    {
+    args.Extent[i] = extent[i];
+    }
+  args.MinimumLabel     = static_cast< int >(label);
+  args.NumberOfStencils = 1;
+  args.Stencils         = &stencilData;
+
+  vtkKWEPaintbrushUtilities::ExecuteOnSlabs( extent,
+      vtkKWEPaintbrushUtilitiesStencilsFromLabelDataSlab, &args );
+}
+
 //----------------------------------------------------------------------------
 void vtkKWEPaintbrushUtilities::GetImageFromStencil(
                           vtkImageData *image,
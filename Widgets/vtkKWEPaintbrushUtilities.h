@@ -33,7 +33,6 @@
 #include "vtkImageStencilData.h"
 #include "vtkKWEPaintbrushStencilData.h"
 #include "vtkKWEPaintbrushLabelData.h"
-#include "vtkImageIterator.h"
 #include "vtkSmartPointer.h"
 #include <vtkstd/map>
 #include <vtkstd/vector>
@@ -65,48 +64,121 @@ public:
   //   GetStencilFromImage< vtkFunctorEqualTo >( labelMapImage, s1, 64.0 );
   //   GetStencilFromImage< vtkFunctorEqualTo >( labelMapImage, s2, 128.0 );
   //   GetStencilFromImage< vtkFunctorEqualTo >( labelMapImage, s3, 192.0 );
+  //
+  // The voxels are compared with the threshold in the scalar type of the
+  // image.
 
   class vtkFunctorEqualTo
     {
     public:
-    inline bool operator()( const double &a, const double &b )
+    template < class T >
+    inline bool operator()( const T &a, const T &b ) const
       { return (a == b); }
     };
 
   class vtkFunctorGreaterThanEqualTo
     {
     public:
-    inline bool operator()( const double &a, const double &b )
+    template < class T >
+    inline bool operator()( const T &a, const T &b ) const
       { return (a >= b); }
     };
 
   class vtkFunctorGreaterThan
     {
     public:
-    inline bool operator()( const double &a, const double &b )
+    template < class T >
+    inline bool operator()( const T &a, const T &b ) const
       { return (a > b); }
     };
 
   class vtkFunctorLessThan
     {
     public:
-    inline bool operator()( const double &a, const double &b )
+    template < class T >
+    inline bool operator()( const T &a, const T &b ) const
       { return (a < b); }
     };
 
   class vtkFunctorLessThanEqualTo
     {
     public:
-    inline bool operator()( const double &a, const double &b )
-      { return (a < b); }
+    template < class T >
+    inline bool operator()( const T &a, const T &b ) const
+      { return (a <= b); }
     };
 
+  // Description:
+  // Call "function" on slabs of slices of "extent", from as many threads as
+  // the extent is worth. Each call is given "arguments" and the first and
+  // last slice of its slab. Slabs do not share rows, so each call may insert
+  // extents into the rows of its own slab of a vtkImageStencilData.
+  typedef void (*SlabFunctionType)( void *arguments, int z1, int z2 );
+  static void ExecuteOnSlabs( int extent[6], SlabFunctionType function,
+                              void *arguments );
+
+  // Description:
+  // Arguments of GetStencilFromImageSlab. Only the first component of the
+  // image is looked at. Scalars point to voxel (Extent[0], Extent[2],
+  // Extent[4]).
+  template < class T >
+  struct StencilFromImageArguments
+    {
+    const T             *Scalars;
+    vtkIdType            Increments[3];
+    int                  Extent[6];
+    T                    Threshold;
+    vtkImageStencilData *Stencil;
+    };
+
+  // Description:
+  // Insert into the stencil the runs of voxels of slices z1 to z2 that
+  // satisfy <FUNCTOR> threshold.
   template < class TFunctor, class T >
-  static void vtkKWEPaintbrushUtilitiesGetStencilFromImage( vtkImageData *image,
-                          vtkImageStencilData *stencilData, T threshold)
+  static void GetStencilFromImageSlab( void *arguments, int z1, int z2 )
     {
+    StencilFromImageArguments< T > *args =
+      static_cast< StencilFromImageArguments< T > * >(arguments);
     TFunctor f;
+    const T threshold = args->Threshold;
+    const int *extent = args->Extent;
+    const int nx = extent[1] - extent[0] + 1;
+    const vtkIdType incX = args->Increments[0];
+
+    for (int z = z1; z <= z2; z++)
+      {
+      const T *slice = args->Scalars + (z - extent[4]) * args->Increments[2];
+      for (int y = extent[2]; y <= extent[3]; y++)
+        {
+        const T *row = slice + (y - extent[2]) * args->Increments[1];
+        int x = 0;
+        while (x < nx)
+          {
+          // Skip the voxels outside, then insert the run of voxels inside.
+          while (x < nx && !f(row[x * incX], threshold))
+            {
+            ++x;
+            }
+          if (x == nx)
+            {
+            break;
+            }
+          const int start = x;
+          while (x < nx && f(row[x * incX], threshold))
+            {
+            ++x;
+            }
+          args->Stencil->InsertNextExtent(
+              extent[0] + start, extent[0] + x - 1, y, z);
+          }
+        }
+      }
+    }
 
+  template < class TFunctor, class T >
+  static void vtkKWEPaintbrushUtilitiesGetStencilFromImage( vtkImageData *image,
+                          vtkImageStencilData *stencilData, T threshold)
+    {
     int extent[6];
     double spacing[3], origin[3];
     image->GetExtent(extent);
@@ -118,68 +190,82 @@ public:
     stencilData->SetOrigin(origin);
     stencilData->AllocateExtents();
 
-    vtkImageIterator< T > it(image, extent);
-
-    int ends[2], index[3];
-    index[1] = extent[2];
-    index[2] = extent[4];
-
-    while( !it.IsAtEnd() )
+    StencilFromImageArguments< T > args;
+    args.Scalars = static_cast< const T * >(image->GetScalarPointer());
+    if (!args.Scalars)
+      {
+      return;
+      }
+    vtkIdType *increments = image->GetIncrements();
+    for (int i = 0; i < 6; i++)
       {
-      T *inSI    = it.BeginSpan();
-      T *inSIEnd = it.EndSpan();
+      args.Extent[i] = extent[i];
+      }
+    for (int i = 0; i < 3; i++)
+      {
+      args.Increments[i] = increments[i];
+      }
+    args.Threshold = threshold;
+    args.Stencil   = stencilData;
 
-      index[0] = extent[0];
-      ends[0] = -1;
-      ends[1] = -1;
-      if (f(static_cast<double>(*inSI), static_cast<double>(threshold)))
-        {
-        ends[0] = extent[0];
-        }
+    vtkKWEPaintbrushUtilities::ExecuteOnSlabs( extent,
+        vtkKWEPaintbrushUtilities::GetStencilFromImageSlab< TFunctor, T >,
+        &args );
+    }
 
-      // for each row
+  // Description:
+  // Arguments of GetStencilsFromImageSlab. The stencil of label l is
+  // Stencils[l - MinimumLabel], NULL if label l was not requested.
+  template < class T >
+  struct StencilsFromImageArguments
+    {
+    const T              *Scalars;
+    vtkIdType             Increments[3];
+    int                   Extent[6];
+    int                   MinimumLabel;
+    int                   NumberOfStencils;
+    vtkImageStencilData **Stencils;
+    };
 
-      while (inSI != inSIEnd)
+  // Description:
+  // Insert the runs of labels of slices z1 to z2 into the stencils of their
+  // labels.
+  template < class T >
+  static void GetStencilsFromImageSlab( void *arguments, int z1, int z2 )
+    {
+    typedef vtkKWEPaintbrushEnums::LabelType LabelType;
+    StencilsFromImageArguments< T > *args =
+      static_cast< StencilsFromImageArguments< T > * >(arguments);
+    const int *extent = args->Extent;
+    const int nx = extent[1] - extent[0] + 1;
+    const vtkIdType incX = args->Increments[0];
+
+    for (int z = z1; z <= z2; z++)
+      {
+      const T *slice = args->Scalars + (z - extent[4]) * args->Increments[2];
+      for (int y = extent[2]; y <= extent[3]; y++)
         {
-
-        if (ends[0] == -1 &&
-            f(static_cast<double>(*inSI), static_cast<double>(threshold)))
+        const T *row = slice + (y - extent[2]) * args->Increments[1];
+        int x = 0;
+        while (x < nx)
           {
-          // look for start
-          ends[0] = index[0];
-          ++index[0];
-          ++inSI;
-          continue;
-          }
+          const LabelType label = static_cast< LabelType >(row[x * incX]);
+          const int start = x;
+          while (++x < nx && static_cast< LabelType >(row[x * incX]) == label)
+            {
+            }
 
-        if (ends[0] != -1 && ends[1] == -1 &&
-            !f(static_cast<double>(*inSI), static_cast<double>(threshold)))
-          {
-          ends[1] = index[0];
-          stencilData->InsertNextExtent(ends[0], ends[1]-1, index[1], index[2]);
-          ends[0] = ends[1] = -1;
+          if (label != vtkKWEPaintbrushLabelData::NoLabelValue)
+            {
+            const int index = static_cast< int >(label) - args->MinimumLabel;
+            if (index >= 0 && index < args->NumberOfStencils &&
+                args->Stencils[index])
+              {
+              args->Stencils[index]->InsertNextExtent(
+                  extent[0] + start, extent[0] + x - 1, y, z);
+              }
+            }
           }
-
-        ++index[0];
-        ++inSI;
-        }
-
-      if (f(static_cast<double>(*(inSI-1)),
-            static_cast<double>(threshold))) // ends[0] can't be -1, ends[1] has to be -1
-        {
-        stencilData->InsertNextExtent(ends[0], extent[1], index[1], index[2]);
-        }
-
-      it.NextSpan();
-
-      if (index[1] == extent[3])
-        {
-        ++index[2];
-        index[1] = extent[2];
-        }
-      else
-        {
-        ++index[1];
         }
       }
     }
@@ -200,93 +286,68 @@ public:
 
     vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
                  vtkSmartPointer< vtkKWEPaintbrushStencilData > > pstrokeDatas;
-    vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
-                 vtkSmartPointer< vtkImageStencilData > > strokeDatas;
+    if (labels.empty())
+      {
+      return pstrokeDatas;
+      }
+
+    int minLabel = static_cast< int >(labels[0]);
+    int maxLabel = minLabel;
     for (vtkstd::vector< vtkKWEPaintbrushEnums::LabelType >::const_iterator lit = labels.begin();
          lit != labels.end(); ++lit)
       {
       vtkKWEPaintbrushEnums::LabelType l = *lit;
+      minLabel = (static_cast< int >(l) < minLabel) ? static_cast< int >(l) : minLabel;
+      maxLabel = (static_cast< int >(l) > maxLabel) ? static_cast< int >(l) : maxLabel;
       pstrokeDatas[l] = vtkSmartPointer< vtkKWEPaintbrushStencilData >::New();
       pstrokeDatas[l]->SetLabel(*lit);
       pstrokeDatas[l]->SetExtent(extent);
       pstrokeDatas[l]->SetSpacing(spacing);
       pstrokeDatas[l]->SetOrigin(origin);
       pstrokeDatas[l]->Allocate();
-      strokeDatas[l] = pstrokeDatas[l]->GetImageStencilData();
       }
 
-    vtkImageIterator< T > it(image, extent);
-
-    int ends[2], index[3];
-    index[1] = extent[2];
-    index[2] = extent[4];
-    vtkKWEPaintbrushEnums::LabelType label = vtkKWEPaintbrushLabelData::NoLabelValue;
-
-    while( !it.IsAtEnd() )
+    // Stencils are looked up per run in a table indexed by label, rather
+    // than in the map.
+    vtkstd::vector< vtkImageStencilData * > strokeDatas(
+        maxLabel - minLabel + 1, static_cast< vtkImageStencilData * >(NULL));
+    for (vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
+           vtkSmartPointer< vtkKWEPaintbrushStencilData > >::const_iterator
+           sit = pstrokeDatas.begin(); sit != pstrokeDatas.end(); ++sit)
       {
-      T *inSI    = it.BeginSpan();
-      T *inSIEnd = it.EndSpan();
-
-      index[0] = extent[0];
-      ends[0] = -1;
-      ends[1] = -1;
-
-      // for each row
-
-      while (inSI != inSIEnd)
-        {
-
-        if (ends[0] == -1 && *inSI != vtkKWEPaintbrushLabelData::NoLabelValue)
-          {
-          // look for start
-          ends[0] = index[0];
-          ++index[0];
-          label = static_cast< vtkKWEPaintbrushEnums::LabelType >(*inSI);
-          ++inSI;
-          continue;
-          }
-
-        if (ends[0] != -1 && ends[1] == -1 && *inSI != label)
-          {
-          ends[1] = index[0];
-          strokeDatas[label]->InsertNextExtent(ends[0], ends[1]-1, index[1], index[2]);
-          ends[0] = ends[1] = -1;
-
-          if (*inSI != vtkKWEPaintbrushLabelData::NoLabelValue)
-            {
-            ends[0] = index[0];
-            label = static_cast< vtkKWEPaintbrushEnums::LabelType >(*inSI);
-            }
-          }
-
-        ++index[0];
-        ++inSI;
-        }
-
-      if (ends[0] != -1 && ends[1] == -1) // ends[0] can't be -1, ends[1] has to be -1
-        {
-        strokeDatas[label]->InsertNextExtent(ends[0], extent[1], index[1], index[2]);
-        }
-
-      it.NextSpan();
+      strokeDatas[static_cast< int >(sit->first) - minLabel] =
+        sit->second->GetImageStencilData();
+      }
 
-      if (index[1] == extent[3])
-        {
-        ++index[2];
-        index[1] = extent[2];
-        }
-      else
-        {
-        ++index[1];
-        }
+    StencilsFromImageArguments< T > args;
+    args.Scalars = static_cast< const T * >(image->GetScalarPointer());
+    if (!args.Scalars)
+      {
+      return pstrokeDatas;
+      }
+    vtkIdType *increments = image->GetIncrements();
+    for (int i = 0; i < 6; i++)
+      {
+      args.Extent[i] = extent[i];
+      }
+    for (int i = 0; i < 3; i++)
+      {
+      args.Increments[i] = increments[i];
       }
+    args.MinimumLabel     = minLabel;
+    args.NumberOfStencils = static_cast< int >(strokeDatas.size());
+    args.Stencils         = &strokeDatas[0];
+
+    vtkKWEPaintbrushUtilities::ExecuteOnSlabs( extent,
+        vtkKWEPaintbrushUtilities::GetStencilsFromImageSlab< T >, &args );
 
     return pstrokeDatas;
     }
 
   // Description:
   // Get a binary stencil from an image. All pixels <FUNCTOR> threshold are
-  // considered within the stencil.
+  // considered within the stencil. Slabs of slices are thresholded in
+  // parallel.
   //
   // TFunctor may be any of the above defined class templates or your own.
   // It may be any one of <= == >= > < operators.
@@ -305,6 +366,10 @@ public:
       }
     }
 
+  // Description:
+  // Get a stencil for each of the labels of a label map. Voxels whose label
+  // was not requested are ignored. Slabs of slices are processed in
+  // parallel.
   static vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
                  vtkSmartPointer< vtkKWEPaintbrushStencilData > >
         GetStencilsFromImage( vtkImageData * image,
@@ -322,6 +387,20 @@ public:
     return r;
     }
 
+  // Description:
+  // Same as GetStencilsFromImage and GetStencilFromImage with
+  // vtkFunctorEqualTo, for the labels of label data. The labels are read a
+  // row at a time through vtkKWEPaintbrushLabelData::GetLabelRow, so that
+  // sparse label data is never copied into a dense label map. Voxels of
+  // NoLabelValue are never part of a stencil.
+  static vtkstd::map< vtkKWEPaintbrushEnums::LabelType,
+                 vtkSmartPointer< vtkKWEPaintbrushStencilData > >
+        GetStencilsFromLabelData( vtkKWEPaintbrushLabelData * labelData,
+           vtkstd::vector< vtkKWEPaintbrushEnums::LabelType > labels);
+  static void GetStencilFromLabelData( vtkKWEPaintbrushLabelData * labelData,
+                                       vtkImageStencilData * stencilData,
+                                       vtkKWEPaintbrushEnums::LabelType label );
+
   // Description:
   // Populate a vtkImageData from a binary stencil.
   // "inVal" and "outVal" define the values assigned to the image inside and
@@ -24,10 +24,18 @@
 #include "vtkContourFilter.h"
 #include "vtkImageStencilData.h"
 #include "vtkImageData.h"
+#include "vtkPolyData.h"
+#include "vtkPoints.h"
+#include "vtkCellArray.h"
+#include "vtkFloatArray.h"
+#include "vtkPointData.h"
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
 #include "vtkObjectFactory.h"
 #include "vtkStreamingDemandDrivenPipeline.h"
+#include <vtkstd/algorithm>
+#include <vtkstd/map>
+#include <vtkstd/vector>
 
 vtkCxxRevisionMacro(vtkKWEStencilContourFilter, "$Revision: 1774 $");
 vtkStandardNewMacro(vtkKWEStencilContourFilter);
@@ -131,6 +139,16 @@ int vtkKWEStencilContourFilter::RequestData(
   if (vtkKWEPaintbrushUtilities::GetIntersectingExtents(
         uExt, inputExtent, intersectingExtents))
     {
+    // A slice is contoured directly from the runs of the stencil.
+    for (int axis = 2; axis >= 0; axis--)
+      {
+      if (intersectingExtents[2*axis] == intersectingExtents[2*axis+1])
+        {
+        this->ContourSlice( input, intersectingExtents, axis, output );
+        return 1;
+        }
+      }
+
     if (intersectingExtents[0] != currentExtent[0] ||
         intersectingExtents[1] != currentExtent[1] ||
         intersectingExtents[2] != currentExtent[2] ||
@@ -160,6 +178,299 @@ int vtkKWEStencilContourFilter::RequestData(
   return 0;
 }
 
+//----------------------------------------------------------------------------
+// Marching squares over the runs of a slice of a stencil. The slice is
+// spanned by axes U and V, its rows run along U. Pixels are 255 inside the
+// stencil and 0 outside, so that an isoline crosses the edges between
+// pixels inside and outside at "Fraction" of the way from the pixel inside.
+class vtkKWEStencilContourFilterSlice
+{
+public:
+  typedef vtkstd::vector< vtkstd::pair< int, int > > RunsType;
+
+  vtkImageStencilData *Stencil;
+  int                  Axis, AxisU, AxisV, Slice;
+  int                  Extent[6];
+  double               Fraction;
+  double               Origin[3], Spacing[3];
+  vtkPoints           *Points;
+  vtkCellArray        *Lines;
+
+  // Runs of row v, within the extent, sorted.
+  void GetRuns( int v, RunsType &runs )
+    {
+    const int u1 = this->Extent[2*this->AxisU];
+    const int u2 = this->Extent[2*this->AxisU+1];
+    runs.clear();
+    int r1, r2, iter, moreSubExtents;
+    if (this->Axis == 0)
+      {
+      // Rows along Y are made of the voxels of the stencil rows along X at
+      // x = Slice.
+      for (int u = u1; u <= u2; u++)
+        {
+        bool inside = false;
+        iter = 0;
+        moreSubExtents = 1;
+        while (moreSubExtents && !inside)
+          {
+          moreSubExtents = this->Stencil->GetNextExtent(
+            r1, r2, this->Slice, this->Slice, u, v, iter );
+          inside = (r1 <= r2);
+          }
+        if (inside)
+          {
+          if (!runs.empty() && runs.back().second == u - 1)
+            {
+            runs.back().second = u;
+            }
+          else
+            {
+            runs.push_back( vtkstd::pair< int, int >(u, u) );
+            }
+          }
+        }
+      return;
+      }
+
+    const int y = (this->Axis == 2) ? v : this->Slice;
+    const int z = (this->Axis == 2) ? this->Slice : v;
+    bool sorted = true;
+    iter = 0;
+    moreSubExtents = 1;
+    while (moreSubExtents)
+      {
+      moreSubExtents = this->Stencil->GetNextExtent( r1, r2, u1, u2, y, z, iter );
+      if (r1 <= r2)
+        {
+        sorted &= (runs.empty() || r1 > runs.back().second);
+        runs.push_back( vtkstd::pair< int, int >(r1, r2) );
+        }
+      }
+    if (!sorted)
+      {
+      vtkstd::sort( runs.begin(), runs.end() );
+      }
+    }
+
+  // Is pixel u of a row inside ? "i" is the index of the first run that
+  // does not end before u, and only moves forward along the row.
+  static bool IsInside( const RunsType &runs, int u, size_t &i )
+    {
+    while (i < runs.size() && runs[i].second < u)
+      {
+      ++i;
+      }
+    return i < runs.size() && runs[i].first <= u;
+    }
+
+  vtkIdType InsertPoint( double u, double v )
+    {
+    double p[3];
+    p[this->Axis]  = this->Origin[this->Axis] +
+                     this->Spacing[this->Axis] * this->Slice;
+    p[this->AxisU] = this->Origin[this->AxisU] + this->Spacing[this->AxisU] * u;
+    p[this->AxisV] = this->Origin[this->AxisV] + this->Spacing[this->AxisV] * v;
+    return this->Points->InsertNextPoint(p);
+    }
+
+  // Point on the edge from pixel (u, v) to (u, v+1), or from (u, v) to
+  // (u+1, v). Points are shared by the cells on either side of the edge.
+  typedef vtkstd::map< int, vtkIdType > EdgePointsType;
+  vtkIdType GetVEdgePoint( EdgePointsType &points, int u, int v, bool inside )
+    {
+    EdgePointsType::iterator it = points.find(u);
+    if (it != points.end())
+      {
+      return it->second;
+      }
+    const vtkIdType id = this->InsertPoint(
+        u, v + (inside ? this->Fraction : 1.0 - this->Fraction));
+    points[u] = id;
+    return id;
+    }
+  vtkIdType GetUEdgePoint( EdgePointsType &points, int u, int v, bool inside )
+    {
+    EdgePointsType::iterator it = points.find(u);
+    if (it != points.end())
+      {
+      return it->second;
+      }
+    const vtkIdType id = this->InsertPoint(
+        u + (inside ? this->Fraction : 1.0 - this->Fraction), v);
+    points[u] = id;
+    return id;
+    }
+
+  void InsertLine( vtkIdType a, vtkIdType b )
+    {
+    vtkIdType pts[2] = { a, b };
+    this->Lines->InsertNextCell(2, pts);
+    }
+
+  void Execute();
+};
+
+//----------------------------------------------------------------------------
+void vtkKWEStencilContourFilterSlice::Execute()
+{
+  // Edges of the cells of marching squares: 0 and 2 run along U, on rows v
+  // and v+1, 1 and 3 along V, at u+1 and u. For each configuration of the
+  // corners (u,v), (u+1,v), (u+1,v+1) and (u,v+1), pairs of edges joined by
+  // a segment. Diagonal corners inside are not connected.
+  static const int segments[16][5] = {
+    { -1 }, { 3, 0, -1 }, { 0, 1, -1 }, { 3, 1, -1 },
+    { 1, 2, -1 }, { 3, 0, 1, 2, -1 }, { 0, 2, -1 }, { 3, 2, -1 },
+    { 2, 3, -1 }, { 0, 2, -1 }, { 0, 1, 2, 3, -1 }, { 1, 2, -1 },
+    { 1, 3, -1 }, { 0, 1, -1 }, { 0, 3, -1 }, { -1 } };
+
+  const int u1 = this->Extent[2*this->AxisU], u2 = this->Extent[2*this->AxisU+1];
+  const int v1 = this->Extent[2*this->AxisV], v2 = this->Extent[2*this->AxisV+1];
+  if (u1 >= u2 || v1 >= v2)
+    {
+    return;
+    }
+
+  RunsType runs[2];
+  EdgePointsType uEdges[2], vEdges;
+  this->GetRuns(v1, runs[0]);
+  vtkstd::vector< int > breaks;
+
+  for (int v = v1; v < v2; v++)
+    {
+    const RunsType &a = runs[0];
+    RunsType &b = runs[1];
+    this->GetRuns(v + 1, b);
+    uEdges[1].clear();
+    vEdges.clear();
+
+    // Both rows are uniform between consecutive breaks.
+    breaks.clear();
+    breaks.push_back(u1);
+    breaks.push_back(u2 + 1);
+    for (int r = 0; r < 2; r++)
+      {
+      const RunsType &row = runs[r];
+      for (size_t i = 0; i < row.size(); i++)
+        {
+        breaks.push_back(row[i].first);
+        breaks.push_back(row[i].second + 1);
+        }
+      }
+    vtkstd::sort( breaks.begin(), breaks.end() );
+    breaks.erase( vtkstd::unique( breaks.begin(), breaks.end() ), breaks.end() );
+
+    size_t ia = 0, ib = 0, ja = 0, jb = 0;
+    for (size_t i = 0; i + 1 < breaks.size(); i++)
+      {
+      const int start = breaks[i], end = breaks[i+1] - 1;
+      const bool insideA = IsInside(a, start, ia);
+      const bool insideB = IsInside(b, start, ib);
+
+      // The cells within, if the rows differ, are crossed by a single
+      // straight line.
+      if (insideA != insideB && end > start)
+        {
+        this->InsertLine( this->GetVEdgePoint(vEdges, start, v, insideA),
+                          this->GetVEdgePoint(vEdges, end, v, insideA) );
+        }
+
+      // The cell straddling the next break.
+      if (i + 2 < breaks.size())
+        {
+        const int u = end;
+        const bool corners[4] = { insideA, IsInside(a, u + 1, ja),
+                                  IsInside(b, u + 1, jb), insideB };
+        const int index = (corners[0] ? 1 : 0) | (corners[1] ? 2 : 0) |
+                          (corners[2] ? 4 : 0) | (corners[3] ? 8 : 0);
+        vtkIdType edgePoints[4];
+        for (const int *edge = segments[index]; *edge >= 0; edge++)
+          {
+          switch (*edge)
+            {
+            case 0:
+              edgePoints[0] = this->GetUEdgePoint(uEdges[0], u, v, corners[0]);
+              break;
+            case 1:
+              edgePoints[1] = this->GetVEdgePoint(vEdges, u + 1, v, corners[1]);
+              break;
+            case 2:
+              edgePoints[2] = this->GetUEdgePoint(uEdges[1], u, v + 1, corners[3]);
+              break;
+            case 3:
+              edgePoints[3] = this->GetVEdgePoint(vEdges, u, v, corners[0]);
+              break;
+            }
+          }
+        for (const int *edge = segments[index]; *edge >= 0; edge += 2)
+          {
+          this->InsertLine( edgePoints[edge[0]], edgePoints[edge[1]] );
+          }
+        }
+      }
+
+    // Row v+1 becomes row v of the next pair of rows.
+    runs[0].swap(runs[1]);
+    uEdges[0].swap(uEdges[1]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkKWEStencilContourFilter::ContourSlice( vtkImageStencilData *input,
+                              int extent[6], int axis, vtkPolyData *output )
+{
+  vtkPoints *points = vtkPoints::New();
+  vtkCellArray *lines = vtkCellArray::New();
+  vtkFloatArray *scalars = this->GetComputeScalars() ? vtkFloatArray::New() : NULL;
+
+  vtkKWEStencilContourFilterSlice slice;
+  slice.Stencil = input;
+  slice.Axis    = axis;
+  slice.AxisU   = (axis == 0) ? 1 : 0;
+  slice.AxisV   = (axis == 2) ? 1 : 2;
+  slice.Slice   = extent[2*axis];
+  slice.Points  = points;
+  slice.Lines   = lines;
+  input->GetOrigin(slice.Origin);
+  input->GetSpacing(slice.Spacing);
+  for (int i = 0; i < 6; i++)
+    {
+    slice.Extent[i] = extent[i];
+    }
+
+  // Contours of values outside ]0, 255[ are empty.
+  const int numberOfContours = this->GetNumberOfContours();
+  for (int c = 0; c < numberOfContours; c++)
+    {
+    const double value = this->GetValue(c);
+    if (value <= 0.0 || value >= 255.0)
+      {
+      continue;
+      }
+    const vtkIdType firstPoint = points->GetNumberOfPoints();
+    slice.Fraction = (255.0 - value) / 255.0;
+    slice.Execute();
+    if (scalars)
+      {
+      for (vtkIdType i = firstPoint; i < points->GetNumberOfPoints(); i++)
+        {
+        scalars->InsertNextValue(static_cast< float >(value));
+        }
+      }
+    }
+
+  output->Initialize();
+  output->SetPoints(points);
+  output->SetLines(lines);
+  if (scalars)
+    {
+    output->GetPointData()->SetScalars(scalars);
+    scalars->Delete();
+    }
+  points->Delete();
+  lines->Delete();
+}
+
 //----------------------------------------------------------------------------
 int vtkKWEStencilContourFilter::FillInputPortInformation(int, vtkInformation *info)
 {
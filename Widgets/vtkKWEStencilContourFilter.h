@@ -20,6 +20,11 @@
 //=============================================================================
 // .NAME vtkKWEStencilContourFilter - generate isosurface/isoline from a vtkImageStencilData
 // .SECTION Description
+// The stencil is contoured as an image of 255 inside and 0 outside. When the
+// extent is a single slice, isolines are generated directly from the runs
+// of the stencil, by marching squares over the runs of adjacent rows rather
+// than over every pixel. Lines along a run are generated as a single
+// segment. Thicker extents are rasterized and handed to vtkContourFilter.
 
 #ifndef __vtkKWEStencilContourFilter_h
 #define __vtkKWEStencilContourFilter_h
@@ -30,6 +35,7 @@
 class vtkContourFilter;
 class vtkImageStencilData;
 class vtkImageData;
+class vtkPolyData;
 
 class VTKEdge_WIDGETS_EXPORT vtkKWEStencilContourFilter : public vtkPolyDataAlgorithm
 {
@@ -97,6 +103,12 @@ protected:
                                   vtkInformationVector*);
   virtual int FillInputPortInformation(int port, vtkInformation *info);
 
+  // Description:
+  // Generate isolines for the slice "extent" directly from the runs of the
+  // stencil. "axis" is the axis along which the extent is one voxel thick.
+  void ContourSlice( vtkImageStencilData *, int extent[6], int axis,
+                     vtkPolyData * );
+
   vtkContourFilter *ContourFilter;
   vtkImageData     *ImageData;
   int               Extent[6];